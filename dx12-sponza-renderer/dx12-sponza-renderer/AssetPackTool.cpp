@@ -0,0 +1,2766 @@
+#include "AssetPackTool.h"
+#include "AssetPackage.h"
+#include "CameraPath.h"
+#include "CpuProfiler.h"
+#include "DeferredReleaseQueue.h"
+#include "FrameTelemetry.h"
+#include "FrustumCuller.h"
+#include "GeometryCodec.h"
+#include "GeometryLayout.h"
+#include "GpuProfileTree.h"
+#include "HeadlessFrameLoop.h"
+#include "JobSystem.h"
+#include "Lz4.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "RenderDevice.h"
+#include "RingAllocator.h"
+#include "StreamingQueue.h"
+#include "TextureContainer.h"
+#include "TextureLoader.h"
+#include "TextureResidency.h"
+#include "TlsfAllocator.h"
+#include "UploadService.h"
+#include "VirtualTexture.h"
+#ifdef _WIN32
+#include "D3D12RenderDevice.h"
+#include <d3dcompiler.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <thread>
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	int Pack(const std::vector<std::string>& args)
+	{
+		if (args.size() < 4) {
+			std::printf("usage: --pack <root> <output.pak> <file or directory>...\n");
+			return 1;
+		}
+		const std::filesystem::path root = args[1];
+
+		std::vector<std::filesystem::path> files;
+		for (size_t i = 3; i < args.size(); i++)
+		{
+			std::filesystem::path input = root / args[i];
+			std::error_code ec;
+			if (std::filesystem::is_directory(input, ec))
+			{
+				for (const auto& item : std::filesystem::recursive_directory_iterator(input, ec)) {
+					if (item.is_regular_file() && item.path().extension() != ".dxtex" &&
+						item.path().extension() != ".dxmesh") {
+						files.push_back(item.path());
+					}
+				}
+			}
+			else {
+				files.push_back(input);
+			}
+		}
+		// stable package layout regardless of directory iteration order
+		std::sort(files.begin(), files.end());
+
+		AssetPackageWriter writer;
+		std::string error;
+		for (const auto& file : files)
+		{
+			std::string name = file.lexically_relative(root).generic_string();
+			if (!writer.AddFileFromDisk(name, file.string(), error)) {
+				std::printf("error: %s\n", error.c_str());
+				return 1;
+			}
+		}
+
+		Clock::time_point start = Clock::now();
+		if (!writer.Write(args[2], error)) {
+			std::printf("error: %s\n", error.c_str());
+			return 1;
+		}
+		std::printf("packed %zu files, %.1f MB -> %.1f MB (%.1f%%) in %.0f ms\n", files.size(),
+			writer.GetUncompressedBytes() / 1048576.0, writer.GetCompressedBytes() / 1048576.0,
+			writer.GetUncompressedBytes() > 0 ? 100.0 * writer.GetCompressedBytes() / writer.GetUncompressedBytes() : 0.0,
+			MillisecondsSince(start));
+		return 0;
+	}
+
+	int Bench(const std::vector<std::string>& args)
+	{
+		if (args.size() < 3) {
+			std::printf("usage: --bench-package <root> <package.pak> [passes]\n");
+			return 1;
+		}
+		int passes = args.size() > 3 ? std::max(1, std::atoi(args[3].c_str())) : 5;
+
+		std::string error;
+		AssetPackage names;
+		if (!names.Open(args[2], error)) {
+			std::printf("error: %s\n", error.c_str());
+			return 1;
+		}
+
+		AssetFileSystem loose;
+		loose.SetRoot(std::filesystem::path(args[1]).generic_string() + "/");
+
+		std::vector<uint8_t> data;
+		for (int pass = 0; pass < passes; pass++)
+		{
+			// loose files
+			Clock::time_point start = Clock::now();
+			uint64_t looseBytes = 0;
+			for (uint32_t i = 0; i < names.GetEntryCount(); i++)
+			{
+				if (!loose.Read(names.GetEntryName(i), data, error)) {
+					std::printf("error: %s\n", error.c_str());
+					return 1;
+				}
+				looseBytes += data.size();
+			}
+			double looseTime = MillisecondsSince(start);
+
+			// the package, opened from scratch every pass
+			start = Clock::now();
+			AssetPackage package;
+			if (!package.Open(args[2], error)) {
+				std::printf("error: %s\n", error.c_str());
+				return 1;
+			}
+			double openTime = MillisecondsSince(start);
+			uint64_t packageBytes = 0;
+			for (uint32_t i = 0; i < package.GetEntryCount(); i++)
+			{
+				if (!package.Read(package.GetEntryName(i), data, error)) {
+					std::printf("error: %s\n", error.c_str());
+					return 1;
+				}
+				packageBytes += data.size();
+			}
+			double packageTime = MillisecondsSince(start);
+
+			std::printf("%s pass: loose %.1f ms (%.0f MB/s), package %.1f ms (open %.2f ms, %.0f MB/s), %u files\n",
+				pass == 0 ? "first" : "warm ", looseTime, looseBytes / 1048576.0 / (looseTime / 1000.0),
+				packageTime, openTime, packageBytes / 1048576.0 / (packageTime / 1000.0), package.GetEntryCount());
+		}
+		return 0;
+	}
+
+	size_t Lz4Size(const std::vector<uint8_t>& data)
+	{
+		std::vector<uint8_t> compressed(Lz4::CompressBound(data.size()));
+		return Lz4::Compress(data.data(), data.size(), compressed.data(), compressed.size());
+	}
+
+	int BenchGeometry(const std::vector<std::string>& args)
+	{
+		if (args.size() < 2) {
+			std::printf("usage: --bench-geometry <mesh.dxmesh> [passes]\n");
+			return 1;
+		}
+		int passes = args.size() > 2 ? std::max(1, std::atoi(args[2].c_str())) : 20;
+
+		std::string error;
+		std::vector<Mesh> meshes;
+		std::vector<Material> materials;
+		if (!MeshCache::Read(args[1], meshes, materials, error)) {
+			std::printf("error: %s\n", error.c_str());
+			return 1;
+		}
+
+		// every mesh back to back, raw and encoded, the way a loader would see them
+		std::vector<uint8_t> rawVertices;
+		std::vector<uint8_t> rawIndices;
+		std::vector<uint8_t> encodedVertices;
+		std::vector<uint8_t> encodedIndices;
+		std::vector<size_t> vertexBytes;
+		std::vector<size_t> indexBytes;
+		size_t vertexCount = 0;
+		size_t indexCount = 0;
+		for (const Mesh& mesh : meshes)
+		{
+			const uint8_t* vertices = reinterpret_cast<const uint8_t*>(mesh.vertices.data());
+			const uint8_t* indices = reinterpret_cast<const uint8_t*>(mesh.indices.data());
+			rawVertices.insert(rawVertices.end(), vertices, vertices + mesh.vertices.size() * sizeof(Vertex));
+			rawIndices.insert(rawIndices.end(), indices, indices + mesh.indices.size() * sizeof(uint32_t));
+
+			size_t offset = encodedVertices.size();
+			encodedVertices.resize(offset + GeometryCodec::VertexBound(mesh.vertices.size(), sizeof(Vertex)));
+			vertexBytes.push_back(GeometryCodec::EncodeVertices(encodedVertices.data() + offset, encodedVertices.size() - offset,
+				mesh.vertices.data(), mesh.vertices.size(), sizeof(Vertex)));
+			encodedVertices.resize(offset + vertexBytes.back());
+
+			offset = encodedIndices.size();
+			encodedIndices.resize(offset + GeometryCodec::IndexBound(mesh.indices.size()));
+			indexBytes.push_back(GeometryCodec::EncodeIndices(encodedIndices.data() + offset, encodedIndices.size() - offset,
+				mesh.indices.data(), mesh.indices.size()));
+			encodedIndices.resize(offset + indexBytes.back());
+
+			vertexCount += mesh.vertices.size();
+			indexCount += mesh.indices.size();
+		}
+
+		std::printf("%zu meshes, %zu vertices, %zu triangles\n", meshes.size(), vertexCount, indexCount / 3);
+		std::printf("vertices %.2f MB -> %.2f MB (%.1f%%), with lz4 %.1f%%, lz4 alone %.1f%%\n",
+			rawVertices.size() / 1048576.0, encodedVertices.size() / 1048576.0, 100.0 * encodedVertices.size() / rawVertices.size(),
+			100.0 * Lz4Size(encodedVertices) / rawVertices.size(), 100.0 * Lz4Size(rawVertices) / rawVertices.size());
+		std::printf("indices  %.2f MB -> %.2f MB (%.2f bytes per triangle), with lz4 %.1f%%, lz4 alone %.1f%%\n",
+			rawIndices.size() / 1048576.0, encodedIndices.size() / 1048576.0, encodedIndices.size() / (indexCount / 3.0),
+			100.0 * Lz4Size(encodedIndices) / rawIndices.size(), 100.0 * Lz4Size(rawIndices) / rawIndices.size());
+
+		// decode speed is measured on the decoded bytes, the same unit as disk bandwidth saved
+		typedef bool (*DecodeVerticesFunction)(void*, size_t, size_t, const uint8_t*, size_t);
+		const DecodeVerticesFunction decoders[2] = { GeometryCodec::DecodeVertices, GeometryCodec::DecodeVerticesScalar };
+		const char* decoderNames[2] = { "vertex decode", "vertex decode (scalar)" };
+		std::vector<uint8_t> decoded(std::max(rawVertices.size(), rawIndices.size()));
+		for (int decoder = 0; decoder < 3; decoder++)
+		{
+			Clock::time_point start = Clock::now();
+			bool ok = true;
+			for (int pass = 0; pass < passes; pass++)
+			{
+				size_t encodedOffset = 0;
+				size_t decodedOffset = 0;
+				for (size_t i = 0; i < meshes.size(); i++)
+				{
+					if (decoder < 2)
+					{
+						ok = ok && decoders[decoder](decoded.data() + decodedOffset, meshes[i].vertices.size(), sizeof(Vertex),
+							encodedVertices.data() + encodedOffset, vertexBytes[i]);
+						encodedOffset += vertexBytes[i];
+						decodedOffset += meshes[i].vertices.size() * sizeof(Vertex);
+					}
+					else
+					{
+						ok = ok && GeometryCodec::DecodeIndices(reinterpret_cast<uint32_t*>(decoded.data() + decodedOffset),
+							meshes[i].indices.size(), encodedIndices.data() + encodedOffset, indexBytes[i]);
+						encodedOffset += indexBytes[i];
+						decodedOffset += meshes[i].indices.size() * sizeof(uint32_t);
+					}
+				}
+			}
+			double time = MillisecondsSince(start) / passes;
+			size_t bytes = decoder < 2 ? rawVertices.size() : rawIndices.size();
+			bool same = decoder < 2 ? std::equal(rawVertices.begin(), rawVertices.end(), decoded.begin()) : ok;
+			std::printf("%-24s %.3f ms, %.2f GB/s%s\n", decoder < 2 ? decoderNames[decoder] : "index decode",
+				time, bytes / (time / 1000.0) / 1e9, ok && same ? "" : ", MISMATCH");
+			if (!ok || !same) {
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+	int BenchProfiler(const std::vector<std::string>& args)
+	{
+		int zones = args.size() > 1 ? std::max(1, std::atoi(args[1].c_str())) : 1000000;
+		PROFILE_THREAD("bench");
+
+		// warms up the thread's buffer and its first chunk
+		{
+			CpuProfileZone zone("warm up");
+		}
+
+		// the loop alone, the signal fences keep the compiler from folding it
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < zones; i++) {
+			std::atomic_signal_fence(std::memory_order_seq_cst);
+		}
+		double loopTime = MillisecondsSince(start);
+
+		start = Clock::now();
+		for (int i = 0; i < zones; i++) {
+			std::atomic_signal_fence(std::memory_order_seq_cst);
+			volatile uint64_t now = CpuProfiler::Now();
+			(void)now;
+		}
+		double counterTime = MillisecondsSince(start);
+
+		start = Clock::now();
+		for (int i = 0; i < zones; i++) {
+			std::atomic_signal_fence(std::memory_order_seq_cst);
+			CpuProfileZone zone("bench zone");
+		}
+		double zoneTime = MillisecondsSince(start);
+
+		std::printf("%d zones: %.1f ns per zone, %.1f ns per counter read, %s\n", zones,
+			(zoneTime - loopTime) * 1e6 / zones, (counterTime - loopTime) * 1e6 / zones,
+			CPU_PROFILER_ENABLED ? "zones enabled" : "zones compiled out");
+		std::printf("%llu events recorded, %llu dropped\n", static_cast<unsigned long long>(CpuProfiler::GetRecordedEvents()),
+			static_cast<unsigned long long>(CpuProfiler::GetDroppedEvents()));
+
+		if (args.size() > 2)
+		{
+			std::string error;
+			start = Clock::now();
+			if (!CpuProfiler::WriteChromeTrace(args[2], error)) {
+				std::printf("error: %s\n", error.c_str());
+				return 1;
+			}
+			std::printf("wrote %s in %.1f ms\n", args[2].c_str(), MillisecondsSince(start));
+		}
+		return 0;
+	}
+
+	struct SyntheticScope
+	{
+		const char* name;
+		uint32_t parent;
+		uint64_t begin; // ticks from the frame's base
+		uint64_t end;
+	};
+
+	// fills [begin, end) with up to three scopes per level, with gaps between
+	// them, in the order they begin like GpuProfiler records them. the few names
+	// make siblings share a path often
+	void GenerateScopes(std::mt19937& random, uint32_t parent, uint32_t depth, uint64_t begin, uint64_t end,
+		std::vector<SyntheticScope>& scopes)
+	{
+		static const char* names[] = { "clear", "meshes", "draw", "imgui" };
+		uint32_t children = depth == 0 ? 1 + random() % 3 : depth < 4 ? random() % 4 : 0;
+		uint64_t cursor = begin;
+		for (uint32_t i = 0; i < children; i++)
+		{
+			uint64_t childBegin = cursor + random() % ((end - cursor) / 4 + 1);
+			uint64_t childEnd = childBegin + random() % ((end - childBegin) / 2 + 1);
+			uint32_t index = static_cast<uint32_t>(scopes.size());
+			scopes.push_back({ names[random() % 4], parent, childBegin, childEnd });
+			GenerateScopes(random, index, depth + 1, childBegin, childEnd, scopes);
+			cursor = childEnd;
+		}
+	}
+
+	int BenchGpuProfileTree(const std::vector<std::string>& args)
+	{
+		int frames = args.size() > 1 ? std::max(1, std::atoi(args[1].c_str())) : 2000;
+		// GpuProfileTree's weight of the newest sample
+		const double averageWeight = 0.05;
+		std::mt19937 random(12345);
+		auto near = [](double value, double expected) { return std::abs(value - expected) <= 1e-6 * std::max(1.0, std::abs(expected)); };
+
+		// a microsecond per tick, the cpu clock at 10 MHz
+		GpuClockCalibration calibration;
+		calibration.gpuFrequency = 1000000;
+		calibration.cpuFrequency = 10000000;
+		calibration.cpuTimestamp = 1000000000;
+
+		// one frame by hand: three draws under meshes merge into one 6 ms sample
+		const uint32_t none = GpuScopeRecord::NoParent;
+		std::vector<GpuScopeRecord> records = {
+			{ "frame", none }, { "clear", 0 }, { "meshes", 0 }, { "draw", 2 }, { "draw", 2 }, { "draw", 2 }, { "imgui", 0 },
+		};
+		std::vector<uint64_t> timestamps = {
+			1000, 11000, 1000, 1500, 2000, 9000, 2000, 3000, 3000, 5000, 5000, 8000, 9000, 10500,
+		};
+		calibration.gpuTimestamp = 1000;
+		GpuProfileTree tree;
+		tree.AddFrame(1, records, timestamps.data(), calibration, 99999.0);
+		const GpuFrameProfile& first = tree.GetLatestFrame();
+		const std::vector<GpuScopeNode>& nodes = first.scopes;
+		if (!near(first.durationMs, 10.0) || !near(first.gpuStartMs, 100000.0) || !near(first.queueLatencyMs, 1.0) ||
+			nodes[3].depth != 2 || nodes[3].parent != 2 || nodes[6].parent != 0 || !near(nodes[0].selfMs, 1.0) ||
+			!near(nodes[2].selfMs, 1.0) || !near(nodes[4].startMs, 2.0) || !near(nodes[3].averageMs, 6.0) ||
+			!near(nodes[5].averageMs, 6.0) || !near(nodes[2].averageMs, 7.0)) {
+			std::printf("hand built frame: the tree is wrong, MISMATCH\n");
+			return 1;
+		}
+
+		// random trees against an average of their own, some frames straddling the
+		// counter wrapping around and some scopes ending before they began
+		GpuProfileTree randomTree;
+		std::map<std::string, double> averages;
+		std::map<std::string, double> totals;
+		std::vector<SyntheticScope> scopes;
+		std::vector<std::string> paths;
+		std::vector<double> childMs;
+		double averageFrameMs = 0.0;
+		uint32_t scopeCount = 0;
+		uint32_t wrappedFrames = 0;
+		uint32_t invalidScopes = 0;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			scopes.clear();
+			GenerateScopes(random, none, 0, 0, 20000, scopes);
+			records.clear();
+			timestamps.clear();
+			// one frame in four straddles the counter wrapping around or its top
+			// bit, where reading the raw ticks signed would flip
+			uint64_t base = (uint64_t(random()) << 32) | random();
+			if (frame % 4 == 0) {
+				base = (frame % 8 == 0 ? 0 : 1ull << 63) - random() % 20000;
+			}
+			uint64_t frameBegin = UINT64_MAX;
+			uint64_t frameEnd = 0;
+			for (auto& scope : scopes)
+			{
+				if (random() % 32 == 0 && scope.end > scope.begin) {
+					std::swap(scope.begin, scope.end);
+					invalidScopes++;
+				}
+				records.push_back({ scope.name, scope.parent });
+				timestamps.push_back(base + scope.begin);
+				timestamps.push_back(base + scope.end);
+				if (scope.end >= scope.begin)
+				{
+					frameBegin = std::min(frameBegin, scope.begin);
+					frameEnd = std::max(frameEnd, scope.end);
+				}
+			}
+			wrappedFrames += base + frameEnd < base;
+			calibration.gpuTimestamp = base + random() % 40000 - 20000ull;
+			double recordEndMs = calibration.cpuTimestamp * 1000.0 / calibration.cpuFrequency - random() % 5;
+			randomTree.AddFrame(frame, records, timestamps.data(), calibration, recordEndMs);
+			const GpuFrameProfile& profile = randomTree.GetLatestFrame();
+			scopeCount += static_cast<uint32_t>(scopes.size());
+			if (frameBegin > frameEnd) {
+				continue;
+			}
+
+			double frameMs = (frameEnd - frameBegin) / 1000.0;
+			double gpuStartMs = calibration.cpuTimestamp * 1000.0 / calibration.cpuFrequency +
+				static_cast<int64_t>(base + frameBegin - calibration.gpuTimestamp) / 1000.0;
+			averageFrameMs = frame == 0 ? frameMs : averageFrameMs + (frameMs - averageFrameMs) * averageWeight;
+			if (profile.scopes.size() != scopes.size() || !near(profile.durationMs, frameMs) || !near(profile.gpuStartMs, gpuStartMs) ||
+				!near(profile.queueLatencyMs, gpuStartMs - recordEndMs) || !near(randomTree.GetAverageFrameMs(), averageFrameMs)) {
+				std::printf("frame %d: %.3f ms from %.3f, expected %.3f ms from %.3f, MISMATCH\n", frame, profile.durationMs,
+					profile.gpuStartMs, frameMs, gpuStartMs);
+				return 1;
+			}
+
+			paths.assign(scopes.size(), std::string());
+			childMs.assign(scopes.size(), 0.0);
+			totals.clear();
+			for (uint32_t i = 0; i < scopes.size(); i++)
+			{
+				const SyntheticScope& scope = scopes[i];
+				paths[i] = scope.parent == none ? scope.name : paths[scope.parent] + "/" + scope.name;
+				if (scope.end >= scope.begin)
+				{
+					totals[paths[i]] += (scope.end - scope.begin) / 1000.0;
+					if (scope.parent != none) {
+						childMs[scope.parent] += (scope.end - scope.begin) / 1000.0;
+					}
+				}
+			}
+			for (const auto& [path, total] : totals)
+			{
+				auto average = averages.emplace(path, total);
+				if (!average.second) {
+					average.first->second += (total - average.first->second) * averageWeight;
+				}
+			}
+
+			for (uint32_t i = 0; i < scopes.size(); i++)
+			{
+				const SyntheticScope& scope = scopes[i];
+				const GpuScopeNode& node = profile.scopes[i];
+				bool valid = scope.end >= scope.begin;
+				uint32_t depth = 0;
+				for (uint32_t parent = scope.parent; parent != none; parent = scopes[parent].parent) {
+					depth++;
+				}
+				double durationMs = valid ? (scope.end - scope.begin) / 1000.0 : 0.0;
+				double startMs = valid ? (scope.begin - frameBegin) / 1000.0 : 0.0;
+				auto average = averages.find(paths[i]);
+				double averageMs = average != averages.end() ? average->second : 0.0;
+				if (node.valid != valid || node.parent != scope.parent || node.depth != depth || !near(node.durationMs, durationMs) ||
+					!near(node.startMs, startMs) || !near(node.selfMs, std::max(0.0, durationMs - childMs[i])) ||
+					!near(node.averageMs, averageMs)) {
+					std::printf("frame %d: scope %u %s, %.3f ms self %.3f average %.3f, expected %.3f, %.3f and %.3f, MISMATCH\n",
+						frame, i, paths[i].c_str(), node.durationMs, node.selfMs, node.averageMs, durationMs,
+						std::max(0.0, durationMs - childMs[i]), averageMs);
+					return 1;
+				}
+			}
+		}
+		std::printf("%d frames, %u scopes on %zu paths: nesting, merged siblings and averages match, %u frames wrapped, %u scopes ended before they began\n",
+			frames, scopeCount, averages.size(), wrappedFrames, invalidScopes);
+		return 0;
+	}
+
+	// a few microseconds of arithmetic the compiler can't drop
+	double SyntheticWork(size_t item, int iterations)
+	{
+		double value = static_cast<double>(item);
+		for (int i = 0; i < iterations; i++) {
+			value = std::sqrt(value * value + i + 1.0);
+		}
+		return value;
+	}
+
+	// every check runs rounds times, a scheduling race shows up as a wrong count
+	// or a hang rather than every time
+	bool StressJobs(JobSystem& jobs, int rounds)
+	{
+		for (int round = 0; round < rounds; round++)
+		{
+			// many tiny jobs on one counter
+			std::atomic<int> ran(0);
+			JobCounter counter;
+			for (int i = 0; i < 10000; i++) {
+				jobs.Run([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); }, &counter);
+			}
+			jobs.Wait(counter);
+			if (ran != 10000) {
+				std::printf("stress: %d of 10000 jobs ran\n", ran.load());
+				return false;
+			}
+
+			// jobs that wait on jobs of their own run others meanwhile
+			std::atomic<int> leaves(0);
+			JobCounter parents;
+			for (int i = 0; i < 64; i++)
+			{
+				jobs.Run([&jobs, &leaves]() {
+					JobCounter children;
+					for (int j = 0; j < 16; j++) {
+						jobs.Run([&leaves]() { leaves.fetch_add(1, std::memory_order_relaxed); }, &children);
+					}
+					jobs.Wait(children);
+				}, &parents);
+			}
+			jobs.Wait(parents);
+			if (leaves != 64 * 16) {
+				std::printf("stress: %d of %d nested jobs ran\n", leaves.load(), 64 * 16);
+				return false;
+			}
+
+			// a dependent job never starts before the jobs it depends on are done
+			std::atomic<int> first(0);
+			std::atomic<int> early(0);
+			JobCounter stage;
+			JobCounter dependents;
+			for (int i = 0; i < 32; i++) {
+				jobs.Run([&first]() { SyntheticWork(0, 200); first.fetch_add(1); }, &stage);
+			}
+			for (int i = 0; i < 32; i++) {
+				jobs.Run([&first, &early]() { if (first.load() != 32) early.fetch_add(1); }, &dependents, &stage);
+			}
+			jobs.Wait(dependents);
+			if (early != 0) {
+				std::printf("stress: %d dependent jobs started early\n", early.load());
+				return false;
+			}
+
+			// every index exactly once, from a thread that isn't a worker too
+			std::vector<std::atomic<uint8_t>> visits(100003);
+			for (auto& visit : visits) {
+				visit = 0;
+			}
+			std::thread outside([&]() {
+				jobs.ParallelFor(0, visits.size() / 2, 97, [&](size_t begin, size_t end) {
+					for (size_t i = begin; i < end; i++) {
+						visits[i].fetch_add(1, std::memory_order_relaxed);
+					}
+				});
+			});
+			jobs.ParallelFor(visits.size() / 2, visits.size(), 97, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					visits[i].fetch_add(1, std::memory_order_relaxed);
+				}
+			});
+			outside.join();
+			for (size_t i = 0; i < visits.size(); i++)
+			{
+				if (visits[i] != 1) {
+					std::printf("stress: index %zu visited %d times\n", i, int(visits[i]));
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	int BenchJobs(const std::vector<std::string>& args)
+	{
+		uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+		uint32_t maxWorkers = args.size() > 1 ? std::max(1, std::atoi(args[1].c_str())) : hardwareThreads;
+		int items = args.size() > 2 ? std::max(1, std::atoi(args[2].c_str())) : 20000;
+		PROFILE_THREAD("bench");
+
+		{
+			JobSystem jobs;
+			jobs.Initialize(maxWorkers - 1);
+			Clock::time_point start = Clock::now();
+			if (!StressJobs(jobs, 20)) {
+				return 1;
+			}
+			JobSystemStats stats = jobs.GetStats();
+			std::printf("stress passed with %u workers in %.1f ms, %llu jobs, %llu stolen, %llu injected\n", maxWorkers,
+				MillisecondsSince(start), static_cast<unsigned long long>(stats.jobs),
+				static_cast<unsigned long long>(stats.steals), static_cast<unsigned long long>(stats.injected));
+		}
+
+		// the same ParallelFor and the same number of empty jobs on 1, 2, 4 ...
+		// workers. more workers than hardware threads only adds overhead
+		std::printf("%d items, %u hardware threads\n", items, hardwareThreads);
+		double baseMs = 0.0;
+		for (uint32_t workers = 1; ; workers = std::min(workers * 2, maxWorkers))
+		{
+			JobSystem jobs;
+			jobs.Initialize(workers - 1);
+			std::vector<double> results(items);
+			auto work = [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					results[i] = SyntheticWork(i, 1000);
+				}
+			};
+			jobs.ParallelFor(0, results.size(), 16, work); // warm up
+
+			Clock::time_point start = Clock::now();
+			jobs.ParallelFor(0, results.size(), 16, work);
+			double forMs = MillisecondsSince(start);
+			baseMs = workers == 1 ? forMs : baseMs;
+
+			const int emptyJobs = 100000;
+			JobCounter counter;
+			start = Clock::now();
+			for (int i = 0; i < emptyJobs; i++) {
+				jobs.Run([]() {}, &counter);
+			}
+			jobs.Wait(counter);
+			double emptyMs = MillisecondsSince(start);
+
+			std::printf("%2u workers: parallel for %8.2f ms (%.2fx), %6.0f ns per empty job\n", workers, forMs,
+				baseMs / forMs, emptyMs * 1e6 / emptyJobs);
+			if (workers == maxWorkers) {
+				break;
+			}
+		}
+		return 0;
+	}
+
+#ifdef _WIN32
+	bool CompileShader(const wchar_t* filename, const D3D_SHADER_MACRO* defines, const char* target,
+		Microsoft::WRL::ComPtr<ID3DBlob>& shader)
+	{
+		Microsoft::WRL::ComPtr<ID3DBlob> errors;
+		if (FAILED(D3DCompileFromFile(filename, defines, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main", target,
+			D3DCOMPILE_ENABLE_STRICTNESS, 0, &shader, &errors))) {
+			std::printf("error: %s\n", errors ? static_cast<const char*>(errors->GetBufferPointer()) : "shader not found");
+			return false;
+		}
+		return true;
+	}
+#endif
+
+	int BenchFrames(const std::vector<std::string>& args)
+	{
+		if (args.size() < 2) {
+			std::printf("usage: --bench-frames <mesh.dxmesh | synthetic[:meshes]> [frames] [workers] [null | d3d12] [telemetry.json]\n");
+			return 1;
+		}
+		int frames = args.size() > 2 ? std::max(1, std::atoi(args[2].c_str())) : 1000;
+		uint32_t workers = args.size() > 3 ? std::max(1, std::atoi(args[3].c_str())) : std::max(1u, std::thread::hardware_concurrency());
+		std::string deviceName = args.size() > 4 ? args[4] : "null";
+		PROFILE_THREAD("bench");
+
+		std::string error;
+		std::vector<Mesh> meshes;
+		std::vector<Material> materials;
+		if (args[1].compare(0, 9, "synthetic") == 0) {
+			int count = args[1].size() > 10 ? std::max(1, std::atoi(args[1].c_str() + 10)) : 4096;
+			HeadlessFrameLoop::BuildSyntheticScene(count, meshes, materials);
+		}
+		else if (!MeshCache::Read(args[1], meshes, materials, error)) {
+			std::printf("error: %s\n", error.c_str());
+			return 1;
+		}
+
+		NullRenderDevice nullDevice;
+		RenderDevice* device = &nullDevice;
+		HeadlessFrameLoopDesc desc;
+#ifdef _WIN32
+		// a real device, the shaders are the renderer's own from the working directory
+		D3D12RenderDevice d3d12Device;
+		Microsoft::WRL::ComPtr<ID3D12Device> d3d12;
+		Microsoft::WRL::ComPtr<ID3DBlob> shaders[3];
+		if (deviceName == "d3d12")
+		{
+			D3D_SHADER_MACRO alphaTestDefines[] = { { "ALPHA_TEST", "1" }, { nullptr, nullptr } };
+			if (FAILED(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&d3d12))) ||
+				!d3d12Device.Initialize(d3d12.Get(), 4096)) {
+				std::printf("error: failed to create the d3d12 device\n");
+				return 1;
+			}
+			if (!CompileShader(L"VertexShader.hlsl", nullptr, "vs_5_0", shaders[0]) ||
+				!CompileShader(L"PixelShader.hlsl", nullptr, "ps_5_0", shaders[1]) ||
+				!CompileShader(L"PixelShader.hlsl", alphaTestDefines, "ps_5_0", shaders[2])) {
+				return 1;
+			}
+			RenderShader* targets[3] = { &desc.vertexShader, &desc.pixelShader, &desc.maskedPixelShader };
+			for (int i = 0; i < 3; i++) {
+				*targets[i] = { shaders[i]->GetBufferPointer(), shaders[i]->GetBufferSize() };
+			}
+			device = &d3d12Device;
+		}
+#endif
+		if (deviceName != "null" && device == &nullDevice) {
+			std::printf("error: unknown device %s\n", deviceName.c_str());
+			return 1;
+		}
+
+		JobSystem jobs;
+		jobs.Initialize(workers - 1);
+		FrameTelemetry telemetry;
+		NullRenderDeviceStats setupStats;
+		{
+			HeadlessFrameLoop loop;
+			if (!loop.Initialize(device, &jobs, desc, meshes, materials, error)) {
+				std::printf("error: %s\n", error.c_str());
+				return 1;
+			}
+			setupStats = nullDevice.GetStats();
+			Clock::time_point start = Clock::now();
+			for (int frame = 0; frame < frames; frame++) {
+				telemetry.Record(loop.RunFrame());
+			}
+			loop.WaitIdle();
+			double totalMs = MillisecondsSince(start);
+
+			const DrawRecorderStats& recorder = loop.GetRecorderStats();
+			std::printf("%s device, %d frames, %u draws in %u chunks on %u workers, %.3f ms per frame\n", deviceName.c_str(),
+				frames, recorder.draws, recorder.chunks, workers, totalMs / frames);
+		}
+
+		FrameTelemetryStats stats = telemetry.ComputeStats(FrameTelemetry::Capacity);
+		const FramePhase phases[] = { FramePhaseFrame, FramePhaseUpdate, FramePhaseRecord, FramePhaseSubmit, FramePhasePresentWait };
+		for (FramePhase phase : phases)
+		{
+			const FramePhaseStats& phaseStats = stats.phases[phase];
+			std::printf("%-13s avg %7.3f  p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f ms\n", FrameTelemetry::GetPhaseName(phase),
+				phaseStats.average, phaseStats.p50, phaseStats.p95, phaseStats.p99, phaseStats.max);
+		}
+		if (args.size() > 5 && !telemetry.WriteJson(args[5], error)) {
+			std::printf("error: %s\n", error.c_str());
+			return 1;
+		}
+
+		if (device != &nullDevice) {
+			return 0;
+		}
+		// what a frame costs the driver, without the setup uploads
+		NullRenderDeviceStats total = nullDevice.GetStats();
+		double perFrame = 1.0 / frames;
+		std::printf("per frame: %.0f lists, %.0f commands, %.0f draws, %.0f state changes, %.0f barriers, %.0f constant bytes, %.0f copy bytes\n",
+			(total.commandLists - setupStats.commandLists) * perFrame, (total.commands - setupStats.commands) * perFrame,
+			(total.draws - setupStats.draws) * perFrame, (total.stateChanges - setupStats.stateChanges) * perFrame,
+			(total.barriers - setupStats.barriers) * perFrame, (total.constantBytes - setupStats.constantBytes) * perFrame,
+			(total.copyBytes - setupStats.copyBytes) * perFrame);
+		std::printf("setup: %.2f MB copied, %.2f MB allocated, %u resources left\n", setupStats.copyBytes / 1048576.0,
+			setupStats.allocatedBytes / 1048576.0, total.resources);
+		if (total.errors > 0)
+		{
+			std::printf("%llu validation errors\n", static_cast<unsigned long long>(total.errors));
+			for (const std::string& message : nullDevice.GetErrors()) {
+				std::printf("  %s\n", message.c_str());
+			}
+			return 1;
+		}
+		return 0;
+	}
+
+	// a camera somewhere in the cube of boxes looking in any direction, with
+	// the renderer's field of view
+	FrustumPlanes RandomFrustum(std::mt19937& random, float extent)
+	{
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+		DirectX::XMFLOAT3 eye(position(random), position(random), position(random));
+		DirectX::XMFLOAT3 forward(direction(random), direction(random), direction(random) + 0.01f);
+		DirectX::XMMATRIX view = DirectX::XMMatrixLookToLH(DirectX::XMLoadFloat3(&eye), DirectX::XMLoadFloat3(&forward),
+			DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV4, 16.0f / 9.0f, 0.1f, extent);
+		DirectX::XMFLOAT4X4 viewProjection;
+		DirectX::XMStoreFloat4x4(&viewProjection, DirectX::XMMatrixMultiply(view, projection));
+		return ExtractFrustumPlanes(viewProjection);
+	}
+
+	void AddRandomBoxes(FrustumCuller& culler, uint32_t count, std::mt19937& random, float extent)
+	{
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> size(0.1f, extent * 0.02f);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			DirectX::XMFLOAT3 boundsMin(position(random), position(random), position(random));
+			DirectX::XMFLOAT3 boundsMax(boundsMin.x + size(random), boundsMin.y + size(random), boundsMin.z + size(random));
+			culler.Add(boundsMin, boundsMax);
+		}
+	}
+
+	int BenchCulling(const std::vector<std::string>& args)
+	{
+		uint32_t boxes = args.size() > 1 ? std::max(1, std::atoi(args[1].c_str())) : 1000000;
+		int passes = args.size() > 2 ? std::max(1, std::atoi(args[2].c_str())) : 100;
+		const float extent = 100.0f;
+		std::mt19937 random(12345);
+
+		// every path against the scalar one, on small sets for the partial
+		// blocks at the end and on random frusta
+		std::vector<CullPath> paths;
+		for (int path = CullPathScalar; path < CullPathCount; path++) {
+			if (FrustumCuller::IsSupported(static_cast<CullPath>(path))) {
+				paths.push_back(static_cast<CullPath>(path));
+			}
+		}
+		std::vector<uint32_t> expected;
+		std::vector<uint32_t> visible;
+		for (uint32_t trial = 0; trial < 2000; trial++)
+		{
+			FrustumCuller culler;
+			AddRandomBoxes(culler, trial % 67, random, extent * 0.25f);
+			FrustumPlanes planes = RandomFrustum(random, extent * 0.25f);
+			expected.resize(culler.GetCount());
+			visible.resize(culler.GetCount());
+			culler.path = CullPathScalar;
+			expected.resize(culler.Cull(planes, expected.data()));
+			for (CullPath path : paths)
+			{
+				culler.path = path;
+				visible.resize(culler.Cull(planes, visible.data()));
+				if (visible != expected) {
+					std::printf("%s culling doesn't match scalar, %u boxes\n", FrustumCuller::GetPathName(path), culler.GetCount());
+					return 1;
+				}
+			}
+		}
+
+		FrustumCuller culler;
+		culler.Reserve(boxes);
+		AddRandomBoxes(culler, boxes, random, extent);
+		std::vector<FrustumPlanes> frusta;
+		for (int i = 0; i < 16; i++) {
+			frusta.push_back(RandomFrustum(random, extent));
+		}
+		std::printf("%u boxes, %d passes over %zu frusta, %zu paths match scalar on 2000 random sets\n", boxes, passes,
+			frusta.size(), paths.size());
+		expected.resize(boxes);
+		visible.resize(boxes);
+		double scalarMs = 0.0;
+		for (CullPath path : paths)
+		{
+			culler.path = path;
+			uint64_t visibleTotal = 0;
+			Clock::time_point start = Clock::now();
+			for (int pass = 0; pass < passes; pass++)
+			{
+				const FrustumPlanes& planes = frusta[pass % frusta.size()];
+				visibleTotal += culler.Cull(planes, visible.data());
+			}
+			double time = MillisecondsSince(start) / passes;
+			// the last pass' frustum once more, against scalar
+			culler.path = CullPathScalar;
+			uint32_t expectedCount = culler.Cull(frusta[(passes - 1) % frusta.size()], expected.data());
+			culler.path = path;
+			uint32_t count = culler.Cull(frusta[(passes - 1) % frusta.size()], visible.data());
+			bool same = count == expectedCount && std::equal(expected.begin(), expected.begin() + count, visible.begin());
+			if (path == CullPathScalar) {
+				scalarMs = time;
+			}
+			std::printf("%-7s %.3f ms, %.2f ns per box, %.1fx scalar, %.1f%% visible%s\n", FrustumCuller::GetPathName(path), time,
+				time * 1e6 / boxes, time > 0.0 ? scalarMs / time : 0.0, 100.0 * visibleTotal / (static_cast<double>(boxes) * passes),
+				same ? "" : ", MISMATCH");
+			if (!same) {
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+	// square masks of the kinds alpha testing is used for, with thin features
+	// that plain box filtered mips lose first
+	void BuildSyntheticMask(int kind, uint32_t size, TextureData& texture, std::mt19937& random)
+	{
+		TextureMip mip;
+		mip.width = size;
+		mip.height = size;
+		mip.pixels.assign(size_t(size) * size * 4, 255);
+		std::uniform_int_distribution<int> noise(0, 255);
+		std::uniform_int_distribution<uint32_t> position(0, size - 1);
+		std::uniform_int_distribution<uint32_t> width(1, 3);
+		for (uint32_t i = 0; i < size * size; i++) {
+			mip.pixels[i * 4 + 3] = kind == 2 && noise(random) < 77 ? 255 : 0; // leaves, 30% scattered
+		}
+		if (kind == 0)
+		{
+			// grass blades, 1 to 3 texels wide at random places
+			for (uint32_t blade = 0; blade < size / 2; blade++)
+			{
+				uint32_t x = position(random);
+				uint32_t top = position(random);
+				uint32_t bladeWidth = width(random);
+				for (uint32_t y = top; y < size; y++) {
+					for (uint32_t dx = 0; dx < bladeWidth && x + dx < size; dx++) {
+						mip.pixels[(size_t(y) * size + x + dx) * 4 + 3] = 255;
+					}
+				}
+			}
+		}
+		else if (kind == 1)
+		{
+			// chain link wire, 2 texels wide diagonals 23 apart
+			for (uint32_t y = 0; y < size; y++) {
+				for (uint32_t x = 0; x < size; x++) {
+					if ((x + y) % 23 < 2 || (x + size - y) % 23 < 2) {
+						mip.pixels[(size_t(y) * size + x) * 4 + 3] = 255;
+					}
+				}
+			}
+		}
+		texture.mips.clear();
+		texture.mips.push_back(std::move(mip));
+	}
+
+	// the largest difference between a mip's alpha coverage and mip 0's over
+	// the mips with at least minTexels texels
+	float MaxCoverageError(const TextureData& texture, float alphaCutoff, uint32_t minTexels)
+	{
+		float coverage = TextureLoader::ComputeAlphaCoverage(texture.mips[0], alphaCutoff);
+		float maxError = 0.0f;
+		for (uint32_t mip = 1; mip < texture.MipCount(); mip++)
+		{
+			const TextureMip& level = texture.mips[mip];
+			if (level.width * level.height >= minTexels) {
+				maxError = std::max(maxError, std::abs(TextureLoader::ComputeAlphaCoverage(level, alphaCutoff) - coverage));
+			}
+		}
+		return maxError;
+	}
+
+	int BenchCoverage(const std::vector<std::string>& args)
+	{
+		// TextureStreamer's cutoff. small mips don't have enough texels to hit
+		// the coverage of mip 0 exactly
+		const float alphaCutoff = 0.5f;
+		const float tolerance = 0.05f;
+		const uint32_t minTexels = 1024;
+
+		std::vector<std::string> names = { "synthetic blades", "synthetic wire", "synthetic noise" };
+		std::vector<TextureData> masks(names.size());
+		std::mt19937 random(12345);
+		for (size_t i = 0; i < masks.size(); i++) {
+			BuildSyntheticMask(static_cast<int>(i), 512, masks[i], random);
+		}
+		// images whose alpha is the mask, like sponza's chain and thorn textures
+		for (size_t i = 1; i < args.size(); i++)
+		{
+			TextureData texture;
+			std::string error;
+			if (!TextureLoader::LoadTexture(args[i], texture, error)) {
+				std::printf("error: %s\n", error.c_str());
+				return 1;
+			}
+			texture.mips.resize(1);
+			names.push_back(args[i]);
+			masks.push_back(std::move(texture));
+		}
+
+		bool passed = true;
+		for (size_t i = 0; i < masks.size(); i++)
+		{
+			TextureData plain = masks[i];
+			TextureLoader::GenerateMips(plain);
+			TextureData preserved = masks[i];
+			TextureLoader::GenerateMipsPreservingCoverage(preserved, alphaCutoff);
+			float plainError = MaxCoverageError(plain, alphaCutoff, minTexels);
+			float preservedError = MaxCoverageError(preserved, alphaCutoff, minTexels);
+			bool ok = preservedError <= tolerance;
+			passed = passed && ok;
+			std::printf("%-40s coverage %.3f, max mip error %.3f box filtered, %.3f preserved%s\n", names[i].c_str(),
+				TextureLoader::ComputeAlphaCoverage(masks[i].mips[0], alphaCutoff), plainError, preservedError,
+				ok ? "" : ", OVER TOLERANCE");
+		}
+		std::printf("%s, tolerance %.2f on mips of %u texels or more\n", passed ? "passed" : "failed", tolerance, minTexels);
+		return passed ? 0 : 1;
+	}
+	// a fake scene for the residency manager, objects along both walls of a
+	// corridor down z, textures shared between them the way materials are
+	struct ResidencyObject
+	{
+		uint32_t texture;
+		DirectX::XMFLOAT3 boundsMin;
+		DirectX::XMFLOAT3 boundsMax;
+	};
+
+	int BenchResidency(const std::vector<std::string>& args)
+	{
+		int frames = args.size() > 1 ? std::max(1, std::atoi(args[1].c_str())) : 3000;
+		uint64_t budgetBytes = (args.size() > 2 ? std::max(1, std::atoi(args[2].c_str())) : 32) * 1024ull * 1024;
+		// TextureStreamer's defaults and the app's viewport
+		const uint32_t maxMipLoads = 8;
+		const float viewportHeight = 1080.0f;
+		const float verticalFov = 1.0472f;
+		const float worldUnitsPerUV = 4.0f;
+		std::mt19937 random(12345);
+
+		TextureResidencyManager residency(budgetBytes);
+		std::vector<uint32_t> widths;
+		std::vector<uint32_t> heights;
+		std::uniform_int_distribution<uint32_t> sizeShift(0, 3);
+		for (uint32_t i = 0; i < 48; i++)
+		{
+			widths.push_back(256u << sizeShift(random));
+			heights.push_back(256u << sizeShift(random));
+			residency.RegisterTexture(widths.back(), heights.back(), 4);
+		}
+		if (residency.GetStats().tailBytes > budgetBytes) {
+			std::printf("the mip tails alone are %llu bytes, over the budget\n",
+				static_cast<unsigned long long>(residency.GetStats().tailBytes));
+			return 1;
+		}
+
+		std::vector<ResidencyObject> objects;
+		for (uint32_t i = 0; i < 100; i++)
+		{
+			float x = i % 2 ? 6.0f : -10.0f;
+			float z = (i / 2) * 4.0f;
+			objects.push_back({ i % static_cast<uint32_t>(widths.size()), { x, 0.0f, z }, { x + 4.0f, 8.0f, z + 4.0f } });
+		}
+
+		// down the corridor, up against a wall, back up and out past its end
+		CameraPath path;
+		path.SetInterval(1.0f);
+		path.AddKey({ { 0.0f, 2.0f, -10.0f }, { 0.0f, 2.0f, 10.0f } });
+		path.AddKey({ { 0.0f, 2.0f, 40.0f }, { 0.0f, 2.0f, 60.0f } });
+		path.AddKey({ { 4.0f, 3.0f, 80.0f }, { 8.0f, 3.0f, 82.0f } });
+		path.AddKey({ { 5.0f, 3.0f, 120.0f }, { 8.0f, 3.0f, 122.0f } });
+		path.AddKey({ { 0.0f, 2.0f, 190.0f }, { 0.0f, 2.0f, 210.0f } });
+		path.AddKey({ { 0.0f, 2.0f, 150.0f }, { 0.0f, 2.0f, 100.0f } });
+		path.AddKey({ { -4.0f, 2.0f, 60.0f }, { -10.0f, 2.0f, 58.0f } });
+		path.AddKey({ { 0.0f, 20.0f, -60.0f }, { 0.0f, 2.0f, 100.0f } });
+
+		std::vector<TextureResidencyChange> changes;
+		uint64_t maxOverBudget = 0;
+		uint32_t overBudgetFrames = 0;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			// the budget is lowered halfway through the path like the app's setting can be
+			if (frame == frames / 2) {
+				residency.SetBudget(budgetBytes / 2);
+			}
+			float time = path.GetDuration() * frame / std::max(1, frames - 1);
+			DirectX::XMFLOAT3 camera = path.Sample(time).position;
+
+			residency.BeginFrame(frame + 1);
+			for (const auto& object : objects)
+			{
+				// distance to the closest point of the bounds, as UpdateTextureStreaming
+				float dx = std::max({ object.boundsMin.x - camera.x, 0.0f, camera.x - object.boundsMax.x });
+				float dy = std::max({ object.boundsMin.y - camera.y, 0.0f, camera.y - object.boundsMax.y });
+				float dz = std::max({ object.boundsMin.z - camera.z, 0.0f, camera.z - object.boundsMax.z });
+				float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+				float desiredMip = TextureResidencyManager::ComputeDesiredMip(widths[object.texture], heights[object.texture],
+					worldUnitsPerUV, distance, viewportHeight, verticalFov);
+				residency.RequestMip(object.texture, desiredMip, 4.0f / std::max(distance, 1.0f));
+			}
+			changes.clear();
+			residency.Update(maxMipLoads, changes);
+
+			// the stats against the resident mips
+			const TextureResidencyStats& stats = residency.GetStats();
+			uint64_t residentBytes = 0;
+			for (uint32_t texture = 0; texture < residency.GetTextureCount(); texture++)
+			{
+				for (uint32_t mip = residency.GetResidentMip(texture); mip < residency.GetMipCount(texture); mip++) {
+					residentBytes += uint64_t(std::max(1u, widths[texture] >> mip)) * std::max(1u, heights[texture] >> mip) * 4;
+				}
+			}
+			if (residentBytes != stats.residentBytes) {
+				std::printf("frame %d: %llu bytes resident, the stats say %llu, MISMATCH\n", frame,
+					static_cast<unsigned long long>(residentBytes), static_cast<unsigned long long>(stats.residentBytes));
+				return 1;
+			}
+			if (residentBytes > residency.GetBudget())
+			{
+				maxOverBudget = std::max(maxOverBudget, residentBytes - residency.GetBudget());
+				overBudgetFrames++;
+			}
+		}
+
+		const TextureResidencyStats& stats = residency.GetStats();
+		std::printf("%d frames, %u textures on %zu objects, budget %llu MB then %llu MB\n", frames,
+			residency.GetTextureCount(), objects.size(), static_cast<unsigned long long>(budgetBytes >> 20),
+			static_cast<unsigned long long>(budgetBytes >> 21));
+		std::printf("%llu mip loads, %llu evictions, peak %.1f MB, tails %.1f MB, %u requests pending at the end\n",
+			static_cast<unsigned long long>(stats.totalMipLoads), static_cast<unsigned long long>(stats.totalMipEvictions),
+			stats.peakResidentBytes / 1048576.0, stats.tailBytes / 1048576.0, stats.pendingRequests);
+		if (overBudgetFrames > 0) {
+			std::printf("over the budget after %u updates, by up to %llu bytes\n", overBudgetFrames,
+				static_cast<unsigned long long>(maxOverBudget));
+			return 1;
+		}
+		std::printf("never over the budget after an update\n");
+		return 0;
+	}
+	int BenchTlsf(const std::vector<std::string>& args)
+	{
+		int steps = args.size() > 1 ? std::max(1, std::atoi(args[1].c_str())) : 200000;
+		// a GpuHeapAllocator sized heap, placed resources and buffers of every size
+		const uint64_t heapSize = 64ull * 1024 * 1024;
+		const uint64_t alignments[] = { 256, 4096, 65536 };
+		std::mt19937 random(12345);
+		std::uniform_int_distribution<int> percent(0, 99);
+		std::uniform_int_distribution<uint64_t> smallSize(1, 64 * 1024);
+		std::uniform_int_distribution<uint64_t> largeSize(64 * 1024, 4 * 1024 * 1024);
+		std::uniform_int_distribution<int> alignment(0, 2);
+
+		// random allocs and frees, each checked against the live ranges by
+		// offset for overlap, and the allocator validated after every step
+		TlsfAllocator allocator(heapSize);
+		std::map<uint64_t, uint64_t> live; // offset to size
+		std::vector<uint64_t> liveOffsets;
+		uint32_t failedAllocations = 0;
+		uint64_t peakUsed = 0;
+		for (int step = 0; step < steps; step++)
+		{
+			// mostly allocate until about half of the heap is used, then hover there
+			bool allocate = liveOffsets.empty() || percent(random) < (allocator.GetStats().usedBytes < heapSize / 2 ? 70 : 45);
+			if (allocate)
+			{
+				uint64_t size = percent(random) < 85 ? smallSize(random) : largeSize(random);
+				uint64_t align = alignments[alignment(random)];
+				uint64_t offset = allocator.Allocate(size, align);
+				if (offset == TlsfAllocator::InvalidOffset) {
+					failedAllocations++;
+				}
+				else
+				{
+					if (offset % align != 0 || offset + size > heapSize) {
+						std::printf("step %d: %llu bytes at %llu, misaligned or out of range\n", step,
+							static_cast<unsigned long long>(size), static_cast<unsigned long long>(offset));
+						return 1;
+					}
+					auto next = live.lower_bound(offset);
+					bool overlaps = (next != live.end() && next->first < offset + size);
+					if (next != live.begin() && std::prev(next)->first + std::prev(next)->second > offset) {
+						overlaps = true;
+					}
+					if (overlaps) {
+						std::printf("step %d: %llu bytes at %llu overlap a live allocation\n", step,
+							static_cast<unsigned long long>(size), static_cast<unsigned long long>(offset));
+						return 1;
+					}
+					live[offset] = size;
+					liveOffsets.push_back(offset);
+				}
+			}
+			else
+			{
+				std::uniform_int_distribution<size_t> pick(0, liveOffsets.size() - 1);
+				size_t index = pick(random);
+				allocator.Free(liveOffsets[index]);
+				live.erase(liveOffsets[index]);
+				liveOffsets[index] = liveOffsets.back();
+				liveOffsets.pop_back();
+			}
+
+			TlsfStats stats = allocator.GetStats();
+			peakUsed = std::max(peakUsed, stats.usedBytes);
+			if (!allocator.Validate() || stats.allocations != live.size() || stats.usedBytes + stats.freeBytes != heapSize) {
+				std::printf("step %d: validation failed after %s\n", step, allocate ? "an allocation" : "a free");
+				return 1;
+			}
+		}
+		TlsfStats stats = allocator.GetStats();
+		std::printf("%d random steps validated, %zu live, %u allocations failed, peak %.1f of %.1f MB used, fragmentation %.2f\n",
+			steps, live.size(), failedAllocations, peakUsed / 1048576.0, heapSize / 1048576.0, stats.Fragmentation());
+
+		// everything freed has to merge back into one block
+		for (uint64_t offset : liveOffsets) {
+			allocator.Free(offset);
+		}
+		stats = allocator.GetStats();
+		if (!allocator.Validate() || !allocator.IsEmpty() || stats.freeBlocks != 1 || stats.largestFreeBlock != heapSize) {
+			std::printf("freeing everything left %u free blocks, MISMATCH\n", stats.freeBlocks);
+			return 1;
+		}
+
+		// alloc and free pairs with a working set of 1024 live allocations
+		const int timedOps = 1000000;
+		std::vector<uint64_t> sizes(4096);
+		for (auto& size : sizes) {
+			size = smallSize(random);
+		}
+		std::vector<uint64_t> ring(1024, uint64_t(TlsfAllocator::InvalidOffset));
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < timedOps; i++)
+		{
+			uint64_t& slot = ring[i % ring.size()];
+			if (slot != TlsfAllocator::InvalidOffset) {
+				allocator.Free(slot);
+			}
+			slot = allocator.Allocate(sizes[i % sizes.size()], 256);
+		}
+		double time = MillisecondsSince(start);
+		std::printf("%d alloc and free pairs, %.1f ns per pair\n", timedOps, time * 1e6 / timedOps);
+		return 0;
+	}
+	// a GeometryPool without the device: vertex and index buffers are arrays,
+	// every element tagged with the mesh it belongs to and its position there
+	struct SimulatedGeometryPool
+	{
+		GeometryLayout layout;
+		std::vector<uint64_t> vertices;
+		std::vector<uint64_t> indices;
+		std::vector<GeometryCopyRun> vertexCopies;
+		std::vector<GeometryCopyRun> indexCopies;
+		std::vector<uint64_t> serials; // by mesh id
+		uint64_t nextSerial = 1;
+		uint32_t grows = 0;
+		uint32_t compactions = 0;
+		const char* error = nullptr; // why the last Rebuild failed
+
+		static uint64_t Tag(uint64_t serial, uint32_t element) { return (serial << 32) | element; }
+
+		// mirrors GeometryPool::Rebuild
+		bool Rebuild(uint32_t vertexCapacity, uint32_t indexCapacity)
+		{
+			if (!layout.Relayout(vertexCapacity, indexCapacity, vertexCopies, indexCopies))
+			{
+				error = "relayout failed";
+				return false;
+			}
+			error = ApplyCopies(vertices, vertexCapacity, vertexCopies);
+			if (!error) {
+				error = ApplyCopies(indices, indexCapacity, indexCopies);
+			}
+			return !error;
+		}
+
+		static const char* ApplyCopies(std::vector<uint64_t>& buffer, uint32_t capacity, const std::vector<GeometryCopyRun>& copies)
+		{
+			std::vector<uint64_t> rebuilt(capacity, 0);
+			for (size_t i = 0; i < copies.size(); i++)
+			{
+				const GeometryCopyRun& run = copies[i];
+				if (run.count == 0 || run.source + run.count > buffer.size() || run.destination + run.count > capacity) {
+					return "copy run out of range";
+				}
+				if (i > 0)
+				{
+					const GeometryCopyRun& previous = copies[i - 1];
+					// index ranges needn't be in vertex order, so only destinations are sorted
+					if (previous.destination + previous.count > run.destination) {
+						return "copy runs overlap or are out of order";
+					}
+					if (previous.source + previous.count == run.source && previous.destination + previous.count == run.destination) {
+						return "copy runs not merged";
+					}
+				}
+				std::copy(buffer.begin() + run.source, buffer.begin() + run.source + run.count, rebuilt.begin() + run.destination);
+			}
+			buffer.swap(rebuilt);
+			return nullptr;
+		}
+
+		// mirrors GeometryPool::AddMesh
+		uint32_t Add(uint32_t vertexCount, uint32_t indexCount, float growthFactor)
+		{
+			uint32_t id = layout.Add(vertexCount, indexCount);
+			if (id == ~0u)
+			{
+				uint64_t vertexCapacity = std::max<uint64_t>(uint64_t(layout.GetVertexCapacity() * growthFactor), layout.GetVertexStats().usedBytes + vertexCount);
+				uint64_t indexCapacity = std::max<uint64_t>(uint64_t(layout.GetIndexCapacity() * growthFactor), layout.GetIndexStats().usedBytes + indexCount);
+				if (!Rebuild(static_cast<uint32_t>(vertexCapacity), static_cast<uint32_t>(indexCapacity))) {
+					return ~0u;
+				}
+				grows++;
+				id = layout.Add(vertexCount, indexCount);
+				if (id == ~0u) {
+					return ~0u;
+				}
+			}
+			if (id >= serials.size()) {
+				serials.resize(id + 1, 0);
+			}
+			serials[id] = nextSerial++;
+			const GeometryRange& range = layout.GetRange(id);
+			for (uint32_t i = 0; i < vertexCount; i++) {
+				vertices[range.baseVertex + i] = Tag(serials[id], i);
+			}
+			for (uint32_t i = 0; i < indexCount; i++) {
+				indices[range.firstIndex + i] = Tag(serials[id], i);
+			}
+			return id;
+		}
+
+		float Fragmentation() const {
+			return std::max(layout.GetVertexStats().Fragmentation(), layout.GetIndexStats().Fragmentation());
+		}
+
+		// every live mesh has to find its own elements at its current range
+		bool Check(uint32_t& wrongMesh) const
+		{
+			for (uint32_t id = 0; id < layout.GetMeshIdCount(); id++)
+			{
+				if (!layout.IsLive(id)) {
+					continue;
+				}
+				const GeometryRange& range = layout.GetRange(id);
+				bool correct = uint64_t(range.baseVertex) + range.vertexCount <= layout.GetVertexCapacity() &&
+					uint64_t(range.firstIndex) + range.indexCount <= layout.GetIndexCapacity();
+				for (uint32_t i = 0; correct && i < range.vertexCount; i++) {
+					correct = vertices[range.baseVertex + i] == Tag(serials[id], i);
+				}
+				for (uint32_t i = 0; correct && i < range.indexCount; i++) {
+					correct = indices[range.firstIndex + i] == Tag(serials[id], i);
+				}
+				if (!correct)
+				{
+					wrongMesh = id;
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	int BenchGeometryLayout(const std::vector<std::string>& args)
+	{
+		int cycles = args.size() > 1 ? std::max(1, std::atoi(args[1].c_str())) : 2000;
+		const float growthFactor = 1.5f;
+		const float compactThreshold = 0.25f;
+		std::mt19937 random(12345);
+		std::uniform_int_distribution<uint32_t> vertexCount(1, 2000);
+		std::uniform_int_distribution<int> percent(0, 99);
+
+		SimulatedGeometryPool pool;
+		pool.layout.Reset(0, 0);
+		if (!pool.Rebuild(4096, 8192)) {
+			std::printf("initial rebuild: %s, MISMATCH\n", pool.error);
+			return 1;
+		}
+
+		// relayout into buffers too small for the live meshes has to leave everything as it was
+		std::vector<uint32_t> live;
+		for (int i = 0; i < 8; i++)
+		{
+			live.push_back(pool.Add(1000, 3000, growthFactor));
+			if (live.back() == ~0u) {
+				std::printf("growing to 8 meshes: %s, MISMATCH\n", pool.error ? pool.error : "no range");
+				return 1;
+			}
+		}
+		GeometryRange before = pool.layout.GetRange(live[3]);
+		uint32_t capacityBefore = pool.layout.GetVertexCapacity();
+		uint32_t wrongMesh = 0;
+		if (pool.layout.Relayout(7999, 24000, pool.vertexCopies, pool.indexCopies) || !pool.vertexCopies.empty() ||
+			pool.layout.GetVertexCapacity() != capacityBefore || pool.layout.GetRange(live[3]).baseVertex != before.baseVertex ||
+			!pool.Check(wrongMesh)) {
+			std::printf("a relayout that doesn't fit changed the layout, MISMATCH\n");
+			return 1;
+		}
+
+		// add/remove cycles, with the compaction check GeometryPool runs every frame
+		uint64_t relocatedMeshes = 0;
+		uint64_t vertexRuns = 0;
+		uint64_t indexRuns = 0;
+		uint32_t peakMeshes = 0;
+		for (int cycle = 0; cycle < cycles; cycle++)
+		{
+			// drift between a few and a few hundred meshes
+			int removes = live.empty() ? 0 : std::uniform_int_distribution<int>(0, std::min<int>(int(live.size()), 12))(random);
+			int adds = std::uniform_int_distribution<int>(0, live.size() < 300 ? 12 : 8)(random);
+			for (int i = 0; i < removes; i++)
+			{
+				size_t index = std::uniform_int_distribution<size_t>(0, live.size() - 1)(random);
+				pool.layout.Remove(live[index]);
+				live[index] = live.back();
+				live.pop_back();
+			}
+			for (int i = 0; i < adds; i++)
+			{
+				uint32_t vertices = percent(random) < 90 ? vertexCount(random) % 200 + 1 : vertexCount(random);
+				uint32_t id = pool.Add(vertices, vertices * 3, growthFactor);
+				if (id == ~0u) {
+					std::printf("cycle %d: adding %u vertices: %s, MISMATCH\n", cycle, vertices, pool.error ? pool.error : "no range");
+					return 1;
+				}
+				live.push_back(id);
+			}
+			peakMeshes = std::max(peakMeshes, pool.layout.GetMeshCount());
+
+			if (pool.Fragmentation() > compactThreshold)
+			{
+				std::vector<GeometryRange> ranges;
+				for (uint32_t id : live) {
+					ranges.push_back(pool.layout.GetRange(id));
+				}
+				if (!pool.Rebuild(pool.layout.GetVertexCapacity(), pool.layout.GetIndexCapacity())) {
+					std::printf("cycle %d: compaction: %s, MISMATCH\n", cycle, pool.error);
+					return 1;
+				}
+				pool.compactions++;
+				vertexRuns += pool.vertexCopies.size();
+				indexRuns += pool.indexCopies.size();
+
+				// a repack leaves one free block behind, so the next frame's check does nothing
+				uint64_t liveVertices = 0;
+				uint64_t liveIndices = 0;
+				for (size_t i = 0; i < live.size(); i++)
+				{
+					const GeometryRange& range = pool.layout.GetRange(live[i]);
+					liveVertices += range.vertexCount;
+					liveIndices += range.indexCount;
+					relocatedMeshes += range.baseVertex != ranges[i].baseVertex || range.firstIndex != ranges[i].firstIndex;
+				}
+				uint64_t copiedVertices = 0;
+				uint64_t copiedIndices = 0;
+				for (const GeometryCopyRun& run : pool.vertexCopies) {
+					copiedVertices += run.count;
+				}
+				for (const GeometryCopyRun& run : pool.indexCopies) {
+					copiedIndices += run.count;
+				}
+				TlsfStats vertexStats = pool.layout.GetVertexStats();
+				TlsfStats indexStats = pool.layout.GetIndexStats();
+				if (copiedVertices != liveVertices || copiedIndices != liveIndices || pool.Fragmentation() != 0.0f ||
+					vertexStats.freeBlocks > 1 || indexStats.freeBlocks > 1 ||
+					vertexStats.usedBytes != liveVertices || indexStats.usedBytes != liveIndices) {
+					std::printf("cycle %d: copied %llu of %llu vertices and %llu of %llu indices, %u and %u free blocks after compaction, MISMATCH\n",
+						cycle, static_cast<unsigned long long>(copiedVertices), static_cast<unsigned long long>(liveVertices),
+						static_cast<unsigned long long>(copiedIndices), static_cast<unsigned long long>(liveIndices),
+						vertexStats.freeBlocks, indexStats.freeBlocks);
+					return 1;
+				}
+			}
+
+			if (!pool.Check(wrongMesh)) {
+				const GeometryRange& range = pool.layout.GetRange(wrongMesh);
+				std::printf("cycle %d: mesh %u at vertex %u index %u doesn't hold its own elements, MISMATCH\n",
+					cycle, wrongMesh, range.baseVertex, range.firstIndex);
+				return 1;
+			}
+		}
+
+		std::printf("%d cycles, %zu meshes live (peak %u), %u grows, %u compactions\n",
+			cycles, live.size(), peakMeshes, pool.grows, pool.compactions);
+		std::printf("%llu meshes relocated in %llu vertex and %llu index copy runs, capacity %u vertices %u indices\n",
+			static_cast<unsigned long long>(relocatedMeshes), static_cast<unsigned long long>(vertexRuns),
+			static_cast<unsigned long long>(indexRuns), pool.layout.GetVertexCapacity(), pool.layout.GetIndexCapacity());
+		if (pool.grows == 0 || pool.compactions == 0) {
+			std::printf("growth and compaction both have to run, MISMATCH\n");
+			return 1;
+		}
+		return 0;
+	}
+	struct RingRange
+	{
+		uint64_t offset;
+		uint64_t size;
+		uint64_t fenceValue;
+	};
+
+	int BenchRing(const std::vector<std::string>& args)
+	{
+		int frames = args.size() > 1 ? std::max(1, std::atoi(args[1].c_str())) : 20000;
+
+		// wrapping by hand: the end of the ring is skipped when an allocation
+		// doesn't fit there, and the skipped bytes retire with it
+		RingAllocator ring(1024);
+		bool wraps = ring.Allocate(600, 1) == 0;
+		ring.Submit(1);
+		wraps = wraps && ring.Allocate(300, 1) == 600;
+		ring.Submit(2);
+		ring.Reclaim(1);
+		wraps = wraps && ring.Allocate(200, 256) == 0 && ring.GetStats().usedBytes == 300 + 124 + 200;
+		wraps = wraps && ring.Allocate(500, 1) == RingAllocator::InvalidOffset && ring.Validate();
+		// filled to the last byte, then nothing fits until a reclaim
+		wraps = wraps && ring.Allocate(400, 1) == 200 && ring.Allocate(1, 1) == RingAllocator::InvalidOffset;
+		ring.Submit(3);
+		wraps = wraps && ring.GetStats().usedBytes == 1024 && ring.Validate();
+		ring.Reclaim(2);
+		wraps = wraps && ring.Allocate(300, 4) == 600 && ring.GetStats().usedBytes == 1024 && ring.Validate();
+		ring.Submit(4);
+		ring.Reclaim(4);
+		wraps = wraps && ring.GetStats().usedBytes == 0 && ring.Allocate(1024, 1024) == 0 && ring.Validate();
+		if (!wraps) {
+			std::printf("wrapping around the ring by hand, MISMATCH\n");
+			return 1;
+		}
+
+		// frames of random allocations on a simulated fence timeline that
+		// completes up to 3 frames late, every allocation checked against the
+		// ranges still in flight
+		std::mt19937 random(12345);
+		std::uniform_int_distribution<int> allocationsPerFrame(0, 19);
+		std::uniform_int_distribution<int> percent(0, 99);
+		std::uniform_int_distribution<uint64_t> smallSize(1, 5000);
+		std::uniform_int_distribution<uint64_t> largeSize(1, 300000);
+		std::uniform_int_distribution<uint32_t> alignmentLog2(0, 9);
+		std::uniform_int_distribution<uint64_t> latency(0, 2);
+		ring.Reset(1 << 20);
+		std::vector<RingRange> inFlight;
+		uint64_t fenceValue = 1;
+		uint64_t completedFenceValue = 0;
+		uint64_t allocatedBytes = 0;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			int allocations = allocationsPerFrame(random);
+			for (int i = 0; i < allocations; i++)
+			{
+				uint64_t size = percent(random) < 10 ? largeSize(random) : smallSize(random);
+				uint64_t alignment = 1ull << alignmentLog2(random);
+				uint64_t offset = ring.Allocate(size, alignment);
+				if (offset == RingAllocator::InvalidOffset) {
+					continue;
+				}
+				bool overlaps = offset % alignment != 0 || offset + size > ring.GetCapacity();
+				for (const RingRange& range : inFlight) {
+					overlaps = overlaps || (offset < range.offset + range.size && range.offset < offset + size);
+				}
+				if (overlaps || !ring.Validate()) {
+					std::printf("frame %d: %llu bytes at %llu overlap a range in flight or break the ring\n", frame,
+						static_cast<unsigned long long>(size), static_cast<unsigned long long>(offset));
+					return 1;
+				}
+				inFlight.push_back({ offset, size, fenceValue });
+				allocatedBytes += size;
+			}
+			ring.Submit(fenceValue++);
+
+			if (fenceValue > 3 && percent(random) < 67) {
+				completedFenceValue = std::max(completedFenceValue, fenceValue - 1 - latency(random));
+			}
+			ring.Reclaim(completedFenceValue);
+			inFlight.erase(std::remove_if(inFlight.begin(), inFlight.end(), [&](const RingRange& range) {
+				return range.fenceValue <= completedFenceValue;
+			}), inFlight.end());
+			if (!ring.Validate()) {
+				std::printf("frame %d: validation failed after reclaiming fence %llu\n", frame,
+					static_cast<unsigned long long>(completedFenceValue));
+				return 1;
+			}
+		}
+		ring.Reclaim(fenceValue);
+		const RingAllocatorStats& stats = ring.GetStats();
+		std::printf("wrap around cases pass, %d frames: %llu allocations, %llu failed, peak %.0f%% used, %.1f%% padding\n",
+			frames, static_cast<unsigned long long>(stats.allocations), static_cast<unsigned long long>(stats.failedAllocations),
+			100.0 * stats.peakUsedBytes / stats.capacity,
+			100.0 * stats.paddingBytes / std::max<uint64_t>(1, stats.paddingBytes + allocatedBytes));
+		if (stats.usedBytes != 0 || stats.pendingSubmissions != 0) {
+			std::printf("%llu bytes still used after the last fence, MISMATCH\n", static_cast<unsigned long long>(stats.usedBytes));
+			return 1;
+		}
+		return 0;
+	}
+	int BenchReleases(const std::vector<std::string>& args)
+	{
+		int frames = args.size() > 1 ? std::max(1, std::atoi(args[1].c_str())) : 20000;
+		std::mt19937 random(12345);
+		std::uniform_int_distribution<int> retiresPerFrame(0, 15);
+		std::uniform_int_distribution<int> percent(0, 99);
+		std::uniform_int_distribution<uint64_t> latency(0, 3);
+
+		// every release records its fence value, the queue has to run exactly
+		// the ones at or below the completed fence, oldest first
+		DeferredReleaseQueue queue;
+		std::vector<uint64_t> released;
+		std::multiset<uint64_t> pending;
+		uint64_t fenceValue = 1;
+		uint64_t completedFenceValue = 0;
+		uint32_t retiredLate = 0;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			queue.SetPendingFenceValue(fenceValue);
+			int retires = retiresPerFrame(random);
+			for (int i = 0; i < retires; i++)
+			{
+				// now and then an object of an older submission, it's sorted in
+				uint64_t value = fenceValue;
+				if (percent(random) < 5 && fenceValue > 4) {
+					value -= 1 + latency(random);
+					retiredLate++;
+				}
+				if (percent(random) < 10)
+				{
+					// a release that retires another object, due at the same fence
+					queue.Retire(value, [&queue, &released, value]() {
+						released.push_back(value);
+						queue.Retire(value, [&released, value]() { released.push_back(value); });
+					});
+					pending.insert(value);
+				}
+				else if (value == fenceValue) {
+					queue.Retire([&released, value]() { released.push_back(value); });
+				}
+				else {
+					queue.Retire(value, [&released, value]() { released.push_back(value); });
+				}
+				pending.insert(value);
+			}
+			fenceValue++;
+
+			if (percent(random) < 67) {
+				completedFenceValue = std::max(completedFenceValue, fenceValue - 1 - std::min(fenceValue - 1, latency(random)));
+			}
+			released.clear();
+			uint32_t count = queue.Process(completedFenceValue);
+			size_t expected = std::distance(pending.begin(), pending.upper_bound(completedFenceValue));
+			bool exact = count == released.size() && released.size() == expected &&
+				std::is_sorted(released.begin(), released.end()) &&
+				(released.empty() || released.back() <= completedFenceValue);
+			pending.erase(pending.begin(), pending.upper_bound(completedFenceValue));
+			if (!exact) {
+				std::printf("frame %d: processing fence %llu released %u, %zu were due, MISMATCH\n", frame,
+					static_cast<unsigned long long>(completedFenceValue), count, expected);
+				return 1;
+			}
+		}
+
+		// an object handed over with RetireObject lives until its fence
+		// completes, the flush runs whatever is still pending
+		released.clear();
+		std::shared_ptr<int> object = std::make_shared<int>(0);
+		queue.SetPendingFenceValue(fenceValue);
+		queue.RetireObject(object);
+		queue.Process(fenceValue - 1);
+		bool alive = object.use_count() == 2;
+		queue.Process(fenceValue);
+		bool kept = alive && object.use_count() == 1;
+		queue.Flush();
+		const DeferredReleaseStats& stats = queue.GetStats();
+		std::printf("%d frames, %llu releases, %u retired out of order, peak %u pending\n", frames,
+			static_cast<unsigned long long>(stats.released), retiredLate, stats.peakPending);
+		if (!kept || released.size() != pending.size() || stats.pending != 0) {
+			std::printf("%s, MISMATCH\n", kept ? "flush didn't run every release" : "a retired object wasn't kept until its fence");
+			return 1;
+		}
+		return 0;
+	}
+	// a width by height quad grid over a wavy surface
+	void BuildGridMesh(uint32_t width, uint32_t height, Mesh& mesh)
+	{
+		mesh.vertices.clear();
+		mesh.indices.clear();
+		for (uint32_t y = 0; y <= height; y++)
+		{
+			for (uint32_t x = 0; x <= width; x++)
+			{
+				Vertex vertex;
+				vertex.position = DirectX::XMFLOAT3(x * 0.1f, std::sin(x * 0.1f) * std::cos(y * 0.1f), y * 0.1f);
+				vertex.normal = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+				vertex.texCoord = DirectX::XMFLOAT2(float(x) / width, float(y) / height);
+				mesh.vertices.push_back(vertex);
+			}
+		}
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				uint32_t corner = y * (width + 1) + x;
+				mesh.indices.insert(mesh.indices.end(), { corner, corner + width + 1, corner + 1, corner + 1, corner + width + 1, corner + width + 2 });
+			}
+		}
+	}
+
+	// renumbers the vertices in the order the triangles first use them
+	void SortVerticesByFirstUse(Mesh& mesh)
+	{
+		std::vector<uint32_t> remap(mesh.vertices.size(), ~0u);
+		std::vector<Vertex> vertices;
+		for (uint32_t& index : mesh.indices)
+		{
+			if (remap[index] == ~0u) {
+				remap[index] = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(mesh.vertices[index]);
+			}
+			index = remap[index];
+		}
+		mesh.vertices.swap(vertices);
+	}
+
+	// the codec may rotate a triangle's corners but keeps its winding
+	bool SameTriangle(const uint32_t* a, const uint32_t* b)
+	{
+		for (int rotation = 0; rotation < 3; rotation++) {
+			if (a[0] == b[rotation] && a[1] == b[(rotation + 1) % 3] && a[2] == b[(rotation + 2) % 3]) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// truncated or bit flipped copies of data, to feed the decoders
+	std::vector<uint8_t> Corrupt(const std::vector<uint8_t>& data, int attempt, std::mt19937& random)
+	{
+		std::vector<uint8_t> corrupt = data;
+		if (corrupt.empty()) {
+			return corrupt;
+		}
+		std::uniform_int_distribution<size_t> position(0, corrupt.size() - 1);
+		if (attempt % 2) {
+			corrupt.resize(position(random));
+		}
+		else {
+			corrupt[position(random)] ^= static_cast<uint8_t>(1 << (position(random) % 8));
+		}
+		return corrupt;
+	}
+
+	int BenchCodecs(const std::vector<std::string>& args)
+	{
+		int meshCount = args.size() > 1 ? std::max(1, std::atoi(args[1].c_str())) : 200;
+		std::mt19937 random(12345);
+		std::uniform_int_distribution<uint32_t> gridSize(1, 80);
+
+		// geometry codec round trips, on meshes in first use order and on
+		// shuffled ones. corrupt input only has to fail or decode something,
+		// it's run under the sanitizers to catch reads out of bounds
+		size_t rawBytes = 0;
+		size_t vertexBytes = 0;
+		size_t indexBytes = 0;
+		size_t triangles = 0;
+		for (int i = 0; i < meshCount; i++)
+		{
+			Mesh mesh;
+			BuildGridMesh(gridSize(random), gridSize(random), mesh);
+			if (i % 3 == 0)
+			{
+				size_t triangleCount = mesh.indices.size() / 3;
+				for (size_t triangle = triangleCount - 1; triangle > 0; triangle--)
+				{
+					size_t other = std::uniform_int_distribution<size_t>(0, triangle)(random);
+					std::swap_ranges(mesh.indices.begin() + triangle * 3, mesh.indices.begin() + triangle * 3 + 3, mesh.indices.begin() + other * 3);
+				}
+			}
+			if (i % 2 == 0) {
+				SortVerticesByFirstUse(mesh);
+			}
+
+			std::vector<uint8_t> vertices(GeometryCodec::VertexBound(mesh.vertices.size(), sizeof(Vertex)));
+			vertices.resize(GeometryCodec::EncodeVertices(vertices.data(), vertices.size(), mesh.vertices.data(), mesh.vertices.size(), sizeof(Vertex)));
+			std::vector<uint8_t> indices(GeometryCodec::IndexBound(mesh.indices.size()));
+			indices.resize(GeometryCodec::EncodeIndices(indices.data(), indices.size(), mesh.indices.data(), mesh.indices.size()));
+
+			std::vector<Vertex> decoded(mesh.vertices.size());
+			std::vector<Vertex> decodedScalar(mesh.vertices.size());
+			std::vector<uint32_t> decodedIndices(mesh.indices.size());
+			bool same = !vertices.empty() && !indices.empty() &&
+				GeometryCodec::DecodeVertices(decoded.data(), decoded.size(), sizeof(Vertex), vertices.data(), vertices.size()) &&
+				GeometryCodec::DecodeVerticesScalar(decodedScalar.data(), decoded.size(), sizeof(Vertex), vertices.data(), vertices.size()) &&
+				std::memcmp(decoded.data(), mesh.vertices.data(), decoded.size() * sizeof(Vertex)) == 0 &&
+				std::memcmp(decodedScalar.data(), mesh.vertices.data(), decoded.size() * sizeof(Vertex)) == 0 &&
+				GeometryCodec::DecodeIndices(decodedIndices.data(), decodedIndices.size(), indices.data(), indices.size());
+			for (size_t triangle = 0; same && triangle < mesh.indices.size() / 3; triangle++) {
+				same = SameTriangle(&mesh.indices[triangle * 3], &decodedIndices[triangle * 3]);
+			}
+			if (!same) {
+				std::printf("mesh %d, %zu vertices: round trip MISMATCH\n", i, mesh.vertices.size());
+				return 1;
+			}
+			for (int attempt = 0; attempt < 20; attempt++)
+			{
+				std::vector<uint8_t> corrupt = Corrupt(vertices, attempt, random);
+				GeometryCodec::DecodeVertices(decoded.data(), decoded.size(), sizeof(Vertex), corrupt.data(), corrupt.size());
+				GeometryCodec::DecodeVerticesScalar(decoded.data(), decoded.size(), sizeof(Vertex), corrupt.data(), corrupt.size());
+				corrupt = Corrupt(indices, attempt, random);
+				GeometryCodec::DecodeIndices(decodedIndices.data(), decodedIndices.size(), corrupt.data(), corrupt.size());
+			}
+			rawBytes += mesh.vertices.size() * sizeof(Vertex);
+			vertexBytes += vertices.size();
+			indexBytes += indices.size();
+			triangles += mesh.indices.size() / 3;
+		}
+		std::printf("geometry codec: %d meshes round trip, vertices at %.1f%%, %.2f bytes per triangle\n", meshCount,
+			100.0 * vertexBytes / rawBytes, double(indexBytes) / triangles);
+
+		// lz4 round trips on random, low entropy, repeating and periodic data.
+		// a destination one byte short has to fail cleanly
+		std::uniform_int_distribution<size_t> lz4Size(0, 5000);
+		std::uniform_int_distribution<int> byte(0, 255);
+		size_t lz4Raw = 0;
+		size_t lz4Compressed = 0;
+		for (int i = 0; i < meshCount * 50; i++)
+		{
+			std::vector<uint8_t> data(lz4Size(random));
+			for (size_t j = 0; j < data.size(); j++)
+			{
+				int value = byte(random);
+				switch (i % 4)
+				{
+				case 0: data[j] = static_cast<uint8_t>(value); break;
+				case 1: data[j] = static_cast<uint8_t>(value % 3); break;
+				case 2: data[j] = j > 10 && value % 5 ? data[j - 1 - value % 10] : static_cast<uint8_t>(value); break;
+				default: data[j] = static_cast<uint8_t>(j % 7); break;
+				}
+			}
+			std::vector<uint8_t> compressed(Lz4::CompressBound(data.size()));
+			compressed.resize(Lz4::Compress(data.data(), data.size(), compressed.data(), compressed.size()));
+			std::vector<uint8_t> decompressed(data.size());
+			bool same = !compressed.empty() && Lz4::Decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()) &&
+				decompressed == data;
+			if (same) {
+				std::vector<uint8_t> tooSmall(compressed.size() - 1);
+				same = Lz4::Compress(data.data(), data.size(), tooSmall.data(), tooSmall.size()) == 0;
+			}
+			if (!same) {
+				std::printf("lz4 %zu bytes: round trip MISMATCH\n", data.size());
+				return 1;
+			}
+			std::vector<uint8_t> corrupt = Corrupt(compressed, i, random);
+			Lz4::Decompress(corrupt.data(), corrupt.size(), decompressed.data(), decompressed.size());
+			lz4Raw += data.size();
+			lz4Compressed += compressed.size();
+		}
+		std::printf("lz4: %d buffers round trip, %.1f%% of their size\n", meshCount * 50, 100.0 * lz4Compressed / lz4Raw);
+
+		// the cache file through disk, then truncated or bit flipped. a read
+		// that doesn't fail may not index past a mesh
+		std::vector<Mesh> meshes;
+		std::vector<Material> materials;
+		HeadlessFrameLoop::BuildSyntheticScene(64, meshes, materials);
+		for (int i = 0; i < 8; i++) {
+			BuildGridMesh(gridSize(random), gridSize(random), meshes[i]);
+		}
+		std::string filename = (std::filesystem::temp_directory_path() / "bench-codecs.dxmesh").string();
+		std::string error;
+		std::vector<Mesh> readMeshes;
+		std::vector<Material> readMaterials;
+		if (!MeshCache::Write(meshes, materials, filename, error) || !MeshCache::Read(filename, readMeshes, readMaterials, error)) {
+			std::printf("error: %s\n", error.c_str());
+			return 1;
+		}
+		bool same = readMeshes.size() == meshes.size() && readMaterials.size() == materials.size();
+		for (size_t i = 0; same && i < materials.size(); i++) {
+			same = readMaterials[i].name == materials[i].name && readMaterials[i].diffuseTexture == materials[i].diffuseTexture &&
+				readMaterials[i].alphaTexture == materials[i].alphaTexture;
+		}
+		for (size_t i = 0; same && i < meshes.size(); i++)
+		{
+			const Mesh& mesh = meshes[i];
+			const Mesh& read = readMeshes[i];
+			same = read.vertices.size() == mesh.vertices.size() && read.indices.size() == mesh.indices.size() &&
+				std::memcmp(read.vertices.data(), mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex)) == 0 &&
+				read.materialName == mesh.materialName && read.materialIndex == mesh.materialIndex &&
+				read.worldUnitsPerUV == mesh.worldUnitsPerUV;
+			for (size_t triangle = 0; same && triangle < mesh.indices.size() / 3; triangle++) {
+				same = SameTriangle(&mesh.indices[triangle * 3], &read.indices[triangle * 3]);
+			}
+		}
+		if (!same) {
+			std::printf("mesh cache round trip MISMATCH\n");
+			return 1;
+		}
+
+		MappedFile file;
+		if (!file.Open(filename, error)) {
+			std::printf("error: %s\n", error.c_str());
+			return 1;
+		}
+		std::vector<uint8_t> cache(file.GetData(), file.GetData() + file.GetSize());
+		file.Close();
+		std::string corruptFilename = (std::filesystem::temp_directory_path() / "bench-codecs-corrupt.dxmesh").string();
+		uint32_t rejected = 0;
+		for (int attempt = 0; attempt < 400; attempt++)
+		{
+			std::vector<uint8_t> corrupt = Corrupt(cache, attempt, random);
+			FILE* output = std::fopen(corruptFilename.c_str(), "wb");
+			if (!output || std::fwrite(corrupt.data(), 1, corrupt.size(), output) != corrupt.size()) {
+				std::printf("error: failed to write %s\n", corruptFilename.c_str());
+				return 1;
+			}
+			std::fclose(output);
+			if (!MeshCache::Read(corruptFilename, readMeshes, readMaterials, error)) {
+				rejected++;
+				continue;
+			}
+			for (const Mesh& mesh : readMeshes)
+			{
+				for (uint32_t index : mesh.indices)
+				{
+					if (index >= mesh.vertices.size()) {
+						std::printf("a corrupt mesh cache read with an index past its mesh, MISMATCH\n");
+						return 1;
+					}
+				}
+			}
+		}
+		std::filesystem::remove(filename);
+		std::filesystem::remove(corruptFilename);
+		std::printf("mesh cache: %zu meshes round trip, %u of 400 corrupt copies rejected, the rest in range\n", meshes.size(), rejected);
+		return 0;
+	}
+	bool WriteFile(const std::string& filename, const std::vector<uint8_t>& data)
+	{
+		FILE* output = std::fopen(filename.c_str(), "wb");
+		if (!output) {
+			return false;
+		}
+		bool written = std::fwrite(data.data(), 1, data.size(), output) == data.size();
+		return std::fclose(output) == 0 && written;
+	}
+
+	int BenchStreaming(const std::vector<std::string>& args)
+	{
+		// a 4 MB file, alternately compressible and random every 64 KB, and
+		// its lz4 compressed chunks back to back in a second file
+		std::mt19937 random(12345);
+		std::uniform_int_distribution<int> byte(0, 255);
+		std::vector<uint8_t> data(4 * 1024 * 1024);
+		for (size_t i = 0; i < data.size(); i++) {
+			data[i] = static_cast<uint8_t>((i / 65536) % 2 ? byte(random) : (i / 7) & 0xff);
+		}
+		struct Chunk
+		{
+			uint64_t offset;
+			uint32_t size;
+			uint32_t uncompressedSize;
+			uint64_t uncompressedOffset;
+		};
+		std::vector<uint8_t> compressed;
+		std::vector<Chunk> chunks;
+		const size_t chunkSize = 50000;
+		for (size_t offset = 0; offset < data.size(); offset += chunkSize)
+		{
+			size_t size = std::min(chunkSize, data.size() - offset);
+			size_t start = compressed.size();
+			compressed.resize(start + Lz4::CompressBound(size));
+			size_t compressedSize = Lz4::Compress(data.data() + offset, size, compressed.data() + start, compressed.size() - start);
+			compressed.resize(start + compressedSize);
+			chunks.push_back({ start, static_cast<uint32_t>(compressedSize), static_cast<uint32_t>(size), offset });
+		}
+		std::string rawFilename = (std::filesystem::temp_directory_path() / "bench-streaming.bin").string();
+		std::string lz4Filename = (std::filesystem::temp_directory_path() / "bench-streaming.lz4").string();
+		if (!WriteFile(rawFilename, data) || !WriteFile(lz4Filename, compressed)) {
+			std::printf("error: failed to create %s\n", rawFilename.c_str());
+			return 1;
+		}
+
+		// the gpu is a NullUploadBackend whose byte arrays stand in for buffers,
+		// small limits so staging, batches and the handoff budget all fill up
+		NullUploadBackend backend(8 * 1024 * 1024);
+		UploadService uploads;
+		uploads.Initialize(&backend, 3);
+		uploads.maxBatchBytes = 1024 * 1024;
+		StreamingQueue queue;
+		std::string error;
+		if (!queue.Initialize(&uploads, error, 8, 1024 * 1024)) {
+			std::printf("error: %s\n", error.c_str());
+			return 1;
+		}
+		queue.maxHandoffBytesPerUpdate = 256 * 1024;
+		uint32_t rawFile = queue.OpenFile(rawFilename, error);
+		uint32_t lz4File = queue.OpenFile(lz4Filename, error);
+		if (rawFile == AsyncFileReader::InvalidFile || lz4File == AsyncFileReader::InvalidFile) {
+			std::printf("error: %s\n", error.c_str());
+			return 1;
+		}
+
+		// every byte of the file four ways: raw and lz4, into memory and into a buffer
+		std::vector<uint8_t> memory(data.size());
+		std::vector<uint8_t> buffer(data.size());
+		std::vector<uint8_t> lz4Memory(data.size());
+		std::vector<uint8_t> lz4Buffer(data.size());
+		Clock::time_point start = Clock::now();
+		for (size_t offset = 0; offset < data.size(); offset += 65536)
+		{
+			StreamRequest request;
+			request.file = rawFile;
+			request.offset = offset;
+			request.size = 65536;
+			request.destination = memory.data();
+			request.destinationOffset = offset;
+			queue.Enqueue(request);
+			request.destinationType = StreamDestination::Buffer;
+			request.destination = buffer.data();
+			queue.Enqueue(request);
+		}
+		for (const Chunk& chunk : chunks)
+		{
+			StreamRequest request;
+			request.file = lz4File;
+			request.offset = chunk.offset;
+			request.size = chunk.size;
+			request.compression = StreamCompression::Lz4;
+			request.uncompressedSize = chunk.uncompressedSize;
+			request.destination = lz4Memory.data();
+			request.destinationOffset = chunk.uncompressedOffset;
+			queue.Enqueue(request);
+			request.destinationType = StreamDestination::Buffer;
+			request.destination = lz4Buffer.data();
+			queue.Enqueue(request);
+		}
+
+		// a read past the end of the file and lz4 that doesn't decompress have
+		// to fail and still complete in order. the read goes straight to its
+		// destination, only the buffer is sure to be left alone
+		std::vector<uint8_t> partial(100, 0xcd);
+		std::vector<uint8_t> untouched(5000, 0xcd);
+		std::vector<uint8_t> tail(10);
+		StreamRequest lastBytes;
+		lastBytes.file = rawFile;
+		lastBytes.offset = data.size() - 10;
+		lastBytes.size = 10;
+		lastBytes.destination = tail.data();
+		StreamFenceValue lastBytesValue = queue.Enqueue(lastBytes);
+		StreamRequest pastEnd;
+		pastEnd.file = rawFile;
+		pastEnd.offset = data.size() - 10;
+		pastEnd.size = 100;
+		pastEnd.destination = partial.data();
+		StreamFenceValue pastEndValue = queue.Enqueue(pastEnd);
+		StreamRequest corrupt;
+		corrupt.file = lz4File;
+		corrupt.offset = 0;
+		corrupt.size = 100;
+		corrupt.compression = StreamCompression::Lz4;
+		corrupt.uncompressedSize = 5000;
+		corrupt.destinationType = StreamDestination::Buffer;
+		corrupt.destination = untouched.data();
+		StreamFenceValue corruptValue = queue.Enqueue(corrupt);
+
+		// frames in which the gpu finishes one batch each
+		int frames = 0;
+		StreamFenceValue completed = 0;
+		while (!queue.IsComplete(corruptValue))
+		{
+			queue.Update();
+			uploads.Flush();
+			backend.CompleteBatches(1);
+			frames++;
+			if (queue.GetCompletedValue() < completed || queue.GetHandedOffValue() < queue.GetCompletedValue() || frames > 100000) {
+				std::printf("frame %d: fence values out of order or stuck, MISMATCH\n", frames);
+				return 1;
+			}
+			completed = queue.GetCompletedValue();
+		}
+		double time = MillisecondsSince(start);
+		const StreamingQueueStats& stats = queue.GetStats();
+		std::printf("%s reads, %llu requests in %d frames, %.1f ms, %llu staging stalls\n", queue.IsAsync() ? "async" : "blocking",
+			static_cast<unsigned long long>(stats.requests), frames, time, static_cast<unsigned long long>(stats.stagingStalls));
+		bool same = memory == data && buffer == data && lz4Memory == data && lz4Buffer == data;
+		bool failed = queue.HasFailed(pastEndValue) && queue.HasFailed(corruptValue) && !queue.HasFailed(lastBytesValue) &&
+			std::equal(tail.begin(), tail.end(), data.end() - 10) &&
+			std::all_of(untouched.begin(), untouched.end(), [](uint8_t value) { return value == 0xcd; });
+		if (!same || !failed) {
+			std::printf("%s, MISMATCH\n", same ? "bad requests didn't fail cleanly" : "streamed data differs from the file");
+			return 1;
+		}
+
+		// every asset of a package into memory and into a buffer, against AssetPackage::Read
+		if (args.size() > 1)
+		{
+			AssetPackage package;
+			uint32_t packageFile = queue.OpenFile(args[1], error);
+			if (!package.Open(args[1], error) || packageFile == AsyncFileReader::InvalidFile) {
+				std::printf("error: %s\n", error.c_str());
+				return 1;
+			}
+			uint64_t bytes = 0;
+			start = Clock::now();
+			for (uint32_t entry = 0; entry < package.GetEntryCount(); entry++)
+			{
+				std::string name = package.GetEntryName(entry);
+				std::vector<uint8_t> expected;
+				std::vector<uint8_t> streamed(package.GetSize(name));
+				std::vector<uint8_t> uploaded(package.GetSize(name));
+				StreamFenceValue memoryValue = 0;
+				StreamFenceValue bufferValue = 0;
+				if (!package.Read(name, expected, error) ||
+					!queue.EnqueueAsset(packageFile, package, name, StreamDestination::Memory, streamed.data(), 0, memoryValue) ||
+					!queue.EnqueueAsset(packageFile, package, name, StreamDestination::Buffer, uploaded.data(), 0, bufferValue)) {
+					std::printf("error: %s\n", error.empty() ? name.c_str() : error.c_str());
+					return 1;
+				}
+				queue.Wait(std::max(memoryValue, bufferValue));
+				if (streamed != expected || uploaded != expected || queue.HasFailed(memoryValue) || queue.HasFailed(bufferValue)) {
+					std::printf("%s streamed differently than read, MISMATCH\n", name.c_str());
+					return 1;
+				}
+				bytes += expected.size();
+			}
+			std::printf("%u package assets streamed twice, %.1f MB in %.1f ms\n", package.GetEntryCount(),
+				bytes / 1048576.0, MillisecondsSince(start));
+		}
+		queue.Shutdown();
+		std::filesystem::remove(rawFilename);
+		std::filesystem::remove(lz4Filename);
+		return 0;
+	}
+	// a subresource as GetCopyableFootprints reports it
+	struct ReferenceFootprint
+	{
+		uint64_t offset;
+		uint64_t rowPitch;
+		uint64_t numRows;
+		uint64_t rowSize;
+	};
+
+	// GetCopyableFootprints written from the d3d12 rules rather than from
+	// TextureContainer: a subresource is rowPitch * numRows bytes with every
+	// row padded, the next one starts at the following 512 byte boundary, and
+	// the total leaves out the padding after the very last row
+	uint64_t ReferenceFootprints(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t arraySize,
+		uint32_t bytesPerBlock, uint32_t blockDimension, std::vector<ReferenceFootprint>& footprints)
+	{
+		footprints.clear();
+		uint64_t offset = 0;
+		uint64_t totalBytes = 0;
+		for (uint32_t subresource = 0; subresource < mipCount * arraySize; subresource++)
+		{
+			uint32_t mip = subresource % mipCount;
+			uint64_t mipWidth = width >> mip ? width >> mip : 1;
+			uint64_t mipHeight = height >> mip ? height >> mip : 1;
+			ReferenceFootprint footprint;
+			footprint.offset = offset;
+			footprint.rowSize = (mipWidth + blockDimension - 1) / blockDimension * bytesPerBlock;
+			footprint.rowPitch = (footprint.rowSize + 255) / 256 * 256;
+			footprint.numRows = (mipHeight + blockDimension - 1) / blockDimension;
+			footprints.push_back(footprint);
+			totalBytes = offset + footprint.rowPitch * (footprint.numRows - 1) + footprint.rowSize;
+			offset = (offset + footprint.rowPitch * footprint.numRows + 511) / 512 * 512;
+		}
+		return totalBytes;
+	}
+
+	bool SameFootprint(const TextureSubresourceLayout& layout, uint64_t baseOffset, const ReferenceFootprint& footprint)
+	{
+		return layout.offset - baseOffset == footprint.offset && layout.rowPitch == footprint.rowPitch &&
+			layout.numRows == footprint.numRows && layout.rowSize == footprint.rowSize;
+	}
+
+	int BenchFootprints(const std::vector<std::string>&)
+	{
+		struct Format
+		{
+			const char* name;
+			uint32_t bytesPerBlock;
+			uint32_t blockDimension;
+		};
+		const Format formats[] = { { "r8", 1, 1 }, { "rgba8", 4, 1 }, { "rgba16f", 8, 1 }, { "bc1", 8, 4 }, { "bc7", 16, 4 } };
+		// odd and non power of two sizes, both sides of the 256 byte pitch and 4 texel blocks
+		const uint32_t sizes[] = { 1, 2, 3, 4, 5, 7, 8, 13, 17, 31, 63, 64, 65, 100, 127, 255, 256, 257, 511, 513, 1000, 1025, 2048, 4096 };
+
+		uint32_t cases = 0;
+		uint32_t subresources = 0;
+		std::vector<TextureSubresourceLayout> layout;
+		std::vector<TextureSubresourceLayout> singleSlice;
+		std::vector<ReferenceFootprint> footprints;
+		for (const Format& format : formats)
+		{
+			for (uint32_t width : sizes)
+			{
+				for (uint32_t height : sizes)
+				{
+					uint32_t fullChain = 1;
+					while ((std::max(width, height) >> fullChain) > 0) {
+						fullChain++;
+					}
+					const uint32_t mipCounts[] = { 1, std::max(1u, fullChain / 2), fullChain };
+					for (uint32_t mipCount : mipCounts)
+					{
+						for (uint32_t arraySize : { 1u, 3u })
+						{
+							cases++;
+							uint64_t size = TextureContainer::ComputeLayout(width, height, mipCount, arraySize,
+								format.bytesPerBlock, format.blockDimension, layout);
+							uint64_t expected = ReferenceFootprints(width, height, mipCount, arraySize,
+								format.bytesPerBlock, format.blockDimension, footprints);
+							bool same = size == expected && layout.size() == footprints.size();
+							for (size_t i = 0; same && i < layout.size(); i++) {
+								same = SameFootprint(layout[i], 0, footprints[i]) && layout[i].width == std::max(1u, width >> (i % mipCount)) &&
+									layout[i].height == std::max(1u, height >> (i % mipCount));
+							}
+							subresources += static_cast<uint32_t>(layout.size());
+
+							// the containers' overload is the general one with 1 texel blocks
+							if (same && arraySize == 1 && format.blockDimension == 1)
+							{
+								TextureContainer::ComputeLayout(width, height, mipCount, format.bytesPerBlock, singleSlice);
+								same = singleSlice.size() == layout.size() &&
+									std::memcmp(singleSlice.data(), layout.data(), layout.size() * sizeof(TextureSubresourceLayout)) == 0;
+							}
+							// a resource holding mips [first, mipCount) is the single slice
+							// layout shifted by the offset of first, what TextureStreamer uploads
+							for (uint32_t first = 1; same && arraySize == 1 && first < mipCount; first++)
+							{
+								ReferenceFootprints(std::max(1u, width >> first), std::max(1u, height >> first), mipCount - first, 1,
+									format.bytesPerBlock, format.blockDimension, footprints);
+								for (uint32_t i = 0; same && i < mipCount - first; i++) {
+									same = SameFootprint(layout[first + i], layout[first].offset, footprints[i]);
+								}
+							}
+							if (!same) {
+								std::printf("%s %ux%u, %u mips, %u slices: layout differs from the footprints, MISMATCH\n",
+									format.name, width, height, mipCount, arraySize);
+								return 1;
+							}
+						}
+					}
+				}
+			}
+		}
+		std::printf("%u textures, %u subresources match the reference footprints, mip ranges included\n", cases, subresources);
+		return 0;
+	}
+	// the entry ResolveFallbacks has to leave for pageId: its own slot when it's
+	// resident, otherwise the slot and mip of the closest resident ancestor.
+	// resident maps page ids to slotX | slotY << 8
+	PageTable::Entry ReferenceEntry(uint32_t pageId, const std::map<uint32_t, uint32_t>& resident, uint32_t mipCount)
+	{
+		PageTable::Entry entry;
+		for (uint32_t page = pageId; PageId::Mip(page) < mipCount; page = PageId::Parent(page))
+		{
+			auto it = resident.find(page);
+			if (it != resident.end())
+			{
+				entry.slotX = static_cast<uint8_t>(it->second & 0xFF);
+				entry.slotY = static_cast<uint8_t>(it->second >> 8);
+				entry.mip = static_cast<uint8_t>(PageId::Mip(page));
+				entry.resident = page == pageId;
+				break;
+			}
+		}
+		return entry;
+	}
+
+	// returns the first page whose entry differs from the reference, or PageId::Invalid
+	uint32_t FindWrongEntry(const PageTable& pageTable, const VirtualTextureDesc& desc, const std::map<uint32_t, uint32_t>& resident)
+	{
+		for (uint32_t mip = 0; mip < desc.mipCount; mip++)
+		{
+			const std::vector<PageTable::Entry>& entries = pageTable.GetMip(mip);
+			for (uint32_t y = 0; y < desc.PagesY(mip); y++)
+			{
+				for (uint32_t x = 0; x < desc.PagesX(mip); x++)
+				{
+					uint32_t pageId = PageId::Pack(mip, x, y);
+					PageTable::Entry expected = ReferenceEntry(pageId, resident, desc.mipCount);
+					const PageTable::Entry& entry = entries[size_t(y) * desc.PagesX(mip) + x];
+					if (entry.slotX != expected.slotX || entry.slotY != expected.slotY || entry.mip != expected.mip ||
+						entry.resident != expected.resident) {
+						return pageId;
+					}
+				}
+			}
+		}
+		return PageId::Invalid;
+	}
+
+	int BenchVirtualTexture(const std::vector<std::string>& args)
+	{
+		int rounds = args.size() > 1 ? std::max(1, std::atoi(args[1].c_str())) : 500;
+		std::mt19937 random(12345);
+
+		// 2048x1024 in 128 texel pages, 16x8 pages down to the single page of mip 4
+		VirtualTextureDesc desc;
+		desc.width = 2048;
+		desc.height = 1024;
+		desc.mipCount = 5;
+		std::vector<uint32_t> pages;
+		for (uint32_t mip = 0; mip < desc.mipCount; mip++) {
+			for (uint32_t y = 0; y < desc.PagesY(mip); y++) {
+				for (uint32_t x = 0; x < desc.PagesX(mip); x++) {
+					pages.push_back(PageId::Pack(mip, x, y));
+				}
+			}
+		}
+		const uint32_t rootPage = pages.back();
+
+		// random pages in and out of the page table, which after ResolveFallbacks has
+		// to match the closest resident ancestors. the feedback of each round goes
+		// through FeedbackAnalyzer against a histogram and ancestor walk of its own
+		PageTable pageTable;
+		pageTable.Initialize(desc);
+		std::map<uint32_t, uint32_t> resident;
+		pageTable.SetResident(rootPage, 0, 0);
+		resident[rootPage] = 0;
+
+		FeedbackAnalyzer analyzer;
+		std::uniform_int_distribution<size_t> pickPage(0, pages.size() - 2);
+		std::vector<uint32_t> feedback;
+		std::vector<uint32_t> touchedPages;
+		std::vector<FeedbackAnalyzer::Request> requests;
+		size_t totalRequests = 0;
+		for (int round = 0; round < rounds; round++)
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				uint32_t page = pages[pickPage(random)];
+				if (resident.erase(page) > 0) {
+					pageTable.SetNonResident(page);
+				}
+				else
+				{
+					uint32_t slotX = random() % 16;
+					uint32_t slotY = random() % 16;
+					pageTable.SetResident(page, slotX, slotY);
+					resident[page] = slotX | slotY << 8;
+				}
+			}
+			pageTable.ResolveFallbacks();
+			uint32_t wrongPage = FindWrongEntry(pageTable, desc, resident);
+			if (wrongPage != PageId::Invalid) {
+				std::printf("round %d: mip %u page %u,%u doesn't fall back to its closest resident ancestor, MISMATCH\n",
+					round, PageId::Mip(wrongPage), PageId::X(wrongPage), PageId::Y(wrongPage));
+				return 1;
+			}
+
+			// mostly a few pages of the finest mips like a view close up, plus
+			// cleared pixels and ids outside the texture that have to be skipped
+			feedback.clear();
+			std::uniform_int_distribution<size_t> pickNear(0, 5);
+			size_t nearStart = pickPage(random);
+			for (int i = 0; i < 1024; i++)
+			{
+				uint32_t kind = random() % 16;
+				if (kind == 0) {
+					feedback.push_back(uint32_t(PageId::Invalid));
+				}
+				else if (kind == 1) {
+					feedback.push_back(random() % 2 ? PageId::Pack(0, 16, 0) : PageId::Pack(desc.mipCount, 0, 0));
+				}
+				else if (kind < 6) {
+					feedback.push_back(pages[pickPage(random)]);
+				}
+				else {
+					feedback.push_back(pages[std::min(nearStart + pickNear(random), pages.size() - 1)]);
+				}
+			}
+
+			std::map<uint32_t, uint32_t> histogram;
+			for (uint32_t pageId : feedback)
+			{
+				uint32_t mip = PageId::Mip(pageId);
+				if (pageId != PageId::Invalid && mip < desc.mipCount && PageId::X(pageId) < desc.PagesX(mip) &&
+					PageId::Y(pageId) < desc.PagesY(mip)) {
+					histogram[pageId]++;
+				}
+			}
+			std::map<uint32_t, uint32_t> expectedRequests;
+			std::set<uint32_t> expectedTouched;
+			for (const auto& [pageId, pixels] : histogram)
+			{
+				uint32_t page = pageId;
+				while (!resident.count(page))
+				{
+					expectedRequests[page] = std::max(expectedRequests[page], pixels);
+					page = PageId::Parent(page);
+				}
+				expectedTouched.insert(page);
+			}
+
+			touchedPages.clear();
+			requests.clear();
+			analyzer.Analyze(feedback.data(), feedback.size(), desc, pageTable, touchedPages, requests);
+			totalRequests += requests.size();
+
+			std::map<uint32_t, uint32_t> requested;
+			for (const auto& request : requests) {
+				requested[request.pageId] = request.pixelCount;
+			}
+			std::set<uint32_t> touched(touchedPages.begin(), touchedPages.end());
+			if (requested != expectedRequests || requested.size() != requests.size() || touched != expectedTouched) {
+				std::printf("round %d: %zu requests and %zu touched pages, expected %zu and %zu, MISMATCH\n", round,
+					requests.size(), touched.size(), expectedRequests.size(), expectedTouched.size());
+				return 1;
+			}
+			// coarsest first, then the most pixels, so every page comes after the page it falls back to
+			for (size_t i = 1; i < requests.size(); i++)
+			{
+				const auto& a = requests[i - 1];
+				const auto& b = requests[i];
+				bool ordered = PageId::Mip(a.pageId) != PageId::Mip(b.pageId) ? PageId::Mip(a.pageId) > PageId::Mip(b.pageId) :
+					a.pixelCount != b.pixelCount ? a.pixelCount > b.pixelCount : a.pageId < b.pageId;
+				if (!ordered) {
+					std::printf("round %d: request %zu out of order, MISMATCH\n", round, i);
+					return 1;
+				}
+			}
+		}
+		std::printf("%d rounds: page table fallbacks and %zu feedback requests match\n", rounds, totalRequests);
+
+		// PhysicalPageCache against a list of its own: the least recently touched
+		// unpinned slot goes first, unless it was touched in the current frame
+		struct ReferenceSlot
+		{
+			uint32_t pageId = PageId::Invalid;
+			uint64_t lastUsedFrame = 0;
+			uint64_t order = 0;
+			bool pinned = false;
+		};
+		PhysicalPageCache cache;
+		cache.Initialize(4, 2);
+		std::vector<ReferenceSlot> slots(cache.GetSlotCount());
+		uint64_t order = 0;
+		for (auto& slot : slots) {
+			slot.order = order++;
+		}
+		uint32_t evictions = 0;
+		uint32_t refusals = 0;
+		uint32_t pinnedCount = 0;
+		for (uint64_t frame = 1; frame <= uint64_t(rounds) * 4; frame++)
+		{
+			for (auto& slot : slots)
+			{
+				if (slot.pageId == PageId::Invalid || random() % 2) {
+					continue;
+				}
+				cache.Touch(cache.Find(slot.pageId), frame);
+				slot.lastUsedFrame = frame;
+				if (!slot.pinned) {
+					slot.order = order++;
+				}
+			}
+
+			for (int i = 0; i < 3; i++)
+			{
+				uint32_t pageId = pages[pickPage(random)];
+				if (cache.Find(pageId) != UINT32_MAX) {
+					continue;
+				}
+				bool pinned = pinnedCount < 2 && random() % 64 == 0;
+
+				uint32_t expectedSlot = UINT32_MAX;
+				for (uint32_t s = 0; s < slots.size(); s++) {
+					if (!slots[s].pinned && (expectedSlot == UINT32_MAX || slots[s].order < slots[expectedSlot].order)) {
+						expectedSlot = s;
+					}
+				}
+				bool expectAllocated = expectedSlot != UINT32_MAX && (slots[expectedSlot].pageId == PageId::Invalid ||
+					slots[expectedSlot].lastUsedFrame < frame);
+
+				uint32_t slot = UINT32_MAX;
+				uint32_t evictedPageId = PageId::Invalid;
+				bool allocated = cache.Allocate(pageId, frame, pinned, slot, evictedPageId);
+				if (allocated != expectAllocated || (allocated && (slot != expectedSlot ||
+					evictedPageId != slots[expectedSlot].pageId))) {
+					std::printf("frame %llu: allocated %d in slot %u evicting %08x, expected %d in slot %u evicting %08x, MISMATCH\n",
+						static_cast<unsigned long long>(frame), allocated, slot, evictedPageId, expectAllocated, expectedSlot,
+						expectedSlot != UINT32_MAX ? slots[expectedSlot].pageId : uint32_t(PageId::Invalid));
+					return 1;
+				}
+				if (!allocated) {
+					refusals++;
+					continue;
+				}
+				if (evictedPageId != PageId::Invalid) {
+					evictions++;
+				}
+				pinnedCount += pinned;
+				slots[slot].pageId = pageId;
+				slots[slot].lastUsedFrame = frame;
+				slots[slot].order = order++;
+				slots[slot].pinned = pinned;
+				if (cache.Find(pageId) != slot || (evictedPageId != PageId::Invalid && cache.Find(evictedPageId) != UINT32_MAX)) {
+					std::printf("frame %llu: Find disagrees with the allocation, MISMATCH\n", static_cast<unsigned long long>(frame));
+					return 1;
+				}
+			}
+		}
+		std::printf("%u slots, %d frames: %u evictions in lru order, %u allocations refused with every slot used in the frame\n",
+			cache.GetSlotCount(), rounds * 4, evictions, refusals);
+
+		// the whole system on a page file: a 1024x1024 texture is 8x8 pages in
+		// 4 mips and the cache holds the pinned root plus three pages
+		TextureData texture;
+		texture.mips.resize(1);
+		texture.mips[0].width = 1024;
+		texture.mips[0].height = 1024;
+		texture.mips[0].pixels.resize(1024 * 1024 * 4);
+		for (size_t i = 0; i < texture.mips[0].pixels.size(); i++) {
+			texture.mips[0].pixels[i] = static_cast<uint8_t>((i / 4 % 1024) ^ (i / 4096) ^ (i % 4 * 85));
+		}
+		TextureLoader::GenerateMips(texture);
+
+		const std::filesystem::path pageFilePath = std::filesystem::temp_directory_path() / "bench-virtual-texture.vtp";
+		std::string error;
+		PageFile pageFile;
+		VirtualTextureSystem system;
+		if (!PageFile::Build(texture, 128, 4, pageFilePath.string(), error) || !pageFile.Open(pageFilePath.string(), error) ||
+			!system.Initialize(pageFilePath.string(), 2, 2, error)) {
+			std::printf("error: %s\n", error.c_str());
+			return 1;
+		}
+		const VirtualTextureDesc& fileDesc = system.GetDesc();
+		const uint32_t fileRoot = PageId::Pack(fileDesc.mipCount - 1, 0, 0);
+
+		// each frame views a single mip 0 page. the three pages of a new view
+		// evict the last one's, except pages its feedback touched in that frame
+		struct Frame
+		{
+			uint32_t x, y;
+			uint32_t uploaded, evicted, dropped;
+			std::vector<uint32_t> expectResident;
+			std::vector<uint32_t> expectMissing;
+		};
+		const std::vector<Frame> frames = {
+			// root, then mip 2, 1 and 0 above 1,1 into the free slots
+			{ 1, 1, 4, 0, 0, { fileRoot, PageId::Pack(2, 0, 0), PageId::Pack(1, 0, 0), PageId::Pack(0, 1, 1) }, {} },
+			// the other corner, all three from before go in lru order
+			{ 6, 6, 3, 3, 0, { PageId::Pack(2, 1, 1), PageId::Pack(1, 3, 3), PageId::Pack(0, 6, 6) },
+				{ PageId::Pack(2, 0, 0), PageId::Pack(1, 0, 0), PageId::Pack(0, 1, 1) } },
+			// 0,0 while 6,6 is still on screen: only 6,6 itself was touched, so its
+			// ancestors make room and the last load is dropped
+			{ 0, 0, 2, 2, 1, { PageId::Pack(0, 6, 6), PageId::Pack(2, 0, 0), PageId::Pack(1, 0, 0) },
+				{ PageId::Pack(2, 1, 1), PageId::Pack(1, 3, 3), PageId::Pack(0, 0, 0) } },
+			// the dropped page is asked for again and replaces 6,6
+			{ 0, 0, 1, 1, 0, { PageId::Pack(0, 0, 0), PageId::Pack(2, 0, 0), PageId::Pack(1, 0, 0) }, { PageId::Pack(0, 6, 6) } },
+		};
+		std::vector<uint32_t> frameFeedback;
+		std::vector<VirtualTextureSystem::PageUpload> uploads;
+		std::vector<uint8_t> pixels;
+		for (uint32_t frame = 0; frame < frames.size(); frame++)
+		{
+			const Frame& expected = frames[frame];
+			frameFeedback.assign(256, PageId::Pack(0, expected.x, expected.y));
+			// the previous view stays partly on screen in the third frame
+			if (frame == 2) {
+				frameFeedback.resize(384, PageId::Pack(0, 6, 6));
+			}
+			system.ProcessFeedback(frameFeedback.data(), frameFeedback.size(), frame + 1);
+			system.WaitForLoads();
+			uploads.clear();
+			system.CollectCompletedPages(16, uploads);
+
+			const VirtualTextureStats& stats = system.GetStats();
+			if (stats.uploadedThisFrame != expected.uploaded || stats.evictedThisFrame != expected.evicted ||
+				stats.droppedThisFrame != expected.dropped || uploads.size() != expected.uploaded) {
+				std::printf("frame %u: %u uploaded, %u evicted, %u dropped, expected %u, %u and %u, MISMATCH\n", frame + 1,
+					stats.uploadedThisFrame, stats.evictedThisFrame, stats.droppedThisFrame, expected.uploaded, expected.evicted,
+					expected.dropped);
+				return 1;
+			}
+
+			const PhysicalPageCache& systemCache = system.GetCache();
+			std::map<uint32_t, uint32_t> systemResident;
+			for (uint32_t mip = 0; mip < fileDesc.mipCount; mip++) {
+				for (uint32_t y = 0; y < fileDesc.PagesY(mip); y++) {
+					for (uint32_t x = 0; x < fileDesc.PagesX(mip); x++) {
+						uint32_t slot = systemCache.Find(PageId::Pack(mip, x, y));
+						if (slot != UINT32_MAX) {
+							systemResident[PageId::Pack(mip, x, y)] = systemCache.SlotX(slot) | systemCache.SlotY(slot) << 8;
+						}
+					}
+				}
+			}
+			bool residency = systemResident.size() == 4;
+			for (uint32_t pageId : expected.expectResident) {
+				residency = residency && systemResident.count(pageId);
+			}
+			for (uint32_t pageId : expected.expectMissing) {
+				residency = residency && !systemResident.count(pageId);
+			}
+			if (!residency) {
+				std::printf("frame %u: the wrong pages are resident, MISMATCH\n", frame + 1);
+				return 1;
+			}
+
+			// evicted pages fall back to what's left above them, and every upload
+			// carries the page the table maps to its slot
+			uint32_t wrongPage = FindWrongEntry(system.GetPageTable(), fileDesc, systemResident);
+			if (wrongPage != PageId::Invalid) {
+				std::printf("frame %u: mip %u page %u,%u isn't remapped to its closest resident ancestor, MISMATCH\n", frame + 1,
+					PageId::Mip(wrongPage), PageId::X(wrongPage), PageId::Y(wrongPage));
+				return 1;
+			}
+			for (const auto& upload : uploads)
+			{
+				auto page = std::find_if(systemResident.begin(), systemResident.end(), [&](const auto& entry) {
+					return entry.second == (upload.slotX | upload.slotY << 8);
+				});
+				if (page == systemResident.end() || !pageFile.ReadPage(page->first, pixels) || pixels != upload.pixels) {
+					std::printf("frame %u: upload to slot %u,%u doesn't hold the page mapped there, MISMATCH\n", frame + 1,
+						upload.slotX, upload.slotY);
+					return 1;
+				}
+			}
+		}
+		system.Shutdown();
+		pageFile.Close();
+		std::filesystem::remove(pageFilePath);
+		std::printf("page file: %zu frames of feedback uploaded, evicted and remapped as expected\n", frames.size());
+		return 0;
+	}
+	int BenchUploads(const std::vector<std::string>& args)
+	{
+		int rounds = args.size() > 1 ? std::max(1, std::atoi(args[1].c_str())) : 300;
+		std::mt19937 random(12345);
+
+		// 1 MB of staging and 256 KB batches, so buffers are split into chunks and
+		// textures into row ranges, and most uploads wait for staging to come back
+		NullUploadBackend backend(1024 * 1024);
+		UploadService uploads;
+		uploads.Initialize(&backend, 3);
+		uploads.maxBatchBytes = 256 * 1024;
+
+		struct Upload
+		{
+			std::vector<uint8_t> data; // tightly packed rows for textures
+			std::vector<uint8_t> buffer;
+			std::vector<std::vector<uint8_t>> subresources;
+			bool texture;
+		};
+		std::vector<Upload> uploaded(rounds);
+		std::vector<uint8_t> staged;
+		uint32_t textureRows = 0;
+		for (int i = 0; i < rounds; i++)
+		{
+			Upload& upload = uploaded[i];
+			upload.texture = random() % 2 == 0;
+			UploadToken token;
+			if (!upload.texture)
+			{
+				upload.data.resize(1 + random() % (2 * 1024 * 1024));
+				for (auto& byte : upload.data) {
+					byte = static_cast<uint8_t>(random());
+				}
+				upload.buffer.resize(upload.data.size() + 64);
+				token = uploads.UploadBuffer(upload.buffer.data(), 64, upload.data.data(), upload.data.size());
+			}
+			else
+			{
+				// rgba8 rows padded to 256 bytes like GetCopyableFootprints
+				UploadTextureFootprint footprint = {};
+				footprint.width = 1 + random() % 1024;
+				footprint.height = 1 + random() % 1024;
+				footprint.rowSize = footprint.width * 4;
+				footprint.rowPitch = (footprint.rowSize + 255) / 256 * 256;
+				footprint.numRows = footprint.height;
+				upload.data.resize(size_t(footprint.rowSize) * footprint.numRows);
+				for (auto& byte : upload.data) {
+					byte = static_cast<uint8_t>(random());
+				}
+				staged.assign(size_t(footprint.rowPitch) * footprint.numRows, 0);
+				for (uint32_t row = 0; row < footprint.numRows; row++) {
+					std::memcpy(staged.data() + size_t(row) * footprint.rowPitch, upload.data.data() + size_t(row) * footprint.rowSize,
+						footprint.rowSize);
+				}
+				upload.subresources.resize(1);
+				token = uploads.UploadTexture(&upload.subresources, 0, staged.data(), footprint);
+				textureRows += footprint.numRows;
+			}
+			if (token == 0) {
+				std::printf("upload %d returned 0 though every piece fits the staging, MISMATCH\n", i);
+				return 1;
+			}
+			backend.CompleteBatches(random() % 2);
+		}
+		uploads.Wait(uploads.Flush());
+
+		for (int i = 0; i < rounds; i++)
+		{
+			const Upload& upload = uploaded[i];
+			bool same = upload.texture ? upload.subresources[0] == upload.data :
+				std::memcmp(upload.buffer.data() + 64, upload.data.data(), upload.data.size()) == 0;
+			if (!same) {
+				std::printf("upload %d arrived different, MISMATCH\n", i);
+				return 1;
+			}
+		}
+		const UploadServiceStats& stats = uploads.GetStats();
+		std::printf("%d uploads, %.1f MB in %llu batches, %u texture rows, %llu staging stalls\n", rounds,
+			stats.bytes / 1048576.0, static_cast<unsigned long long>(stats.batches), textureRows,
+			static_cast<unsigned long long>(stats.stagingStalls));
+
+		// batches allowed to be larger than the staging: copies that can't be
+		// staged even with nothing in flight return 0 instead of writing through
+		// a null staging pointer, and the service carries on
+		uploads.maxBatchBytes = 4 * 1024 * 1024;
+		std::vector<uint8_t> large(2 * 1024 * 1024, 0xab);
+		std::vector<uint8_t> largeBuffer(large.size());
+		std::vector<std::vector<uint8_t>> largeTexture(1);
+		UploadTextureFootprint footprint = {};
+		footprint.width = 512;
+		footprint.height = 1024;
+		footprint.rowSize = 2048;
+		footprint.rowPitch = 2048;
+		footprint.numRows = 1024;
+		bool written = false;
+		uint64_t failuresBefore = stats.stagingFailures;
+		UploadToken buffer = uploads.UploadBuffer(largeBuffer.data(), 0, large.data(), large.size());
+		UploadToken texture = uploads.UploadTexture(&largeTexture, 0, large.data(), footprint);
+		UploadToken inPlace = uploads.UploadBufferInPlace(largeBuffer.data(), 0, large.size(),
+			[&](uint8_t*) { written = true; return true; });
+		UploadToken small = uploads.UploadBuffer(largeBuffer.data(), 0, large.data(), 1000);
+		uploads.Wait(uploads.Flush());
+		if (buffer != 0 || texture != 0 || inPlace != 0 || written || stats.stagingFailures != failuresBefore + 3 ||
+			small == 0 || largeBuffer[999] != 0xab || largeBuffer[1000] != 0) {
+			std::printf("uploads larger than the staging didn't fail cleanly, MISMATCH\n");
+			return 1;
+		}
+		std::printf("uploads larger than the staging returned 0, the next one went through\n");
+		return 0;
+	}
+}
+
+int RunAssetPackTool(const std::vector<std::string>& args)
+{
+	if (args.empty()) {
+		return -1;
+	}
+	if (args[0] == "--pack") {
+		return Pack(args);
+	}
+	if (args[0] == "--bench-package") {
+		return Bench(args);
+	}
+	if (args[0] == "--bench-geometry") {
+		return BenchGeometry(args);
+	}
+	if (args[0] == "--bench-profiler") {
+		return BenchProfiler(args);
+	}
+	if (args[0] == "--bench-gpu-tree") {
+		return BenchGpuProfileTree(args);
+	}
+	if (args[0] == "--bench-jobs") {
+		return BenchJobs(args);
+	}
+	if (args[0] == "--bench-frames") {
+		return BenchFrames(args);
+	}
+	if (args[0] == "--bench-culling") {
+		return BenchCulling(args);
+	}
+	if (args[0] == "--bench-coverage") {
+		return BenchCoverage(args);
+	}
+	if (args[0] == "--bench-residency") {
+		return BenchResidency(args);
+	}
+	if (args[0] == "--bench-tlsf") {
+		return BenchTlsf(args);
+	}
+	if (args[0] == "--bench-geometry-layout") {
+		return BenchGeometryLayout(args);
+	}
+	if (args[0] == "--bench-ring") {
+		return BenchRing(args);
+	}
+	if (args[0] == "--bench-releases") {
+		return BenchReleases(args);
+	}
+	if (args[0] == "--bench-codecs") {
+		return BenchCodecs(args);
+	}
+	if (args[0] == "--bench-streaming") {
+		return BenchStreaming(args);
+	}
+	if (args[0] == "--bench-footprints") {
+		return BenchFootprints(args);
+	}
+	if (args[0] == "--bench-virtual") {
+		return BenchVirtualTexture(args);
+	}
+	if (args[0] == "--bench-uploads") {
+		return BenchUploads(args);
+	}
+	return -1;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+// command line front end for asset packages, run through the renderer exe:
+//
+//   --pack <root> <output.pak> <file or directory>...
+//       packs the files (directories recursively) under names relative to root.
+//       cooked .dxtex and .dxmesh files are skipped, they're rebuilt on load
+//   --bench-package <root> <package.pak> [passes]
+//       reads every packaged asset as a loose file under root and from the
+//       package, timing open and read separately. the first pass is only cold
+//       if the os file cache was dropped beforehand
+//   --bench-geometry <mesh.dxmesh> [passes]
+//       sizes of the mesh cache's geometry raw, GeometryCodec encoded and with
+//       lz4 on top, and decode throughput of the sse2 and scalar decoders
+//   --bench-profiler [zones] [trace.json]
+//       cost of a CpuProfiler zone in ns against an empty loop, optionally
+//       writing the recorded zones out as a chrome trace
+//   --bench-gpu-tree [frames]
+//       feeds GpuProfileTree a hand built frame and random scope trees of
+//       synthetic timestamps, checking nesting, self times, siblings merged
+//       into one sample per path, the moving averages and frames across the
+//       timestamp counter wrapping around
+//   --bench-jobs [workers] [items]
+//       stress checks the JobSystem with workers workers, then times a
+//       ParallelFor over items and empty job throughput on 1, 2, 4 ... workers
+//   --bench-frames <mesh.dxmesh | synthetic[:meshes]> [frames] [workers] [null | d3d12] [telemetry.json]
+//       runs the frame loop headless (see HeadlessFrameLoop) for frames frames
+//       and prints the phase percentiles. on the null device also commands,
+//       state changes and bytes per frame, and fails on any validation error.
+//       d3d12 compiles the shaders from the working directory
+//   --bench-culling [boxes] [passes]
+//       checks FrustumCuller's simd paths against the scalar one on random
+//       boxes and frusta, then times each path culling boxes random boxes
+//   --bench-coverage [image]...
+//       builds mips of synthetic alpha masks and of the images' alpha with
+//       GenerateMips and GenerateMipsPreservingCoverage and fails when a
+//       preserved mip's alpha test coverage is off mip 0's by more than 0.05
+//   --bench-residency [frames] [budget MB]
+//       drives TextureResidencyManager along a scripted camera path through a
+//       fake corridor of textures, halving the budget halfway, and fails when
+//       resident bytes are over the budget after any Update
+//   --bench-tlsf [steps]
+//       fuzzes TlsfAllocator with steps random allocs and frees, validating it
+//       and checking the live allocations don't overlap after every step, then
+//       times alloc and free pairs
+//   --bench-geometry-layout [cycles]
+//       cycles of random mesh adds and removes through a GeometryLayout over
+//       cpu arrays, growing and compacting like GeometryPool, checking every
+//       live mesh finds its elements at its range after the copy runs
+//   --bench-ring [frames]
+//       checks RingAllocator wrapping around its end by hand, then runs frames
+//       frames of random allocations against a fence timeline completing up to
+//       3 frames late, failing on overlap with a range still in flight
+//   --bench-releases [frames]
+//       retires releases into a DeferredReleaseQueue at increasing fence values,
+//       some late and some retiring more, and fails unless every Process runs
+//       exactly the releases at or below the completed fence, oldest first
+//   --bench-codecs [meshes]
+//       round trips meshes random grids through GeometryCodec's decoders, random
+//       buffers through lz4 and a synthetic scene through a .dxmesh cache, and
+//       feeds all three truncated and bit flipped copies. build with the
+//       sanitizers to catch the reads out of bounds
+//   --bench-streaming [package.pak]
+//       streams a generated file raw and lz4 compressed into memory and into
+//       NullUploadBackend buffers, one gpu batch finishing per frame, with a
+//       read past the end and corrupt lz4 that have to fail. with a package
+//       every asset is streamed and compared to AssetPackage::Read
+//   --bench-footprints
+//       checks TextureContainer::ComputeLayout against GetCopyableFootprints'
+//       rules, written out independently, for odd and non power of two sizes,
+//       bc and plain formats, single mips, full chains, array slices and
+//       every mip range a streamed resource can hold
+//   --bench-virtual [rounds]
+//       drives the virtual texture page table, FeedbackAnalyzer and
+//       PhysicalPageCache with synthetic feedback against reference models of
+//       the fallbacks, requests and lru order, then runs VirtualTextureSystem
+//       on a generated page file and checks evictions and the remapped table
+//   --bench-uploads [count]
+//       random buffer and texture uploads through UploadService and a
+//       NullUploadBackend with less staging than they need at once, compared
+//       byte for byte, then copies larger than the staging that have to fail
+//
+// returns the process exit code, or -1 when args aren't a tool command
+int RunAssetPackTool(const std::vector<std::string>& args);
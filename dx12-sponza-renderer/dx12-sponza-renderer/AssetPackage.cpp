@@ -0,0 +1,440 @@
+#include "AssetPackage.h"
+#include "Lz4.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <thread>
+
+namespace
+{
+	const uint32_t PackageVersion = 1;
+
+	uint32_t WorkerCount(uint32_t requested, uint32_t jobs)
+	{
+		uint32_t threads = requested > 0 ? requested : std::max(1u, std::thread::hardware_concurrency());
+		return std::max(1u, std::min(threads, jobs));
+	}
+
+	// runs job(i) for i in [0, count) on up to workers threads, the caller included
+	template<typename Job>
+	void ParallelFor(uint32_t count, uint32_t workers, const Job& job)
+	{
+		std::atomic<uint32_t> next(0);
+		auto worker = [&]() {
+			for (uint32_t i = next++; i < count; i = next++) {
+				job(i);
+			}
+		};
+
+		std::vector<std::future<void>> helpers;
+		for (uint32_t i = 1; i < workers; i++) {
+			helpers.push_back(std::async(std::launch::async, worker));
+		}
+		worker();
+		for (auto& helper : helpers) {
+			helper.get();
+		}
+	}
+
+	char NormalizeChar(char c)
+	{
+		return c == '\\' ? '/' : static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	}
+
+	// stored names keep their case for the loose file fallback
+	bool NamesEqual(const char* stored, const std::string& normalized)
+	{
+		for (size_t i = 0; i < normalized.size(); i++) {
+			if (NormalizeChar(stored[i]) != normalized[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	uint32_t ChunkCount(uint64_t size, uint32_t chunkSize)
+	{
+		return static_cast<uint32_t>((size + chunkSize - 1) / chunkSize);
+	}
+}
+
+std::string AssetPackage::NormalizeName(const std::string& name)
+{
+	std::string normalized = name;
+	for (char& c : normalized) {
+		c = NormalizeChar(c);
+	}
+	return normalized;
+}
+
+uint64_t AssetPackage::HashName(const std::string& normalizedName)
+{
+	// fnv-1a
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : normalizedName)
+	{
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool AssetPackage::Open(const std::string& filename, std::string& error)
+{
+	Close();
+	if (!m_file.Open(filename, error)) {
+		error = "asset package: " + error;
+		return false;
+	}
+
+	const uint8_t* bytes = m_file.GetData();
+	const uint64_t fileSize = m_file.GetSize();
+	AssetPackageHeader header = {};
+	if (fileSize >= sizeof(header)) {
+		std::memcpy(&header, bytes, sizeof(header));
+	}
+
+	uint64_t tocSize = uint64_t(header.bucketCount) * sizeof(uint32_t) + uint64_t(header.entryCount) * sizeof(AssetPackageEntry) +
+		uint64_t(header.chunkCount) * sizeof(AssetPackageChunk) + header.namesSize;
+	bool valid = std::memcmp(header.magic, "DXPK", 4) == 0 && header.version == PackageVersion && header.chunkSize > 0 &&
+		header.bucketCount > 0 && (header.bucketCount & (header.bucketCount - 1)) == 0 && header.bucketCount > header.entryCount &&
+		header.tocOffset >= sizeof(header) && header.tocOffset <= fileSize && tocSize <= fileSize - header.tocOffset &&
+		header.tocOffset % alignof(AssetPackageEntry) == 0;
+	if (!valid) {
+		error = "invalid asset package " + filename;
+		Close();
+		return false;
+	}
+
+	const uint8_t* toc = bytes + header.tocOffset;
+	m_buckets = reinterpret_cast<const uint32_t*>(toc);
+	toc += uint64_t(header.bucketCount) * sizeof(uint32_t);
+	m_entries = reinterpret_cast<const AssetPackageEntry*>(toc);
+	toc += uint64_t(header.entryCount) * sizeof(AssetPackageEntry);
+	m_chunks = reinterpret_cast<const AssetPackageChunk*>(toc);
+	toc += uint64_t(header.chunkCount) * sizeof(AssetPackageChunk);
+	m_names = reinterpret_cast<const char*>(toc);
+	m_header = header;
+
+	// everything Read trusts is checked once here
+	for (uint32_t bucket = 0; bucket < header.bucketCount && valid; bucket++) {
+		valid = m_buckets[bucket] == ~0u || m_buckets[bucket] < header.entryCount;
+	}
+	for (uint32_t i = 0; i < header.entryCount && valid; i++)
+	{
+		const AssetPackageEntry& entry = m_entries[i];
+		valid = uint64_t(entry.nameOffset) + entry.nameLength <= header.namesSize &&
+			uint64_t(entry.firstChunk) + entry.chunkCount <= header.chunkCount &&
+			entry.chunkCount == ChunkCount(entry.size, header.chunkSize);
+	}
+	for (uint32_t i = 0; i < header.chunkCount && valid; i++)
+	{
+		const AssetPackageChunk& chunk = m_chunks[i];
+		valid = chunk.offset >= sizeof(header) && chunk.offset <= header.tocOffset && chunk.compressedSize <= header.tocOffset - chunk.offset &&
+			chunk.compressedSize <= header.chunkSize &&
+			(chunk.compression == AssetCompressionNone || chunk.compression == AssetCompressionLz4);
+	}
+	if (!valid) {
+		error = "corrupt asset package table of contents " + filename;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void AssetPackage::Close()
+{
+	m_file.Close();
+	m_header = {};
+	m_buckets = nullptr;
+	m_entries = nullptr;
+	m_chunks = nullptr;
+	m_names = nullptr;
+}
+
+const AssetPackageEntry* AssetPackage::FindEntry(const std::string& name) const
+{
+	if (!IsOpen()) {
+		return nullptr;
+	}
+
+	std::string normalized = NormalizeName(name);
+	uint64_t hash = HashName(normalized);
+	uint32_t mask = m_header.bucketCount - 1;
+	for (uint32_t bucket = static_cast<uint32_t>(hash) & mask; m_buckets[bucket] != ~0u; bucket = (bucket + 1) & mask)
+	{
+		const AssetPackageEntry& entry = m_entries[m_buckets[bucket]];
+		if (entry.nameHash == hash && entry.nameLength == normalized.size() &&
+			NamesEqual(m_names + entry.nameOffset, normalized)) {
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+uint64_t AssetPackage::GetSize(const std::string& name) const
+{
+	const AssetPackageEntry* entry = FindEntry(name);
+	return entry ? entry->size : 0;
+}
+
+std::string AssetPackage::GetEntryName(uint32_t entry) const
+{
+	return std::string(m_names + m_entries[entry].nameOffset, m_entries[entry].nameLength);
+}
+
+bool AssetPackage::DecompressChunk(uint32_t chunk, uint8_t* destination, size_t size) const
+{
+	const AssetPackageChunk& info = m_chunks[chunk];
+	const uint8_t* source = m_file.GetData() + info.offset;
+	if (info.compression == AssetCompressionNone)
+	{
+		if (info.compressedSize != size) {
+			return false;
+		}
+		std::memcpy(destination, source, size);
+		return true;
+	}
+	return Lz4::Decompress(source, info.compressedSize, destination, size);
+}
+
+bool AssetPackage::Read(const std::string& name, std::vector<uint8_t>& data, std::string& error) const
+{
+	const AssetPackageEntry* entry = FindEntry(name);
+	if (!entry) {
+		error = "asset not in package: " + name;
+		return false;
+	}
+
+	data.resize(static_cast<size_t>(entry->size));
+	const uint32_t chunkSize = m_header.chunkSize;
+	std::atomic<bool> failed(false);
+	ParallelFor(entry->chunkCount, WorkerCount(workerThreads, entry->chunkCount), [&](uint32_t i) {
+		uint64_t offset = uint64_t(i) * chunkSize;
+		size_t size = static_cast<size_t>(std::min<uint64_t>(chunkSize, entry->size - offset));
+		if (!DecompressChunk(entry->firstChunk + i, data.data() + offset, size)) {
+			failed = true;
+		}
+	});
+
+	if (failed) {
+		error = "corrupt chunk in asset " + name;
+		return false;
+	}
+	return true;
+}
+
+bool AssetPackage::GetChunkLocations(const std::string& name, std::vector<AssetChunkLocation>& chunks) const
+{
+	const AssetPackageEntry* entry = FindEntry(name);
+	if (!entry) {
+		return false;
+	}
+
+	chunks.clear();
+	for (uint32_t i = 0; i < entry->chunkCount; i++)
+	{
+		const AssetPackageChunk& chunk = m_chunks[entry->firstChunk + i];
+		uint64_t assetOffset = uint64_t(i) * m_header.chunkSize;
+		uint32_t uncompressedSize = static_cast<uint32_t>(std::min<uint64_t>(m_header.chunkSize, entry->size - assetOffset));
+		chunks.push_back({ chunk.offset, chunk.compressedSize, uncompressedSize, assetOffset,
+			static_cast<AssetCompression>(chunk.compression) });
+	}
+	return true;
+}
+
+bool AssetPackageWriter::AddFile(const std::string& name, std::vector<uint8_t>&& data)
+{
+	std::string normalized = AssetPackage::NormalizeName(name);
+	for (const File& file : m_files) {
+		if (AssetPackage::NormalizeName(file.name) == normalized) {
+			return false;
+		}
+	}
+	std::string stored = name;
+	std::replace(stored.begin(), stored.end(), '\\', '/');
+	m_uncompressedBytes += data.size();
+	m_files.push_back({ stored, std::move(data) });
+	return true;
+}
+
+bool AssetPackageWriter::AddFileFromDisk(const std::string& name, const std::string& path, std::string& error)
+{
+	std::FILE* input = std::fopen(path.c_str(), "rb");
+	if (!input) {
+		error = "failed to open " + path;
+		return false;
+	}
+	std::vector<uint8_t> data;
+	std::fseek(input, 0, SEEK_END);
+	long size = std::ftell(input);
+	std::fseek(input, 0, SEEK_SET);
+	bool ok = size >= 0;
+	if (ok)
+	{
+		data.resize(static_cast<size_t>(size));
+		ok = std::fread(data.data(), 1, data.size(), input) == data.size();
+	}
+	std::fclose(input);
+	if (!ok) {
+		error = "failed to read " + path;
+		return false;
+	}
+	if (!AddFile(name, std::move(data))) {
+		error = "duplicate asset " + name;
+		return false;
+	}
+	return true;
+}
+
+bool AssetPackageWriter::Write(const std::string& filename, std::string& error)
+{
+	const uint32_t chunkSize = AssetPackage::ChunkSize;
+
+	AssetPackageHeader header = {};
+	std::memcpy(header.magic, "DXPK", 4);
+	header.version = PackageVersion;
+	header.chunkSize = chunkSize;
+	header.entryCount = static_cast<uint32_t>(m_files.size());
+	header.bucketCount = 1;
+	while (header.bucketCount < header.entryCount * 2 || header.bucketCount <= header.entryCount) {
+		header.bucketCount *= 2;
+	}
+
+	// chunk sources in file order
+	struct ChunkSource
+	{
+		const uint8_t* data;
+		size_t size;
+	};
+	std::vector<AssetPackageEntry> entries(m_files.size());
+	std::vector<ChunkSource> sources;
+	std::string names;
+	for (size_t i = 0; i < m_files.size(); i++)
+	{
+		const File& file = m_files[i];
+		AssetPackageEntry& entry = entries[i];
+		entry.nameHash = AssetPackage::HashName(AssetPackage::NormalizeName(file.name));
+		entry.nameOffset = static_cast<uint32_t>(names.size());
+		entry.nameLength = static_cast<uint32_t>(file.name.size());
+		entry.size = file.data.size();
+		entry.firstChunk = static_cast<uint32_t>(sources.size());
+		entry.chunkCount = ChunkCount(entry.size, chunkSize);
+		names += file.name;
+		for (uint64_t offset = 0; offset < entry.size; offset += chunkSize) {
+			sources.push_back({ file.data.data() + offset, static_cast<size_t>(std::min<uint64_t>(chunkSize, entry.size - offset)) });
+		}
+	}
+	header.chunkCount = static_cast<uint32_t>(sources.size());
+	header.namesSize = names.size();
+
+	// compressed chunks that don't save at least an eighth are stored raw,
+	// a memcpy is cheaper to read than an lz4 block that barely shrank
+	std::vector<std::vector<uint8_t>> compressed(sources.size());
+	ParallelFor(header.chunkCount, WorkerCount(0, header.chunkCount), [&](uint32_t i) {
+		std::vector<uint8_t>& output = compressed[i];
+		output.resize(Lz4::CompressBound(sources[i].size));
+		size_t size = Lz4::Compress(sources[i].data, sources[i].size, output.data(), output.size());
+		output.resize(size > 0 && size < sources[i].size - sources[i].size / 8 ? size : 0);
+	});
+
+	std::vector<AssetPackageChunk> chunks(sources.size());
+	uint64_t offset = sizeof(header);
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		bool stored = compressed[i].empty();
+		chunks[i].offset = offset;
+		chunks[i].compressedSize = static_cast<uint32_t>(stored ? sources[i].size : compressed[i].size());
+		chunks[i].compression = stored ? AssetCompressionNone : AssetCompressionLz4;
+		offset += chunks[i].compressedSize;
+	}
+	header.tocOffset = (offset + alignof(AssetPackageEntry) - 1) & ~uint64_t(alignof(AssetPackageEntry) - 1);
+
+	std::vector<uint32_t> buckets(header.bucketCount, ~0u);
+	for (uint32_t i = 0; i < header.entryCount; i++)
+	{
+		uint32_t bucket = static_cast<uint32_t>(entries[i].nameHash) & (header.bucketCount - 1);
+		while (buckets[bucket] != ~0u) {
+			bucket = (bucket + 1) & (header.bucketCount - 1);
+		}
+		buckets[bucket] = i;
+	}
+
+	std::FILE* output = std::fopen(filename.c_str(), "wb");
+	if (!output) {
+		error = "failed to create asset package " + filename;
+		return false;
+	}
+	bool ok = std::fwrite(&header, sizeof(header), 1, output) == 1;
+	m_compressedBytes = 0;
+	for (size_t i = 0; i < sources.size() && ok; i++)
+	{
+		const uint8_t* data = compressed[i].empty() ? sources[i].data : compressed[i].data();
+		ok = std::fwrite(data, 1, chunks[i].compressedSize, output) == chunks[i].compressedSize;
+		m_compressedBytes += chunks[i].compressedSize;
+	}
+	static const uint8_t padding[8] = {};
+	ok = ok && std::fwrite(padding, 1, header.tocOffset - offset, output) == header.tocOffset - offset;
+	ok = ok && std::fwrite(buckets.data(), sizeof(uint32_t), buckets.size(), output) == buckets.size();
+	ok = ok && std::fwrite(entries.data(), sizeof(AssetPackageEntry), entries.size(), output) == entries.size();
+	ok = ok && std::fwrite(chunks.data(), sizeof(AssetPackageChunk), chunks.size(), output) == chunks.size();
+	ok = ok && std::fwrite(names.data(), 1, names.size(), output) == names.size();
+	ok = std::fclose(output) == 0 && ok;
+	if (!ok) {
+		error = "failed to write asset package " + filename;
+	}
+	return ok;
+}
+
+bool AssetFileSystem::Mount(const std::string& packageFile, std::string& error)
+{
+	if (!m_package.Open(packageFile, error)) {
+		return false;
+	}
+	m_packageFile = packageFile;
+	return true;
+}
+
+bool AssetFileSystem::Exists(const std::string& name) const
+{
+	std::error_code ec;
+	return m_package.Contains(name) || std::filesystem::exists(GetLoosePath(name), ec);
+}
+
+bool AssetFileSystem::Read(const std::string& name, std::vector<uint8_t>& data, std::string& error) const
+{
+	if (m_package.Contains(name)) {
+		return m_package.Read(name, data, error);
+	}
+
+	std::FILE* input = std::fopen(GetLoosePath(name).c_str(), "rb");
+	if (!input) {
+		error = "failed to open " + GetLoosePath(name);
+		return false;
+	}
+	std::fseek(input, 0, SEEK_END);
+	long size = std::ftell(input);
+	std::fseek(input, 0, SEEK_SET);
+	bool ok = size >= 0;
+	if (ok)
+	{
+		data.resize(static_cast<size_t>(size));
+		ok = std::fread(data.data(), 1, data.size(), input) == data.size();
+	}
+	std::fclose(input);
+	if (!ok) {
+		error = "failed to read " + GetLoosePath(name);
+	}
+	return ok;
+}
+
+std::filesystem::file_time_type AssetFileSystem::GetWriteTime(const std::string& name, std::error_code& ec) const
+{
+	if (m_package.Contains(name)) {
+		return std::filesystem::last_write_time(m_packageFile, ec);
+	}
+	return std::filesystem::last_write_time(GetLoosePath(name), ec);
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <filesystem>
+#include "MappedFile.h"
+
+// single file archive of assets. every asset is split into ChunkSize chunks
+// compressed independently with lz4 (kept raw when that doesn't pay off), so
+// one asset decompresses on several threads and a reader never needs more
+// than the chunks it touches. the table of contents at the end of the file
+// is an open addressing hash table over the normalized asset names.
+//
+// file layout:
+//   AssetPackageHeader
+//   chunk data
+//   uint32_t buckets[bucketCount]   entry index or ~0u
+//   AssetPackageEntry entries[entryCount]
+//   AssetPackageChunk chunks[chunkCount]
+//   char names[namesSize]
+
+struct AssetPackageHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t chunkSize;
+	uint32_t entryCount;
+	uint32_t bucketCount; // power of two
+	uint32_t chunkCount;
+	uint64_t tocOffset;
+	uint64_t namesSize;
+};
+
+struct AssetPackageEntry
+{
+	uint64_t nameHash;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint64_t size;
+	uint32_t firstChunk;
+	uint32_t chunkCount;
+};
+
+struct AssetPackageChunk
+{
+	uint64_t offset;
+	uint32_t compressedSize;
+	uint32_t compression; // AssetCompression
+};
+
+enum AssetCompression : uint32_t
+{
+	AssetCompressionNone = 0,
+	AssetCompressionLz4 = 1
+};
+
+// where one chunk of an asset sits in the package file, for reading assets
+// with something other than AssetPackage::Read, e.g. a StreamingQueue
+struct AssetChunkLocation
+{
+	uint64_t fileOffset;
+	uint32_t size; // bytes in the file
+	uint32_t uncompressedSize;
+	uint64_t assetOffset; // where the chunk goes in the asset
+	AssetCompression compression;
+};
+
+class AssetPackage
+{
+public:
+	static const uint32_t ChunkSize = 64 * 1024;
+
+	// asset names use forward slashes and are case insensitive, both are
+	// normalized before hashing so "Textures\\Lion.tga" finds "textures/lion.tga".
+	// the package stores names as they were added
+	static std::string NormalizeName(const std::string& name);
+	static uint64_t HashName(const std::string& normalizedName);
+
+	// maps the file and validates the table of contents, nothing else is read
+	bool Open(const std::string& filename, std::string& error);
+	void Close();
+	bool IsOpen() const { return m_file.IsOpen(); }
+
+	bool Contains(const std::string& name) const { return FindEntry(name) != nullptr; }
+	uint64_t GetSize(const std::string& name) const;
+
+	// decompresses the whole asset. chunks are split between up to
+	// workerThreads threads, the calling thread being one of them
+	bool Read(const std::string& name, std::vector<uint8_t>& data, std::string& error) const;
+
+	bool GetChunkLocations(const std::string& name, std::vector<AssetChunkLocation>& chunks) const;
+
+	uint32_t GetEntryCount() const { return m_header.entryCount; }
+	std::string GetEntryName(uint32_t entry) const;
+
+	uint32_t workerThreads = 0; // 0 uses every hardware thread
+
+private:
+	const AssetPackageEntry* FindEntry(const std::string& name) const;
+	bool DecompressChunk(uint32_t chunk, uint8_t* destination, size_t size) const;
+
+	MappedFile m_file;
+	AssetPackageHeader m_header = {};
+	const uint32_t* m_buckets = nullptr;
+	const AssetPackageEntry* m_entries = nullptr;
+	const AssetPackageChunk* m_chunks = nullptr;
+	const char* m_names = nullptr;
+};
+
+// builds a package in memory and writes it in one go
+class AssetPackageWriter
+{
+public:
+	// returns false if the name is already in the package
+	bool AddFile(const std::string& name, std::vector<uint8_t>&& data);
+	bool AddFileFromDisk(const std::string& name, const std::string& path, std::string& error);
+
+	// compresses the chunks on every hardware thread
+	bool Write(const std::string& filename, std::string& error);
+
+	uint64_t GetUncompressedBytes() const { return m_uncompressedBytes; }
+	uint64_t GetCompressedBytes() const { return m_compressedBytes; }
+
+private:
+	struct File
+	{
+		std::string name; // forward slashes, original case
+		std::vector<uint8_t> data;
+	};
+
+	std::vector<File> m_files;
+	uint64_t m_uncompressedBytes = 0;
+	uint64_t m_compressedBytes = 0;
+};
+
+// resolves asset names against a mounted package first and loose files under
+// the root second, so loaders don't care which one shipped
+class AssetFileSystem
+{
+public:
+	// root ends with a path separator
+	void SetRoot(const std::string& root) { m_root = root; }
+	bool Mount(const std::string& packageFile, std::string& error);
+
+	bool Exists(const std::string& name) const;
+	bool Read(const std::string& name, std::vector<uint8_t>& data, std::string& error) const;
+
+	// when the asset last changed, for invalidating caches built from it.
+	// packaged assets use the package's time
+	std::filesystem::file_time_type GetWriteTime(const std::string& name, std::error_code& ec) const;
+
+	std::string GetLoosePath(const std::string& name) const { return m_root + name; }
+	const AssetPackage& GetPackage() const { return m_package; }
+
+private:
+	std::string m_root;
+	std::string m_packageFile;
+	AssetPackage m_package;
+};
@@ -0,0 +1,323 @@
+#include "AsyncFileReader.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#ifndef _WIN32
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace
+{
+	// no liburing in the tree, the three syscalls are all it needs
+	int IoUringSetup(uint32_t entries, io_uring_params* params)
+	{
+		return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+	}
+
+	int IoUringEnter(int ring, uint32_t toSubmit, uint32_t minComplete, uint32_t flags)
+	{
+		return static_cast<int>(syscall(__NR_io_uring_enter, ring, toSubmit, minComplete, flags, nullptr, 0));
+	}
+
+	template<typename T>
+	T* RingField(void* ring, uint32_t offset)
+	{
+		return reinterpret_cast<T*>(static_cast<uint8_t*>(ring) + offset);
+	}
+}
+#endif
+
+AsyncFileReader::~AsyncFileReader()
+{
+	Shutdown();
+}
+
+bool AsyncFileReader::Initialize(uint32_t queueDepth, std::string& error)
+{
+	Shutdown();
+	m_queueDepth = std::max(1u, queueDepth);
+	m_reads.assign(m_queueDepth, Read());
+
+#ifdef _WIN32
+	m_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+	if (!m_port) {
+		error = "failed to create io completion port";
+		return false;
+	}
+	m_async = true;
+#else
+	io_uring_params params = {};
+	m_ring = IoUringSetup(m_queueDepth, &params);
+	if (m_ring < 0) {
+		// not an error, reads just stop overlapping
+		m_ring = -1;
+		m_async = false;
+		return true;
+	}
+
+	m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMap) {
+		m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+	}
+	m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+	void* sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQ_RING);
+	void* cqRing = singleMap ? sqRing :
+		mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_CQ_RING);
+	void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQES);
+	m_sqRing = sqRing != MAP_FAILED ? sqRing : nullptr;
+	m_cqRing = cqRing != MAP_FAILED ? cqRing : nullptr;
+	m_sqes = sqes != MAP_FAILED ? sqes : nullptr;
+	if (!m_sqRing || !m_cqRing || !m_sqes) {
+		error = "failed to map io_uring";
+		Shutdown();
+		return false;
+	}
+
+	m_sqHead = RingField<uint32_t>(m_sqRing, params.sq_off.head);
+	m_sqTail = RingField<uint32_t>(m_sqRing, params.sq_off.tail);
+	m_sqMask = RingField<uint32_t>(m_sqRing, params.sq_off.ring_mask);
+	m_sqArray = RingField<uint32_t>(m_sqRing, params.sq_off.array);
+	m_cqHead = RingField<uint32_t>(m_cqRing, params.cq_off.head);
+	m_cqTail = RingField<uint32_t>(m_cqRing, params.cq_off.tail);
+	m_cqMask = RingField<uint32_t>(m_cqRing, params.cq_off.ring_mask);
+	m_cqes = RingField<io_uring_cqe>(m_cqRing, params.cq_off.cqes);
+	m_async = true;
+#endif
+	return true;
+}
+
+void AsyncFileReader::Shutdown()
+{
+	// the kernel may still write into destinations, let it finish
+	std::vector<AsyncReadCompletion> completions;
+	while (m_inFlight > 0) {
+		Poll(true, completions);
+	}
+
+	for (uint32_t file = 0; file < m_files.size(); file++) {
+		CloseFile(file);
+	}
+	m_files.clear();
+	m_reads.clear();
+	m_syncCompletions.clear();
+
+#ifdef _WIN32
+	if (m_port) {
+		CloseHandle(m_port);
+		m_port = nullptr;
+	}
+#else
+	if (m_sqes) {
+		munmap(m_sqes, m_sqesSize);
+	}
+	if (m_cqRing && m_cqRing != m_sqRing) {
+		munmap(m_cqRing, m_cqRingSize);
+	}
+	if (m_sqRing) {
+		munmap(m_sqRing, m_sqRingSize);
+	}
+	m_sqRing = m_cqRing = m_sqes = nullptr;
+	if (m_ring >= 0) {
+		close(m_ring);
+		m_ring = -1;
+	}
+	m_unsubmitted = 0;
+#endif
+	m_async = false;
+}
+
+uint32_t AsyncFileReader::OpenFile(const std::string& filename, std::string& error)
+{
+	File file = {};
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		error = "failed to open " + filename;
+		return InvalidFile;
+	}
+	LARGE_INTEGER size = {};
+	GetFileSizeEx(handle, &size);
+	if (m_port && !CreateIoCompletionPort(handle, m_port, 0, 0)) {
+		CloseHandle(handle);
+		error = "failed to attach " + filename + " to the io completion port";
+		return InvalidFile;
+	}
+	file.handle = reinterpret_cast<intptr_t>(handle);
+	file.size = static_cast<uint64_t>(size.QuadPart);
+#else
+	int descriptor = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor < 0) {
+		error = "failed to open " + filename;
+		return InvalidFile;
+	}
+	struct stat fileStat = {};
+	fstat(descriptor, &fileStat);
+	file.handle = descriptor;
+	file.size = static_cast<uint64_t>(fileStat.st_size);
+#endif
+	file.open = true;
+
+	for (uint32_t i = 0; i < m_files.size(); i++) {
+		if (!m_files[i].open) {
+			m_files[i] = file;
+			return i;
+		}
+	}
+	m_files.push_back(file);
+	return static_cast<uint32_t>(m_files.size() - 1);
+}
+
+void AsyncFileReader::CloseFile(uint32_t file)
+{
+	if (file >= m_files.size() || !m_files[file].open) {
+		return;
+	}
+#ifdef _WIN32
+	CloseHandle(reinterpret_cast<HANDLE>(m_files[file].handle));
+#else
+	close(static_cast<int>(m_files[file].handle));
+#endif
+	m_files[file].open = false;
+}
+
+uint32_t AsyncFileReader::AllocateSlot()
+{
+	for (uint32_t slot = 0; slot < m_reads.size(); slot++) {
+		if (!m_reads[slot].busy) {
+			return slot;
+		}
+	}
+	assert(!"no free read slot, check CanSubmit first");
+	return 0;
+}
+
+void AsyncFileReader::Submit(uint32_t file, uint64_t offset, uint32_t size, void* destination, uint64_t userData)
+{
+	assert(CanSubmit() && m_files[file].open);
+	uint32_t slot = AllocateSlot();
+	Read& read = m_reads[slot];
+	read.userData = userData;
+	read.size = size;
+	read.busy = true;
+	m_inFlight++;
+
+#ifdef _WIN32
+	read.overlapped = {};
+	read.overlapped.Offset = static_cast<DWORD>(offset);
+	read.overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+	// completes through the port even when ReadFile finishes right away
+	if (!ReadFile(reinterpret_cast<HANDLE>(m_files[file].handle), destination, size, nullptr, &read.overlapped) &&
+		GetLastError() != ERROR_IO_PENDING) {
+		Complete(slot, false, m_syncCompletions);
+	}
+#else
+	if (m_async)
+	{
+		// the kernel sees it on the next Poll, so a burst of Submits is one syscall
+		uint32_t tail = *m_sqTail;
+		uint32_t index = tail & *m_sqMask;
+		io_uring_sqe& sqe = static_cast<io_uring_sqe*>(m_sqes)[index];
+		std::memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = IORING_OP_READ;
+		sqe.fd = static_cast<int>(m_files[file].handle);
+		sqe.off = offset;
+		sqe.addr = reinterpret_cast<uint64_t>(destination);
+		sqe.len = size;
+		sqe.user_data = slot;
+		m_sqArray[index] = index;
+		__atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+		m_unsubmitted++;
+		return;
+	}
+
+	uint8_t* target = static_cast<uint8_t*>(destination);
+	uint32_t done = 0;
+	while (done < size)
+	{
+		ssize_t result = pread(static_cast<int>(m_files[file].handle), target + done, size - done, offset + done);
+		if (result < 0 && errno == EINTR) {
+			continue;
+		}
+		if (result <= 0) {
+			break;
+		}
+		done += static_cast<uint32_t>(result);
+	}
+	Complete(slot, done == size, m_syncCompletions);
+#endif
+}
+
+void AsyncFileReader::Complete(uint32_t slot, bool success, std::vector<AsyncReadCompletion>& completions)
+{
+	Read& read = m_reads[slot];
+	assert(read.busy);
+	completions.push_back({ read.userData, success });
+	read.busy = false;
+	m_inFlight--;
+}
+
+void AsyncFileReader::Poll(bool wait, std::vector<AsyncReadCompletion>& completions)
+{
+	if (!m_syncCompletions.empty())
+	{
+		completions.insert(completions.end(), m_syncCompletions.begin(), m_syncCompletions.end());
+		m_syncCompletions.clear();
+		wait = false;
+	}
+	if (!m_async || m_inFlight == 0) {
+		return;
+	}
+
+#ifdef _WIN32
+	OVERLAPPED_ENTRY entries[64];
+	ULONG count = 0;
+	if (!GetQueuedCompletionStatusEx(m_port, entries, _countof(entries), &count, wait ? INFINITE : 0, FALSE)) {
+		return;
+	}
+	for (ULONG i = 0; i < count; i++)
+	{
+		// the overlapped is the first member of its read slot
+		Read* read = reinterpret_cast<Read*>(entries[i].lpOverlapped);
+		uint32_t slot = static_cast<uint32_t>(read - m_reads.data());
+		// failed reads transfer less than asked for
+		Complete(slot, entries[i].dwNumberOfBytesTransferred == read->size, completions);
+	}
+#else
+	for (;;)
+	{
+		if (m_unsubmitted > 0)
+		{
+			int submitted = IoUringEnter(m_ring, m_unsubmitted, 0, 0);
+			if (submitted > 0) {
+				m_unsubmitted -= static_cast<uint32_t>(submitted);
+			}
+		}
+
+		uint32_t head = *m_cqHead;
+		uint32_t tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+		bool reaped = head != tail;
+		for (; head != tail; head++)
+		{
+			const io_uring_cqe& cqe = static_cast<const io_uring_cqe*>(m_cqes)[head & *m_cqMask];
+			uint32_t slot = static_cast<uint32_t>(cqe.user_data);
+			Complete(slot, cqe.res >= 0 && static_cast<uint32_t>(cqe.res) == m_reads[slot].size, completions);
+		}
+		__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+
+		if (!wait || reaped || m_inFlight == 0) {
+			break;
+		}
+		IoUringEnter(m_ring, 0, 1, IORING_ENTER_GETEVENTS);
+	}
+#endif
+}
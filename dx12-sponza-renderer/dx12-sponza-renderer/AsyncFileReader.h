@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// overlapped file reads. windows uses FILE_FLAG_OVERLAPPED handles on one io
+// completion port, linux an io_uring set up with raw syscalls. where io_uring
+// isn't available (old kernels, seccomp) reads fall back to pread inside
+// Submit and complete on the next Poll, which keeps the same interface.
+// io_uring reads reach the kernel on the next Poll, one syscall per burst.
+//
+// single threaded: Submit and Poll are called from the owning thread, only
+// the kernel works in the background.
+
+struct AsyncReadCompletion
+{
+	uint64_t userData;
+	bool success; // false on an error or a short read
+};
+
+class AsyncFileReader
+{
+public:
+	static const uint32_t InvalidFile = ~0u;
+
+	AsyncFileReader() = default;
+	AsyncFileReader(const AsyncFileReader&) = delete;
+	AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+	~AsyncFileReader();
+
+	// queueDepth is the most reads in flight at once
+	bool Initialize(uint32_t queueDepth, std::string& error);
+	// waits for the reads in flight and closes every file
+	void Shutdown();
+
+	uint32_t OpenFile(const std::string& filename, std::string& error);
+	// the file must have no reads in flight
+	void CloseFile(uint32_t file);
+	uint64_t GetFileSize(uint32_t file) const { return m_files[file].size; }
+
+	bool CanSubmit() const { return m_inFlight < m_queueDepth; }
+	// destination has to stay valid until the read's completion is polled
+	void Submit(uint32_t file, uint64_t offset, uint32_t size, void* destination, uint64_t userData);
+
+	// appends finished reads to completions. with wait it blocks until at
+	// least one read finishes, unless nothing is in flight
+	void Poll(bool wait, std::vector<AsyncReadCompletion>& completions);
+
+	uint32_t GetInFlight() const { return m_inFlight; }
+	bool IsAsync() const { return m_async; }
+
+private:
+	struct File
+	{
+		intptr_t handle; // HANDLE or file descriptor
+		uint64_t size;
+		bool open;
+	};
+
+	struct Read
+	{
+#ifdef _WIN32
+		OVERLAPPED overlapped; // first, completions hand back its address
+#endif
+		uint64_t userData;
+		uint32_t size;
+		bool busy;
+	};
+
+	uint32_t AllocateSlot();
+	void Complete(uint32_t slot, bool success, std::vector<AsyncReadCompletion>& completions);
+
+	std::vector<File> m_files;
+	std::vector<Read> m_reads; // one slot per read in flight, never reallocated
+	std::vector<AsyncReadCompletion> m_syncCompletions; // fallback path
+	uint32_t m_queueDepth = 0;
+	uint32_t m_inFlight = 0;
+	bool m_async = false;
+
+#ifdef _WIN32
+	HANDLE m_port = nullptr;
+#else
+	// io_uring
+	int m_ring = -1;
+	void* m_sqRing = nullptr;
+	void* m_cqRing = nullptr;
+	void* m_sqes = nullptr;
+	size_t m_sqRingSize = 0;
+	size_t m_cqRingSize = 0;
+	size_t m_sqesSize = 0;
+	uint32_t* m_sqHead = nullptr;
+	uint32_t* m_sqTail = nullptr;
+	uint32_t* m_sqMask = nullptr;
+	uint32_t* m_sqArray = nullptr;
+	uint32_t* m_cqHead = nullptr;
+	uint32_t* m_cqTail = nullptr;
+	uint32_t* m_cqMask = nullptr;
+	void* m_cqes = nullptr;
+	uint32_t m_unsubmitted = 0;
+#endif
+};
@@ -0,0 +1,184 @@
+#include "BundleCache.h"
+#include <algorithm>
+
+namespace
+{
+	// weight of the newest sample in the moving average
+	const double AverageWeight = 0.05;
+
+	double Milliseconds()
+	{
+		LARGE_INTEGER frequency, counter;
+		QueryPerformanceFrequency(&frequency);
+		QueryPerformanceCounter(&counter);
+		return counter.QuadPart * 1000.0 / frequency.QuadPart;
+	}
+
+	// field by field, draw items have padding
+	bool SameDraw(const DrawItem& a, const DrawItem& b)
+	{
+		return a.pipeline == b.pipeline && a.descriptorTable == b.descriptorTable &&
+			a.constantCount == b.constantCount && a.indexCount == b.indexCount &&
+			a.firstIndex == b.firstIndex && a.baseVertex == b.baseVertex &&
+			std::equal(a.constants, a.constants + a.constantCount, b.constants);
+	}
+}
+
+bool BundleCache::Initialize(ID3D12Device* device, DeferredReleaseQueue* releases)
+{
+	Shutdown();
+	m_device = device;
+	m_releases = releases;
+	return true;
+}
+
+void BundleCache::Shutdown()
+{
+	m_bundles.clear();
+	m_bundleCount = 0;
+	m_device.Reset();
+	m_valid = false;
+}
+
+void BundleCache::Invalidate()
+{
+	m_valid = false;
+}
+
+bool BundleCache::SameState(const D3D12DrawState& state) const
+{
+	const D3D12DrawState& recorded = m_recordedState;
+	return m_valid && state.rootSignature == recorded.rootSignature && state.srvHeap == recorded.srvHeap &&
+		std::equal(state.pipelines, state.pipelines + state.pipelineCount, m_recordedPipelines.begin(), m_recordedPipelines.end()) &&
+		state.vertexBuffer.BufferLocation == recorded.vertexBuffer.BufferLocation &&
+		state.vertexBuffer.SizeInBytes == recorded.vertexBuffer.SizeInBytes &&
+		state.vertexBuffer.StrideInBytes == recorded.vertexBuffer.StrideInBytes &&
+		state.indexBuffer.BufferLocation == recorded.indexBuffer.BufferLocation &&
+		state.indexBuffer.SizeInBytes == recorded.indexBuffer.SizeInBytes &&
+		state.indexBuffer.Format == recorded.indexBuffer.Format;
+}
+
+uint32_t BundleCache::Update(const std::vector<DrawItem>& items, const D3D12DrawState& state)
+{
+	m_frameStart = Milliseconds();
+	bool sameState = SameState(state);
+	if (!sameState) {
+		m_recordedState = state;
+		m_recordedPipelines.assign(state.pipelines, state.pipelines + state.pipelineCount);
+		m_valid = true;
+	}
+
+	m_bundleCount = (items.size() + DrawsPerBundle - 1) / DrawsPerBundle;
+	if (m_bundles.size() < m_bundleCount) {
+		m_bundles.resize(m_bundleCount);
+	}
+
+	uint32_t recorded = 0;
+	double recordMs = 0.0;
+	size_t recordedDraws = 0;
+	for (size_t i = 0; i < m_bundleCount; i++)
+	{
+		Bundle& bundle = m_bundles[i];
+		const DrawItem* first = items.data() + i * DrawsPerBundle;
+		size_t count = std::min<size_t>(DrawsPerBundle, items.size() - i * DrawsPerBundle);
+		bool same = sameState && bundle.commandList && bundle.items.size() == count &&
+			std::equal(first, first + count, bundle.items.begin(), SameDraw);
+		if (same) {
+			continue;
+		}
+
+		double start = Milliseconds();
+		if (!Record(bundle, first, count, state)) {
+			m_valid = false; // try again next frame
+			continue;
+		}
+		recordMs += Milliseconds() - start;
+		recordedDraws += count;
+		recorded++;
+	}
+
+	m_stats.bundles = static_cast<uint32_t>(m_bundleCount);
+	m_stats.draws = static_cast<uint32_t>(items.size());
+	m_stats.recorded = recorded;
+	m_stats.totalRecorded += recorded;
+	if (recordedDraws > 0)
+	{
+		double perDraw = recordMs / recordedDraws;
+		m_stats.recordMsPerDraw = m_stats.totalRecorded == recorded ? perDraw :
+			m_stats.recordMsPerDraw + (perDraw - m_stats.recordMsPerDraw) * AverageWeight;
+	}
+	m_stats.directMs = m_stats.recordMsPerDraw * items.size();
+	return recorded;
+}
+
+bool BundleCache::Record(Bundle& bundle, const DrawItem* items, size_t count, const D3D12DrawState& state)
+{
+	// the old bundle may still be executing in a frame in flight
+	if (bundle.commandList) {
+		m_releases->RetireObject(bundle.commandList);
+		m_releases->RetireObject(bundle.allocator);
+		bundle.commandList.Reset();
+		bundle.allocator.Reset();
+	}
+	bundle.items.clear();
+
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator;
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> commandList;
+	uint32_t pipeline = items[0].pipeline;
+	if (FAILED(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_BUNDLE, IID_PPV_ARGS(&allocator))) ||
+		FAILED(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_BUNDLE, allocator.Get(), state.pipelines[pipeline],
+			IID_PPV_ARGS(&commandList)))) {
+		return false;
+	}
+
+	// setting the caller's root signature makes the bundle inherit its root
+	// arguments, the heap has to match the caller's
+	ID3D12DescriptorHeap* heaps[] = { state.srvHeap };
+	commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+	commandList->SetGraphicsRootSignature(state.rootSignature);
+	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	commandList->IASetVertexBuffers(0, 1, &state.vertexBuffer);
+	commandList->IASetIndexBuffer(&state.indexBuffer);
+
+	uint64_t table = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		const DrawItem& item = items[i];
+		if (item.pipeline != pipeline) {
+			commandList->SetPipelineState(state.pipelines[item.pipeline]);
+			pipeline = item.pipeline;
+		}
+		if (i == 0 || item.descriptorTable != table) {
+			D3D12_GPU_DESCRIPTOR_HANDLE handle = { item.descriptorTable };
+			commandList->SetGraphicsRootDescriptorTable(D3D12DrawBackend::TableRootParameter, handle);
+			table = item.descriptorTable;
+		}
+		if (item.constantCount > 0) {
+			commandList->SetGraphicsRoot32BitConstants(D3D12DrawBackend::ConstantsRootParameter, item.constantCount, item.constants, 0);
+		}
+		commandList->DrawIndexedInstanced(item.indexCount, 1, item.firstIndex, item.baseVertex, 0);
+	}
+	if (FAILED(commandList->Close())) {
+		return false;
+	}
+
+	bundle.allocator = allocator;
+	bundle.commandList = commandList;
+	bundle.items.assign(items, items + count);
+	return true;
+}
+
+void BundleCache::Execute(ID3D12GraphicsCommandList* commandList, const D3D12DrawState& state)
+{
+	ID3D12DescriptorHeap* heaps[] = { state.srvHeap };
+	commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+	commandList->SetGraphicsRootSignature(state.rootSignature);
+	commandList->SetGraphicsRootConstantBufferView(0, state.matrixConstants);
+	commandList->SetGraphicsRootConstantBufferView(1, state.lightConstants);
+	for (size_t i = 0; i < m_bundleCount; i++) {
+		if (m_bundles[i].commandList) {
+			commandList->ExecuteBundle(m_bundles[i].commandList.Get());
+		}
+	}
+	m_stats.frameMs = Milliseconds() - m_frameStart;
+}
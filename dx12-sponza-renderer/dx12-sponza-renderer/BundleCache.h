@@ -0,0 +1,73 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <vector>
+#include "D3D12DrawBackend.h"
+#include "DeferredReleaseQueue.h"
+
+struct BundleCacheStats
+{
+	uint32_t bundles = 0;
+	uint32_t draws = 0;
+	uint32_t recorded = 0; // bundles recorded this frame
+	uint64_t totalRecorded = 0;
+	double frameMs = 0.0; // Update and Execute this frame
+	double recordMsPerDraw = 0.0; // moving average over recorded bundles
+	// what recording this frame's draws directly would have cost, at the
+	// per draw cost measured while recording bundles
+	double directMs = 0.0;
+};
+
+// the draw list as a run of bundles of up to DrawsPerBundle draws. a bundle
+// is recorded once and executed every frame until its draws or the state
+// they were recorded with change, a texture array being recreated or the
+// geometry pool compacting shows up as a changed draw. bundles being
+// replaced are retired through the release queue since frames in flight
+// may still execute them.
+class BundleCache
+{
+public:
+	static const uint32_t DrawsPerBundle = 128;
+
+	bool Initialize(ID3D12Device* device, DeferredReleaseQueue* releases);
+	void Shutdown();
+
+	// brings the bundles in line with items, returns how many were recorded
+	uint32_t Update(const std::vector<DrawItem>& items, const D3D12DrawState& state);
+	// records every bundle again on the next Update
+	void Invalidate();
+
+	// sets the heap, root signature and the frame's constant buffers the
+	// bundles inherit, then executes them in order. the render targets,
+	// viewport and scissor have to be set on commandList already
+	void Execute(ID3D12GraphicsCommandList* commandList, const D3D12DrawState& state);
+
+	const BundleCacheStats& GetStats() const { return m_stats; }
+
+private:
+	struct Bundle
+	{
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> allocator;
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> commandList;
+		std::vector<DrawItem> items;
+	};
+
+	bool SameState(const D3D12DrawState& state) const;
+	bool Record(Bundle& bundle, const DrawItem* items, size_t count, const D3D12DrawState& state);
+
+	Microsoft::WRL::ComPtr<ID3D12Device> m_device;
+	DeferredReleaseQueue* m_releases = nullptr;
+	std::vector<Bundle> m_bundles;
+	size_t m_bundleCount = 0; // in use, m_bundles may hold more
+
+	// what the bundles were recorded with, everything but the per frame
+	// constant buffers, which they inherit
+	D3D12DrawState m_recordedState;
+	std::vector<ID3D12PipelineState*> m_recordedPipelines;
+	bool m_valid = false;
+
+	double m_frameStart = 0.0;
+	BundleCacheStats m_stats;
+};
@@ -0,0 +1,206 @@
+#include "CameraPath.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	XMFLOAT3 Lerp(const XMFLOAT3& a, const XMFLOAT3& b, float t)
+	{
+		XMFLOAT3 result;
+		XMStoreFloat3(&result, XMVectorLerp(XMLoadFloat3(&a), XMLoadFloat3(&b), t));
+		return result;
+	}
+
+	// other mirrored through key
+	CameraKey Mirror(const CameraKey& key, const CameraKey& other)
+	{
+		return { Lerp(other.position, key.position, 2.0f), Lerp(other.target, key.target, 2.0f) };
+	}
+}
+
+float CameraPath::GetDuration() const
+{
+	return m_keys.size() > 1 ? m_interval * (m_keys.size() - 1) : 0.0f;
+}
+
+CameraKey CameraPath::Sample(float time) const
+{
+	if (m_keys.empty()) {
+		return CameraKey();
+	}
+	float position = std::min(std::max(time / m_interval, 0.0f), static_cast<float>(m_keys.size() - 1));
+	size_t segment = std::min(static_cast<size_t>(position), m_keys.size() - 1);
+	float t = position - segment;
+
+	// uniform catmull-rom. past the ends the neighbour is the next key
+	// mirrored, so a path keeps its speed into the first and last key
+	size_t last = m_keys.size() - 1;
+	const CameraKey& k1 = m_keys[segment];
+	const CameraKey& k2 = m_keys[std::min(segment + 1, last)];
+	CameraKey k0 = segment > 0 ? m_keys[segment - 1] : Mirror(k1, k2);
+	CameraKey k3 = segment + 2 <= last ? m_keys[segment + 2] : Mirror(k2, k1);
+	CameraKey key;
+	XMStoreFloat3(&key.position, XMVectorCatmullRom(XMLoadFloat3(&k0.position), XMLoadFloat3(&k1.position),
+		XMLoadFloat3(&k2.position), XMLoadFloat3(&k3.position), t));
+	XMStoreFloat3(&key.target, XMVectorCatmullRom(XMLoadFloat3(&k0.target), XMLoadFloat3(&k1.target),
+		XMLoadFloat3(&k2.target), XMLoadFloat3(&k3.target), t));
+	return key;
+}
+
+void CameraPath::SetBounds(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+	m_boundsMin = boundsMin;
+	m_boundsMax = boundsMax;
+	m_hasBounds = true;
+}
+
+void CameraPath::FitToBounds(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+	if (m_hasBounds)
+	{
+		XMVECTOR fromMin = XMLoadFloat3(&m_boundsMin);
+		XMVECTOR toMin = XMLoadFloat3(&boundsMin);
+		XMVECTOR scale = (XMLoadFloat3(&boundsMax) - toMin) / (XMLoadFloat3(&m_boundsMax) - fromMin);
+		for (CameraKey& key : m_keys)
+		{
+			XMStoreFloat3(&key.position, toMin + (XMLoadFloat3(&key.position) - fromMin) * scale);
+			XMStoreFloat3(&key.target, toMin + (XMLoadFloat3(&key.target) - fromMin) * scale);
+		}
+	}
+	SetBounds(boundsMin, boundsMax);
+}
+
+bool CameraPath::Load(const std::string& filename, std::string& error)
+{
+	std::FILE* input = std::fopen(filename.c_str(), "r");
+	if (!input) {
+		error = "failed to open " + filename;
+		return false;
+	}
+	std::vector<CameraKey> keys;
+	float interval = 0.0f;
+	bool hasBounds = false;
+	XMFLOAT3 boundsMin = {};
+	XMFLOAT3 boundsMax = {};
+	bool header = false;
+	char line[256];
+	int lineNumber = 0;
+	while (error.empty() && std::fgets(line, sizeof(line), input))
+	{
+		lineNumber++;
+		char word[16] = {};
+		if (std::sscanf(line, " %15s", word) != 1 || word[0] == '#') {
+			continue; // blank or comment
+		}
+		int version = 0;
+		CameraKey key;
+		if (!header) {
+			header = std::strcmp(word, "camerapath") == 0 && std::sscanf(line, " camerapath %d", &version) == 1 && version == 1;
+			if (!header) {
+				error = filename + " isn't a version 1 camera path";
+			}
+		}
+		else if (std::strcmp(word, "interval") == 0) {
+			if (std::sscanf(line, " interval %f", &interval) != 1 || !(interval > 0.0f)) {
+				error = filename + ":" + std::to_string(lineNumber) + ": bad interval";
+			}
+		}
+		else if (std::strcmp(word, "bounds") == 0) {
+			hasBounds = std::sscanf(line, " bounds %f %f %f %f %f %f", &boundsMin.x, &boundsMin.y, &boundsMin.z,
+				&boundsMax.x, &boundsMax.y, &boundsMax.z) == 6 &&
+				boundsMax.x > boundsMin.x && boundsMax.y > boundsMin.y && boundsMax.z > boundsMin.z;
+			if (!hasBounds) {
+				error = filename + ":" + std::to_string(lineNumber) + ": bad bounds";
+			}
+		}
+		else if (std::strcmp(word, "key") == 0 && std::sscanf(line, " key %f %f %f %f %f %f",
+			&key.position.x, &key.position.y, &key.position.z, &key.target.x, &key.target.y, &key.target.z) == 6) {
+			keys.push_back(key);
+		}
+		else {
+			error = filename + ":" + std::to_string(lineNumber) + ": expected a key";
+		}
+	}
+	std::fclose(input);
+	if (error.empty() && (interval <= 0.0f || keys.empty())) {
+		error = filename + " has no interval or no keys";
+	}
+	if (!error.empty()) {
+		return false;
+	}
+	m_interval = interval;
+	m_keys.swap(keys);
+	m_hasBounds = hasBounds;
+	m_boundsMin = boundsMin;
+	m_boundsMax = boundsMax;
+	return true;
+}
+
+bool CameraPath::Save(const std::string& filename, std::string& error) const
+{
+	std::FILE* output = std::fopen(filename.c_str(), "w");
+	if (!output) {
+		error = "failed to create " + filename;
+		return false;
+	}
+	std::fprintf(output, "camerapath 1\ninterval %g\n", m_interval);
+	if (m_hasBounds) {
+		std::fprintf(output, "bounds %.4f %.4f %.4f %.4f %.4f %.4f\n", m_boundsMin.x, m_boundsMin.y, m_boundsMin.z,
+			m_boundsMax.x, m_boundsMax.y, m_boundsMax.z);
+	}
+	for (const CameraKey& key : m_keys) {
+		std::fprintf(output, "key %.4f %.4f %.4f %.4f %.4f %.4f\n", key.position.x, key.position.y, key.position.z,
+			key.target.x, key.target.y, key.target.z);
+	}
+	bool ok = std::ferror(output) == 0;
+	std::fclose(output);
+	if (!ok) {
+		error = "failed to write " + filename;
+	}
+	return ok;
+}
+
+void CameraPathRecorder::Start(float interval)
+{
+	m_path.Clear();
+	m_path.SetInterval(interval);
+	m_recording = true;
+	m_started = false;
+	m_time = 0.0f;
+}
+
+void CameraPathRecorder::Update(float deltaTime, const XMFLOAT3& position, const XMFLOAT3& target)
+{
+	if (!m_recording) {
+		return;
+	}
+	CameraKey current = { position, target };
+	if (!m_started)
+	{
+		m_path.AddKey(current);
+		m_last = current;
+		m_started = true;
+		return;
+	}
+
+	// keys that fall inside this frame, between the last camera and this one
+	float start = m_time;
+	m_time += deltaTime;
+	float interval = m_path.GetInterval();
+	for (float keyTime = interval * m_path.GetKeyCount(); keyTime <= m_time; keyTime = interval * m_path.GetKeyCount())
+	{
+		float t = deltaTime > 0.0f ? (keyTime - start) / deltaTime : 1.0f;
+		m_path.AddKey({ Lerp(m_last.position, current.position, t), Lerp(m_last.target, current.target, t) });
+	}
+	m_last = current;
+}
+
+CameraPath CameraPathRecorder::Stop()
+{
+	m_recording = false;
+	return m_path;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <DirectXMath.h>
+
+struct CameraKey
+{
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT3 target;
+};
+
+// camera position and target at a fixed interval, played back along a
+// catmull-rom spline through the keys. the same time always gives the same
+// camera, so a path replayed at a fixed timestep makes runs comparable.
+//
+// paths are text, one key per line after the interval in seconds:
+//   camerapath 1
+//   interval 0.5
+//   bounds <min x y z> <max x y z>
+//   key <position x y z> <target x y z>
+// with # comments. bounds is optional, the scene bounds the keys were placed
+// in. FitToBounds maps such a path onto the scene it plays in, so a path
+// doesn't depend on the model's units. the benchmarks directory next to
+// models has the standard sponza paths
+class CameraPath
+{
+public:
+	void Clear() { m_keys.clear(); }
+	void SetInterval(float seconds) { m_interval = seconds; }
+	void AddKey(const CameraKey& key) { m_keys.push_back(key); }
+	void SetBounds(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax);
+	bool HasBounds() const { return m_hasBounds; }
+
+	// moves the keys from the path's bounds to these, axis by axis, and makes
+	// them the path's bounds. a path without bounds is already in scene units
+	// and only takes them on
+	void FitToBounds(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax);
+
+	bool IsEmpty() const { return m_keys.empty(); }
+	float GetInterval() const { return m_interval; }
+	size_t GetKeyCount() const { return m_keys.size(); }
+	// the time of the last key
+	float GetDuration() const;
+
+	// clamped to the path's start and end
+	CameraKey Sample(float time) const;
+
+	bool Load(const std::string& filename, std::string& error);
+	bool Save(const std::string& filename, std::string& error) const;
+
+private:
+	float m_interval = 0.5f;
+	std::vector<CameraKey> m_keys;
+	bool m_hasBounds = false;
+	DirectX::XMFLOAT3 m_boundsMin = {};
+	DirectX::XMFLOAT3 m_boundsMax = {};
+};
+
+// turns the camera of frames at any rate into keys at a fixed interval, each
+// key interpolated between the frames around its time
+class CameraPathRecorder
+{
+public:
+	void Start(float interval);
+	// the camera after a frame of deltaTime seconds, the first call is time 0
+	void Update(float deltaTime, const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& target);
+	// the keys so far, recording stops
+	CameraPath Stop();
+
+	bool IsRecording() const { return m_recording; }
+	float GetTime() const { return m_time; }
+
+private:
+	CameraPath m_path;
+	bool m_recording = false;
+	bool m_started = false; // has the first frame
+	float m_time = 0.0f;
+	CameraKey m_last = {};
+};
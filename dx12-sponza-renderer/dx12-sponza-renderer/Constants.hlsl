@@ -18,7 +18,16 @@ cbuffer LightBuffer : register(b1)
     float2 padding; // 16 byte padding
 };
 
-Texture2D catTexture : register(t0);
+// set per draw, see TexturePlacement
+cbuffer MaterialBuffer : register(b3)
+{
+    float2 materialUvScale;
+    float2 materialUvOffset;
+    float materialSlice;
+};
+
+// material textures are packed into arrays and atlases, see TextureArrayPacker.h
+Texture2DArray diffuseTextures : register(t0);
 SamplerState defaultSampler : register(s0);
 
 // vertex Input
@@ -0,0 +1,165 @@
+#include "CpuProfiler.h"
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+thread_local CpuProfileBuffer* CpuProfiler::t_buffer = nullptr;
+
+namespace
+{
+	// buffers live until the process exits, threads that ended stay in the trace
+	struct Registry
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<CpuProfileBuffer>> buffers;
+		std::map<uint32_t, std::string> threadNames;
+		uint32_t nextThreadId = 1; // threads are numbered in the order they first record
+	};
+
+	Registry& GetRegistry()
+	{
+		static Registry registry;
+		return registry;
+	}
+
+	// trace timestamps count from here so they stay small
+	const uint64_t StartTicks = CpuProfiler::Now();
+
+	// names are literals in practice, escape anyway so the json stays valid
+	void WriteJsonString(std::FILE* output, const char* text)
+	{
+		std::fputc('"', output);
+		for (const char* c = text; *c; c++)
+		{
+			if (*c == '"' || *c == '\\') {
+				std::fputc('\\', output);
+			}
+			if (static_cast<unsigned char>(*c) >= 0x20) {
+				std::fputc(*c, output);
+			}
+		}
+		std::fputc('"', output);
+	}
+}
+
+CpuProfileBuffer* CpuProfiler::RegisterThread()
+{
+	std::unique_ptr<CpuProfileBuffer> buffer(new CpuProfileBuffer());
+	t_buffer = buffer.get();
+
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	buffer->threadId = registry.nextThreadId++;
+	registry.buffers.push_back(std::move(buffer));
+	return t_buffer;
+}
+
+CpuProfileEvent* CpuProfiler::AddChunk(CpuProfileBuffer* buffer, uint64_t chunkIndex)
+{
+	if (chunkIndex >= CpuProfileBuffer::MaxChunks) {
+		return nullptr;
+	}
+	// a chunk belongs to the buffer's thread, readers see it through the count
+	CpuProfileEvent* chunk = new CpuProfileEvent[CpuProfileBuffer::ChunkEvents];
+	buffer->chunks[chunkIndex].store(chunk, std::memory_order_release);
+	return chunk;
+}
+
+void CpuProfiler::SetThreadName(const char* name)
+{
+	CpuProfileBuffer* buffer = t_buffer ? t_buffer : RegisterThread();
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	registry.threadNames[buffer->threadId] = name;
+}
+
+uint64_t CpuProfiler::GetFrequency()
+{
+	return std::chrono::steady_clock::period::den / std::chrono::steady_clock::period::num;
+}
+
+uint64_t CpuProfiler::GetRecordedEvents()
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	uint64_t events = 0;
+	for (const auto& buffer : registry.buffers) {
+		events += buffer->count.load(std::memory_order_acquire);
+	}
+	return events;
+}
+
+uint64_t CpuProfiler::GetDroppedEvents()
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	uint64_t dropped = 0;
+	for (const auto& buffer : registry.buffers) {
+		dropped += buffer->dropped.load(std::memory_order_relaxed);
+	}
+	return dropped;
+}
+
+bool CpuProfiler::WriteChromeTrace(const std::string& filename, std::string& error)
+{
+	std::FILE* output = std::fopen(filename.c_str(), "w");
+	if (!output) {
+		error = "failed to create " + filename;
+		return false;
+	}
+
+	// ts and dur are in microseconds, three decimals keep nanoseconds
+	const double ticksToMicroseconds = 1e6 / GetFrequency();
+#ifdef _WIN32
+	const uint32_t processId = GetCurrentProcessId();
+#else
+	const uint32_t processId = static_cast<uint32_t>(getpid());
+#endif
+	bool first = true;
+	auto separator = [&]() {
+		std::fprintf(output, first ? "\n" : ",\n");
+		first = false;
+	};
+
+	// the registry lock only keeps new threads out, recording threads never take it
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	std::fprintf(output, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	for (const auto& thread : registry.threadNames)
+	{
+		separator();
+		std::fprintf(output, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":", processId, thread.first);
+		WriteJsonString(output, thread.second.c_str());
+		std::fprintf(output, "}}");
+	}
+	for (const auto& buffer : registry.buffers)
+	{
+		uint64_t count = buffer->count.load(std::memory_order_acquire);
+		for (uint64_t i = 0; i < count; i++)
+		{
+			const CpuProfileEvent* chunk = buffer->chunks[i / CpuProfileBuffer::ChunkEvents].load(std::memory_order_relaxed);
+			const CpuProfileEvent& event = chunk[i % CpuProfileBuffer::ChunkEvents];
+			separator();
+			std::fprintf(output, "{\"name\":");
+			WriteJsonString(output, event.name);
+			std::fprintf(output, ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				processId, buffer->threadId, static_cast<int64_t>(event.start - StartTicks) * ticksToMicroseconds,
+				(event.end - event.start) * ticksToMicroseconds);
+		}
+	}
+	std::fprintf(output, "\n]}\n");
+
+	bool ok = std::ferror(output) == 0;
+	std::fclose(output);
+	if (!ok) {
+		error = "failed to write " + filename;
+	}
+	return ok;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdint>
+
+// 0 compiles every PROFILE_ macro out, the profiler itself stays linkable
+#ifndef CPU_PROFILER_ENABLED
+#define CPU_PROFILER_ENABLED 1
+#endif
+
+struct CpuProfileEvent
+{
+	const char* name;
+	uint64_t start; // CpuProfiler::Now ticks
+	uint64_t end;
+};
+
+// events of one thread, appended by that thread only. chunks are never moved
+// or freed, so readers on other threads only need the published count
+struct CpuProfileBuffer
+{
+	static const uint32_t ChunkEvents = 4096;
+	static const uint32_t MaxChunks = 1024; // 4M events, 96 MB if a thread fills it
+
+	std::atomic<CpuProfileEvent*> chunks[MaxChunks] = {};
+	std::atomic<uint64_t> count{ 0 };
+	std::atomic<uint64_t> dropped{ 0 };
+	uint32_t threadId = 0;
+};
+
+// instrumentation for startup and frames. a zone costs two counter reads and
+// a store into the calling thread's buffer, no locks: a thread's first zone
+// registers its buffer and a buffer's first event in a chunk allocates it.
+// everything recorded since startup is kept, WriteChromeTrace exports it as a
+// chrome trace that chrome://tracing and ui.perfetto.dev open.
+class CpuProfiler
+{
+public:
+	// steady_clock ticks, QueryPerformanceCounter underneath on windows
+	static uint64_t Now()
+	{
+		return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+	}
+
+	static void Record(const char* name, uint64_t start, uint64_t end)
+	{
+		CpuProfileBuffer* buffer = t_buffer ? t_buffer : RegisterThread();
+		uint64_t index = buffer->count.load(std::memory_order_relaxed);
+		uint64_t chunkIndex = index / CpuProfileBuffer::ChunkEvents;
+		CpuProfileEvent* chunk = chunkIndex < CpuProfileBuffer::MaxChunks ?
+			buffer->chunks[chunkIndex].load(std::memory_order_relaxed) : nullptr;
+		if (!chunk && !(chunk = AddChunk(buffer, chunkIndex))) {
+			buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		chunk[index % CpuProfileBuffer::ChunkEvents] = { name, start, end };
+		buffer->count.store(index + 1, std::memory_order_release);
+	}
+
+	// shows up as the thread's name in the trace, the name is copied
+	static void SetThreadName(const char* name);
+
+	// every thread's events, may run while other threads record
+	static bool WriteChromeTrace(const std::string& filename, std::string& error);
+
+	static uint64_t GetRecordedEvents();
+	static uint64_t GetDroppedEvents();
+	static uint64_t GetFrequency();
+
+private:
+	static CpuProfileBuffer* RegisterThread();
+	static CpuProfileEvent* AddChunk(CpuProfileBuffer* buffer, uint64_t chunkIndex);
+
+	static thread_local CpuProfileBuffer* t_buffer;
+};
+
+// records its lifetime as an event
+class CpuProfileZone
+{
+public:
+	explicit CpuProfileZone(const char* name) : m_name(name), m_start(CpuProfiler::Now()) {}
+	~CpuProfileZone() { CpuProfiler::Record(m_name, m_start, CpuProfiler::Now()); }
+
+	CpuProfileZone(const CpuProfileZone&) = delete;
+	CpuProfileZone& operator=(const CpuProfileZone&) = delete;
+
+private:
+	const char* m_name;
+	uint64_t m_start;
+};
+
+#define CPU_PROFILE_CONCAT_(a, b) a##b
+#define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT_(a, b)
+
+#if CPU_PROFILER_ENABLED
+// name has to be a string literal or otherwise outlive the profiler
+#define PROFILE_ZONE(name) CpuProfileZone CPU_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#define PROFILE_THREAD(name) CpuProfiler::SetThreadName(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
@@ -0,0 +1,95 @@
+#include "D3D12DrawBackend.h"
+
+bool D3D12DrawBackend::Initialize(ID3D12Device* device, uint32_t frameSlots, uint32_t maxChunks)
+{
+	Shutdown();
+	m_device = device;
+	m_maxChunks = maxChunks;
+
+	m_allocators.resize(frameSlots * maxChunks);
+	for (auto& allocator : m_allocators) {
+		if (FAILED(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&allocator)))) {
+			return false;
+		}
+	}
+
+	// lists are created open, BeginChunk expects them closed
+	m_commandLists.resize(maxChunks);
+	for (uint32_t i = 0; i < maxChunks; i++)
+	{
+		if (FAILED(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_allocators[i].Get(), nullptr,
+			IID_PPV_ARGS(&m_commandLists[i])))) {
+			return false;
+		}
+		m_commandLists[i]->Close();
+	}
+	return true;
+}
+
+void D3D12DrawBackend::Shutdown()
+{
+	m_commandLists.clear();
+	m_allocators.clear();
+	m_device.Reset();
+	m_chunkCount = 0;
+}
+
+void D3D12DrawBackend::BeginFrame(uint32_t frameSlot, uint32_t chunkCount)
+{
+	m_frameSlot = frameSlot;
+	m_chunkCount = chunkCount;
+}
+
+void D3D12DrawBackend::BeginChunk(uint32_t chunk, uint32_t pipeline)
+{
+	// the chunk's allocator for this slot is only touched by the chunk's thread
+	ID3D12CommandAllocator* allocator = m_allocators[m_frameSlot * m_maxChunks + chunk].Get();
+	ID3D12GraphicsCommandList* commandList = m_commandLists[chunk].Get();
+	allocator->Reset();
+	commandList->Reset(allocator, m_state.pipelines[pipeline]);
+
+	ID3D12DescriptorHeap* heaps[] = { m_state.srvHeap };
+	commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+	commandList->SetGraphicsRootSignature(m_state.rootSignature);
+	commandList->SetGraphicsRootConstantBufferView(0, m_state.matrixConstants);
+	commandList->SetGraphicsRootConstantBufferView(1, m_state.lightConstants);
+	commandList->OMSetRenderTargets(1, &m_state.renderTarget, FALSE, &m_state.depthStencil);
+	commandList->RSSetViewports(1, &m_state.viewport);
+	commandList->RSSetScissorRects(1, &m_state.scissorRect);
+	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	commandList->IASetVertexBuffers(0, 1, &m_state.vertexBuffer);
+	commandList->IASetIndexBuffer(&m_state.indexBuffer);
+}
+
+void D3D12DrawBackend::SetPipeline(uint32_t chunk, uint32_t pipeline)
+{
+	m_commandLists[chunk]->SetPipelineState(m_state.pipelines[pipeline]);
+}
+
+void D3D12DrawBackend::SetDescriptorTable(uint32_t chunk, uint64_t descriptorTable)
+{
+	D3D12_GPU_DESCRIPTOR_HANDLE table = { descriptorTable };
+	m_commandLists[chunk]->SetGraphicsRootDescriptorTable(TableRootParameter, table);
+}
+
+void D3D12DrawBackend::SetConstants(uint32_t chunk, const uint32_t* constants, uint32_t count)
+{
+	m_commandLists[chunk]->SetGraphicsRoot32BitConstants(ConstantsRootParameter, count, constants, 0);
+}
+
+void D3D12DrawBackend::Draw(uint32_t chunk, uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex)
+{
+	m_commandLists[chunk]->DrawIndexedInstanced(indexCount, 1, firstIndex, baseVertex, 0);
+}
+
+void D3D12DrawBackend::EndChunk(uint32_t chunk)
+{
+	m_commandLists[chunk]->Close();
+}
+
+void D3D12DrawBackend::AppendCommandLists(std::vector<ID3D12CommandList*>& commandLists) const
+{
+	for (uint32_t i = 0; i < m_chunkCount; i++) {
+		commandLists.push_back(m_commandLists[i].Get());
+	}
+}
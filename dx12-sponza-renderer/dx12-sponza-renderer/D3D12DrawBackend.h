@@ -0,0 +1,62 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <vector>
+#include "DrawRecorder.h"
+
+// everything a chunk's command list starts with, set once per frame before
+// DrawRecorder::Record
+struct D3D12DrawState
+{
+	ID3D12RootSignature* rootSignature = nullptr;
+	ID3D12PipelineState* const* pipelines = nullptr; // DrawItem::pipeline indexes this
+	uint32_t pipelineCount = 0;
+	ID3D12DescriptorHeap* srvHeap = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS matrixConstants = 0; // root parameter 0
+	D3D12_GPU_VIRTUAL_ADDRESS lightConstants = 0; // root parameter 1
+	D3D12_CPU_DESCRIPTOR_HANDLE renderTarget = {};
+	D3D12_CPU_DESCRIPTOR_HANDLE depthStencil = {};
+	D3D12_VIEWPORT viewport = {};
+	D3D12_RECT scissorRect = {};
+	D3D12_VERTEX_BUFFER_VIEW vertexBuffer = {};
+	D3D12_INDEX_BUFFER_VIEW indexBuffer = {};
+};
+
+// a direct command list per chunk, with an allocator per chunk and frame
+// slot so a slot's allocators can be reset once its frame is done while
+// other frames are still in flight. the lists are submitted in chunk order
+// between the frame's own command lists.
+class D3D12DrawBackend : public DrawRecordingBackend
+{
+public:
+	static const uint32_t TableRootParameter = 2;
+	static const uint32_t ConstantsRootParameter = 3;
+
+	bool Initialize(ID3D12Device* device, uint32_t frameSlots, uint32_t maxChunks);
+	void Shutdown();
+
+	void SetState(const D3D12DrawState& state) { m_state = state; }
+
+	void BeginFrame(uint32_t frameSlot, uint32_t chunkCount) override;
+	void BeginChunk(uint32_t chunk, uint32_t pipeline) override;
+	void SetPipeline(uint32_t chunk, uint32_t pipeline) override;
+	void SetDescriptorTable(uint32_t chunk, uint64_t descriptorTable) override;
+	void SetConstants(uint32_t chunk, const uint32_t* constants, uint32_t count) override;
+	void Draw(uint32_t chunk, uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex) override;
+	void EndChunk(uint32_t chunk) override;
+
+	// the recorded chunk lists in submission order
+	void AppendCommandLists(std::vector<ID3D12CommandList*>& commandLists) const;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12Device> m_device;
+	uint32_t m_maxChunks = 0;
+	// [frameSlot * m_maxChunks + chunk]
+	std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> m_allocators;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList>> m_commandLists;
+	uint32_t m_frameSlot = 0;
+	uint32_t m_chunkCount = 0;
+	D3D12DrawState m_state;
+};
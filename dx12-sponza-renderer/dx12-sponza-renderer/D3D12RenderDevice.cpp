@@ -0,0 +1,623 @@
+#include "D3D12RenderDevice.h"
+#include "d3dx12.h"
+#include "SceneConstants.h"
+#include <algorithm>
+#include <string>
+
+namespace
+{
+	DXGI_FORMAT GetDxgiFormat(RenderFormat format)
+	{
+		switch (format)
+		{
+		case RenderFormatRGBA8: return DXGI_FORMAT_R8G8B8A8_UNORM;
+		case RenderFormatD32: return DXGI_FORMAT_D32_FLOAT;
+		case RenderFormatR16Uint: return DXGI_FORMAT_R16_UINT;
+		case RenderFormatR32Uint: return DXGI_FORMAT_R32_UINT;
+		default: return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+
+	D3D12_RESOURCE_STATES GetD3D12State(RenderResourceState state)
+	{
+		switch (state)
+		{
+		case RenderStateCopyDest: return D3D12_RESOURCE_STATE_COPY_DEST;
+		case RenderStateCopySource: return D3D12_RESOURCE_STATE_COPY_SOURCE;
+		case RenderStateGenericRead: return D3D12_RESOURCE_STATE_GENERIC_READ;
+		case RenderStateVertexAndConstantBuffer: return D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+		case RenderStateIndexBuffer: return D3D12_RESOURCE_STATE_INDEX_BUFFER;
+		case RenderStateRenderTarget: return D3D12_RESOURCE_STATE_RENDER_TARGET;
+		case RenderStateDepthWrite: return D3D12_RESOURCE_STATE_DEPTH_WRITE;
+		case RenderStatePixelShaderResource: return D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+		default: return D3D12_RESOURCE_STATE_COMMON;
+		}
+	}
+
+	void SetName(ID3D12Object* object, const char* name)
+	{
+		if (name) {
+			std::string narrow(name);
+			object->SetName(std::wstring(narrow.begin(), narrow.end()).c_str());
+		}
+	}
+}
+
+bool D3D12RenderDevice::ViewHeap::Initialize(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t count, bool shaderVisible)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+	desc.Type = type;
+	desc.NumDescriptors = count;
+	desc.Flags = shaderVisible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	if (FAILED(device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&heap)))) {
+		return false;
+	}
+	descriptorSize = device->GetDescriptorHandleIncrementSize(type);
+	freeSlots.clear();
+	for (uint32_t i = count; i > 0; i--) {
+		freeSlots.push_back(i - 1);
+	}
+	return true;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE D3D12RenderDevice::ViewHeap::GetCpuHandle(uint32_t slot) const
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE handle = heap->GetCPUDescriptorHandleForHeapStart();
+	handle.ptr += SIZE_T(slot) * descriptorSize;
+	return handle;
+}
+
+D3D12RenderDevice::~D3D12RenderDevice()
+{
+	Shutdown();
+}
+
+bool D3D12RenderDevice::Initialize(ID3D12Device* device, uint32_t maxViews)
+{
+	Shutdown();
+	m_device = device;
+	m_resources.resize(1);
+
+	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+	if (FAILED(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_queue)))) {
+		return false;
+	}
+	if (FAILED(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)))) {
+		return false;
+	}
+	m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	if (!m_fenceEvent) {
+		return false;
+	}
+	m_fenceValue = 0;
+
+	return m_srvHeap.Initialize(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, maxViews, true) &&
+		m_rtvHeap.Initialize(device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, maxViews, false) &&
+		m_dsvHeap.Initialize(device, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, maxViews, false) &&
+		CreateRootSignature();
+}
+
+void D3D12RenderDevice::Shutdown()
+{
+	if (m_queue && m_fence) {
+		WaitForFenceValue(Signal());
+	}
+	m_submitLists.clear();
+	m_resources.clear();
+	m_freeIndices.clear();
+	m_srvHeap = ViewHeap();
+	m_rtvHeap = ViewHeap();
+	m_dsvHeap = ViewHeap();
+	m_rootSignature.Reset();
+	if (m_fenceEvent) {
+		CloseHandle(m_fenceEvent);
+		m_fenceEvent = nullptr;
+	}
+	m_fence.Reset();
+	m_queue.Reset();
+	m_device.Reset();
+}
+
+bool D3D12RenderDevice::CreateRootSignature()
+{
+	// the renderer's layout, see the root signature in dx12-sponza-renderer.cpp
+	D3D12_ROOT_PARAMETER rootParameters[4] = {};
+	rootParameters[MatrixConstantsSlot].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+	rootParameters[MatrixConstantsSlot].Descriptor.ShaderRegister = 0; // b0
+	rootParameters[MatrixConstantsSlot].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+	rootParameters[LightConstantsSlot].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+	rootParameters[LightConstantsSlot].Descriptor.ShaderRegister = 1; // b1
+	rootParameters[LightConstantsSlot].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+	CD3DX12_DESCRIPTOR_RANGE descriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+	rootParameters[TableRootParameter].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+	rootParameters[TableRootParameter].DescriptorTable.NumDescriptorRanges = 1;
+	rootParameters[TableRootParameter].DescriptorTable.pDescriptorRanges = &descriptorRange;
+	rootParameters[TableRootParameter].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+	static_assert(sizeof(MaterialConstants) / 4 <= MaxRootConstants, "material constants outgrew the root layout");
+	rootParameters[ConstantsRootParameter].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+	rootParameters[ConstantsRootParameter].Constants.ShaderRegister = 3; // b3
+	rootParameters[ConstantsRootParameter].Constants.Num32BitValues = sizeof(MaterialConstants) / 4;
+	rootParameters[ConstantsRootParameter].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+	D3D12_STATIC_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+	samplerDesc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+	samplerDesc.AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+	samplerDesc.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+	samplerDesc.ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER;
+	samplerDesc.BorderColor = D3D12_STATIC_BORDER_COLOR_TRANSPARENT_BLACK;
+	samplerDesc.MaxLOD = D3D12_FLOAT32_MAX;
+	samplerDesc.ShaderRegister = 0;
+	samplerDesc.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(_countof(rootParameters), rootParameters, 1, &samplerDesc,
+		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+	Microsoft::WRL::ComPtr<ID3DBlob> signature;
+	if (FAILED(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, nullptr))) {
+		return false;
+	}
+	return SUCCEEDED(m_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(),
+		IID_PPV_ARGS(&m_rootSignature)));
+}
+
+RenderHandle D3D12RenderDevice::CreateBuffer(const RenderBufferDesc& desc)
+{
+	// constant buffer views are read in 256 byte blocks
+	uint64_t size = (desc.usage & RenderBufferConstant) ? (desc.size + 255) & ~255ull : desc.size;
+	bool upload = desc.memory == RenderMemoryUpload;
+	CD3DX12_HEAP_PROPERTIES heap(upload ? D3D12_HEAP_TYPE_UPLOAD : D3D12_HEAP_TYPE_DEFAULT);
+	CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+	Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+	if (size == 0 || FAILED(m_device->CreateCommittedResource(&heap, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+		upload ? D3D12_RESOURCE_STATE_GENERIC_READ : D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&buffer)))) {
+		return InvalidRenderHandle;
+	}
+	SetName(buffer.Get(), desc.name);
+
+	uint8_t* mapped = nullptr;
+	if (upload)
+	{
+		// mapped for the buffer's lifetime, upload heaps allow it
+		CD3DX12_RANGE noRead(0, 0);
+		if (FAILED(buffer->Map(0, &noRead, reinterpret_cast<void**>(&mapped)))) {
+			return InvalidRenderHandle;
+		}
+	}
+
+	RenderHandle handle = Allocate(KindBuffer);
+	Resource& resource = m_resources[GetIndex(handle)];
+	resource.resource = buffer;
+	resource.size = size;
+	resource.mapped = mapped;
+	return handle;
+}
+
+RenderHandle D3D12RenderDevice::CreateTexture(const RenderTextureDesc& desc)
+{
+	D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE;
+	if (desc.usage & RenderTextureRenderTarget) {
+		flags |= D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+	}
+	if (desc.usage & RenderTextureDepthStencil)
+	{
+		flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+		if (!(desc.usage & RenderTextureSampled)) {
+			flags |= D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE;
+		}
+	}
+	DXGI_FORMAT format = GetDxgiFormat(desc.format);
+	CD3DX12_RESOURCE_DESC textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(format, desc.width, desc.height,
+		static_cast<UINT16>(desc.arraySize), static_cast<UINT16>(desc.mipLevels), 1, 0, flags);
+
+	// targets clear fastest to the value they were created with
+	D3D12_CLEAR_VALUE clearValue = {};
+	clearValue.Format = format;
+	const D3D12_CLEAR_VALUE* optimizedClear = nullptr;
+	if (desc.usage & RenderTextureRenderTarget)
+	{
+		for (int i = 0; i < 4; i++) {
+			clearValue.Color[i] = desc.clearColor[i];
+		}
+		optimizedClear = &clearValue;
+	}
+	else if (desc.usage & RenderTextureDepthStencil)
+	{
+		clearValue.DepthStencil.Depth = desc.clearDepth;
+		optimizedClear = &clearValue;
+	}
+
+	CD3DX12_HEAP_PROPERTIES heap(D3D12_HEAP_TYPE_DEFAULT);
+	Microsoft::WRL::ComPtr<ID3D12Resource> texture;
+	if (format == DXGI_FORMAT_UNKNOWN || FAILED(m_device->CreateCommittedResource(&heap, D3D12_HEAP_FLAG_NONE, &textureDesc,
+		GetD3D12State(desc.initialState), optimizedClear, IID_PPV_ARGS(&texture)))) {
+		return InvalidRenderHandle;
+	}
+	SetName(texture.Get(), desc.name);
+
+	RenderHandle handle = Allocate(KindTexture);
+	Resource& resource = m_resources[GetIndex(handle)];
+	resource.resource = texture;
+	resource.texture = desc;
+	resource.texture.name = nullptr;
+	return handle;
+}
+
+RenderHandle D3D12RenderDevice::CreatePipeline(const RenderPipelineDesc& desc)
+{
+	// OBJLoader's Vertex
+	D3D12_INPUT_ELEMENT_DESC inputLayout[] = {
+		{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+		{"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+		{"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+	};
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+	psoDesc.InputLayout = { inputLayout, _countof(inputLayout) };
+	psoDesc.pRootSignature = m_rootSignature.Get();
+	psoDesc.VS = { desc.vertexShader.code, desc.vertexShader.size };
+	psoDesc.PS = { desc.pixelShader.code, desc.pixelShader.size };
+	CD3DX12_RASTERIZER_DESC rasterizerDesc(D3D12_DEFAULT);
+	rasterizerDesc.CullMode = D3D12_CULL_MODE_NONE;
+	psoDesc.RasterizerState = rasterizerDesc;
+	psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+	psoDesc.DepthStencilState.DepthEnable = desc.depthFormat != RenderFormatUnknown;
+	psoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
+	psoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
+	psoDesc.DSVFormat = GetDxgiFormat(desc.depthFormat);
+	psoDesc.SampleMask = UINT_MAX;
+	psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	psoDesc.NumRenderTargets = 1;
+	psoDesc.RTVFormats[0] = GetDxgiFormat(desc.renderTargetFormat);
+	psoDesc.SampleDesc.Count = 1;
+
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> pipeline;
+	if (FAILED(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipeline)))) {
+		return InvalidRenderHandle;
+	}
+	SetName(pipeline.Get(), desc.name);
+
+	RenderHandle handle = Allocate(KindPipeline);
+	m_resources[GetIndex(handle)].pipeline = pipeline;
+	return handle;
+}
+
+RenderHandle D3D12RenderDevice::CreateCommandList(uint32_t frameSlots)
+{
+	std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> allocators(frameSlots);
+	for (auto& allocator : allocators) {
+		if (FAILED(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&allocator)))) {
+			return InvalidRenderHandle;
+		}
+	}
+	// lists are created open, Begin expects them closed
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> commandList;
+	if (frameSlots == 0 || FAILED(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocators[0].Get(), nullptr,
+		IID_PPV_ARGS(&commandList)))) {
+		return InvalidRenderHandle;
+	}
+	commandList->Close();
+
+	RenderHandle handle = Allocate(KindCommandList);
+	Resource& resource = m_resources[GetIndex(handle)];
+	resource.commandList = commandList;
+	resource.allocators.swap(allocators);
+	return handle;
+}
+
+RenderHandle D3D12RenderDevice::CreateShaderResourceView(RenderHandle texture)
+{
+	return CreateView(texture, KindShaderResourceView);
+}
+
+RenderHandle D3D12RenderDevice::CreateRenderTargetView(RenderHandle texture)
+{
+	return CreateView(texture, KindRenderTargetView);
+}
+
+RenderHandle D3D12RenderDevice::CreateDepthStencilView(RenderHandle texture)
+{
+	return CreateView(texture, KindDepthStencilView);
+}
+
+RenderHandle D3D12RenderDevice::CreateView(RenderHandle texture, Kind kind)
+{
+	Resource* target = Find(texture, KindTexture);
+	ViewHeap* heap = GetViewHeap(kind);
+	if (!target || heap->freeSlots.empty()) {
+		return InvalidRenderHandle;
+	}
+	uint32_t slot = heap->freeSlots.back();
+	heap->freeSlots.pop_back();
+	ID3D12Resource* resource = target->resource.Get();
+	const RenderTextureDesc& desc = target->texture;
+
+	if (kind == KindShaderResourceView)
+	{
+		// the shaders sample a Texture2DArray, single textures are arrays of one
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Format = GetDxgiFormat(desc.format);
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MipLevels = desc.mipLevels;
+		srvDesc.Texture2DArray.ArraySize = desc.arraySize;
+		m_device->CreateShaderResourceView(resource, &srvDesc, heap->GetCpuHandle(slot));
+	}
+	else if (kind == KindRenderTargetView) {
+		m_device->CreateRenderTargetView(resource, nullptr, heap->GetCpuHandle(slot));
+	}
+	else
+	{
+		D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Format = GetDxgiFormat(desc.format);
+		dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+		m_device->CreateDepthStencilView(resource, &dsvDesc, heap->GetCpuHandle(slot));
+	}
+
+	RenderHandle handle = Allocate(kind);
+	Resource& view = m_resources[GetIndex(handle)];
+	view.slot = slot;
+	view.target = texture;
+	m_resources[GetIndex(texture)].views.push_back(handle);
+	return handle;
+}
+
+D3D12RenderDevice::ViewHeap* D3D12RenderDevice::GetViewHeap(Kind kind)
+{
+	switch (kind)
+	{
+	case KindShaderResourceView: return &m_srvHeap;
+	case KindRenderTargetView: return &m_rtvHeap;
+	case KindDepthStencilView: return &m_dsvHeap;
+	default: return nullptr;
+	}
+}
+
+uint64_t D3D12RenderDevice::GetDescriptorTable(RenderHandle shaderResourceView)
+{
+	Resource* view = Find(shaderResourceView, KindShaderResourceView);
+	if (!view) {
+		return 0;
+	}
+	return m_srvHeap.heap->GetGPUDescriptorHandleForHeapStart().ptr + uint64_t(view->slot) * m_srvHeap.descriptorSize;
+}
+
+void D3D12RenderDevice::Destroy(RenderHandle handle)
+{
+	uint32_t index = GetIndex(handle);
+	if (index == 0 || index >= m_resources.size() || m_resources[index].kind == KindFree ||
+		MakeHandle(index, m_resources[index].generation) != handle) {
+		return;
+	}
+	Resource& resource = m_resources[index];
+
+	std::vector<RenderHandle> views;
+	views.swap(resource.views);
+	for (RenderHandle view : views) {
+		Destroy(view);
+	}
+	if (ViewHeap* heap = GetViewHeap(resource.kind))
+	{
+		heap->freeSlots.push_back(resource.slot);
+		if (Resource* target = Find(resource.target, KindTexture)) {
+			target->views.erase(std::remove(target->views.begin(), target->views.end(), handle), target->views.end());
+		}
+	}
+	if (resource.mapped) {
+		resource.resource->Unmap(0, nullptr);
+	}
+
+	uint32_t generation = resource.generation + 1;
+	resource = Resource();
+	resource.generation = generation;
+	m_freeIndices.push_back(index);
+}
+
+uint8_t* D3D12RenderDevice::GetMappedData(RenderHandle buffer)
+{
+	Resource* resource = Find(buffer, KindBuffer);
+	return resource ? resource->mapped : nullptr;
+}
+
+void D3D12RenderDevice::Begin(RenderHandle list, uint32_t frameSlot)
+{
+	// the slot's allocator is only reset by the list's recording thread
+	Resource* resource = Find(list, KindCommandList);
+	ID3D12CommandAllocator* allocator = resource->allocators[frameSlot].Get();
+	ID3D12GraphicsCommandList* commandList = resource->commandList.Get();
+	allocator->Reset();
+	commandList->Reset(allocator, nullptr);
+
+	ID3D12DescriptorHeap* heaps[] = { m_srvHeap.heap.Get() };
+	commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+	commandList->SetGraphicsRootSignature(m_rootSignature.Get());
+	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+void D3D12RenderDevice::Close(RenderHandle list)
+{
+	GetCommandList(list)->Close();
+}
+
+void D3D12RenderDevice::Barrier(RenderHandle list, RenderHandle resource, RenderResourceState before, RenderResourceState after)
+{
+	Resource* target = Find(resource, KindBuffer);
+	if (!target) {
+		target = Find(resource, KindTexture);
+	}
+	CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(target->resource.Get(),
+		GetD3D12State(before), GetD3D12State(after));
+	GetCommandList(list)->ResourceBarrier(1, &barrier);
+}
+
+void D3D12RenderDevice::CopyBuffer(RenderHandle list, RenderHandle destination, uint64_t destinationOffset,
+	RenderHandle source, uint64_t sourceOffset, uint64_t size)
+{
+	GetCommandList(list)->CopyBufferRegion(Find(destination, KindBuffer)->resource.Get(), destinationOffset,
+		Find(source, KindBuffer)->resource.Get(), sourceOffset, size);
+}
+
+void D3D12RenderDevice::CopyBufferToTexture(RenderHandle list, RenderHandle destination, uint32_t subresource,
+	RenderHandle source, uint64_t sourceOffset)
+{
+	Resource* target = Find(destination, KindTexture);
+	const RenderTextureDesc& desc = target->texture;
+	uint32_t mip = subresource % desc.mipLevels;
+
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+	footprint.Offset = sourceOffset;
+	footprint.Footprint.Format = GetDxgiFormat(desc.format);
+	footprint.Footprint.Width = std::max(1u, desc.width >> mip);
+	footprint.Footprint.Height = std::max(1u, desc.height >> mip);
+	footprint.Footprint.Depth = 1;
+	footprint.Footprint.RowPitch = GetTextureRowPitch(footprint.Footprint.Width, desc.format);
+
+	CD3DX12_TEXTURE_COPY_LOCATION destinationLocation(target->resource.Get(), subresource);
+	CD3DX12_TEXTURE_COPY_LOCATION sourceLocation(Find(source, KindBuffer)->resource.Get(), footprint);
+	GetCommandList(list)->CopyTextureRegion(&destinationLocation, 0, 0, 0, &sourceLocation, nullptr);
+}
+
+void D3D12RenderDevice::SetRenderTarget(RenderHandle list, RenderHandle renderTargetView, RenderHandle depthStencilView)
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE renderTarget = m_rtvHeap.GetCpuHandle(Find(renderTargetView, KindRenderTargetView)->slot);
+	D3D12_CPU_DESCRIPTOR_HANDLE depthStencil = {};
+	if (depthStencilView != InvalidRenderHandle) {
+		depthStencil = m_dsvHeap.GetCpuHandle(Find(depthStencilView, KindDepthStencilView)->slot);
+	}
+	GetCommandList(list)->OMSetRenderTargets(1, &renderTarget, FALSE,
+		depthStencilView != InvalidRenderHandle ? &depthStencil : nullptr);
+}
+
+void D3D12RenderDevice::ClearRenderTarget(RenderHandle list, RenderHandle renderTargetView, const float color[4])
+{
+	GetCommandList(list)->ClearRenderTargetView(m_rtvHeap.GetCpuHandle(Find(renderTargetView, KindRenderTargetView)->slot),
+		color, 0, nullptr);
+}
+
+void D3D12RenderDevice::ClearDepth(RenderHandle list, RenderHandle depthStencilView, float depth)
+{
+	GetCommandList(list)->ClearDepthStencilView(m_dsvHeap.GetCpuHandle(Find(depthStencilView, KindDepthStencilView)->slot),
+		D3D12_CLEAR_FLAG_DEPTH, depth, 0, 0, nullptr);
+}
+
+void D3D12RenderDevice::SetViewport(RenderHandle list, uint32_t width, uint32_t height)
+{
+	D3D12_VIEWPORT viewport = { 0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f };
+	D3D12_RECT scissorRect = { 0, 0, static_cast<LONG>(width), static_cast<LONG>(height) };
+	ID3D12GraphicsCommandList* commandList = GetCommandList(list);
+	commandList->RSSetViewports(1, &viewport);
+	commandList->RSSetScissorRects(1, &scissorRect);
+}
+
+void D3D12RenderDevice::SetPipeline(RenderHandle list, RenderHandle pipeline)
+{
+	GetCommandList(list)->SetPipelineState(Find(pipeline, KindPipeline)->pipeline.Get());
+}
+
+void D3D12RenderDevice::SetConstantBuffer(RenderHandle list, uint32_t slot, RenderHandle buffer, uint64_t offset)
+{
+	GetCommandList(list)->SetGraphicsRootConstantBufferView(slot,
+		Find(buffer, KindBuffer)->resource->GetGPUVirtualAddress() + offset);
+}
+
+void D3D12RenderDevice::SetDescriptorTable(RenderHandle list, uint64_t descriptorTable)
+{
+	D3D12_GPU_DESCRIPTOR_HANDLE table = { descriptorTable };
+	GetCommandList(list)->SetGraphicsRootDescriptorTable(TableRootParameter, table);
+}
+
+void D3D12RenderDevice::SetConstants(RenderHandle list, const uint32_t* constants, uint32_t count)
+{
+	GetCommandList(list)->SetGraphicsRoot32BitConstants(ConstantsRootParameter, count, constants, 0);
+}
+
+void D3D12RenderDevice::SetVertexBuffer(RenderHandle list, RenderHandle buffer, uint32_t stride)
+{
+	Resource* resource = Find(buffer, KindBuffer);
+	D3D12_VERTEX_BUFFER_VIEW view = {};
+	view.BufferLocation = resource->resource->GetGPUVirtualAddress();
+	view.SizeInBytes = static_cast<UINT>(resource->size);
+	view.StrideInBytes = stride;
+	GetCommandList(list)->IASetVertexBuffers(0, 1, &view);
+}
+
+void D3D12RenderDevice::SetIndexBuffer(RenderHandle list, RenderHandle buffer, RenderFormat format)
+{
+	Resource* resource = Find(buffer, KindBuffer);
+	D3D12_INDEX_BUFFER_VIEW view = {};
+	view.BufferLocation = resource->resource->GetGPUVirtualAddress();
+	view.SizeInBytes = static_cast<UINT>(resource->size);
+	view.Format = GetDxgiFormat(format);
+	GetCommandList(list)->IASetIndexBuffer(&view);
+}
+
+void D3D12RenderDevice::DrawIndexed(RenderHandle list, uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex)
+{
+	GetCommandList(list)->DrawIndexedInstanced(indexCount, 1, firstIndex, baseVertex, 0);
+}
+
+void D3D12RenderDevice::Submit(const RenderHandle* lists, uint32_t count)
+{
+	m_submitLists.clear();
+	for (uint32_t i = 0; i < count; i++) {
+		m_submitLists.push_back(GetCommandList(lists[i]));
+	}
+	m_queue->ExecuteCommandLists(count, m_submitLists.data());
+}
+
+uint64_t D3D12RenderDevice::Signal()
+{
+	m_queue->Signal(m_fence.Get(), ++m_fenceValue);
+	return m_fenceValue;
+}
+
+uint64_t D3D12RenderDevice::GetCompletedFenceValue()
+{
+	return m_fence->GetCompletedValue();
+}
+
+void D3D12RenderDevice::WaitForFenceValue(uint64_t fenceValue)
+{
+	if (m_fence->GetCompletedValue() < fenceValue)
+	{
+		m_fence->SetEventOnCompletion(fenceValue, m_fenceEvent);
+		WaitForSingleObject(m_fenceEvent, INFINITE);
+	}
+}
+
+RenderHandle D3D12RenderDevice::Allocate(Kind kind)
+{
+	uint32_t index;
+	if (!m_freeIndices.empty()) {
+		index = m_freeIndices.back();
+		m_freeIndices.pop_back();
+	}
+	else {
+		index = static_cast<uint32_t>(m_resources.size());
+		m_resources.emplace_back();
+	}
+	m_resources[index].kind = kind;
+	return MakeHandle(index, m_resources[index].generation);
+}
+
+D3D12RenderDevice::Resource* D3D12RenderDevice::Find(RenderHandle handle, Kind kind)
+{
+	uint32_t index = GetIndex(handle);
+	if (index == 0 || index >= m_resources.size()) {
+		return nullptr;
+	}
+	Resource& resource = m_resources[index];
+	if (resource.kind != kind || MakeHandle(index, resource.generation) != handle) {
+		return nullptr;
+	}
+	return &resource;
+}
+
+ID3D12GraphicsCommandList* D3D12RenderDevice::GetCommandList(RenderHandle list)
+{
+	return Find(list, KindCommandList)->commandList.Get();
+}
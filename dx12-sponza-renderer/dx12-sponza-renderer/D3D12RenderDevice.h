@@ -0,0 +1,132 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <vector>
+#include "RenderDevice.h"
+
+// RenderDevice on a D3D12 device with its own direct queue and fence. views
+// come from fixed size heaps, the srv heap is shader visible and set on
+// every list at Begin together with the shared root signature. nothing is
+// checked beyond what the debug layer does, run frame code on
+// NullRenderDevice for that.
+class D3D12RenderDevice : public RenderDevice
+{
+public:
+	D3D12RenderDevice() = default;
+	D3D12RenderDevice(const D3D12RenderDevice&) = delete;
+	D3D12RenderDevice& operator=(const D3D12RenderDevice&) = delete;
+	~D3D12RenderDevice();
+
+	// maxViews of each kind of view
+	bool Initialize(ID3D12Device* device, uint32_t maxViews);
+	// waits for the queue, then frees everything still alive
+	void Shutdown();
+
+	RenderHandle CreateBuffer(const RenderBufferDesc& desc) override;
+	RenderHandle CreateTexture(const RenderTextureDesc& desc) override;
+	RenderHandle CreatePipeline(const RenderPipelineDesc& desc) override;
+	RenderHandle CreateCommandList(uint32_t frameSlots) override;
+	RenderHandle CreateShaderResourceView(RenderHandle texture) override;
+	RenderHandle CreateRenderTargetView(RenderHandle texture) override;
+	RenderHandle CreateDepthStencilView(RenderHandle texture) override;
+	uint64_t GetDescriptorTable(RenderHandle shaderResourceView) override;
+	void Destroy(RenderHandle handle) override;
+	uint8_t* GetMappedData(RenderHandle buffer) override;
+
+	void Begin(RenderHandle list, uint32_t frameSlot) override;
+	void Close(RenderHandle list) override;
+	void Barrier(RenderHandle list, RenderHandle resource, RenderResourceState before, RenderResourceState after) override;
+	void CopyBuffer(RenderHandle list, RenderHandle destination, uint64_t destinationOffset,
+		RenderHandle source, uint64_t sourceOffset, uint64_t size) override;
+	void CopyBufferToTexture(RenderHandle list, RenderHandle destination, uint32_t subresource,
+		RenderHandle source, uint64_t sourceOffset) override;
+	void SetRenderTarget(RenderHandle list, RenderHandle renderTargetView, RenderHandle depthStencilView) override;
+	void ClearRenderTarget(RenderHandle list, RenderHandle renderTargetView, const float color[4]) override;
+	void ClearDepth(RenderHandle list, RenderHandle depthStencilView, float depth) override;
+	void SetViewport(RenderHandle list, uint32_t width, uint32_t height) override;
+	void SetPipeline(RenderHandle list, RenderHandle pipeline) override;
+	void SetConstantBuffer(RenderHandle list, uint32_t slot, RenderHandle buffer, uint64_t offset) override;
+	void SetDescriptorTable(RenderHandle list, uint64_t descriptorTable) override;
+	void SetConstants(RenderHandle list, const uint32_t* constants, uint32_t count) override;
+	void SetVertexBuffer(RenderHandle list, RenderHandle buffer, uint32_t stride) override;
+	void SetIndexBuffer(RenderHandle list, RenderHandle buffer, RenderFormat format) override;
+	void DrawIndexed(RenderHandle list, uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex) override;
+
+	void Submit(const RenderHandle* lists, uint32_t count) override;
+	uint64_t Signal() override;
+	uint64_t GetCompletedFenceValue() override;
+	void WaitForFenceValue(uint64_t fenceValue) override;
+
+	ID3D12CommandQueue* GetQueue() const { return m_queue.Get(); }
+
+private:
+	static const uint32_t TableRootParameter = 2;
+	static const uint32_t ConstantsRootParameter = 3;
+
+	enum Kind : uint32_t
+	{
+		KindFree,
+		KindBuffer,
+		KindTexture,
+		KindPipeline,
+		KindCommandList,
+		KindShaderResourceView,
+		KindRenderTargetView,
+		KindDepthStencilView,
+	};
+
+	// a heap of views with a free list of its slots
+	struct ViewHeap
+	{
+		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> heap;
+		uint32_t descriptorSize = 0;
+		std::vector<uint32_t> freeSlots;
+
+		bool Initialize(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t count, bool shaderVisible);
+		D3D12_CPU_DESCRIPTOR_HANDLE GetCpuHandle(uint32_t slot) const;
+	};
+
+	struct Resource
+	{
+		Kind kind = KindFree;
+		uint32_t generation = 0;
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> pipeline;
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> commandList;
+		std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> allocators; // one per frame slot
+		uint64_t size = 0; // buffers
+		RenderTextureDesc texture;
+		uint8_t* mapped = nullptr; // upload buffers
+		uint32_t slot = 0; // views, in the heap of their kind
+		RenderHandle target = InvalidRenderHandle; // the texture a view is of
+		std::vector<RenderHandle> views;
+	};
+
+	static RenderHandle MakeHandle(uint32_t index, uint32_t generation) { return (generation << 20) | index; }
+	static uint32_t GetIndex(RenderHandle handle) { return handle & 0xfffff; }
+
+	RenderHandle Allocate(Kind kind);
+	// nullptr when handle isn't a live resource of kind
+	Resource* Find(RenderHandle handle, Kind kind);
+	ID3D12GraphicsCommandList* GetCommandList(RenderHandle list);
+	RenderHandle CreateView(RenderHandle texture, Kind kind);
+	ViewHeap* GetViewHeap(Kind kind);
+	bool CreateRootSignature();
+
+	Microsoft::WRL::ComPtr<ID3D12Device> m_device;
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_queue;
+	Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
+	HANDLE m_fenceEvent = nullptr;
+	uint64_t m_fenceValue = 0; // last signaled
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSignature;
+
+	ViewHeap m_srvHeap;
+	ViewHeap m_rtvHeap;
+	ViewHeap m_dsvHeap;
+
+	std::vector<Resource> m_resources; // handle index 0 is never used
+	std::vector<uint32_t> m_freeIndices;
+	std::vector<ID3D12CommandList*> m_submitLists;
+};
@@ -0,0 +1,144 @@
+#include "D3D12UploadBackend.h"
+#include "d3dx12.h"
+#include <algorithm>
+
+namespace
+{
+	// texel rows per row of a footprint, bc formats store 4x4 blocks
+	UINT RowHeight(DXGI_FORMAT format)
+	{
+		return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM) ||
+			(format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB) ? 4 : 1;
+	}
+}
+
+bool D3D12UploadBackend::Initialize(ID3D12Device* device, uint32_t maxBatchesInFlight, UINT64 stagingSize)
+{
+	m_device = device;
+
+	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+	if (FAILED(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_queue)))) {
+		return false;
+	}
+
+	m_allocators.resize(maxBatchesInFlight);
+	for (auto& allocator : m_allocators) {
+		if (FAILED(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&allocator)))) {
+			return false;
+		}
+	}
+
+	// created closed, BeginBatch resets it onto a slot's allocator
+	if (FAILED(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, m_allocators[0].Get(), nullptr, IID_PPV_ARGS(&m_commandList)))) {
+		return false;
+	}
+	m_commandList->Close();
+
+	if (FAILED(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)))) {
+		return false;
+	}
+	m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	if (m_fenceEvent == nullptr) {
+		return false;
+	}
+
+	return m_staging.Initialize(device, stagingSize);
+}
+
+void D3D12UploadBackend::Shutdown()
+{
+	if (m_fenceEvent)
+	{
+		CloseHandle(m_fenceEvent);
+		m_fenceEvent = nullptr;
+	}
+}
+
+bool D3D12UploadBackend::AllocateStaging(uint64_t size, uint64_t alignment, UploadStaging& staging)
+{
+	// the ring falls back to a dedicated buffer, so this only runs out when the
+	// device can't create one. UploadService then waits for batches in flight
+	UploadAllocation allocation = m_staging.Allocate(size, alignment);
+	if (!allocation.cpuAddress) {
+		return false;
+	}
+	staging.cpuAddress = allocation.cpuAddress;
+	staging.buffer = allocation.resource;
+	staging.offset = allocation.offset;
+	return true;
+}
+
+void D3D12UploadBackend::BeginBatch(uint32_t slot)
+{
+	m_allocators[slot]->Reset();
+	m_commandList->Reset(m_allocators[slot].Get(), nullptr);
+}
+
+void D3D12UploadBackend::CopyBuffer(void* destination, uint64_t destinationOffset, const UploadStaging& source, uint64_t size)
+{
+	m_commandList->CopyBufferRegion(static_cast<ID3D12Resource*>(destination), destinationOffset,
+		static_cast<ID3D12Resource*>(source.buffer), source.offset, size);
+}
+
+void D3D12UploadBackend::CopyTexture(void* destination, uint32_t subresource, uint32_t firstRow, const UploadStaging& source,
+	const UploadTextureFootprint& footprint)
+{
+	// a row range lands rowHeight texel rows per row further down
+	DXGI_FORMAT format = static_cast<DXGI_FORMAT>(footprint.format);
+	UINT rowHeight = RowHeight(format);
+	UINT y = firstRow * rowHeight;
+
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT placed = {};
+	placed.Offset = source.offset;
+	placed.Footprint.Format = format;
+	placed.Footprint.Width = footprint.width;
+	placed.Footprint.Height = std::min(footprint.height - y, footprint.numRows * rowHeight);
+	placed.Footprint.Depth = 1;
+	placed.Footprint.RowPitch = footprint.rowPitch;
+
+	CD3DX12_TEXTURE_COPY_LOCATION dst(static_cast<ID3D12Resource*>(destination), subresource);
+	CD3DX12_TEXTURE_COPY_LOCATION src(static_cast<ID3D12Resource*>(source.buffer), placed);
+	m_commandList->CopyTextureRegion(&dst, 0, y, 0, &src, nullptr);
+}
+
+void D3D12UploadBackend::CopyBufferRegion(void* destination, uint64_t destinationOffset, void* source, uint64_t sourceOffset, uint64_t size)
+{
+	// the source is promoted to COPY_SOURCE like destinations are to COPY_DEST
+	m_commandList->CopyBufferRegion(static_cast<ID3D12Resource*>(destination), destinationOffset,
+		static_cast<ID3D12Resource*>(source), sourceOffset, size);
+}
+
+void D3D12UploadBackend::ExecuteBatch(uint32_t, uint64_t fenceValue)
+{
+	m_commandList->Close();
+	ID3D12CommandList* commandLists[] = { m_commandList.Get() };
+	m_queue->ExecuteCommandLists(_countof(commandLists), commandLists);
+	m_queue->Signal(m_fence.Get(), fenceValue);
+	m_staging.Submit(fenceValue);
+}
+
+uint64_t D3D12UploadBackend::GetCompletedFenceValue()
+{
+	uint64_t completed = m_fence->GetCompletedValue();
+	m_staging.Reclaim(completed);
+	return completed;
+}
+
+void D3D12UploadBackend::WaitForFenceValue(uint64_t fenceValue)
+{
+	if (m_fence->GetCompletedValue() < fenceValue)
+	{
+		m_fence->SetEventOnCompletion(fenceValue, m_fenceEvent);
+		WaitForSingleObject(m_fenceEvent, INFINITE);
+	}
+	m_staging.Reclaim(m_fence->GetCompletedValue());
+}
+
+void D3D12UploadBackend::QueueWait(ID3D12CommandQueue* queue, UploadToken token)
+{
+	if (token > m_fence->GetCompletedValue()) {
+		queue->Wait(m_fence.Get(), token);
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <vector>
+#include "UploadService.h"
+#include "UploadRingBuffer.h"
+
+// runs UploadService batches on a dedicated COPY queue with one command
+// allocator per batch slot and its own fence, whose values are the upload
+// tokens. destinations are ID3D12Resource pointers in the COMMON state: copy
+// queues promote them to COPY_DEST and they decay back once the batch is
+// done, so the graphics queue can read them without barriers on this side.
+class D3D12UploadBackend : public UploadBackend
+{
+public:
+	bool Initialize(ID3D12Device* device, uint32_t maxBatchesInFlight, UINT64 stagingSize);
+	void Shutdown();
+
+	bool AllocateStaging(uint64_t size, uint64_t alignment, UploadStaging& staging) override;
+	void BeginBatch(uint32_t slot) override;
+	void CopyBuffer(void* destination, uint64_t destinationOffset, const UploadStaging& source, uint64_t size) override;
+	void CopyTexture(void* destination, uint32_t subresource, uint32_t firstRow, const UploadStaging& source,
+		const UploadTextureFootprint& footprint) override;
+	void CopyBufferRegion(void* destination, uint64_t destinationOffset, void* source, uint64_t sourceOffset, uint64_t size) override;
+	void ExecuteBatch(uint32_t slot, uint64_t fenceValue) override;
+	uint64_t GetCompletedFenceValue() override;
+	void WaitForFenceValue(uint64_t fenceValue) override;
+
+	// makes queue wait on the gpu until the token's batch has run. the token
+	// has to be submitted, see UploadService::EnsureSubmitted
+	void QueueWait(ID3D12CommandQueue* queue, UploadToken token);
+
+	const UploadRingBuffer& GetStagingRing() const { return m_staging; }
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12Device> m_device;
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_queue;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> m_allocators;
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> m_commandList;
+	Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
+	HANDLE m_fenceEvent = nullptr;
+
+	// retired on the copy fence, so it never mixes with graphics fence values
+	UploadRingBuffer m_staging;
+};
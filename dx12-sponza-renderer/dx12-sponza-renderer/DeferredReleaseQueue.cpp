@@ -0,0 +1,46 @@
+#include "DeferredReleaseQueue.h"
+#include <algorithm>
+
+void DeferredReleaseQueue::Retire(Release release)
+{
+	Retire(m_pendingFenceValue, std::move(release));
+}
+
+void DeferredReleaseQueue::Retire(uint64_t fenceValue, Release release)
+{
+	// fence values almost always arrive in order, older ones are sorted in
+	auto position = m_pending.end();
+	if (!m_pending.empty() && m_pending.back().fenceValue > fenceValue)
+	{
+		position = std::upper_bound(m_pending.begin(), m_pending.end(), fenceValue,
+			[](uint64_t value, const PendingRelease& pending) { return value < pending.fenceValue; });
+	}
+	m_pending.insert(position, { fenceValue, std::move(release) });
+
+	m_stats.pending = static_cast<uint32_t>(m_pending.size());
+	m_stats.peakPending = std::max(m_stats.peakPending, m_stats.pending);
+}
+
+uint32_t DeferredReleaseQueue::Process(uint64_t completedFenceValue)
+{
+	uint32_t released = 0;
+	while (!m_pending.empty() && m_pending.front().fenceValue <= completedFenceValue)
+	{
+		// popped first so a release may retire more objects
+		Release release = std::move(m_pending.front().release);
+		m_pending.pop_front();
+		release();
+		released++;
+	}
+
+	m_stats.released += released;
+	m_stats.pending = static_cast<uint32_t>(m_pending.size());
+	return released;
+}
+
+void DeferredReleaseQueue::Flush()
+{
+	while (!m_pending.empty()) {
+		Process(m_pending.back().fenceValue);
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <cstdint>
+
+struct DeferredReleaseStats
+{
+	uint32_t pending = 0;
+	uint32_t peakPending = 0;
+	uint64_t released = 0;
+};
+
+// frees gpu objects once the fence value of the last submission using them
+// has completed, without waiting for the gpu. every subsystem retires through
+// one of these instead of keeping its own list to clear after a cpu wait.
+// a release is any callable, its captures are destroyed right after it runs,
+// so capturing a ComPtr is enough to keep the object alive until then.
+// not thread safe, only the render thread retires and processes, it's the
+// one recording the work and reading the fence.
+class DeferredReleaseQueue
+{
+public:
+	typedef std::function<void()> Release;
+
+	// the fence value the work recorded from now on will be signaled with,
+	// Retire without a fence value tags releases with it
+	void SetPendingFenceValue(uint64_t fenceValue) { m_pendingFenceValue = fenceValue; }
+	uint64_t GetPendingFenceValue() const { return m_pendingFenceValue; }
+
+	void Retire(Release release);
+	void Retire(uint64_t fenceValue, Release release);
+
+	// keeps object, typically a ComPtr, alive until the pending fence value completes
+	template<typename T>
+	void RetireObject(T object) {
+		Retire([object]() mutable { object = T(); });
+	}
+
+	// runs the releases whose fence value has completed, oldest first. returns
+	// how many ran
+	uint32_t Process(uint64_t completedFenceValue);
+
+	// runs every release, only once the device is idle
+	void Flush();
+
+	const DeferredReleaseStats& GetStats() const { return m_stats; }
+
+private:
+	struct PendingRelease
+	{
+		uint64_t fenceValue;
+		Release release;
+	};
+
+	std::deque<PendingRelease> m_pending; // ordered by fence value
+	uint64_t m_pendingFenceValue = 0;
+	DeferredReleaseStats m_stats;
+};
@@ -0,0 +1,75 @@
+#include "DeviceDrawBackend.h"
+
+bool DeviceDrawBackend::Initialize(RenderDevice* device, uint32_t frameSlots, uint32_t maxChunks)
+{
+	Shutdown();
+	m_device = device;
+	for (uint32_t i = 0; i < maxChunks; i++)
+	{
+		RenderHandle commandList = m_device->CreateCommandList(frameSlots);
+		if (commandList == InvalidRenderHandle) {
+			return false;
+		}
+		m_commandLists.push_back(commandList);
+	}
+	return true;
+}
+
+void DeviceDrawBackend::Shutdown()
+{
+	for (RenderHandle commandList : m_commandLists) {
+		m_device->Destroy(commandList);
+	}
+	m_commandLists.clear();
+	m_device = nullptr;
+	m_chunkCount = 0;
+}
+
+void DeviceDrawBackend::BeginFrame(uint32_t frameSlot, uint32_t chunkCount)
+{
+	m_frameSlot = frameSlot;
+	m_chunkCount = chunkCount;
+}
+
+void DeviceDrawBackend::BeginChunk(uint32_t chunk, uint32_t pipeline)
+{
+	RenderHandle commandList = m_commandLists[chunk];
+	m_device->Begin(commandList, m_frameSlot);
+	m_device->SetPipeline(commandList, m_state.pipelines[pipeline]);
+	m_device->SetConstantBuffer(commandList, RenderDevice::MatrixConstantsSlot, m_state.matrixConstants, m_state.matrixConstantsOffset);
+	m_device->SetConstantBuffer(commandList, RenderDevice::LightConstantsSlot, m_state.lightConstants, m_state.lightConstantsOffset);
+	m_device->SetRenderTarget(commandList, m_state.renderTarget, m_state.depthStencil);
+	m_device->SetViewport(commandList, m_state.width, m_state.height);
+	m_device->SetVertexBuffer(commandList, m_state.vertexBuffer, m_state.vertexStride);
+	m_device->SetIndexBuffer(commandList, m_state.indexBuffer, m_state.indexFormat);
+}
+
+void DeviceDrawBackend::SetPipeline(uint32_t chunk, uint32_t pipeline)
+{
+	m_device->SetPipeline(m_commandLists[chunk], m_state.pipelines[pipeline]);
+}
+
+void DeviceDrawBackend::SetDescriptorTable(uint32_t chunk, uint64_t descriptorTable)
+{
+	m_device->SetDescriptorTable(m_commandLists[chunk], descriptorTable);
+}
+
+void DeviceDrawBackend::SetConstants(uint32_t chunk, const uint32_t* constants, uint32_t count)
+{
+	m_device->SetConstants(m_commandLists[chunk], constants, count);
+}
+
+void DeviceDrawBackend::Draw(uint32_t chunk, uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex)
+{
+	m_device->DrawIndexed(m_commandLists[chunk], indexCount, firstIndex, baseVertex);
+}
+
+void DeviceDrawBackend::EndChunk(uint32_t chunk)
+{
+	m_device->Close(m_commandLists[chunk]);
+}
+
+void DeviceDrawBackend::AppendCommandLists(std::vector<RenderHandle>& commandLists) const
+{
+	commandLists.insert(commandLists.end(), m_commandLists.begin(), m_commandLists.begin() + m_chunkCount);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include "DrawRecorder.h"
+#include "RenderDevice.h"
+
+// everything a chunk's command list starts with, set once per frame before
+// DrawRecorder::Record
+struct DeviceDrawState
+{
+	const RenderHandle* pipelines = nullptr; // DrawItem::pipeline indexes this
+	uint32_t pipelineCount = 0;
+	RenderHandle matrixConstants = InvalidRenderHandle;
+	uint64_t matrixConstantsOffset = 0;
+	RenderHandle lightConstants = InvalidRenderHandle;
+	uint64_t lightConstantsOffset = 0;
+	RenderHandle renderTarget = InvalidRenderHandle; // views
+	RenderHandle depthStencil = InvalidRenderHandle;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	RenderHandle vertexBuffer = InvalidRenderHandle;
+	uint32_t vertexStride = 0;
+	RenderHandle indexBuffer = InvalidRenderHandle;
+	RenderFormat indexFormat = RenderFormatR32Uint;
+};
+
+// D3D12DrawBackend on a RenderDevice: a list per chunk with an allocator per
+// frame slot, submitted in chunk order between the frame's own lists
+class DeviceDrawBackend : public DrawRecordingBackend
+{
+public:
+	bool Initialize(RenderDevice* device, uint32_t frameSlots, uint32_t maxChunks);
+	void Shutdown();
+
+	void SetState(const DeviceDrawState& state) { m_state = state; }
+
+	void BeginFrame(uint32_t frameSlot, uint32_t chunkCount) override;
+	void BeginChunk(uint32_t chunk, uint32_t pipeline) override;
+	void SetPipeline(uint32_t chunk, uint32_t pipeline) override;
+	void SetDescriptorTable(uint32_t chunk, uint64_t descriptorTable) override;
+	void SetConstants(uint32_t chunk, const uint32_t* constants, uint32_t count) override;
+	void Draw(uint32_t chunk, uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex) override;
+	void EndChunk(uint32_t chunk) override;
+
+	// the recorded chunk lists in submission order
+	void AppendCommandLists(std::vector<RenderHandle>& commandLists) const;
+
+private:
+	RenderDevice* m_device = nullptr;
+	std::vector<RenderHandle> m_commandLists;
+	uint32_t m_frameSlot = 0;
+	uint32_t m_chunkCount = 0;
+	DeviceDrawState m_state;
+};
@@ -0,0 +1,204 @@
+#include "DrawRecorder.h"
+#include <algorithm>
+#include <chrono>
+
+void DrawRecorder::Initialize(DrawRecordingBackend* backend, JobSystem* jobs)
+{
+	m_backend = backend;
+	m_jobs = jobs;
+}
+
+void DrawRecorder::Shutdown()
+{
+	m_backend = nullptr;
+	m_jobs = nullptr;
+}
+
+uint32_t DrawRecorder::GetChunkCount(size_t drawCount) const
+{
+	if (drawCount == 0) {
+		return 0;
+	}
+	if (!parallel) {
+		return 1;
+	}
+	size_t drawsPerChunk = std::max(1u, minDrawsPerChunk);
+	size_t chunks = (drawCount + drawsPerChunk - 1) / drawsPerChunk;
+	return static_cast<uint32_t>(std::min<size_t>(chunks, GetMaxChunks()));
+}
+
+uint32_t DrawRecorder::Record(uint32_t frameSlot, const std::vector<DrawItem>& items)
+{
+	auto start = std::chrono::steady_clock::now();
+	m_chunkCount = GetChunkCount(items.size());
+	m_backend->BeginFrame(frameSlot, m_chunkCount);
+
+	m_items = items.data();
+	m_itemCount = items.size();
+	m_pipelineChanges.store(0, std::memory_order_relaxed);
+	m_tableChanges.store(0, std::memory_order_relaxed);
+
+	// jobs take chunks in any order, the chunk index alone decides where a
+	// chunk's list goes in the submission
+	if (m_chunkCount > 1 && m_jobs) {
+		m_jobs->ParallelFor(0, m_chunkCount, 1, [this](size_t begin, size_t end) {
+			for (size_t chunk = begin; chunk < end; chunk++) {
+				RecordChunk(static_cast<uint32_t>(chunk));
+			}
+		});
+	}
+	else {
+		for (uint32_t chunk = 0; chunk < m_chunkCount; chunk++) {
+			RecordChunk(chunk);
+		}
+	}
+
+	m_stats.draws = static_cast<uint32_t>(items.size());
+	m_stats.chunks = m_chunkCount;
+	m_stats.pipelineChanges = m_pipelineChanges.load(std::memory_order_relaxed);
+	m_stats.tableChanges = m_tableChanges.load(std::memory_order_relaxed);
+	m_stats.recordMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	m_items = nullptr;
+	m_itemCount = 0;
+	return m_chunkCount;
+}
+
+void DrawRecorder::RecordChunk(uint32_t chunk)
+{
+	// even split by draw count, recording cost is per draw not per triangle
+	size_t begin = m_itemCount * chunk / m_chunkCount;
+	size_t end = m_itemCount * (chunk + 1) / m_chunkCount;
+
+	uint32_t pipeline = m_items[begin].pipeline;
+	m_backend->BeginChunk(chunk, pipeline);
+
+	// a fresh list has no table bound, the first draw always sets one
+	uint64_t table = 0;
+	bool tableBound = false;
+	uint32_t pipelineChanges = 0;
+	uint32_t tableChanges = 0;
+	for (size_t i = begin; i < end; i++)
+	{
+		const DrawItem& item = m_items[i];
+		if (item.pipeline != pipeline) {
+			m_backend->SetPipeline(chunk, item.pipeline);
+			pipeline = item.pipeline;
+			pipelineChanges++;
+		}
+		if (!tableBound || item.descriptorTable != table) {
+			m_backend->SetDescriptorTable(chunk, item.descriptorTable);
+			table = item.descriptorTable;
+			tableBound = true;
+			tableChanges++;
+		}
+		if (item.constantCount > 0) {
+			m_backend->SetConstants(chunk, item.constants, item.constantCount);
+		}
+		m_backend->Draw(chunk, item.indexCount, item.firstIndex, item.baseVertex);
+	}
+	m_backend->EndChunk(chunk);
+
+	m_pipelineChanges.fetch_add(pipelineChanges, std::memory_order_relaxed);
+	m_tableChanges.fetch_add(tableChanges, std::memory_order_relaxed);
+}
+
+void MemoryDrawBackend::BeginFrame(uint32_t frameSlot, uint32_t chunkCount)
+{
+	(void)frameSlot;
+	if (m_chunks.size() < chunkCount) {
+		m_chunks.resize(chunkCount);
+	}
+	for (uint32_t i = 0; i < chunkCount; i++) {
+		m_chunks[i].commands.clear();
+		m_chunks[i].open = false;
+		m_chunks[i].closed = false;
+		m_chunks[i].error = false;
+	}
+	m_chunkCount = chunkCount;
+}
+
+void MemoryDrawBackend::Append(uint32_t chunk, const Command& command)
+{
+	Chunk& target = m_chunks[chunk];
+	if (!target.open || target.closed) {
+		target.error = true;
+	}
+	target.commands.push_back(command);
+}
+
+void MemoryDrawBackend::BeginChunk(uint32_t chunk, uint32_t pipeline)
+{
+	Chunk& target = m_chunks[chunk];
+	if (target.open) {
+		target.error = true;
+	}
+	target.open = true;
+
+	Command command = {};
+	command.type = CommandSetup;
+	command.values[0] = pipeline;
+	Append(chunk, command);
+}
+
+void MemoryDrawBackend::SetPipeline(uint32_t chunk, uint32_t pipeline)
+{
+	Command command = {};
+	command.type = CommandPipeline;
+	command.values[0] = pipeline;
+	Append(chunk, command);
+}
+
+void MemoryDrawBackend::SetDescriptorTable(uint32_t chunk, uint64_t descriptorTable)
+{
+	Command command = {};
+	command.type = CommandDescriptorTable;
+	command.descriptorTable = descriptorTable;
+	Append(chunk, command);
+}
+
+void MemoryDrawBackend::SetConstants(uint32_t chunk, const uint32_t* constants, uint32_t count)
+{
+	Command command = {};
+	command.type = CommandConstants;
+	command.values[0] = count > DrawItem::MaxConstants ? uint32_t(DrawItem::MaxConstants) : count;
+	std::copy(constants, constants + command.values[0], command.values + 1);
+	Append(chunk, command);
+}
+
+void MemoryDrawBackend::Draw(uint32_t chunk, uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex)
+{
+	Command command = {};
+	command.type = CommandDraw;
+	command.values[0] = indexCount;
+	command.values[1] = firstIndex;
+	command.values[2] = static_cast<uint32_t>(baseVertex);
+	Append(chunk, command);
+}
+
+void MemoryDrawBackend::EndChunk(uint32_t chunk)
+{
+	Chunk& target = m_chunks[chunk];
+	if (!target.open || target.closed) {
+		target.error = true;
+	}
+	target.closed = true;
+}
+
+std::vector<MemoryDrawBackend::Command> MemoryDrawBackend::GetSubmittedCommands() const
+{
+	std::vector<Command> commands;
+	for (uint32_t i = 0; i < m_chunkCount; i++) {
+		commands.insert(commands.end(), m_chunks[i].commands.begin(), m_chunks[i].commands.end());
+	}
+	return commands;
+}
+
+bool MemoryDrawBackend::HasErrors() const
+{
+	for (uint32_t i = 0; i < m_chunkCount; i++) {
+		if (m_chunks[i].error || !m_chunks[i].closed) {
+			return true;
+		}
+	}
+	return false;
+}
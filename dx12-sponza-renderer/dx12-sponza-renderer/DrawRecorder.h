@@ -0,0 +1,152 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include "JobSystem.h"
+
+// one draw of the frame's draw list, everything a worker needs to record it
+// without touching renderer state
+struct DrawItem
+{
+	static const uint32_t MaxConstants = 8;
+
+	uint32_t pipeline; // index into the backend's pipeline states
+	uint64_t descriptorTable; // gpu descriptor handle of the texture array
+	uint32_t constants[MaxConstants]; // root constants, 32 bit values
+	uint32_t constantCount;
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+};
+
+// a chunk is recorded into its own command list by one thread. the backend
+// sets up everything a draw depends on (render targets, root signature,
+// heaps, buffers) at the start of every chunk since command lists don't
+// inherit state from each other.
+class DrawRecordingBackend
+{
+public:
+	virtual ~DrawRecordingBackend() = default;
+
+	// main thread, before any chunk of the frame. the previous frame that used
+	// frameSlot has to be done on the gpu
+	virtual void BeginFrame(uint32_t frameSlot, uint32_t chunkCount) = 0;
+
+	// chunk calls come from any thread, but every chunk from only one
+	virtual void BeginChunk(uint32_t chunk, uint32_t pipeline) = 0;
+	virtual void SetPipeline(uint32_t chunk, uint32_t pipeline) = 0;
+	virtual void SetDescriptorTable(uint32_t chunk, uint64_t descriptorTable) = 0;
+	virtual void SetConstants(uint32_t chunk, const uint32_t* constants, uint32_t count) = 0;
+	virtual void Draw(uint32_t chunk, uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex) = 0;
+	virtual void EndChunk(uint32_t chunk) = 0;
+};
+
+struct DrawRecorderStats
+{
+	uint32_t draws = 0;
+	uint32_t chunks = 0;
+	uint32_t pipelineChanges = 0;
+	uint32_t tableChanges = 0; // descriptor table switches over all chunks
+	double recordMs = 0.0; // BeginFrame to the last chunk closed
+};
+
+// records a draw list into chunks as jobs. chunks are contiguous ranges of
+// the list, so submitting the backend's chunk lists in chunk order draws in
+// list order. the calling thread records chunks too and returns once every
+// chunk is closed.
+class DrawRecorder
+{
+public:
+	DrawRecorder() = default;
+	DrawRecorder(const DrawRecorder&) = delete;
+	DrawRecorder& operator=(const DrawRecorder&) = delete;
+
+	// up to one chunk per worker of jobs, without jobs everything is
+	// recorded on the calling thread
+	void Initialize(DrawRecordingBackend* backend, JobSystem* jobs);
+	void Shutdown();
+
+	// returns the number of chunks recorded, the backend's lists 0..n-1
+	uint32_t Record(uint32_t frameSlot, const std::vector<DrawItem>& items);
+
+	// how many chunks a list of drawCount draws is split into
+	uint32_t GetChunkCount(size_t drawCount) const;
+	uint32_t GetMaxChunks() const { return m_jobs ? m_jobs->GetWorkerCount() : 1; }
+
+	const DrawRecorderStats& GetStats() const { return m_stats; }
+
+	// below this many draws per chunk a command list costs more than it saves
+	uint32_t minDrawsPerChunk = 64;
+	bool parallel = true;
+
+private:
+	void RecordChunk(uint32_t chunk);
+
+	DrawRecordingBackend* m_backend = nullptr;
+	JobSystem* m_jobs = nullptr;
+
+	// the frame being recorded, read by the jobs between the start and the
+	// end of a Record call
+	const DrawItem* m_items = nullptr;
+	size_t m_itemCount = 0;
+	uint32_t m_chunkCount = 0;
+	std::atomic<uint32_t> m_pipelineChanges{ 0 };
+	std::atomic<uint32_t> m_tableChanges{ 0 };
+
+	DrawRecorderStats m_stats;
+};
+
+// keeps every command in memory instead of recording it for a gpu, to check
+// the chunking and the submission order and to time the recorder without a
+// device
+class MemoryDrawBackend : public DrawRecordingBackend
+{
+public:
+	enum CommandType : uint32_t
+	{
+		CommandSetup, // the state every chunk starts with
+		CommandPipeline,
+		CommandDescriptorTable,
+		CommandConstants,
+		CommandDraw,
+	};
+
+	struct Command
+	{
+		CommandType type;
+		uint32_t values[DrawItem::MaxConstants + 1]; // type specific, constants lead with their count
+		uint64_t descriptorTable;
+	};
+
+	void BeginFrame(uint32_t frameSlot, uint32_t chunkCount) override;
+	void BeginChunk(uint32_t chunk, uint32_t pipeline) override;
+	void SetPipeline(uint32_t chunk, uint32_t pipeline) override;
+	void SetDescriptorTable(uint32_t chunk, uint64_t descriptorTable) override;
+	void SetConstants(uint32_t chunk, const uint32_t* constants, uint32_t count) override;
+	void Draw(uint32_t chunk, uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex) override;
+	void EndChunk(uint32_t chunk) override;
+
+	// the frame's chunks concatenated in submission order, like one
+	// ExecuteCommandLists of all of them would run
+	std::vector<Command> GetSubmittedCommands() const;
+
+	const std::vector<Command>& GetChunk(uint32_t chunk) const { return m_chunks[chunk].commands; }
+	uint32_t GetChunkCount() const { return m_chunkCount; }
+	// a chunk was begun twice, written after it ended or never closed
+	bool HasErrors() const;
+
+private:
+	struct Chunk
+	{
+		std::vector<Command> commands;
+		bool open = false;
+		bool closed = false;
+		bool error = false;
+	};
+
+	void Append(uint32_t chunk, const Command& command);
+
+	std::vector<Chunk> m_chunks;
+	uint32_t m_chunkCount = 0;
+};
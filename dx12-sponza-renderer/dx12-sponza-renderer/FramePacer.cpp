@@ -0,0 +1,103 @@
+#include "FramePacer.h"
+#include <algorithm>
+
+namespace
+{
+	// weight of the newest sample in the moving averages
+	const double AverageWeight = 0.05;
+	// frames dxgi hasn't reported after this many presents never will be
+	const size_t MaxPendingFrames = 16;
+
+	int64_t Now()
+	{
+		LARGE_INTEGER counter;
+		QueryPerformanceCounter(&counter);
+		return counter.QuadPart;
+	}
+
+	void Accumulate(double& average, double sample)
+	{
+		average += (sample - average) * AverageWeight;
+	}
+}
+
+FramePacer::~FramePacer()
+{
+	Shutdown();
+}
+
+bool FramePacer::Initialize(IDXGISwapChain2* swapChain, uint32_t maxFrameLatency)
+{
+	Shutdown();
+	m_swapChain = swapChain;
+
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	m_frequency = frequency.QuadPart;
+
+	SetMaximumFrameLatency(maxFrameLatency);
+	m_waitableObject = m_swapChain->GetFrameLatencyWaitableObject();
+	return m_waitableObject != nullptr;
+}
+
+void FramePacer::Shutdown()
+{
+	if (m_waitableObject) {
+		CloseHandle(m_waitableObject);
+		m_waitableObject = nullptr;
+	}
+	m_swapChain.Reset();
+	m_pendingFrames.clear();
+}
+
+void FramePacer::SetMaximumFrameLatency(uint32_t latency)
+{
+	m_maxFrameLatency = std::max(1u, latency);
+	m_swapChain->SetMaximumFrameLatency(m_maxFrameLatency);
+}
+
+void FramePacer::WaitForNextFrame()
+{
+	int64_t start = Now();
+	if (m_waitableObject) {
+		// bounded so a lost device or a minimized window can't hang the loop
+		WaitForSingleObjectEx(m_waitableObject, 1000, TRUE);
+	}
+	m_inputTime = Now();
+	Accumulate(m_stats.waitMs, ToMilliseconds(m_inputTime - start));
+}
+
+void FramePacer::SetInputTime(double milliseconds)
+{
+	m_inputTime = static_cast<int64_t>(milliseconds * m_frequency / 1000.0);
+}
+
+void FramePacer::OnPresent()
+{
+	Accumulate(m_stats.inputToPresentMs, ToMilliseconds(Now() - m_inputTime));
+
+	UINT presentCount = 0;
+	if (SUCCEEDED(m_swapChain->GetLastPresentCount(&presentCount))) {
+		m_pendingFrames.push_back({ presentCount, m_inputTime });
+	}
+	if (m_pendingFrames.size() > MaxPendingFrames) {
+		m_pendingFrames.pop_front();
+	}
+
+	// only the latest displayed frame is reported, frames before it are skipped.
+	// fails until the first vblank and whenever the statistics are disjoint
+	DXGI_FRAME_STATISTICS statistics = {};
+	if (FAILED(m_swapChain->GetFrameStatistics(&statistics))) {
+		return;
+	}
+	while (!m_pendingFrames.empty() && m_pendingFrames.front().presentCount <= statistics.PresentCount)
+	{
+		const PendingFrame& frame = m_pendingFrames.front();
+		if (frame.presentCount == statistics.PresentCount && statistics.SyncQPCTime.QuadPart > frame.inputTime)
+		{
+			Accumulate(m_stats.inputToDisplayMs, ToMilliseconds(statistics.SyncQPCTime.QuadPart - frame.inputTime));
+			m_stats.displayedFrames++;
+		}
+		m_pendingFrames.pop_front();
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <windows.h>
+#include <dxgi1_3.h>
+#include <wrl/client.h>
+#include <deque>
+#include <cstdint>
+
+struct FramePacerStats
+{
+	double waitMs = 0.0; // blocked on the swap chain's waitable object
+	double inputToPresentMs = 0.0; // input sampled to Present returning
+	double inputToDisplayMs = 0.0; // input sampled to the frame's vblank, 0 until dxgi reports one
+	uint64_t displayedFrames = 0; // frames inputToDisplayMs was measured on
+};
+
+// paces the frame loop with the swap chain's frame latency waitable object:
+// a frame waits before it samples input until the swap chain has room for
+// it, so input is never older than the frames queued ahead of it. the
+// latency is measured from that point to Present, and to the vblank the
+// frame went out on when dxgi has frame statistics for it.
+class FramePacer
+{
+public:
+	FramePacer() = default;
+	FramePacer(const FramePacer&) = delete;
+	FramePacer& operator=(const FramePacer&) = delete;
+	~FramePacer();
+
+	// the swap chain has to be created with DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT
+	bool Initialize(IDXGISwapChain2* swapChain, uint32_t maxFrameLatency);
+	void Shutdown();
+
+	// frames the swap chain may queue before WaitForNextFrame blocks
+	void SetMaximumFrameLatency(uint32_t latency);
+	uint32_t GetMaximumFrameLatency() const { return m_maxFrameLatency; }
+
+	// call right before sampling input for the frame
+	void WaitForNextFrame();
+	// when input is sampled on another thread than the one that waits, the
+	// latency is measured from there. milliseconds of QueryPerformanceCounter,
+	// call between WaitForNextFrame and OnPresent
+	void SetInputTime(double milliseconds);
+	// call right after Present
+	void OnPresent();
+
+	const FramePacerStats& GetStats() const { return m_stats; }
+
+private:
+	struct PendingFrame
+	{
+		UINT presentCount;
+		int64_t inputTime;
+	};
+
+	double ToMilliseconds(int64_t ticks) const { return ticks * 1000.0 / m_frequency; }
+
+	Microsoft::WRL::ComPtr<IDXGISwapChain2> m_swapChain;
+	HANDLE m_waitableObject = nullptr;
+	uint32_t m_maxFrameLatency = 0;
+	int64_t m_frequency = 1;
+	int64_t m_inputTime = 0;
+	std::deque<PendingFrame> m_pendingFrames; // presented, not yet seen in frame statistics
+	FramePacerStats m_stats;
+};
@@ -0,0 +1,57 @@
+#include "FramePacket.h"
+#include <cstring>
+
+namespace
+{
+	// ImVector's assignment frees before it copies, resize keeps the capacity
+	template<typename T>
+	void CopyVector(ImVector<T>& destination, const ImVector<T>& source)
+	{
+		destination.resize(source.Size);
+		if (source.Size > 0) {
+			std::memcpy(destination.Data, source.Data, source.Size * sizeof(T));
+		}
+	}
+}
+
+ImGuiDrawSnapshot::~ImGuiDrawSnapshot()
+{
+	for (ImDrawList* list : m_lists) {
+		IM_DELETE(list);
+	}
+}
+
+void ImGuiDrawSnapshot::Capture(const ImDrawData* source)
+{
+	m_drawData.Clear();
+	if (!source || !source->Valid) {
+		return;
+	}
+
+	for (int i = 0; i < source->CmdListsCount; i++)
+	{
+		const ImDrawList* sourceList = source->CmdLists[i];
+		if (m_lists.size() <= static_cast<size_t>(i)) {
+			m_lists.push_back(IM_NEW(ImDrawList)(nullptr));
+		}
+		ImDrawList* list = m_lists[i];
+		CopyVector(list->CmdBuffer, sourceList->CmdBuffer);
+		CopyVector(list->IdxBuffer, sourceList->IdxBuffer);
+		CopyVector(list->VtxBuffer, sourceList->VtxBuffer);
+		list->Flags = sourceList->Flags;
+		for (ImDrawCmd& command : list->CmdBuffer) {
+			command.TexRef = ImTextureRef(command.GetTexID());
+		}
+		m_drawData.CmdLists.push_back(list);
+	}
+
+	m_drawData.Valid = true;
+	m_drawData.CmdListsCount = source->CmdListsCount;
+	m_drawData.TotalIdxCount = source->TotalIdxCount;
+	m_drawData.TotalVtxCount = source->TotalVtxCount;
+	m_drawData.DisplayPos = source->DisplayPos;
+	m_drawData.DisplaySize = source->DisplaySize;
+	m_drawData.FramebufferScale = source->FramebufferScale;
+	m_drawData.OwnerViewport = nullptr;
+	m_drawData.Textures = nullptr;
+}
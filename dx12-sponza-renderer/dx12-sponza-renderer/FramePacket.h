@@ -0,0 +1,122 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include "ImGui/imgui.h"
+
+// a frame's ImDrawData copied out of the imgui context. imgui rebuilds its
+// draw lists on the next NewFrame, so a render thread that draws a frame
+// while the next one is built needs its own copy. the lists are kept and
+// refilled, so steady state copies don't allocate.
+class ImGuiDrawSnapshot
+{
+public:
+	ImGuiDrawSnapshot() = default;
+	ImGuiDrawSnapshot(const ImGuiDrawSnapshot&) = delete;
+	ImGuiDrawSnapshot& operator=(const ImGuiDrawSnapshot&) = delete;
+	~ImGuiDrawSnapshot();
+
+	// texture updates stay with the thread that owns the context, they have
+	// to be done before this. texture ids are resolved here so the copy never
+	// reads the atlas' ImTextureData
+	void Capture(const ImDrawData* source);
+
+	ImDrawData* GetDrawData() { return &m_drawData; }
+
+private:
+	ImDrawData m_drawData;
+	std::vector<ImDrawList*> m_lists; // owned, m_drawData.CmdLists points at the first ones
+};
+
+// bounded hand off between a producer building frames and a consumer
+// rendering them. PacketCount packets circulate: the producer fills a free
+// one while the consumer renders the last, and waits when it's that far
+// ahead. packets are reused, whatever they hold keeps its memory.
+template<typename Packet>
+class FramePacketQueue
+{
+public:
+	static const uint32_t PacketCount = 2;
+
+	FramePacketQueue()
+	{
+		for (Packet& packet : m_packets) {
+			m_free.push_back(&packet);
+		}
+	}
+	FramePacketQueue(const FramePacketQueue&) = delete;
+	FramePacketQueue& operator=(const FramePacketQueue&) = delete;
+
+	// producer. blocks until a packet is free, nullptr once closed
+	Packet* BeginWrite()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_changed.wait(lock, [this] { return m_closed || !m_free.empty(); });
+		if (m_closed) {
+			return nullptr;
+		}
+		Packet* packet = m_free.front();
+		m_free.pop_front();
+		return packet;
+	}
+
+	void EndWrite(Packet* packet)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_ready.push_back(packet);
+		}
+		m_changed.notify_all();
+	}
+
+	// producer. blocks until the consumer is done with every packet written
+	void WaitIdle()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_changed.wait(lock, [this] { return m_closed || m_free.size() == PacketCount; });
+	}
+
+	// consumer. blocks until a packet is written, nullptr once closed and
+	// every written packet was read
+	Packet* BeginRead()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_changed.wait(lock, [this] { return m_closed || !m_ready.empty(); });
+		if (m_ready.empty()) {
+			return nullptr;
+		}
+		Packet* packet = m_ready.front();
+		m_ready.pop_front();
+		return packet;
+	}
+
+	void EndRead(Packet* packet)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_free.push_back(packet);
+		}
+		m_changed.notify_all();
+	}
+
+	// wakes both sides, the consumer still gets the packets already written
+	void Close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_closed = true;
+		}
+		m_changed.notify_all();
+	}
+
+private:
+	Packet m_packets[PacketCount];
+	std::deque<Packet*> m_free;
+	std::deque<Packet*> m_ready; // written, in order
+	std::mutex m_mutex;
+	std::condition_variable m_changed; // two threads, every change wakes the other
+	bool m_closed = false;
+};
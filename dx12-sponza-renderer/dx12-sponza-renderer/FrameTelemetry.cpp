@@ -0,0 +1,211 @@
+#include "FrameTelemetry.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+	// nearest rank on sorted values
+	float Percentile(const std::vector<float>& sorted, float percentile)
+	{
+		size_t rank = static_cast<size_t>(percentile / 100.0f * sorted.size() + 0.5f);
+		return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+	}
+
+	const char* BuildConfiguration()
+	{
+#ifdef _DEBUG
+		return "debug";
+#else
+		return "release";
+#endif
+	}
+}
+
+FrameTelemetry::FrameTelemetry()
+	: m_slots(new Slot[Capacity])
+	, m_written(0)
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "the ring is indexed with a mask");
+	for (uint32_t i = 0; i < Capacity; i++) {
+		m_slots[i].sequence.store(0, std::memory_order_relaxed);
+	}
+}
+
+void FrameTelemetry::Record(const FrameSample& sample)
+{
+	uint64_t index = m_written.load(std::memory_order_relaxed);
+	Slot& slot = m_slots[index & (Capacity - 1)];
+
+	slot.sequence.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.frame.store(sample.frame, std::memory_order_relaxed);
+	for (uint32_t phase = 0; phase < FramePhaseCount; phase++) {
+		slot.ms[phase].store(sample.ms[phase], std::memory_order_relaxed);
+	}
+	slot.sequence.store(index + 1, std::memory_order_release);
+	m_written.store(index + 1, std::memory_order_release);
+}
+
+void FrameTelemetry::Snapshot(uint32_t maxFrames, std::vector<FrameSample>& samples) const
+{
+	samples.clear();
+	uint64_t written = m_written.load(std::memory_order_acquire);
+	uint64_t count = std::min<uint64_t>({ written, maxFrames, Capacity });
+	samples.reserve(static_cast<size_t>(count));
+	for (uint64_t index = written - count; index < written; index++)
+	{
+		const Slot& slot = m_slots[index & (Capacity - 1)];
+		uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+		if (sequence != index + 1) {
+			continue; // overwritten since written was read, or being written
+		}
+
+		FrameSample sample;
+		sample.frame = slot.frame.load(std::memory_order_relaxed);
+		for (uint32_t phase = 0; phase < FramePhaseCount; phase++) {
+			sample.ms[phase] = slot.ms[phase].load(std::memory_order_relaxed);
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+			samples.push_back(sample);
+		}
+	}
+}
+
+FrameTelemetryStats FrameTelemetry::ComputeStats(uint32_t windowFrames) const
+{
+	std::vector<FrameSample> samples;
+	Snapshot(windowFrames, samples);
+	return ComputeStats(samples, stutterFactor);
+}
+
+FrameTelemetryStats FrameTelemetry::ComputeStats(const std::vector<FrameSample>& samples, float stutterFactor)
+{
+	FrameTelemetryStats stats;
+	stats.frames = static_cast<uint32_t>(samples.size());
+	if (samples.empty()) {
+		return stats;
+	}
+
+	std::vector<float> values(samples.size());
+	for (uint32_t phase = 0; phase < FramePhaseCount; phase++)
+	{
+		double sum = 0.0;
+		for (size_t i = 0; i < samples.size(); i++) {
+			values[i] = samples[i].ms[phase];
+			sum += values[i];
+		}
+		std::sort(values.begin(), values.end());
+
+		FramePhaseStats& phaseStats = stats.phases[phase];
+		phaseStats.average = static_cast<float>(sum / samples.size());
+		phaseStats.p50 = Percentile(values, 50.0f);
+		phaseStats.p95 = Percentile(values, 95.0f);
+		phaseStats.p99 = Percentile(values, 99.0f);
+		phaseStats.max = values.back();
+	}
+
+	// a stutter is a frame far off the typical one, whatever the frame rate
+	float threshold = stats.phases[FramePhaseFrame].p50 * stutterFactor;
+	for (const FrameSample& sample : samples) {
+		if (sample.ms[FramePhaseFrame] > threshold) {
+			stats.stutters++;
+		}
+	}
+	return stats;
+}
+
+bool FrameTelemetry::WriteCsv(const std::string& filename, std::string& error) const
+{
+	std::vector<FrameSample> samples;
+	Snapshot(Capacity, samples);
+
+	std::FILE* output = std::fopen(filename.c_str(), "w");
+	if (!output) {
+		error = "failed to create " + filename;
+		return false;
+	}
+	std::fprintf(output, "frame");
+	for (uint32_t phase = 0; phase < FramePhaseCount; phase++) {
+		std::fprintf(output, ",%s_ms", GetPhaseName(static_cast<FramePhase>(phase)));
+	}
+	std::fprintf(output, "\n");
+	for (const FrameSample& sample : samples)
+	{
+		std::fprintf(output, "%llu", static_cast<unsigned long long>(sample.frame));
+		for (uint32_t phase = 0; phase < FramePhaseCount; phase++) {
+			std::fprintf(output, ",%.4f", sample.ms[phase]);
+		}
+		std::fprintf(output, "\n");
+	}
+	bool ok = std::ferror(output) == 0;
+	std::fclose(output);
+	if (!ok) {
+		error = "failed to write " + filename;
+	}
+	return ok;
+}
+
+bool FrameTelemetry::WriteJson(const std::string& filename, std::string& error) const
+{
+	std::vector<FrameSample> samples;
+	Snapshot(Capacity, samples);
+	FrameTelemetryStats stats = ComputeStats(samples, stutterFactor);
+
+	std::FILE* output = std::fopen(filename.c_str(), "w");
+	if (!output) {
+		error = "failed to create " + filename;
+		return false;
+	}
+	std::fprintf(output, "{\n");
+	std::fprintf(output, "  \"build\": { \"configuration\": \"%s\", \"date\": \"%s %s\" },\n",
+		BuildConfiguration(), __DATE__, __TIME__);
+	std::fprintf(output, "  \"frames\": %u,\n", stats.frames);
+	std::fprintf(output, "  \"stutterFactor\": %.2f,\n", stutterFactor);
+	std::fprintf(output, "  \"stutters\": %u,\n", stats.stutters);
+	std::fprintf(output, "  \"phases\": {\n");
+	for (uint32_t phase = 0; phase < FramePhaseCount; phase++)
+	{
+		const FramePhaseStats& phaseStats = stats.phases[phase];
+		std::fprintf(output, "    \"%s\": { \"average\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+			GetPhaseName(static_cast<FramePhase>(phase)), phaseStats.average, phaseStats.p50, phaseStats.p95,
+			phaseStats.p99, phaseStats.max, phase + 1 < FramePhaseCount ? "," : "");
+	}
+	std::fprintf(output, "  },\n");
+	std::fprintf(output, "  \"columns\": [\"frame\"");
+	for (uint32_t phase = 0; phase < FramePhaseCount; phase++) {
+		std::fprintf(output, ", \"%s_ms\"", GetPhaseName(static_cast<FramePhase>(phase)));
+	}
+	std::fprintf(output, "],\n");
+	std::fprintf(output, "  \"samples\": [\n");
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		std::fprintf(output, "    [%llu", static_cast<unsigned long long>(samples[i].frame));
+		for (uint32_t phase = 0; phase < FramePhaseCount; phase++) {
+			std::fprintf(output, ", %.4f", samples[i].ms[phase]);
+		}
+		std::fprintf(output, "]%s\n", i + 1 < samples.size() ? "," : "");
+	}
+	std::fprintf(output, "  ]\n}\n");
+	bool ok = std::ferror(output) == 0;
+	std::fclose(output);
+	if (!ok) {
+		error = "failed to write " + filename;
+	}
+	return ok;
+}
+
+const char* FrameTelemetry::GetPhaseName(FramePhase phase)
+{
+	switch (phase)
+	{
+	case FramePhaseFrame: return "frame";
+	case FramePhaseUpdate: return "update";
+	case FramePhaseRecord: return "record";
+	case FramePhaseSubmit: return "submit";
+	case FramePhasePresentWait: return "present_wait";
+	case FramePhasePacketWait: return "packet_wait";
+	case FramePhaseInputToPresent: return "input_to_present";
+	default: return "unknown";
+	}
+}
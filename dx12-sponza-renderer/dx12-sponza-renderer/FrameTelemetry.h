@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// where a frame's cpu time goes. update and packet wait run on the
+// simulation thread, the rest on the render thread
+enum FramePhase : uint32_t
+{
+	FramePhaseFrame, // one rendered frame to the next
+	FramePhaseUpdate, // input, camera and ui
+	FramePhaseRecord, // command list recording
+	FramePhaseSubmit, // streaming, upload flush and ExecuteCommandLists
+	FramePhasePresentWait, // blocked on the swap chain, Present and the frame fence
+	FramePhasePacketWait, // simulation blocked on the render thread for a free frame packet
+	FramePhaseInputToPresent, // not a slice of the frame, input sampled to Present returning
+	FramePhaseCount
+};
+
+struct FrameSample
+{
+	uint64_t frame = 0;
+	float ms[FramePhaseCount] = {};
+};
+
+struct FramePhaseStats
+{
+	float average = 0.0f;
+	float p50 = 0.0f;
+	float p95 = 0.0f;
+	float p99 = 0.0f;
+	float max = 0.0f;
+};
+
+struct FrameTelemetryStats
+{
+	uint32_t frames = 0; // in the window the stats cover
+	FramePhaseStats phases[FramePhaseCount];
+	uint32_t stutters = 0; // frames over stutterFactor times the median
+};
+
+// frame timings in a fixed size ring. Record never blocks or allocates and
+// the ring may be read from any thread while it's written: every slot is a
+// seqlock, readers skip slots that change under them.
+class FrameTelemetry
+{
+public:
+	static const uint32_t Capacity = 8192; // power of two, about two minutes at 60 hz
+
+	FrameTelemetry();
+
+	// one producer thread
+	void Record(const FrameSample& sample);
+	uint64_t GetRecordedFrames() const { return m_written.load(std::memory_order_acquire); }
+
+	// copies up to maxFrames of the newest samples, oldest first
+	void Snapshot(uint32_t maxFrames, std::vector<FrameSample>& samples) const;
+
+	// percentiles over the newest windowFrames samples
+	FrameTelemetryStats ComputeStats(uint32_t windowFrames) const;
+
+	// every sample still in the ring. the json adds the stats over them and
+	// the build they came from, for comparing runs offline
+	bool WriteCsv(const std::string& filename, std::string& error) const;
+	bool WriteJson(const std::string& filename, std::string& error) const;
+
+	static const char* GetPhaseName(FramePhase phase);
+
+	float stutterFactor = 2.0f;
+
+private:
+	struct Slot
+	{
+		std::atomic<uint64_t> sequence; // sample index + 1 once written, 0 while writing
+		std::atomic<uint64_t> frame;
+		std::atomic<float> ms[FramePhaseCount];
+	};
+
+	static FrameTelemetryStats ComputeStats(const std::vector<FrameSample>& samples, float stutterFactor);
+
+	std::unique_ptr<Slot[]> m_slots;
+	std::atomic<uint64_t> m_written;
+};
@@ -0,0 +1,332 @@
+#include "FrustumCuller.h"
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FRUSTUM_CULLER_SSE
+#include <xmmintrin.h>
+#endif
+// avx2 is picked at runtime, so it's compiled without /arch:AVX2. gcc and
+// clang only allow its intrinsics in functions targeting it
+#if defined(_M_X64) || defined(__x86_64__)
+#define FRUSTUM_CULLER_AVX2
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	uint32_t LowestBit(uint32_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, value);
+		return index;
+#else
+		return __builtin_ctz(value);
+#endif
+	}
+
+	// for every plane, the bounds arrays holding the corner furthest along its normal
+	typedef const float* PlaneCorners[6][3];
+
+	void SelectCorners(const FrustumPlanes& planes, const std::vector<float> bounds[6], PlaneCorners& corners)
+	{
+		for (int plane = 0; plane < 6; plane++)
+		{
+			corners[plane][0] = bounds[planes.a[plane] >= 0.0f ? 3 : 0].data();
+			corners[plane][1] = bounds[planes.b[plane] >= 0.0f ? 4 : 1].data();
+			corners[plane][2] = bounds[planes.c[plane] >= 0.0f ? 5 : 2].data();
+		}
+	}
+
+	// the lanes of a block the mask has set, ascending, appended to visible
+	uint32_t AppendLanes(uint32_t mask, uint32_t base, uint32_t* visible)
+	{
+		uint32_t count = 0;
+		for (; mask != 0; mask &= mask - 1) {
+			visible[count++] = base + LowestBit(mask);
+		}
+		return count;
+	}
+
+#ifdef FRUSTUM_CULLER_AVX2
+	// per 8 bit mask the lanes it has set, 3 bits each from the lowest, and
+	// their count in the top byte. the lane numbers are the output, so
+	// there's nothing to permute: a variable shift per lane unpacks them
+	struct CompactTable
+	{
+		uint32_t entries[256];
+
+		CompactTable()
+		{
+			for (uint32_t mask = 0; mask < 256; mask++)
+			{
+				uint32_t count = 0;
+				uint32_t entry = 0;
+				for (uint32_t lane = 0; lane < 8; lane++) {
+					if (mask & (1u << lane)) {
+						entry |= lane << (3 * count++);
+					}
+				}
+				entries[mask] = entry | count << 24;
+			}
+		}
+	};
+	const CompactTable g_compactTable;
+
+	AVX2_FUNCTION uint32_t CullAvx2Blocks(const FrustumPlanes& planes, const PlaneCorners& corners, uint32_t count, uint32_t* visible)
+	{
+		__m256 a[6], b[6], c[6], d[6];
+		for (int plane = 0; plane < 6; plane++)
+		{
+			a[plane] = _mm256_set1_ps(planes.a[plane]);
+			b[plane] = _mm256_set1_ps(planes.b[plane]);
+			c[plane] = _mm256_set1_ps(planes.c[plane]);
+			d[plane] = _mm256_set1_ps(planes.d[plane]);
+		}
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256i shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+		const __m256i laneMask = _mm256_set1_epi32(7);
+
+		uint32_t written = 0;
+		for (uint32_t base = 0; base < count; base += 8)
+		{
+			// not less than rather than greater or equal, so nan keeps a box like it does in the scalar path
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int plane = 0; plane < 6; plane++)
+			{
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(a[plane], _mm256_loadu_ps(corners[plane][0] + base)),
+					_mm256_mul_ps(b[plane], _mm256_loadu_ps(corners[plane][1] + base))),
+					_mm256_mul_ps(c[plane], _mm256_loadu_ps(corners[plane][2] + base))), d[plane]);
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_NLT_UQ));
+			}
+			uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+			if (count - base < 8) {
+				written += AppendLanes(mask & ((1u << (count - base)) - 1), base, visible + written);
+				break;
+			}
+
+			// lane i shifts the entry right by 3 i to get the i-th visible lane.
+			// all 8 lanes are stored and the count moves past the visible
+			// ones. written is at most base, so a full block never stores
+			// past count
+			uint32_t entry = g_compactTable.entries[mask];
+			__m256i lanes = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(entry)), shifts), laneMask);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(visible + written), _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(base))));
+			written += entry >> 24;
+		}
+		return written;
+	}
+#endif
+
+	bool HasAvx2()
+	{
+#if !defined(FRUSTUM_CULLER_AVX2)
+		return false;
+#elif defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) {
+			return false;
+		}
+		// avx needs the os to save the ymm registers as well
+		__cpuid(info, 1);
+		bool avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0;
+		if (!avx || (_xgetbv(0) & 6) != 6) {
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+}
+
+FrustumPlanes ExtractFrustumPlanes(const XMFLOAT4X4& viewProjection)
+{
+	// clip = v * m, so the planes w + x >= 0, w - x >= 0, w + y >= 0,
+	// w - y >= 0, z >= 0 and w - z >= 0 are sums of m's columns
+	const float (*m)[4] = viewProjection.m;
+	const float signs[6][4] = {
+		{ 1.0f, 0.0f, 0.0f, 1.0f }, // left
+		{ -1.0f, 0.0f, 0.0f, 1.0f }, // right
+		{ 0.0f, 1.0f, 0.0f, 1.0f }, // bottom
+		{ 0.0f, -1.0f, 0.0f, 1.0f }, // top
+		{ 0.0f, 0.0f, 1.0f, 0.0f }, // near
+		{ 0.0f, 0.0f, -1.0f, 1.0f }, // far
+	};
+	FrustumPlanes planes;
+	float* coefficients[4] = { planes.a, planes.b, planes.c, planes.d };
+	for (int plane = 0; plane < 6; plane++)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			float sum = 0.0f;
+			for (int column = 0; column < 4; column++) {
+				sum += signs[plane][column] * m[row][column];
+			}
+			coefficients[row][plane] = sum;
+		}
+	}
+	return planes;
+}
+
+FrustumCuller::FrustumCuller()
+	: path(GetBestPath())
+{
+}
+
+void FrustumCuller::Clear()
+{
+	m_count = 0;
+	for (std::vector<float>& bounds : m_bounds) {
+		bounds.clear();
+	}
+}
+
+void FrustumCuller::Reserve(uint32_t count)
+{
+	for (std::vector<float>& bounds : m_bounds) {
+		bounds.reserve((count + BlockSize - 1) / BlockSize * BlockSize);
+	}
+}
+
+void FrustumCuller::Add(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+	// a block at a time, the padding is never reported visible
+	if (m_count % BlockSize == 0) {
+		for (std::vector<float>& bounds : m_bounds) {
+			bounds.resize(m_count + BlockSize, 0.0f);
+		}
+	}
+	const float values[6] = { boundsMin.x, boundsMin.y, boundsMin.z, boundsMax.x, boundsMax.y, boundsMax.z };
+	for (int i = 0; i < 6; i++) {
+		m_bounds[i][m_count] = values[i];
+	}
+	m_count++;
+}
+
+uint32_t FrustumCuller::Cull(const FrustumPlanes& planes, uint32_t* visible) const
+{
+	switch (IsSupported(path) ? path : CullPathScalar)
+	{
+	case CullPathAvx2:
+		return CullAvx2(planes, visible);
+	case CullPathSse:
+		return CullSse(planes, visible);
+	default:
+		return CullScalar(planes, visible);
+	}
+}
+
+CullPath FrustumCuller::GetBestPath()
+{
+	return IsSupported(CullPathAvx2) ? CullPathAvx2 : IsSupported(CullPathSse) ? CullPathSse : CullPathScalar;
+}
+
+bool FrustumCuller::IsSupported(CullPath path)
+{
+	static const bool avx2 = HasAvx2();
+	switch (path)
+	{
+	case CullPathScalar:
+		return true;
+	case CullPathSse:
+#ifdef FRUSTUM_CULLER_SSE
+		return true;
+#else
+		return false;
+#endif
+	case CullPathAvx2:
+		return avx2;
+	default:
+		return false;
+	}
+}
+
+const char* FrustumCuller::GetPathName(CullPath path)
+{
+	const char* names[CullPathCount] = { "scalar", "sse", "avx2" };
+	return path < CullPathCount ? names[path] : "unknown";
+}
+
+uint32_t FrustumCuller::CullScalar(const FrustumPlanes& planes, uint32_t* visible) const
+{
+	PlaneCorners corners;
+	SelectCorners(planes, m_bounds, corners);
+	uint32_t written = 0;
+	for (uint32_t i = 0; i < m_count; i++)
+	{
+		bool inside = true;
+		for (int plane = 0; plane < 6 && inside; plane++)
+		{
+			float distance = planes.a[plane] * corners[plane][0][i] + planes.b[plane] * corners[plane][1][i] +
+				planes.c[plane] * corners[plane][2][i] + planes.d[plane];
+			inside = !(distance < 0.0f);
+		}
+		if (inside) {
+			visible[written++] = i;
+		}
+	}
+	return written;
+}
+
+uint32_t FrustumCuller::CullSse(const FrustumPlanes& planes, uint32_t* visible) const
+{
+#ifdef FRUSTUM_CULLER_SSE
+	PlaneCorners corners;
+	SelectCorners(planes, m_bounds, corners);
+	__m128 a[6], b[6], c[6], d[6];
+	for (int plane = 0; plane < 6; plane++)
+	{
+		a[plane] = _mm_set1_ps(planes.a[plane]);
+		b[plane] = _mm_set1_ps(planes.b[plane]);
+		c[plane] = _mm_set1_ps(planes.c[plane]);
+		d[plane] = _mm_set1_ps(planes.d[plane]);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	uint32_t written = 0;
+	for (uint32_t base = 0; base < m_count; base += 4)
+	{
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (int plane = 0; plane < 6; plane++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(a[plane], _mm_loadu_ps(corners[plane][0] + base)),
+				_mm_mul_ps(b[plane], _mm_loadu_ps(corners[plane][1] + base))),
+				_mm_mul_ps(c[plane], _mm_loadu_ps(corners[plane][2] + base))), d[plane]);
+			inside = _mm_and_ps(inside, _mm_cmpnlt_ps(distance, zero));
+		}
+		uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+		if (m_count - base < 4) {
+			mask &= (1u << (m_count - base)) - 1;
+		}
+		written += AppendLanes(mask, base, visible + written);
+	}
+	return written;
+#else
+	return CullScalar(planes, visible);
+#endif
+}
+
+uint32_t FrustumCuller::CullAvx2(const FrustumPlanes& planes, uint32_t* visible) const
+{
+#ifdef FRUSTUM_CULLER_AVX2
+	PlaneCorners corners;
+	SelectCorners(planes, m_bounds, corners);
+	return CullAvx2Blocks(planes, corners, m_count, visible);
+#else
+	return CullScalar(planes, visible);
+#endif
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <DirectXMath.h>
+
+// the six planes of a view frustum as a x + b y + c z + d >= 0 inside, one
+// array per coefficient. not normalized, only the sign is used
+struct FrustumPlanes
+{
+	float a[6];
+	float b[6];
+	float c[6];
+	float d[6];
+};
+
+// planes of a row vector view * projection, d3d clip space with z in 0..w
+FrustumPlanes ExtractFrustumPlanes(const DirectX::XMFLOAT4X4& viewProjection);
+
+enum CullPath
+{
+	CullPathScalar,
+	CullPathSse, // 4 boxes at a time
+	CullPathAvx2, // 8 boxes at a time
+	CullPathCount
+};
+
+// axis aligned boxes tested against a frustum. the bounds are stored as one
+// array per coordinate, padded to a block of 8, so the simd paths load a
+// coordinate of 4 or 8 boxes at once. per plane only the box corner
+// furthest along its normal is tested, a box is culled when that corner is
+// outside any plane, so boxes crossing a plane stay visible. every path
+// computes the same sums in the same order and agrees with the scalar one
+// exactly.
+class FrustumCuller
+{
+public:
+	static const uint32_t BlockSize = 8;
+
+	FrustumCuller();
+
+	void Clear();
+	void Reserve(uint32_t count);
+	void Add(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax);
+	uint32_t GetCount() const { return m_count; }
+
+	// writes the indices of the boxes in the frustum in ascending order to
+	// visible, which needs room for GetCount() indices. returns how many
+	uint32_t Cull(const FrustumPlanes& planes, uint32_t* visible) const;
+
+	// the fastest the cpu supports
+	static CullPath GetBestPath();
+	static bool IsSupported(CullPath path);
+	static const char* GetPathName(CullPath path);
+
+	// falls back to scalar when the cpu doesn't support it
+	CullPath path;
+
+private:
+	uint32_t CullScalar(const FrustumPlanes& planes, uint32_t* visible) const;
+	uint32_t CullSse(const FrustumPlanes& planes, uint32_t* visible) const;
+	uint32_t CullAvx2(const FrustumPlanes& planes, uint32_t* visible) const;
+
+	uint32_t m_count = 0;
+	// min x, y, z then max x, y, z, each padded to a multiple of BlockSize
+	std::vector<float> m_bounds[6];
+};
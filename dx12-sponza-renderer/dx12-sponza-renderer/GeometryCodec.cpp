@@ -0,0 +1,592 @@
+#include "GeometryCodec.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define GEOMETRY_CODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const size_t BlockVertices = 256;
+	const size_t GroupSize = 16;
+	const size_t MaxStride = 256;
+	// payload of a group for each 2 bit mode: all zero, 2, 4 and 8 bits per value
+	const size_t GroupBytes[4] = { 0, 4, 8, 16 };
+
+	// modes of four groups share a byte
+	size_t HeaderBytes(size_t groups)
+	{
+		return (groups + 3) / 4;
+	}
+
+	uint8_t Zigzag(uint8_t delta)
+	{
+		return static_cast<uint8_t>((delta << 1) ^ (static_cast<int8_t>(delta) >> 7));
+	}
+
+	uint8_t Unzigzag(uint8_t value)
+	{
+		return static_cast<uint8_t>((value >> 1) ^ -(value & 1));
+	}
+
+	uint32_t GroupMode(const uint8_t* values)
+	{
+		uint8_t bits = 0;
+		for (size_t i = 0; i < GroupSize; i++) {
+			bits |= values[i];
+		}
+		return bits == 0 ? 0 : bits < 4 ? 1 : bits < 16 ? 2 : 3;
+	}
+
+	void EncodeGroup(uint8_t* out, const uint8_t* values, uint32_t mode)
+	{
+		if (mode == 1) {
+			for (size_t i = 0; i < 4; i++) {
+				out[i] = static_cast<uint8_t>(values[i * 4] | values[i * 4 + 1] << 2 | values[i * 4 + 2] << 4 | values[i * 4 + 3] << 6);
+			}
+		}
+		else if (mode == 2) {
+			for (size_t i = 0; i < 8; i++) {
+				out[i] = static_cast<uint8_t>(values[i * 2] | values[i * 2 + 1] << 4);
+			}
+		}
+		else if (mode == 3) {
+			std::memcpy(out, values, GroupSize);
+		}
+	}
+
+	void DecodeGroupScalar(const uint8_t* in, uint32_t mode, uint8_t* values)
+	{
+		for (size_t i = 0; i < GroupSize; i++)
+		{
+			if (mode == 0) {
+				values[i] = 0;
+			}
+			else if (mode == 1) {
+				values[i] = (in[i / 4] >> (i % 4 * 2)) & 3;
+			}
+			else if (mode == 2) {
+				values[i] = (in[i / 2] >> (i % 2 * 4)) & 15;
+			}
+			else {
+				values[i] = in[i];
+			}
+		}
+	}
+
+	// deltas of one byte plane of a block, starting from base
+	void DecodePlaneScalar(const uint8_t* headers, const uint8_t* in, size_t groups, uint8_t base, uint8_t* plane)
+	{
+		for (size_t group = 0; group < groups; group++)
+		{
+			uint32_t mode = (headers[group / 4] >> (group % 4 * 2)) & 3;
+			DecodeGroupScalar(in, mode, plane + group * GroupSize);
+			in += GroupBytes[mode];
+			for (size_t i = 0; i < GroupSize; i++)
+			{
+				base = static_cast<uint8_t>(base + Unzigzag(plane[group * GroupSize + i]));
+				plane[group * GroupSize + i] = base;
+			}
+		}
+	}
+
+	void TransposeScalar(const uint8_t* planes, size_t vertexCount, size_t stride, uint8_t* vertices)
+	{
+		for (size_t i = 0; i < vertexCount; i++) {
+			for (size_t k = 0; k < stride; k++) {
+				vertices[i * stride + k] = planes[k * BlockVertices + i];
+			}
+		}
+	}
+
+#ifdef GEOMETRY_CODEC_SSE2
+	__m128i DecodeGroupSse2(const uint8_t* in, uint32_t mode)
+	{
+		switch (mode)
+		{
+		case 1:
+		{
+			// byte i holds values 4i..4i+3 two bits apart, spread them and interleave
+			int32_t packed;
+			std::memcpy(&packed, in, sizeof(packed));
+			__m128i x = _mm_cvtsi32_si128(packed);
+			__m128i mask = _mm_set1_epi8(3);
+			__m128i a = _mm_and_si128(x, mask);
+			__m128i b = _mm_and_si128(_mm_srli_epi16(x, 2), mask);
+			__m128i c = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+			__m128i d = _mm_and_si128(_mm_srli_epi16(x, 6), mask);
+			return _mm_unpacklo_epi16(_mm_unpacklo_epi8(a, b), _mm_unpacklo_epi8(c, d));
+		}
+		case 2:
+		{
+			__m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in));
+			__m128i mask = _mm_set1_epi8(15);
+			return _mm_unpacklo_epi8(_mm_and_si128(x, mask), _mm_and_si128(_mm_srli_epi16(x, 4), mask));
+		}
+		case 3:
+			return _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+		default:
+			return _mm_setzero_si128();
+		}
+	}
+
+	void DecodePlaneSse2(const uint8_t* headers, const uint8_t* in, size_t groups, uint8_t base, uint8_t* plane)
+	{
+		__m128i running = _mm_set1_epi8(static_cast<char>(base));
+		for (size_t group = 0; group < groups; group++)
+		{
+			uint32_t mode = (headers[group / 4] >> (group % 4 * 2)) & 3;
+			__m128i x = DecodeGroupSse2(in, mode);
+			in += GroupBytes[mode];
+
+			// unzigzag, sse2 has no byte shifts so shift words and mask
+			__m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(x, _mm_set1_epi8(1)));
+			x = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(x, 1), _mm_set1_epi8(0x7F)), sign);
+
+			// prefix sum over the 16 deltas in four steps
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+			x = _mm_add_epi8(x, running);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(plane + group * GroupSize), x);
+
+			// broadcast the last byte as the next group's base
+			running = _mm_shuffle_epi32(_mm_shufflehi_epi16(_mm_unpackhi_epi8(x, x), 0xFF), 0xFF);
+		}
+	}
+
+	void Store4(uint8_t* destination, __m128i value)
+	{
+		int32_t word = _mm_cvtsi128_si32(value);
+		std::memcpy(destination, &word, sizeof(word));
+	}
+
+	// four planes of 16 vertices interleave into 16 dwords
+	void TransposeSse2(const uint8_t* planes, size_t vertexCount, size_t stride, uint8_t* vertices)
+	{
+		for (size_t k = 0; k < stride; k += 4)
+		{
+			const uint8_t* plane = planes + k * BlockVertices;
+			for (size_t i = 0; i < vertexCount; i += GroupSize)
+			{
+				__m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + i));
+				__m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + BlockVertices + i));
+				__m128i p2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + BlockVertices * 2 + i));
+				__m128i p3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + BlockVertices * 3 + i));
+				__m128i t0 = _mm_unpacklo_epi8(p0, p1);
+				__m128i t1 = _mm_unpackhi_epi8(p0, p1);
+				__m128i t2 = _mm_unpacklo_epi8(p2, p3);
+				__m128i t3 = _mm_unpackhi_epi8(p2, p3);
+				__m128i rows[4] = { _mm_unpacklo_epi16(t0, t2), _mm_unpackhi_epi16(t0, t2),
+					_mm_unpacklo_epi16(t1, t3), _mm_unpackhi_epi16(t1, t3) };
+
+				uint8_t* out = vertices + i * stride + k;
+				if (vertexCount - i >= GroupSize)
+				{
+					// constant lanes keep the rows in registers
+					for (size_t row = 0; row < 4; row++)
+					{
+						Store4(out + (row * 4) * stride, rows[row]);
+						Store4(out + (row * 4 + 1) * stride, _mm_shuffle_epi32(rows[row], 1));
+						Store4(out + (row * 4 + 2) * stride, _mm_shuffle_epi32(rows[row], 2));
+						Store4(out + (row * 4 + 3) * stride, _mm_shuffle_epi32(rows[row], 3));
+					}
+					continue;
+				}
+				for (size_t j = 0; j < vertexCount - i; j++)
+				{
+					Store4(out + j * stride, rows[j / 4]);
+					rows[j / 4] = _mm_srli_si128(rows[j / 4], 4);
+				}
+			}
+		}
+	}
+#endif
+
+	template<bool Simd>
+	bool DecodeVerticesImpl(void* vertices, size_t vertexCount, size_t stride, const uint8_t* source, size_t size)
+	{
+		if (stride == 0 || stride % 4 != 0 || stride > MaxStride) {
+			return false;
+		}
+
+		uint8_t* output = static_cast<uint8_t*>(vertices);
+		const uint8_t* in = source;
+		const uint8_t* const end = source + size;
+		std::vector<uint8_t> planes(stride * BlockVertices);
+		uint8_t last[MaxStride] = {};
+
+		for (size_t first = 0; first < vertexCount; first += BlockVertices)
+		{
+			size_t count = std::min(BlockVertices, vertexCount - first);
+			size_t groups = (count + GroupSize - 1) / GroupSize;
+			size_t headerBytes = HeaderBytes(groups);
+			for (size_t k = 0; k < stride; k++)
+			{
+				if (static_cast<size_t>(end - in) < headerBytes) {
+					return false;
+				}
+				const uint8_t* headers = in;
+				in += headerBytes;
+
+				// every payload size is known from the headers, check them all up front
+				size_t payload = 0;
+				for (size_t group = 0; group < groups; group++) {
+					payload += GroupBytes[(headers[group / 4] >> (group % 4 * 2)) & 3];
+				}
+				if (static_cast<size_t>(end - in) < payload) {
+					return false;
+				}
+
+				uint8_t* plane = planes.data() + k * BlockVertices;
+#ifdef GEOMETRY_CODEC_SSE2
+				if (Simd) {
+					DecodePlaneSse2(headers, in, groups, last[k], plane);
+				}
+				else
+#endif
+				{
+					DecodePlaneScalar(headers, in, groups, last[k], plane);
+				}
+				in += payload;
+				last[k] = plane[count - 1];
+			}
+
+#ifdef GEOMETRY_CODEC_SSE2
+			if (Simd) {
+				TransposeSse2(planes.data(), count, stride, output + first * stride);
+				continue;
+			}
+#endif
+			TransposeScalar(planes.data(), count, stride, output + first * stride);
+		}
+		return in == end;
+	}
+
+	// index coding
+
+	const uint32_t EdgeFifoSize = 15; // edge codes 0..14, 15 starts a triangle without a known edge
+	const uint32_t VertexFifoSize = 14; // vertex codes 1..14, 0 is the next new vertex, 15 an explicit index
+	const uint32_t NoEdge = 15;
+	const uint32_t NextVertex = 0;
+	const uint32_t ExplicitVertex = 15;
+	const uint32_t Invalid = ~0u;
+
+	struct IndexCoderState
+	{
+		uint32_t edges[EdgeFifoSize][2];
+		uint32_t vertices[VertexFifoSize];
+		uint32_t edgeOffset = 0;
+		uint32_t vertexOffset = 0;
+		uint32_t next = 0;
+		uint32_t last = 0;
+
+		IndexCoderState()
+		{
+			std::fill(&edges[0][0], &edges[0][0] + EdgeFifoSize * 2, Invalid);
+			std::fill(vertices, vertices + VertexFifoSize, Invalid);
+		}
+
+		// i = 0 is the most recent
+		uint32_t Edge(uint32_t i, uint32_t side) const { return edges[(edgeOffset + EdgeFifoSize - 1 - i) % EdgeFifoSize][side]; }
+		uint32_t Vertex(uint32_t i) const { return vertices[(vertexOffset + VertexFifoSize - 1 - i) % VertexFifoSize]; }
+
+		void PushEdge(uint32_t a, uint32_t b)
+		{
+			edges[edgeOffset][0] = a;
+			edges[edgeOffset][1] = b;
+			edgeOffset = (edgeOffset + 1) % EdgeFifoSize;
+		}
+
+		void PushVertex(uint32_t v)
+		{
+			vertices[vertexOffset] = v;
+			vertexOffset = (vertexOffset + 1) % VertexFifoSize;
+		}
+
+		// edges are stored reversed, that's how the triangle across them lists them
+		void PushTriangleEdges(uint32_t a, uint32_t b, uint32_t c, bool sharedFirstEdge)
+		{
+			if (!sharedFirstEdge) {
+				PushEdge(b, a);
+			}
+			PushEdge(c, b);
+			PushEdge(a, c);
+		}
+	};
+
+	uint8_t* WriteVarint(uint8_t* out, uint32_t value)
+	{
+		for (; value >= 0x80; value >>= 7) {
+			*out++ = static_cast<uint8_t>(value | 0x80);
+		}
+		*out++ = static_cast<uint8_t>(value);
+		return out;
+	}
+
+	bool ReadVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value)
+	{
+		value = 0;
+		for (uint32_t shift = 0; shift < 35; shift += 7)
+		{
+			if (in >= end) {
+				return false;
+			}
+			uint8_t byte = *in++;
+			value |= uint32_t(byte & 0x7F) << shift;
+			if (byte < 0x80) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	uint32_t EncodeVertex(IndexCoderState& state, uint32_t v, uint8_t*& explicitOut)
+	{
+		uint32_t code = ExplicitVertex;
+		if (v == state.next)
+		{
+			code = NextVertex;
+			state.next++;
+			state.PushVertex(v);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < VertexFifoSize; i++) {
+				if (state.Vertex(i) == v) {
+					code = 1 + i;
+					break;
+				}
+			}
+			if (code == ExplicitVertex)
+			{
+				int32_t delta = static_cast<int32_t>(v - state.last);
+				explicitOut = WriteVarint(explicitOut, (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31));
+				state.PushVertex(v);
+			}
+		}
+		state.last = v;
+		return code;
+	}
+
+	bool DecodeVertex(IndexCoderState& state, uint32_t code, const uint8_t*& in, const uint8_t* end, uint32_t& v)
+	{
+		if (code == NextVertex)
+		{
+			v = state.next++;
+			state.PushVertex(v);
+		}
+		else if (code != ExplicitVertex)
+		{
+			v = state.Vertex(code - 1);
+			if (v == Invalid) {
+				return false;
+			}
+		}
+		else
+		{
+			uint32_t zigzag;
+			if (!ReadVarint(in, end, zigzag)) {
+				return false;
+			}
+			v = state.last + ((zigzag >> 1) ^ (0u - (zigzag & 1)));
+			state.PushVertex(v);
+		}
+		state.last = v;
+		return true;
+	}
+}
+
+size_t GeometryCodec::VertexBound(size_t vertexCount, size_t stride)
+{
+	size_t blocks = (vertexCount + BlockVertices - 1) / BlockVertices;
+	return blocks * stride * (HeaderBytes(BlockVertices / GroupSize) + BlockVertices);
+}
+
+size_t GeometryCodec::EncodeVertices(uint8_t* destination, size_t capacity, const void* vertices, size_t vertexCount, size_t stride)
+{
+	if (stride == 0 || stride % 4 != 0 || stride > MaxStride) {
+		return 0;
+	}
+
+	const uint8_t* input = static_cast<const uint8_t*>(vertices);
+	uint8_t* out = destination;
+	uint8_t* const end = destination + capacity;
+	uint8_t last[MaxStride] = {};
+	uint8_t deltas[BlockVertices];
+
+	for (size_t first = 0; first < vertexCount; first += BlockVertices)
+	{
+		size_t count = std::min(BlockVertices, vertexCount - first);
+		size_t groups = (count + GroupSize - 1) / GroupSize;
+		size_t headerBytes = HeaderBytes(groups);
+		for (size_t k = 0; k < stride; k++)
+		{
+			// padding past the last vertex is zero deltas
+			std::fill(deltas, deltas + BlockVertices, uint8_t(0));
+			for (size_t i = 0; i < count; i++)
+			{
+				uint8_t value = input[(first + i) * stride + k];
+				deltas[i] = Zigzag(static_cast<uint8_t>(value - last[k]));
+				last[k] = value;
+			}
+
+			size_t planeBytes = headerBytes;
+			uint32_t modes[BlockVertices / GroupSize];
+			for (size_t group = 0; group < groups; group++)
+			{
+				modes[group] = GroupMode(deltas + group * GroupSize);
+				planeBytes += GroupBytes[modes[group]];
+			}
+			if (static_cast<size_t>(end - out) < planeBytes) {
+				return 0;
+			}
+
+			std::fill(out, out + headerBytes, uint8_t(0));
+			for (size_t group = 0; group < groups; group++) {
+				out[group / 4] |= static_cast<uint8_t>(modes[group] << (group % 4 * 2));
+			}
+			out += headerBytes;
+			for (size_t group = 0; group < groups; group++)
+			{
+				EncodeGroup(out, deltas + group * GroupSize, modes[group]);
+				out += GroupBytes[modes[group]];
+			}
+		}
+	}
+	return static_cast<size_t>(out - destination);
+}
+
+bool GeometryCodec::DecodeVertices(void* vertices, size_t vertexCount, size_t stride, const uint8_t* source, size_t size)
+{
+	return DecodeVerticesImpl<true>(vertices, vertexCount, stride, source, size);
+}
+
+bool GeometryCodec::DecodeVerticesScalar(void* vertices, size_t vertexCount, size_t stride, const uint8_t* source, size_t size)
+{
+	return DecodeVerticesImpl<false>(vertices, vertexCount, stride, source, size);
+}
+
+size_t GeometryCodec::IndexBound(size_t indexCount)
+{
+	// a code per triangle, at worst a vertex code byte and three 5 byte varints
+	return indexCount / 3 * (1 + 1 + 3 * 5);
+}
+
+size_t GeometryCodec::EncodeIndices(uint8_t* destination, size_t capacity, const uint32_t* indices, size_t indexCount)
+{
+	size_t triangleCount = indexCount / 3;
+	if (indexCount % 3 != 0 || capacity < triangleCount) {
+		return 0;
+	}
+
+	// one code byte per triangle, then everything else in order
+	IndexCoderState state;
+	uint8_t* codes = destination;
+	uint8_t* data = destination + triangleCount;
+	uint8_t* const end = destination + capacity;
+	for (size_t triangle = 0; triangle < triangleCount; triangle++)
+	{
+		// a code byte and three varints at most
+		uint8_t scratch[1 + 3 * 5];
+		uint8_t* extra = scratch;
+
+		uint32_t a = indices[triangle * 3];
+		uint32_t b = indices[triangle * 3 + 1];
+		uint32_t c = indices[triangle * 3 + 2];
+
+		// the most recent edge any corner rotation starts with
+		uint32_t edge = NoEdge;
+		for (uint32_t i = 0; i < EdgeFifoSize && edge == NoEdge; i++)
+		{
+			uint32_t x = state.Edge(i, 0);
+			uint32_t y = state.Edge(i, 1);
+			if (x == a && y == b) {
+				edge = i;
+			}
+			else if (x == b && y == c) {
+				edge = i;
+				std::swap(a, b);
+				std::swap(b, c);
+			}
+			else if (x == c && y == a) {
+				edge = i;
+				std::swap(a, c);
+				std::swap(b, c);
+			}
+		}
+
+		if (edge != NoEdge)
+		{
+			uint32_t code = EncodeVertex(state, c, extra);
+			codes[triangle] = static_cast<uint8_t>(edge << 4 | code);
+			state.PushTriangleEdges(a, b, c, true);
+		}
+		else
+		{
+			uint8_t* codesBC = extra++;
+			uint32_t codeA = EncodeVertex(state, a, extra);
+			uint32_t codeB = EncodeVertex(state, b, extra);
+			uint32_t codeC = EncodeVertex(state, c, extra);
+			*codesBC = static_cast<uint8_t>(codeB << 4 | codeC);
+			codes[triangle] = static_cast<uint8_t>(NoEdge << 4 | codeA);
+			state.PushTriangleEdges(a, b, c, false);
+		}
+
+		size_t extraBytes = static_cast<size_t>(extra - scratch);
+		if (static_cast<size_t>(end - data) < extraBytes) {
+			return 0;
+		}
+		std::memcpy(data, scratch, extraBytes);
+		data += extraBytes;
+	}
+	return static_cast<size_t>(data - destination);
+}
+
+bool GeometryCodec::DecodeIndices(uint32_t* indices, size_t indexCount, const uint8_t* source, size_t size)
+{
+	size_t triangleCount = indexCount / 3;
+	if (indexCount % 3 != 0 || size < triangleCount) {
+		return false;
+	}
+
+	IndexCoderState state;
+	const uint8_t* in = source + triangleCount;
+	const uint8_t* const end = source + size;
+	for (size_t triangle = 0; triangle < triangleCount; triangle++)
+	{
+		uint32_t code = source[triangle];
+		uint32_t edge = code >> 4;
+		uint32_t a, b, c;
+		if (edge != NoEdge)
+		{
+			a = state.Edge(edge, 0);
+			b = state.Edge(edge, 1);
+			if (a == Invalid || !DecodeVertex(state, code & 15, in, end, c)) {
+				return false;
+			}
+			state.PushTriangleEdges(a, b, c, true);
+		}
+		else
+		{
+			if (in >= end) {
+				return false;
+			}
+			uint32_t codesBC = *in++;
+			if (!DecodeVertex(state, code & 15, in, end, a) ||
+				!DecodeVertex(state, codesBC >> 4, in, end, b) ||
+				!DecodeVertex(state, codesBC & 15, in, end, c)) {
+				return false;
+			}
+			state.PushTriangleEdges(a, b, c, false);
+		}
+		indices[triangle * 3] = a;
+		indices[triangle * 3 + 1] = b;
+		indices[triangle * 3 + 2] = c;
+	}
+	return in == end;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// compact encodings for vertex and index buffers, after meshoptimizer's
+// codecs. both are meant to be decoded at load time faster than the disk can
+// deliver the bytes they save, and compress further with lz4 afterwards.
+//
+// vertices are cut into blocks of 256. every byte of the vertex becomes a
+// plane of zigzagged deltas to the same byte of the previous vertex, stored
+// in groups of 16 at 0, 2, 4 or 8 bits each. the decoder undoes a group with a
+// handful of sse2 instructions and transposes the planes back four at a time.
+// works best when neighbouring vertices are close, i.e. in first use order.
+//
+// indices are coded a triangle at a time against a fifo of recent edges and
+// one of recent vertices, most triangles cost a byte. a decoded triangle may
+// start at a different corner than the original, the winding is kept.
+namespace GeometryCodec
+{
+	// stride has to be a multiple of 4, at most 256
+	size_t VertexBound(size_t vertexCount, size_t stride);
+	// returns the encoded size, 0 if it doesn't fit in capacity
+	size_t EncodeVertices(uint8_t* destination, size_t capacity, const void* vertices, size_t vertexCount, size_t stride);
+	// fails on malformed input or when the input isn't exactly size bytes
+	bool DecodeVertices(void* vertices, size_t vertexCount, size_t stride, const uint8_t* source, size_t size);
+	// the portable decoder DecodeVertices uses without sse2, for comparing
+	bool DecodeVerticesScalar(void* vertices, size_t vertexCount, size_t stride, const uint8_t* source, size_t size);
+
+	// indexCount has to be a multiple of 3
+	size_t IndexBound(size_t indexCount);
+	size_t EncodeIndices(uint8_t* destination, size_t capacity, const uint32_t* indices, size_t indexCount);
+	// decoded indices aren't range checked against any vertex count
+	bool DecodeIndices(uint32_t* indices, size_t indexCount, const uint8_t* source, size_t size);
+}
@@ -0,0 +1,128 @@
+#include "GeometryLayout.h"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	// extends the last run when the range continues it on both sides
+	void AddCopy(std::vector<GeometryCopyRun>& copies, uint64_t source, uint64_t destination, uint64_t count)
+	{
+		if (count == 0) {
+			return;
+		}
+		if (!copies.empty())
+		{
+			GeometryCopyRun& run = copies.back();
+			if (run.source + run.count == source && run.destination + run.count == destination)
+			{
+				run.count += count;
+				return;
+			}
+		}
+		copies.push_back({ source, destination, count });
+	}
+}
+
+void GeometryLayout::Reset(uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+	m_vertexRanges.Reset(vertexCapacity);
+	m_indexRanges.Reset(indexCapacity);
+	m_vertexCapacity = vertexCapacity;
+	m_indexCapacity = indexCapacity;
+	m_meshes.clear();
+	m_freeMeshes.clear();
+}
+
+uint32_t GeometryLayout::Add(uint32_t vertexCount, uint32_t indexCount)
+{
+	uint64_t baseVertex = m_vertexRanges.Allocate(vertexCount, 1);
+	if (baseVertex == TlsfAllocator::InvalidOffset) {
+		return ~0u;
+	}
+	uint64_t firstIndex = m_indexRanges.Allocate(indexCount, 1);
+	if (firstIndex == TlsfAllocator::InvalidOffset)
+	{
+		m_vertexRanges.Free(baseVertex);
+		return ~0u;
+	}
+
+	uint32_t id;
+	if (!m_freeMeshes.empty())
+	{
+		id = m_freeMeshes.back();
+		m_freeMeshes.pop_back();
+	}
+	else
+	{
+		id = static_cast<uint32_t>(m_meshes.size());
+		m_meshes.emplace_back();
+	}
+
+	LayoutMesh& mesh = m_meshes[id];
+	mesh.range.baseVertex = static_cast<uint32_t>(baseVertex);
+	mesh.range.vertexCount = vertexCount;
+	mesh.range.firstIndex = static_cast<uint32_t>(firstIndex);
+	mesh.range.indexCount = indexCount;
+	mesh.live = true;
+	return id;
+}
+
+void GeometryLayout::Remove(uint32_t mesh)
+{
+	LayoutMesh& removed = m_meshes[mesh];
+	assert(removed.live);
+	m_vertexRanges.Free(removed.range.baseVertex);
+	m_indexRanges.Free(removed.range.firstIndex);
+	removed.live = false;
+	m_freeMeshes.push_back(mesh);
+}
+
+bool GeometryLayout::Relayout(uint32_t vertexCapacity, uint32_t indexCapacity,
+	std::vector<GeometryCopyRun>& vertexCopies, std::vector<GeometryCopyRun>& indexCopies)
+{
+	vertexCopies.clear();
+	indexCopies.clear();
+
+	m_order.clear();
+	for (uint32_t i = 0; i < m_meshes.size(); i++) {
+		if (m_meshes[i].live) {
+			m_order.push_back(i);
+		}
+	}
+	std::sort(m_order.begin(), m_order.end(), [&](uint32_t a, uint32_t b) {
+		return m_meshes[a].range.baseVertex < m_meshes[b].range.baseVertex;
+	});
+
+	// allocated one after another from empty allocators, so the live meshes end
+	// up packed at the front in their current order
+	TlsfAllocator vertexRanges(vertexCapacity);
+	TlsfAllocator indexRanges(indexCapacity);
+	m_relocated.clear();
+	for (uint32_t id : m_order)
+	{
+		GeometryRange range = m_meshes[id].range;
+		uint64_t baseVertex = vertexRanges.Allocate(range.vertexCount, 1);
+		uint64_t firstIndex = indexRanges.Allocate(range.indexCount, 1);
+		if (baseVertex == TlsfAllocator::InvalidOffset || firstIndex == TlsfAllocator::InvalidOffset)
+		{
+			vertexCopies.clear();
+			indexCopies.clear();
+			return false;
+		}
+
+		AddCopy(vertexCopies, range.baseVertex, baseVertex, range.vertexCount);
+		AddCopy(indexCopies, range.firstIndex, firstIndex, range.indexCount);
+		range.baseVertex = static_cast<uint32_t>(baseVertex);
+		range.firstIndex = static_cast<uint32_t>(firstIndex);
+		m_relocated.push_back(range);
+	}
+
+	for (size_t i = 0; i < m_order.size(); i++) {
+		m_meshes[m_order[i]].range = m_relocated[i];
+	}
+	m_vertexRanges = std::move(vertexRanges);
+	m_indexRanges = std::move(indexRanges);
+	m_vertexCapacity = vertexCapacity;
+	m_indexCapacity = indexCapacity;
+	return true;
+}
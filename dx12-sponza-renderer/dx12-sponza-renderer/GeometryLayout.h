@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "TlsfAllocator.h"
+
+// where a mesh lives in the pool, in vertices and indices. indices stay
+// relative to the mesh, draws pass baseVertex to DrawIndexedInstanced
+struct GeometryRange
+{
+	uint32_t baseVertex = 0;
+	uint32_t vertexCount = 0;
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+};
+
+// elements to copy from the old buffer to the new one when the layout changes,
+// in vertices or indices
+struct GeometryCopyRun
+{
+	uint64_t source = 0;
+	uint64_t destination = 0;
+	uint64_t count = 0;
+};
+
+// the bookkeeping half of GeometryPool: the vertex and index ranges of every
+// mesh, handed out by a TlsfAllocator per buffer, and the plan for moving them
+// into new buffers. it never touches the buffers, so it runs headless
+class GeometryLayout
+{
+public:
+	// forgets every mesh
+	void Reset(uint32_t vertexCapacity, uint32_t indexCapacity);
+
+	// returns the mesh id, ~0u when either range doesn't fit. ids of removed meshes are reused
+	uint32_t Add(uint32_t vertexCount, uint32_t indexCount);
+	void Remove(uint32_t mesh);
+
+	const GeometryRange& GetRange(uint32_t mesh) const { return m_meshes[mesh].range; }
+	bool IsLive(uint32_t mesh) const { return mesh < m_meshes.size() && m_meshes[mesh].live; }
+	uint32_t GetMeshIdCount() const { return static_cast<uint32_t>(m_meshes.size()); }
+	uint32_t GetMeshCount() const { return static_cast<uint32_t>(m_meshes.size() - m_freeMeshes.size()); }
+
+	// packs the live meshes into fresh ranges of the given capacities, keeping
+	// their order so meshes that were already packed move with a single copy.
+	// the copies from the old ranges to the new ones come out merged into runs.
+	// afterwards the free space of each buffer is one block. returns false and
+	// leaves the layout as it was when the live meshes don't fit
+	bool Relayout(uint32_t vertexCapacity, uint32_t indexCapacity,
+		std::vector<GeometryCopyRun>& vertexCopies, std::vector<GeometryCopyRun>& indexCopies);
+
+	uint32_t GetVertexCapacity() const { return m_vertexCapacity; }
+	uint32_t GetIndexCapacity() const { return m_indexCapacity; }
+	// sizes count vertices and indices
+	TlsfStats GetVertexStats() const { return m_vertexRanges.GetStats(); }
+	TlsfStats GetIndexStats() const { return m_indexRanges.GetStats(); }
+
+private:
+	struct LayoutMesh
+	{
+		GeometryRange range;
+		bool live = false;
+	};
+
+	TlsfAllocator m_vertexRanges;
+	TlsfAllocator m_indexRanges;
+	uint32_t m_vertexCapacity = 0;
+	uint32_t m_indexCapacity = 0;
+
+	std::vector<LayoutMesh> m_meshes;
+	std::vector<uint32_t> m_freeMeshes;
+
+	std::vector<uint32_t> m_order; // scratch, live meshes by baseVertex
+	std::vector<GeometryRange> m_relocated; // scratch, new ranges in m_order
+};
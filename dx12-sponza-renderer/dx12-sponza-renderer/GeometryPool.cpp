@@ -0,0 +1,131 @@
+#include "GeometryPool.h"
+#include <algorithm>
+
+bool GeometryPool::Initialize(GpuHeapAllocator* heaps, UploadService* uploads, uint32_t vertexStride,
+	uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+	m_heaps = heaps;
+	m_uploads = uploads;
+	m_vertexStride = vertexStride;
+	return Rebuild(vertexCapacity, indexCapacity);
+}
+
+uint32_t GeometryPool::AddMesh(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount)
+{
+	uint32_t id = m_layout.Add(vertexCount, indexCount);
+	if (id == ~0u)
+	{
+		// grow by the factor, or by enough for the mesh if it's larger than that
+		uint64_t verticesUsed = m_layout.GetVertexStats().usedBytes;
+		uint64_t indicesUsed = m_layout.GetIndexStats().usedBytes;
+		uint64_t vertexCapacity = std::max<uint64_t>(uint64_t(m_layout.GetVertexCapacity() * growthFactor), verticesUsed + vertexCount);
+		uint64_t indexCapacity = std::max<uint64_t>(uint64_t(m_layout.GetIndexCapacity() * growthFactor), indicesUsed + indexCount);
+		if (vertexCapacity > UINT32_MAX || indexCapacity > UINT32_MAX ||
+			!Rebuild(static_cast<uint32_t>(vertexCapacity), static_cast<uint32_t>(indexCapacity))) {
+			return ~0u;
+		}
+		m_grows++;
+		id = m_layout.Add(vertexCount, indexCount);
+		if (id == ~0u) {
+			return ~0u;
+		}
+	}
+
+	const GeometryRange& range = m_layout.GetRange(id);
+	uint64_t vertexBytes = uint64_t(vertexCount) * m_vertexStride;
+	uint64_t indexBytes = uint64_t(indexCount) * sizeof(uint32_t);
+	UploadToken vertexUpload = m_uploads->UploadBuffer(m_vertexBuffer.resource.Get(),
+		m_vertexBuffer.offset + uint64_t(range.baseVertex) * m_vertexStride, vertices, vertexBytes);
+	UploadToken indexUpload = m_uploads->UploadBuffer(m_indexBuffer.resource.Get(),
+		m_indexBuffer.offset + uint64_t(range.firstIndex) * sizeof(uint32_t), indices, indexBytes);
+	if ((vertexUpload == 0 && vertexBytes > 0) || (indexUpload == 0 && indexBytes > 0))
+	{
+		RemoveMesh(id);
+		return ~0u;
+	}
+	return id;
+}
+
+void GeometryPool::RemoveMesh(uint32_t mesh)
+{
+	m_layout.Remove(mesh);
+}
+
+bool GeometryPool::Compact(float fragmentationThreshold)
+{
+	if (GetStats().fragmentation <= fragmentationThreshold) {
+		return false;
+	}
+	if (!Rebuild(m_layout.GetVertexCapacity(), m_layout.GetIndexCapacity())) {
+		return false;
+	}
+	m_compactions++;
+	return true;
+}
+
+bool GeometryPool::Rebuild(uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+	// pool buffers stay out of the heap allocator's shared pages, an old and
+	// a new buffer in the same page would make the copies below overlap
+	uint64_t vertexBytes = std::max<uint64_t>(uint64_t(vertexCapacity) * m_vertexStride, m_heaps->sharedBufferLimit + 1);
+	uint64_t indexBytes = std::max<uint64_t>(uint64_t(indexCapacity) * sizeof(uint32_t), m_heaps->sharedBufferLimit + 1);
+	vertexCapacity = static_cast<uint32_t>(vertexBytes / m_vertexStride);
+	indexCapacity = static_cast<uint32_t>(indexBytes / sizeof(uint32_t));
+
+	GpuAllocation vertexBuffer;
+	GpuAllocation indexBuffer;
+	if (!m_heaps->CreateBuffer(uint64_t(vertexCapacity) * m_vertexStride, vertexBuffer)) {
+		return false;
+	}
+	if (!m_heaps->CreateBuffer(uint64_t(indexCapacity) * sizeof(uint32_t), indexBuffer))
+	{
+		m_heaps->Free(vertexBuffer);
+		return false;
+	}
+	if (!m_layout.Relayout(vertexCapacity, indexCapacity, m_vertexCopies, m_indexCopies))
+	{
+		m_heaps->Free(vertexBuffer);
+		m_heaps->Free(indexBuffer);
+		return false;
+	}
+
+	for (const GeometryCopyRun& run : m_vertexCopies) {
+		m_uploads->CopyBuffer(vertexBuffer.resource.Get(), vertexBuffer.offset + run.destination * m_vertexStride,
+			m_vertexBuffer.resource.Get(), m_vertexBuffer.offset + run.source * m_vertexStride, run.count * m_vertexStride);
+	}
+	for (const GeometryCopyRun& run : m_indexCopies) {
+		m_uploads->CopyBuffer(indexBuffer.resource.Get(), indexBuffer.offset + run.destination * sizeof(uint32_t),
+			m_indexBuffer.resource.Get(), m_indexBuffer.offset + run.source * sizeof(uint32_t), run.count * sizeof(uint32_t));
+	}
+
+	// draws recorded earlier may still read the old buffers
+	m_heaps->Release(m_vertexBuffer);
+	m_heaps->Release(m_indexBuffer);
+	m_vertexBuffer = std::move(vertexBuffer);
+	m_indexBuffer = std::move(indexBuffer);
+
+	m_vertexBufferView.BufferLocation = m_vertexBuffer.gpuAddress;
+	m_vertexBufferView.StrideInBytes = m_vertexStride;
+	m_vertexBufferView.SizeInBytes = vertexCapacity * m_vertexStride;
+	m_indexBufferView.BufferLocation = m_indexBuffer.gpuAddress;
+	m_indexBufferView.Format = DXGI_FORMAT_R32_UINT;
+	m_indexBufferView.SizeInBytes = indexCapacity * sizeof(uint32_t);
+	return true;
+}
+
+GeometryPoolStats GeometryPool::GetStats() const
+{
+	TlsfStats vertexStats = m_layout.GetVertexStats();
+	TlsfStats indexStats = m_layout.GetIndexStats();
+
+	GeometryPoolStats stats;
+	stats.meshes = m_layout.GetMeshCount();
+	stats.vertexCapacity = m_layout.GetVertexCapacity();
+	stats.verticesUsed = static_cast<uint32_t>(vertexStats.usedBytes);
+	stats.indexCapacity = m_layout.GetIndexCapacity();
+	stats.indicesUsed = static_cast<uint32_t>(indexStats.usedBytes);
+	stats.grows = m_grows;
+	stats.compactions = m_compactions;
+	stats.fragmentation = std::max(vertexStats.Fragmentation(), indexStats.Fragmentation());
+	return stats;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d12.h>
+#include <vector>
+#include "GeometryLayout.h"
+#include "GpuHeapAllocator.h"
+#include "UploadService.h"
+
+struct GeometryPoolStats
+{
+	uint32_t meshes = 0;
+	uint32_t vertexCapacity = 0;
+	uint32_t verticesUsed = 0;
+	uint32_t indexCapacity = 0;
+	uint32_t indicesUsed = 0;
+	uint32_t grows = 0;
+	uint32_t compactions = 0;
+	float fragmentation = 0.0f; // worse of the two buffers, see TlsfStats
+};
+
+// one vertex buffer and one 32 bit index buffer for every mesh of the scene,
+// so the input assembler is bound once per frame. ranges are handed out by a
+// GeometryLayout, which also plans the copies of a rebuild. when a mesh doesn't fit the buffers are rebuilt
+// bigger, and Compact rebuilds them at the same size once removed meshes have
+// left the free space scattered. rebuilding copies the live meshes on the
+// upload queue, so ranges change and have to be looked up again afterwards.
+// the old buffers go to the heap allocator's release queue, the frame that
+// waits on the copies is the last one that can read them.
+class GeometryPool
+{
+public:
+	// heaps and uploads have to outlive the pool
+	bool Initialize(GpuHeapAllocator* heaps, UploadService* uploads, uint32_t vertexStride,
+		uint32_t vertexCapacity, uint32_t indexCapacity);
+
+	// returns the mesh id, ~0u when the buffers can't grow or the upload can't be staged
+	uint32_t AddMesh(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+	// the range may be reused right away, the gpu has to be done drawing it
+	void RemoveMesh(uint32_t mesh);
+
+	const GeometryRange& GetRange(uint32_t mesh) const { return m_layout.GetRange(mesh); }
+
+	// repacks the live meshes when fragmentation is above the threshold,
+	// returns whether it did. cheap enough to call every frame, a repack
+	// leaves no fragmentation behind
+	bool Compact(float fragmentationThreshold = 0.25f);
+
+	const D3D12_VERTEX_BUFFER_VIEW& GetVertexBufferView() const { return m_vertexBufferView; }
+	const D3D12_INDEX_BUFFER_VIEW& GetIndexBufferView() const { return m_indexBufferView; }
+
+	GeometryPoolStats GetStats() const;
+
+	// capacity is multiplied by at least this much when the pool grows
+	float growthFactor = 1.5f;
+
+private:
+	bool Rebuild(uint32_t vertexCapacity, uint32_t indexCapacity);
+
+	GpuHeapAllocator* m_heaps = nullptr;
+	UploadService* m_uploads = nullptr;
+	uint32_t m_vertexStride = 0;
+
+	GpuAllocation m_vertexBuffer;
+	GpuAllocation m_indexBuffer;
+	D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView = {};
+	D3D12_INDEX_BUFFER_VIEW m_indexBufferView = {};
+	GeometryLayout m_layout;
+	std::vector<GeometryCopyRun> m_vertexCopies; // scratch for Rebuild
+	std::vector<GeometryCopyRun> m_indexCopies;
+
+	uint32_t m_grows = 0;
+	uint32_t m_compactions = 0;
+};
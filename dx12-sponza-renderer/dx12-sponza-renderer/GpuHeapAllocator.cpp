@@ -0,0 +1,216 @@
+#include "GpuHeapAllocator.h"
+#include "d3dx12.h"
+#include <algorithm>
+#include <cassert>
+
+using Microsoft::WRL::ComPtr;
+
+bool GpuHeapAllocator::Initialize(ID3D12Device* device, DeferredReleaseQueue* releases, UINT64 heapSize, UINT64 sharedPageSize)
+{
+	m_device = device;
+	m_releases = releases;
+	m_heapSize = heapSize;
+	m_sharedPageSize = std::min(sharedPageSize, heapSize);
+	return true;
+}
+
+bool GpuHeapAllocator::CreateBuffer(UINT64 size, GpuAllocation& allocation)
+{
+	allocation = GpuAllocation();
+	if (size <= sharedBufferLimit)
+	{
+		// 256 bytes keeps every shared range usable as a constant buffer too
+		const UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+		uint32_t page = 0;
+		UINT64 offset = TlsfAllocator::InvalidOffset;
+		for (; page < m_sharedPages.size(); page++)
+		{
+			offset = m_sharedPages[page].allocator.Allocate(size, alignment);
+			if (offset != TlsfAllocator::InvalidOffset) {
+				break;
+			}
+		}
+
+		if (offset == TlsfAllocator::InvalidOffset)
+		{
+			SharedPage newPage;
+			auto pageDesc = CD3DX12_RESOURCE_DESC::Buffer(m_sharedPageSize);
+			D3D12_RESOURCE_ALLOCATION_INFO info = m_device->GetResourceAllocationInfo(0, 1, &pageDesc);
+			if (!CreatePlaced(HeapCategory::Buffers, pageDesc, D3D12_RESOURCE_STATE_COMMON, info, newPage.buffer)) {
+				return false;
+			}
+			newPage.allocator.Reset(m_sharedPageSize);
+			offset = newPage.allocator.Allocate(size, alignment);
+			page = static_cast<uint32_t>(m_sharedPages.size());
+			m_sharedPages.push_back(std::move(newPage));
+		}
+
+		const GpuAllocation& pageBuffer = m_sharedPages[page].buffer;
+		allocation.resource = pageBuffer.resource;
+		allocation.offset = offset;
+		allocation.size = size;
+		allocation.gpuAddress = pageBuffer.gpuAddress + offset;
+		allocation.kind = GpuAllocationKind::Shared;
+		allocation.block = page;
+		allocation.blockOffset = offset;
+		return true;
+	}
+
+	auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+	D3D12_RESOURCE_ALLOCATION_INFO info = m_device->GetResourceAllocationInfo(0, 1, &bufferDesc);
+	bool created = info.SizeInBytes <= m_heapSize
+		? CreatePlaced(HeapCategory::Buffers, bufferDesc, D3D12_RESOURCE_STATE_COMMON, info, allocation)
+		: CreateCommitted(bufferDesc, D3D12_RESOURCE_STATE_COMMON, allocation);
+	if (created) {
+		allocation.gpuAddress = allocation.resource->GetGPUVirtualAddress();
+	}
+	return created;
+}
+
+bool GpuHeapAllocator::CreateTexture(const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState, GpuAllocation& allocation)
+{
+	// render targets and depth buffers would need a heap category of their own
+	assert(!(desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)));
+
+	allocation = GpuAllocation();
+	D3D12_RESOURCE_ALLOCATION_INFO info = m_device->GetResourceAllocationInfo(0, 1, &desc);
+	if (info.SizeInBytes > m_heapSize) {
+		return CreateCommitted(desc, initialState, allocation);
+	}
+	return CreatePlaced(HeapCategory::Textures, desc, initialState, info, allocation);
+}
+
+void GpuHeapAllocator::Release(GpuAllocation& allocation)
+{
+	if (allocation.kind == GpuAllocationKind::None) {
+		return;
+	}
+	m_releases->Retire([this, allocation]() mutable { Free(allocation); });
+	allocation = GpuAllocation();
+}
+
+void GpuHeapAllocator::Free(GpuAllocation& allocation)
+{
+	switch (allocation.kind)
+	{
+	case GpuAllocationKind::Committed:
+		m_committedResources--;
+		m_committedBytes -= allocation.size;
+		break;
+	case GpuAllocationKind::Placed:
+		m_heaps[allocation.block].allocator.Free(allocation.blockOffset);
+		break;
+	case GpuAllocationKind::Shared:
+		// the page itself stays placed for the next small buffers
+		m_sharedPages[allocation.block].allocator.Free(allocation.blockOffset);
+		break;
+	case GpuAllocationKind::None:
+		break;
+	}
+	allocation = GpuAllocation();
+}
+
+bool GpuHeapAllocator::AllocateInHeap(HeapCategory category, UINT64 size, UINT64 alignment, uint32_t& heap, UINT64& offset)
+{
+	for (heap = 0; heap < m_heaps.size(); heap++)
+	{
+		if (m_heaps[heap].category != category) {
+			continue;
+		}
+		offset = m_heaps[heap].allocator.Allocate(size, alignment);
+		if (offset != TlsfAllocator::InvalidOffset) {
+			return true;
+		}
+	}
+
+	// tier 1 hardware can't mix buffers and textures in one heap
+	CD3DX12_HEAP_DESC heapDesc(m_heapSize, D3D12_HEAP_TYPE_DEFAULT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+		category == HeapCategory::Buffers ? D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS : D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES);
+
+	Heap newHeap;
+	if (FAILED(m_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&newHeap.heap)))) {
+		return false;
+	}
+	newHeap.category = category;
+	newHeap.allocator.Reset(m_heapSize);
+	offset = newHeap.allocator.Allocate(size, alignment);
+	heap = static_cast<uint32_t>(m_heaps.size());
+	m_heaps.push_back(std::move(newHeap));
+	return offset != TlsfAllocator::InvalidOffset;
+}
+
+bool GpuHeapAllocator::CreatePlaced(HeapCategory category, const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState,
+	const D3D12_RESOURCE_ALLOCATION_INFO& info, GpuAllocation& allocation)
+{
+	uint32_t heap;
+	UINT64 offset;
+	if (!AllocateInHeap(category, info.SizeInBytes, info.Alignment, heap, offset)) {
+		return false;
+	}
+
+	if (FAILED(m_device->CreatePlacedResource(m_heaps[heap].heap.Get(), offset, &desc, initialState, nullptr,
+		IID_PPV_ARGS(&allocation.resource))))
+	{
+		m_heaps[heap].allocator.Free(offset);
+		return false;
+	}
+
+	allocation.offset = 0;
+	allocation.size = info.SizeInBytes;
+	allocation.kind = GpuAllocationKind::Placed;
+	allocation.block = heap;
+	allocation.blockOffset = offset;
+	if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER) {
+		allocation.gpuAddress = allocation.resource->GetGPUVirtualAddress();
+	}
+	return true;
+}
+
+bool GpuHeapAllocator::CreateCommitted(const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState, GpuAllocation& allocation)
+{
+	auto defaultHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	if (FAILED(m_device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &desc, initialState, nullptr,
+		IID_PPV_ARGS(&allocation.resource))))
+	{
+		return false;
+	}
+
+	allocation.offset = 0;
+	allocation.size = m_device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+	allocation.kind = GpuAllocationKind::Committed;
+	m_committedResources++;
+	m_committedBytes += allocation.size;
+	return true;
+}
+
+GpuHeapStats GpuHeapAllocator::GetStats() const
+{
+	GpuHeapStats stats;
+	UINT64 freeBytes = 0;
+	UINT64 largestFreeBlock = 0;
+	for (const Heap& heap : m_heaps)
+	{
+		TlsfStats heapStats = heap.allocator.GetStats();
+		stats.heaps++;
+		stats.heapBytes += heapStats.size;
+		stats.usedBytes += heapStats.usedBytes;
+		stats.placedResources += heapStats.allocations;
+		freeBytes += heapStats.freeBytes;
+		largestFreeBlock = std::max(largestFreeBlock, heapStats.largestFreeBlock);
+	}
+	for (const SharedPage& page : m_sharedPages)
+	{
+		TlsfStats pageStats = page.allocator.GetStats();
+		stats.sharedPages++;
+		stats.sharedBytes += pageStats.usedBytes;
+		stats.sharedBuffers += pageStats.allocations;
+	}
+	// pages are placed resources themselves, count the buffers in them instead
+	stats.placedResources -= stats.sharedPages;
+	stats.committedResources = m_committedResources;
+	stats.committedBytes = m_committedBytes;
+
+	// a resource has to fit in one heap, so the largest block anywhere is what matters
+	stats.fragmentation = freeBytes > 0 ? 1.0f - static_cast<float>(largestFreeBlock) / freeBytes : 0.0f;
+	return stats;
+}
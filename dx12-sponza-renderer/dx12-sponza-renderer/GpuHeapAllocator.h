@@ -0,0 +1,103 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <vector>
+#include "TlsfAllocator.h"
+#include "DeferredReleaseQueue.h"
+
+// where an allocation's memory came from, Free needs it to give it back
+enum class GpuAllocationKind : uint8_t
+{
+	None,
+	Committed, // too large for a heap, has its own
+	Placed,    // placed resource in one of the heaps
+	Shared     // range of a placed buffer shared with other small buffers
+};
+
+struct GpuAllocation
+{
+	Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+	UINT64 offset = 0; // into resource, only non zero for shared buffers
+	UINT64 size = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = 0; // buffers only, includes offset
+
+	GpuAllocationKind kind = GpuAllocationKind::None;
+	uint32_t block = 0; // heap or shared page index
+	UINT64 blockOffset = 0;
+};
+
+struct GpuHeapStats
+{
+	uint32_t heaps = 0;
+	UINT64 heapBytes = 0;
+	UINT64 usedBytes = 0;
+	uint32_t placedResources = 0;
+	uint32_t sharedPages = 0;
+	UINT64 sharedBytes = 0; // used inside the shared pages
+	uint32_t sharedBuffers = 0;
+	uint32_t committedResources = 0;
+	UINT64 committedBytes = 0;
+	float fragmentation = 0.0f; // of the heap free space, see TlsfStats
+};
+
+// reserves large ID3D12Heaps in the default heap type and sub-allocates placed
+// resources from them with a TlsfAllocator each. buffers and textures get
+// separate heaps so it also runs on resource heap tier 1. placed resources
+// are still 64KB aligned, so buffers below sharedBufferLimit are packed into
+// shared placed buffers instead and get an offset into them.
+// resources start in COMMON for the copy queue. Release frees through the
+// DeferredReleaseQueue once the gpu is done, Free right away.
+class GpuHeapAllocator
+{
+public:
+	// releases has to outlive the allocator
+	bool Initialize(ID3D12Device* device, DeferredReleaseQueue* releases,
+		UINT64 heapSize = 64 * 1024 * 1024, UINT64 sharedPageSize = 4 * 1024 * 1024);
+
+	bool CreateBuffer(UINT64 size, GpuAllocation& allocation);
+	bool CreateTexture(const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState, GpuAllocation& allocation);
+	// frees once the release queue's pending fence value has completed
+	void Release(GpuAllocation& allocation);
+	// the gpu has to be done with the allocation
+	void Free(GpuAllocation& allocation);
+
+	GpuHeapStats GetStats() const;
+
+	UINT64 sharedBufferLimit = 256 * 1024;
+
+private:
+	enum class HeapCategory : uint8_t { Buffers, Textures };
+
+	struct Heap
+	{
+		Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+		HeapCategory category;
+		TlsfAllocator allocator;
+	};
+
+	struct SharedPage
+	{
+		GpuAllocation buffer; // placed in a buffer heap
+		TlsfAllocator allocator;
+	};
+
+	// finds room in a heap of the category, reserving a new heap if none has it
+	bool AllocateInHeap(HeapCategory category, UINT64 size, UINT64 alignment, uint32_t& heap, UINT64& offset);
+	bool CreatePlaced(HeapCategory category, const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState,
+		const D3D12_RESOURCE_ALLOCATION_INFO& info, GpuAllocation& allocation);
+	bool CreateCommitted(const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initialState, GpuAllocation& allocation);
+
+	Microsoft::WRL::ComPtr<ID3D12Device> m_device;
+	DeferredReleaseQueue* m_releases = nullptr;
+	UINT64 m_heapSize = 0;
+	UINT64 m_sharedPageSize = 0;
+
+	// heaps are kept once reserved, their allocator holds the address space
+	std::vector<Heap> m_heaps;
+	std::vector<SharedPage> m_sharedPages;
+
+	uint32_t m_committedResources = 0;
+	UINT64 m_committedBytes = 0;
+};
@@ -0,0 +1,107 @@
+#include "GpuProfileTree.h"
+#include <algorithm>
+
+namespace
+{
+	// weight of the newest sample in the moving averages
+	const double AverageWeight = 0.05;
+}
+
+double GpuClockCalibration::ToCpuMilliseconds(uint64_t gpuTicks) const
+{
+	// signed, timestamps from before the calibration are fine
+	double gpuMs = static_cast<int64_t>(gpuTicks - gpuTimestamp) * 1000.0 / gpuFrequency;
+	return cpuTimestamp * 1000.0 / cpuFrequency + gpuMs;
+}
+
+void GpuProfileTree::AddFrame(uint64_t frame, const std::vector<GpuScopeRecord>& records, const uint64_t* timestamps,
+	const GpuClockCalibration& calibration, double recordEndMs)
+{
+	GpuFrameProfile& profile = m_latest;
+	profile.frame = frame;
+	profile.scopes.resize(records.size());
+	m_paths.resize(records.size());
+
+	// ticks are taken relative to the first timestamp and read signed like
+	// ToCpuMilliseconds does, so a counter wrapping around mid frame still
+	// orders and measures the scopes right
+	const uint64_t base = records.empty() ? 0 : timestamps[0];
+	int64_t frameBegin = INT64_MAX;
+	int64_t frameEnd = INT64_MIN;
+	for (uint32_t i = 0; i < records.size(); i++)
+	{
+		int64_t begin = static_cast<int64_t>(timestamps[2 * i] - base);
+		int64_t end = static_cast<int64_t>(timestamps[2 * i + 1] - base);
+		GpuScopeNode& node = profile.scopes[i];
+		node = GpuScopeNode();
+		node.name = records[i].name;
+		node.valid = end >= begin;
+		node.durationMs = node.valid ? (end - begin) * 1000.0 / calibration.gpuFrequency : 0.0;
+		node.selfMs = node.durationMs;
+
+		// a parent always began before its children, anything else is a root
+		uint32_t parent = records[i].parent;
+		if (parent < i) {
+			node.parent = parent;
+			node.depth = profile.scopes[parent].depth + 1;
+			m_paths[i] = m_paths[parent] + "/" + node.name;
+		}
+		else {
+			m_paths[i] = node.name;
+		}
+		if (node.valid) {
+			frameBegin = std::min(frameBegin, begin);
+			frameEnd = std::max(frameEnd, end);
+		}
+	}
+	if (frameBegin > frameEnd) {
+		profile.gpuStartMs = 0.0;
+		profile.durationMs = 0.0;
+		profile.queueLatencyMs = 0.0;
+		return; // nothing usable, keep the averages as they are
+	}
+
+	profile.gpuStartMs = calibration.ToCpuMilliseconds(base + static_cast<uint64_t>(frameBegin));
+	profile.durationMs = (frameEnd - frameBegin) * 1000.0 / calibration.gpuFrequency;
+	profile.queueLatencyMs = profile.gpuStartMs - recordEndMs;
+
+	m_frameTotals.clear();
+	for (uint32_t i = 0; i < records.size(); i++)
+	{
+		GpuScopeNode& node = profile.scopes[i];
+		if (!node.valid) {
+			continue;
+		}
+		node.startMs = (static_cast<int64_t>(timestamps[2 * i] - base) - frameBegin) * 1000.0 / calibration.gpuFrequency;
+		if (node.parent != GpuScopeRecord::NoParent) {
+			GpuScopeNode& parent = profile.scopes[node.parent];
+			parent.selfMs = std::max(0.0, parent.selfMs - node.durationMs);
+		}
+		// siblings sharing a name, like a scope per draw, are one sample per frame
+		m_frameTotals[m_paths[i]] += node.durationMs;
+	}
+
+	// scopes that only show up some frames start from their first sample
+	for (const auto& [path, total] : m_frameTotals)
+	{
+		auto average = m_averages.emplace(path, total);
+		if (!average.second) {
+			average.first->second += (total - average.first->second) * AverageWeight;
+		}
+	}
+	for (uint32_t i = 0; i < records.size(); i++)
+	{
+		auto average = m_averages.find(m_paths[i]);
+		profile.scopes[i].averageMs = average != m_averages.end() ? average->second : 0.0;
+	}
+
+	if (!m_hasFrames) {
+		m_averageFrameMs = profile.durationMs;
+		m_averageQueueLatencyMs = profile.queueLatencyMs;
+		m_hasFrames = true;
+	}
+	else {
+		m_averageFrameMs += (profile.durationMs - m_averageFrameMs) * AverageWeight;
+		m_averageQueueLatencyMs += (profile.queueLatencyMs - m_averageQueueLatencyMs) * AverageWeight;
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+// gpu and cpu clocks sampled at the same moment (GetClockCalibration), maps
+// gpu timestamps onto the QueryPerformanceCounter timeline
+struct GpuClockCalibration
+{
+	uint64_t gpuFrequency = 1;
+	uint64_t gpuTimestamp = 0;
+	uint64_t cpuFrequency = 1;
+	uint64_t cpuTimestamp = 0;
+
+	// milliseconds on the same timeline as QueryPerformanceCounter * 1000 / frequency
+	double ToCpuMilliseconds(uint64_t gpuTicks) const;
+};
+
+// a scope as recorded, its timestamps are timestamps[2 * index] and [2 * index + 1]
+struct GpuScopeRecord
+{
+	const char* name; // has to outlive the profiler, string literals
+	uint32_t parent; // index of the enclosing scope, NoParent for roots
+	static const uint32_t NoParent = UINT32_MAX;
+};
+
+struct GpuScopeNode
+{
+	const char* name = nullptr;
+	uint32_t depth = 0;
+	uint32_t parent = GpuScopeRecord::NoParent;
+	double startMs = 0.0; // from the frame's first timestamp
+	double durationMs = 0.0;
+	double selfMs = 0.0; // not covered by children
+	double averageMs = 0.0; // moving average per frame of the scopes with the same path, siblings summed
+	bool valid = true; // false when the gpu reported an end before the begin
+};
+
+// one frame's scopes, depth first so a scope's subtree directly follows it
+struct GpuFrameProfile
+{
+	uint64_t frame = 0;
+	double gpuStartMs = 0.0; // first timestamp on the cpu timeline
+	double durationMs = 0.0; // first to last timestamp
+	double queueLatencyMs = 0.0; // cpu finished recording to gpu start
+	std::vector<GpuScopeNode> scopes;
+};
+
+// turns resolved timestamps into a scope tree and keeps moving averages per
+// scope path. knows nothing about the device, GpuProfiler feeds it
+class GpuProfileTree
+{
+public:
+	// scopes in the order they began, parents before their children.
+	// recordEndMs is when the cpu closed the frame's command list, on the
+	// same timeline as the calibration
+	void AddFrame(uint64_t frame, const std::vector<GpuScopeRecord>& records, const uint64_t* timestamps,
+		const GpuClockCalibration& calibration, double recordEndMs);
+
+	// empty until the first frame is added
+	const GpuFrameProfile& GetLatestFrame() const { return m_latest; }
+	double GetAverageFrameMs() const { return m_averageFrameMs; }
+	double GetAverageQueueLatencyMs() const { return m_averageQueueLatencyMs; }
+
+private:
+	GpuFrameProfile m_latest;
+	std::vector<std::string> m_paths; // scratch, per record
+	std::unordered_map<std::string, double> m_frameTotals; // scratch, this frame's time per path
+	std::unordered_map<std::string, double> m_averages; // by "parent/child" path
+	double m_averageFrameMs = 0.0;
+	double m_averageQueueLatencyMs = 0.0;
+	bool m_hasFrames = false;
+};
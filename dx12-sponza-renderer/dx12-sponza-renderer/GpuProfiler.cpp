@@ -0,0 +1,168 @@
+#include "GpuProfiler.h"
+#include "d3dx12.h"
+
+namespace
+{
+	// the clocks drift apart slowly, recalibrating every couple of seconds is plenty
+	const uint64_t CalibrationInterval = 120;
+
+	double CpuMilliseconds()
+	{
+		LARGE_INTEGER frequency, counter;
+		QueryPerformanceFrequency(&frequency);
+		QueryPerformanceCounter(&counter);
+		return counter.QuadPart * 1000.0 / frequency.QuadPart;
+	}
+}
+
+bool GpuProfiler::Initialize(ID3D12Device* device, ID3D12CommandQueue* queue, uint32_t frameSlots, uint32_t maxScopesPerFrame)
+{
+	Shutdown();
+	m_queue = queue;
+	m_maxScopes = maxScopesPerFrame;
+	m_slots.assign(frameSlots, FrameSlot());
+	for (FrameSlot& slot : m_slots) {
+		slot.records.reserve(m_maxScopes);
+	}
+	m_openScopes.reserve(m_maxScopes);
+
+	UINT queryCount = frameSlots * m_maxScopes * 2;
+	D3D12_QUERY_HEAP_DESC heapDesc = {};
+	heapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	heapDesc.Count = queryCount;
+	if (FAILED(device->CreateQueryHeap(&heapDesc, IID_PPV_ARGS(&m_queryHeap)))) {
+		Shutdown();
+		return false;
+	}
+
+	auto heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+	auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(queryCount * sizeof(uint64_t));
+	HRESULT hr = device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_readback));
+	void* data = nullptr;
+	D3D12_RANGE readRange = { 0, queryCount * sizeof(uint64_t) };
+	if (FAILED(hr) || FAILED(m_readback->Map(0, &readRange, &data))) {
+		Shutdown();
+		return false;
+	}
+	m_readbackData = static_cast<const uint64_t*>(data);
+
+	Calibrate();
+	return true;
+}
+
+void GpuProfiler::Shutdown()
+{
+	if (m_readbackData) {
+		D3D12_RANGE writeRange = { 0, 0 };
+		m_readback->Unmap(0, &writeRange);
+		m_readbackData = nullptr;
+	}
+	m_readback.Reset();
+	m_queryHeap.Reset();
+	m_queue.Reset();
+	m_slots.clear();
+	m_openScopes.clear();
+}
+
+void GpuProfiler::Calibrate()
+{
+	UINT64 gpuFrequency = 0;
+	UINT64 gpuTimestamp = 0;
+	UINT64 cpuTimestamp = 0;
+	if (FAILED(m_queue->GetTimestampFrequency(&gpuFrequency)) || gpuFrequency == 0 ||
+		FAILED(m_queue->GetClockCalibration(&gpuTimestamp, &cpuTimestamp))) {
+		return; // keep the previous calibration
+	}
+	LARGE_INTEGER cpuFrequency;
+	QueryPerformanceFrequency(&cpuFrequency);
+
+	m_calibration.gpuFrequency = gpuFrequency;
+	m_calibration.gpuTimestamp = gpuTimestamp;
+	m_calibration.cpuFrequency = cpuFrequency.QuadPart;
+	m_calibration.cpuTimestamp = cpuTimestamp;
+	m_calibratedFrame = m_frame;
+}
+
+void GpuProfiler::BeginFrame(uint32_t slot)
+{
+	if (!IsEnabled()) {
+		return;
+	}
+	m_slot = slot;
+	FrameSlot& frame = m_slots[m_slot];
+
+	// the frame that used this slot last is done. a slot left behind when
+	// fewer frames are in flight holds an older frame than the tree has seen
+	const GpuFrameProfile& latest = m_tree.GetLatestFrame();
+	if (frame.pending && (latest.scopes.empty() || frame.frame > latest.frame))
+	{
+		const uint64_t* timestamps = m_readbackData + m_slot * m_maxScopes * 2;
+		m_tree.AddFrame(frame.frame, frame.records, timestamps, m_calibration, frame.recordEndMs);
+	}
+	frame.pending = false;
+	frame.records.clear();
+	frame.frame = m_frame;
+	m_openScopes.clear();
+
+	if (m_frame - m_calibratedFrame >= CalibrationInterval) {
+		Calibrate();
+	}
+}
+
+void GpuProfiler::EndFrame(ID3D12GraphicsCommandList* commandList)
+{
+	if (!IsEnabled()) {
+		return;
+	}
+	while (!m_openScopes.empty()) {
+		EndScope(commandList);
+	}
+
+	FrameSlot& frame = m_slots[m_slot];
+	if (!frame.records.empty())
+	{
+		UINT firstQuery = m_slot * m_maxScopes * 2;
+		UINT queryCount = static_cast<UINT>(frame.records.size()) * 2;
+		commandList->ResolveQueryData(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, firstQuery, queryCount,
+			m_readback.Get(), firstQuery * sizeof(uint64_t));
+		frame.pending = true;
+	}
+	frame.recordEndMs = CpuMilliseconds();
+	m_frame++;
+}
+
+uint32_t GpuProfiler::BeginScope(ID3D12GraphicsCommandList* commandList, const char* name)
+{
+	if (!IsEnabled()) {
+		return InvalidScope;
+	}
+	FrameSlot& frame = m_slots[m_slot];
+	uint32_t scope = InvalidScope;
+	if (frame.records.size() < m_maxScopes)
+	{
+		// once a frame is out of queries every later scope is too, so an open
+		// scope here always has a record
+		scope = static_cast<uint32_t>(frame.records.size());
+		GpuScopeRecord record = { name, GpuScopeRecord::NoParent };
+		if (!m_openScopes.empty()) {
+			record.parent = m_openScopes.back();
+		}
+		frame.records.push_back(record);
+		commandList->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, m_slot * m_maxScopes * 2 + scope * 2);
+	}
+	m_openScopes.push_back(scope);
+	return scope;
+}
+
+void GpuProfiler::EndScope(ID3D12GraphicsCommandList* commandList)
+{
+	if (m_openScopes.empty()) {
+		return;
+	}
+	uint32_t scope = m_openScopes.back();
+	m_openScopes.pop_back();
+	if (scope != InvalidScope) {
+		commandList->EndQuery(m_queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, m_slot * m_maxScopes * 2 + scope * 2 + 1);
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <vector>
+#include "GpuProfileTree.h"
+
+// gpu time of command list regions from timestamp queries. every frame in
+// flight has its own range of the query heap and of a readback buffer the
+// queries are resolved into at the end of the frame. a slot is read back
+// when its frame context comes around again, after the fence wait that
+// frees the context, so reading never stalls the gpu.
+//
+//     g_gpuProfiler.BeginFrame(frameContext);
+//     {
+//         GpuProfileScope scope(g_gpuProfiler, commandList, "meshes");
+//         ...
+//     }
+//     g_gpuProfiler.EndFrame(commandList);
+class GpuProfiler
+{
+public:
+	static const uint32_t InvalidScope = UINT32_MAX;
+
+	bool Initialize(ID3D12Device* device, ID3D12CommandQueue* queue, uint32_t frameSlots, uint32_t maxScopesPerFrame = 64);
+	void Shutdown();
+
+	// slot is the frame context being recorded, its previous frame has to be done on the gpu
+	void BeginFrame(uint32_t slot);
+	// closes open scopes and resolves the frame's queries, before the command list is closed
+	void EndFrame(ID3D12GraphicsCommandList* commandList);
+
+	// scopes nest, the name has to outlive the profiler. returns InvalidScope
+	// once the frame is out of queries, EndScope accepts it
+	uint32_t BeginScope(ID3D12GraphicsCommandList* commandList, const char* name);
+	void EndScope(ID3D12GraphicsCommandList* commandList);
+
+	const GpuProfileTree& GetTree() const { return m_tree; }
+	bool IsEnabled() const { return m_queryHeap != nullptr; }
+
+private:
+	struct FrameSlot
+	{
+		std::vector<GpuScopeRecord> records;
+		uint64_t frame = 0;
+		double recordEndMs = 0.0;
+		bool pending = false; // resolved, not read back yet
+	};
+
+	void Calibrate();
+
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_queue;
+	Microsoft::WRL::ComPtr<ID3D12QueryHeap> m_queryHeap;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_readback;
+	const uint64_t* m_readbackData = nullptr; // mapped for the profiler's lifetime
+
+	std::vector<FrameSlot> m_slots;
+	uint32_t m_maxScopes = 0;
+	uint32_t m_slot = 0; // being recorded
+	std::vector<uint32_t> m_openScopes; // stack of scopes begun and not ended
+	uint64_t m_frame = 0;
+
+	GpuClockCalibration m_calibration;
+	uint64_t m_calibratedFrame = 0;
+	GpuProfileTree m_tree;
+};
+
+// times the scope's lifetime
+class GpuProfileScope
+{
+public:
+	GpuProfileScope(GpuProfiler& profiler, ID3D12GraphicsCommandList* commandList, const char* name)
+		: m_profiler(profiler), m_commandList(commandList)
+	{
+		m_profiler.BeginScope(m_commandList, name);
+	}
+	~GpuProfileScope() { m_profiler.EndScope(m_commandList); }
+
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+	GpuProfiler& m_profiler;
+	ID3D12GraphicsCommandList* m_commandList;
+};
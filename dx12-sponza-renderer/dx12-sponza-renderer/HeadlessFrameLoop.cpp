@@ -0,0 +1,441 @@
+#include "HeadlessFrameLoop.h"
+#include "JobSystem.h"
+#include "SceneConstants.h"
+#include <DirectXMath.h>
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	float MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+	}
+
+	// matrices and light of a frame slot, each constant buffer view 256 byte aligned
+	const uint64_t ConstantsStride = 512;
+	const uint64_t LightConstantsOffset = 256;
+
+	const uint32_t PlaceholderSize = 4;
+	const float ClearColor[4] = { 0.0f, 0.2f, 0.4f, 1.0f };
+}
+
+HeadlessFrameLoop::~HeadlessFrameLoop()
+{
+	Shutdown();
+}
+
+bool HeadlessFrameLoop::Initialize(RenderDevice* device, JobSystem* jobs, const HeadlessFrameLoopDesc& desc,
+	const std::vector<Mesh>& meshes, const std::vector<Material>& materials, std::string& error)
+{
+	Shutdown();
+	m_device = device;
+	m_desc = desc;
+	m_desc.framesInFlight = std::max(1u, desc.framesInFlight);
+	uint32_t maxChunks = jobs ? jobs->GetWorkerCount() : 1;
+	if (!m_drawBackend.Initialize(device, m_desc.framesInFlight, maxChunks)) {
+		error = "failed to create the chunk command lists";
+		return false;
+	}
+	m_recorder.Initialize(&m_drawBackend, jobs);
+
+	RenderPipelineDesc pipelineDesc;
+	pipelineDesc.vertexShader = desc.vertexShader;
+	pipelineDesc.pixelShader = desc.pixelShader;
+	pipelineDesc.name = "headless opaque";
+	m_pipelines[0] = device->CreatePipeline(pipelineDesc);
+	pipelineDesc.pixelShader = desc.maskedPixelShader;
+	pipelineDesc.name = "headless masked";
+	m_pipelines[1] = device->CreatePipeline(pipelineDesc);
+
+	// the target starts and ends every frame in common, like a presented back buffer
+	RenderTextureDesc targetDesc;
+	targetDesc.width = desc.width;
+	targetDesc.height = desc.height;
+	targetDesc.usage = RenderTextureRenderTarget;
+	targetDesc.initialState = RenderStateCommon;
+	std::copy(ClearColor, ClearColor + 4, targetDesc.clearColor);
+	targetDesc.name = "headless target";
+	m_renderTarget = device->CreateTexture(targetDesc);
+	m_renderTargetView = device->CreateRenderTargetView(m_renderTarget);
+
+	RenderTextureDesc depthDesc;
+	depthDesc.width = desc.width;
+	depthDesc.height = desc.height;
+	depthDesc.format = RenderFormatD32;
+	depthDesc.usage = RenderTextureDepthStencil;
+	depthDesc.initialState = RenderStateDepthWrite;
+	depthDesc.name = "headless depth";
+	m_depth = device->CreateTexture(depthDesc);
+	m_depthView = device->CreateDepthStencilView(m_depth);
+
+	RenderBufferDesc constantsDesc;
+	constantsDesc.size = ConstantsStride * m_desc.framesInFlight;
+	constantsDesc.memory = RenderMemoryUpload;
+	constantsDesc.usage = RenderBufferConstant;
+	constantsDesc.name = "headless constants";
+	m_constants = device->CreateBuffer(constantsDesc);
+
+	m_commandList = device->CreateCommandList(m_desc.framesInFlight);
+	m_postCommandList = device->CreateCommandList(m_desc.framesInFlight);
+	if (m_pipelines[0] == InvalidRenderHandle || m_pipelines[1] == InvalidRenderHandle ||
+		m_renderTargetView == InvalidRenderHandle || m_depthView == InvalidRenderHandle ||
+		m_constants == InvalidRenderHandle || m_commandList == InvalidRenderHandle || m_postCommandList == InvalidRenderHandle) {
+		error = "failed to create the frame's pipelines, targets or lists";
+		return false;
+	}
+
+	// opaque draws first, the masked pipeline only switches once
+	std::vector<uint32_t> order(meshes.size());
+	for (uint32_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	auto masked = [&](uint32_t mesh) {
+		int material = meshes[mesh].materialIndex;
+		return material >= 0 && material < int(materials.size()) && !materials[material].alphaTexture.empty();
+	};
+	std::stable_partition(order.begin(), order.end(), [&](uint32_t mesh) { return !masked(mesh); });
+
+	XMFLOAT3 boundsMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+	XMFLOAT3 boundsMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	uint32_t firstIndex = 0;
+	int32_t baseVertex = 0;
+	std::vector<uint32_t> meshFirstIndex(meshes.size());
+	std::vector<int32_t> meshBaseVertex(meshes.size());
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		meshFirstIndex[i] = firstIndex;
+		meshBaseVertex[i] = baseVertex;
+		firstIndex += static_cast<uint32_t>(meshes[i].indices.size());
+		baseVertex += static_cast<int32_t>(meshes[i].vertices.size());
+		boundsMin = { std::min(boundsMin.x, meshes[i].boundsMin.x), std::min(boundsMin.y, meshes[i].boundsMin.y), std::min(boundsMin.z, meshes[i].boundsMin.z) };
+		boundsMax = { std::max(boundsMax.x, meshes[i].boundsMax.x), std::max(boundsMax.y, meshes[i].boundsMax.y), std::max(boundsMax.z, meshes[i].boundsMax.z) };
+	}
+	for (uint32_t mesh : order)
+	{
+		if (meshes[mesh].indices.empty()) {
+			continue;
+		}
+		int material = meshes[mesh].materialIndex;
+		SceneDraw draw;
+		draw.pipeline = masked(mesh) ? 1 : 0;
+		draw.material = material >= 0 && material < int(materials.size()) ? material : 0;
+		draw.indexCount = static_cast<uint32_t>(meshes[mesh].indices.size());
+		draw.firstIndex = meshFirstIndex[mesh];
+		draw.baseVertex = meshBaseVertex[mesh];
+		m_sceneDraws.push_back(draw);
+	}
+	if (m_sceneDraws.empty()) {
+		error = "the scene has nothing to draw";
+		return false;
+	}
+	m_center = { (boundsMin.x + boundsMax.x) * 0.5f, (boundsMin.y + boundsMax.y) * 0.5f, (boundsMin.z + boundsMax.z) * 0.5f };
+	float dx = boundsMax.x - boundsMin.x;
+	float dy = boundsMax.y - boundsMin.y;
+	float dz = boundsMax.z - boundsMin.z;
+	m_radius = std::max(1.0f, 0.5f * std::sqrt(dx * dx + dy * dy + dz * dz));
+
+	if (!Upload(meshes, std::max<size_t>(1, materials.size()), error)) {
+		return false;
+	}
+
+	DeviceDrawState& state = m_drawState;
+	state.pipelines = m_pipelines;
+	state.pipelineCount = 2;
+	state.matrixConstants = m_constants;
+	state.lightConstants = m_constants;
+	state.renderTarget = m_renderTargetView;
+	state.depthStencil = m_depthView;
+	state.width = desc.width;
+	state.height = desc.height;
+	state.vertexBuffer = m_vertexBuffer;
+	state.vertexStride = sizeof(Vertex);
+	state.indexBuffer = m_indexBuffer;
+	state.indexFormat = RenderFormatR32Uint;
+
+	m_slotFenceValues.assign(m_desc.framesInFlight, 0);
+	m_frame = 0;
+	return true;
+}
+
+bool HeadlessFrameLoop::Upload(const std::vector<Mesh>& meshes, size_t materialCount, std::string& error)
+{
+	uint64_t vertexBytes = 0;
+	uint64_t indexBytes = 0;
+	for (const Mesh& mesh : meshes)
+	{
+		vertexBytes += mesh.vertices.size() * sizeof(Vertex);
+		indexBytes += mesh.indices.size() * sizeof(uint32_t);
+	}
+	RenderTextureDesc textureDesc;
+	textureDesc.width = PlaceholderSize;
+	textureDesc.height = PlaceholderSize;
+	uint64_t textureBytes = uint64_t(GetTextureRowPitch(PlaceholderSize, RenderFormatRGBA8)) * PlaceholderSize;
+	uint64_t textureStride = (textureBytes + 511) & ~511ull;
+	uint64_t textureOffset = (vertexBytes + indexBytes + 511) & ~511ull;
+
+	RenderBufferDesc bufferDesc;
+	bufferDesc.size = vertexBytes;
+	bufferDesc.usage = RenderBufferVertex;
+	bufferDesc.name = "headless vertices";
+	m_vertexBuffer = m_device->CreateBuffer(bufferDesc);
+	bufferDesc.size = indexBytes;
+	bufferDesc.usage = RenderBufferIndex;
+	bufferDesc.name = "headless indices";
+	m_indexBuffer = m_device->CreateBuffer(bufferDesc);
+
+	RenderBufferDesc stagingDesc;
+	stagingDesc.size = textureOffset + textureStride * materialCount;
+	stagingDesc.memory = RenderMemoryUpload;
+	stagingDesc.usage = RenderBufferCopySource;
+	stagingDesc.name = "headless staging";
+	RenderHandle staging = m_device->CreateBuffer(stagingDesc);
+	RenderHandle commandList = m_device->CreateCommandList(1);
+	uint8_t* mapped = m_device->GetMappedData(staging);
+	if (m_vertexBuffer == InvalidRenderHandle || m_indexBuffer == InvalidRenderHandle || !mapped ||
+		commandList == InvalidRenderHandle) {
+		m_device->Destroy(staging);
+		m_device->Destroy(commandList);
+		error = "failed to create the scene's buffers";
+		return false;
+	}
+
+	uint64_t offset = 0;
+	for (const Mesh& mesh : meshes)
+	{
+		std::memcpy(mapped + offset, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+		offset += mesh.vertices.size() * sizeof(Vertex);
+	}
+	for (const Mesh& mesh : meshes)
+	{
+		std::memcpy(mapped + offset, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+		offset += mesh.indices.size() * sizeof(uint32_t);
+	}
+
+	m_device->Begin(commandList, 0);
+	m_device->CopyBuffer(commandList, m_vertexBuffer, 0, staging, 0, vertexBytes);
+	m_device->CopyBuffer(commandList, m_indexBuffer, 0, staging, vertexBytes, indexBytes);
+	m_device->Barrier(commandList, m_vertexBuffer, RenderStateCopyDest, RenderStateVertexAndConstantBuffer);
+	m_device->Barrier(commandList, m_indexBuffer, RenderStateCopyDest, RenderStateIndexBuffer);
+
+	// a flat colour per material, they only have to be sampled
+	bool texturesCreated = true;
+	for (size_t i = 0; i < materialCount && texturesCreated; i++)
+	{
+		RenderHandle texture = m_device->CreateTexture(textureDesc);
+		RenderHandle view = m_device->CreateShaderResourceView(texture);
+		if (view == InvalidRenderHandle) {
+			m_device->Destroy(texture);
+			texturesCreated = false;
+			break;
+		}
+		m_textures.push_back(texture);
+		m_tables.push_back(m_device->GetDescriptorTable(view));
+
+		uint64_t source = textureOffset + textureStride * i;
+		uint32_t colour = 0xff000000u | static_cast<uint32_t>(i * 0x9e3779b1u & 0xffffffu);
+		for (uint32_t y = 0; y < PlaceholderSize; y++) {
+			for (uint32_t x = 0; x < PlaceholderSize; x++) {
+				std::memcpy(mapped + source + y * GetTextureRowPitch(PlaceholderSize, RenderFormatRGBA8) + x * 4, &colour, 4);
+			}
+		}
+		m_device->CopyBufferToTexture(commandList, texture, 0, staging, source);
+		m_device->Barrier(commandList, texture, RenderStateCopyDest, RenderStatePixelShaderResource);
+	}
+	m_device->Close(commandList);
+	m_device->Submit(&commandList, 1);
+	m_device->WaitForFenceValue(m_device->Signal());
+	m_device->Destroy(commandList);
+	m_device->Destroy(staging);
+	if (!texturesCreated) {
+		error = "failed to create the material textures";
+	}
+	return texturesCreated;
+}
+
+void HeadlessFrameLoop::Shutdown()
+{
+	if (!m_device) {
+		return;
+	}
+	WaitIdle();
+	m_recorder.Shutdown();
+	m_drawBackend.Shutdown();
+	RenderHandle handles[] = { m_pipelines[0], m_pipelines[1], m_vertexBuffer, m_indexBuffer, m_constants,
+		m_renderTarget, m_depth, m_commandList, m_postCommandList };
+	for (RenderHandle handle : handles) {
+		if (handle != InvalidRenderHandle) {
+			m_device->Destroy(handle);
+		}
+	}
+	for (RenderHandle texture : m_textures) {
+		m_device->Destroy(texture);
+	}
+	m_pipelines[0] = m_pipelines[1] = InvalidRenderHandle;
+	m_vertexBuffer = m_indexBuffer = m_constants = InvalidRenderHandle;
+	m_renderTarget = m_renderTargetView = m_depth = m_depthView = InvalidRenderHandle;
+	m_commandList = m_postCommandList = InvalidRenderHandle;
+	m_textures.clear();
+	m_tables.clear();
+	m_sceneDraws.clear();
+	m_slotFenceValues.clear();
+	m_device = nullptr;
+}
+
+void HeadlessFrameLoop::WaitIdle()
+{
+	for (uint64_t fenceValue : m_slotFenceValues) {
+		m_device->WaitForFenceValue(fenceValue);
+	}
+}
+
+void HeadlessFrameLoop::WriteConstants(uint32_t slot)
+{
+	// one turn around the scene every 600 frames, so draws move on screen
+	float angle = static_cast<float>(m_frame % 600) / 600.0f * XM_2PI;
+	XMFLOAT3 eye = { m_center.x + std::cos(angle) * m_radius, m_center.y + m_radius * 0.25f, m_center.z + std::sin(angle) * m_radius };
+	XMFLOAT3 up = { 0.0f, 1.0f, 0.0f };
+	XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&eye), XMLoadFloat3(&m_center), XMLoadFloat3(&up));
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4,
+		static_cast<float>(m_desc.width) / static_cast<float>(m_desc.height), 0.1f, m_radius * 4.0f);
+
+	MatrixBuffer matrices = {};
+	XMStoreFloat4x4(&matrices.world, XMMatrixIdentity()); // symmetric, no transpose needed
+	XMStoreFloat4x4(&matrices.view, XMMatrixTranspose(view));
+	XMStoreFloat4x4(&matrices.projection, XMMatrixTranspose(projection));
+
+	LightBuffer light = {};
+	light.lightDirection = XMFLOAT3(0.0f, -0.7071f, -0.7071f);
+	light.lightColor = XMFLOAT3(1.0f, 1.0f, 1.0f);
+	light.lightIntensity = 1.0f;
+	light.ambientIntensity = 0.1f;
+	light.cameraPosition = eye;
+	light.specularPower = 32.0f;
+	light.specularIntensity = 1.0f;
+
+	uint8_t* constants = m_device->GetMappedData(m_constants) + ConstantsStride * slot;
+	std::memcpy(constants, &matrices, sizeof(matrices));
+	std::memcpy(constants + LightConstantsOffset, &light, sizeof(light));
+}
+
+FrameSample HeadlessFrameLoop::RunFrame()
+{
+	Clock::time_point frameStart = Clock::now();
+	FrameSample sample;
+	sample.frame = m_frame;
+	uint32_t slot = static_cast<uint32_t>(m_frame % m_desc.framesInFlight);
+
+	// the slot's constants and allocators are free once its last frame is done
+	m_device->WaitForFenceValue(m_slotFenceValues[slot]);
+	sample.ms[FramePhasePresentWait] = MillisecondsSince(frameStart);
+
+	Clock::time_point start = Clock::now();
+	WriteConstants(slot);
+	m_drawItems.resize(m_sceneDraws.size());
+	for (size_t i = 0; i < m_sceneDraws.size(); i++)
+	{
+		const SceneDraw& draw = m_sceneDraws[i];
+		MaterialConstants material = { XMFLOAT2(1.0f, 1.0f), XMFLOAT2(0.0f, 0.0f), 0.0f };
+		DrawItem& item = m_drawItems[i];
+		item.pipeline = draw.pipeline;
+		item.descriptorTable = m_tables[draw.material];
+		item.constantCount = sizeof(MaterialConstants) / 4;
+		std::memcpy(item.constants, &material, sizeof(material));
+		item.indexCount = draw.indexCount;
+		item.firstIndex = draw.firstIndex;
+		item.baseVertex = draw.baseVertex;
+	}
+	sample.ms[FramePhaseUpdate] = MillisecondsSince(start);
+
+	start = Clock::now();
+	m_device->Begin(m_commandList, slot);
+	m_device->Barrier(m_commandList, m_renderTarget, RenderStateCommon, RenderStateRenderTarget);
+	m_device->ClearRenderTarget(m_commandList, m_renderTargetView, ClearColor);
+	m_device->ClearDepth(m_commandList, m_depthView, 1.0f);
+	m_device->Close(m_commandList);
+
+	m_drawState.matrixConstantsOffset = ConstantsStride * slot;
+	m_drawState.lightConstantsOffset = ConstantsStride * slot + LightConstantsOffset;
+	m_drawBackend.SetState(m_drawState);
+	m_recorder.parallel = parallelRecording;
+	m_recorder.Record(slot, m_drawItems);
+
+	m_device->Begin(m_postCommandList, slot);
+	m_device->Barrier(m_postCommandList, m_renderTarget, RenderStateRenderTarget, RenderStateCommon);
+	m_device->Close(m_postCommandList);
+	sample.ms[FramePhaseRecord] = MillisecondsSince(start);
+
+	start = Clock::now();
+	m_frameCommandLists.clear();
+	m_frameCommandLists.push_back(m_commandList);
+	m_drawBackend.AppendCommandLists(m_frameCommandLists);
+	m_frameCommandLists.push_back(m_postCommandList);
+	m_device->Submit(m_frameCommandLists.data(), static_cast<uint32_t>(m_frameCommandLists.size()));
+	m_slotFenceValues[slot] = m_device->Signal();
+	sample.ms[FramePhaseSubmit] = MillisecondsSince(start);
+
+	sample.ms[FramePhaseFrame] = MillisecondsSince(frameStart);
+	m_frame++;
+	return sample;
+}
+
+void HeadlessFrameLoop::BuildSyntheticScene(uint32_t count, std::vector<Mesh>& meshes, std::vector<Material>& materials)
+{
+	const uint32_t materialCount = 8;
+	materials.resize(materialCount);
+	for (uint32_t i = 0; i < materialCount; i++)
+	{
+		materials[i].name = "synthetic " + std::to_string(i);
+		materials[i].diffuseTexture = materials[i].name + ".png";
+		materials[i].alphaTexture = i % 4 == 3 ? materials[i].diffuseTexture : std::string();
+	}
+
+	// unit boxes two units apart on a square grid
+	uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(count))));
+	meshes.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Mesh& mesh = meshes[i];
+		XMFLOAT3 origin = { 2.0f * (i % side), 0.0f, 2.0f * (i / side) };
+		mesh.vertices.clear();
+		mesh.indices.clear();
+		for (int face = 0; face < 6; face++)
+		{
+			int axis = face / 2;
+			float sign = face % 2 ? 1.0f : -1.0f;
+			float normal[3] = {};
+			normal[axis] = sign;
+			uint32_t first = static_cast<uint32_t>(mesh.vertices.size());
+			for (int corner = 0; corner < 4; corner++)
+			{
+				float u = corner & 1 ? 0.5f : -0.5f;
+				float v = corner & 2 ? 0.5f : -0.5f;
+				float position[3];
+				position[axis] = 0.5f * sign;
+				position[(axis + 1) % 3] = u;
+				position[(axis + 2) % 3] = v;
+				Vertex vertex;
+				vertex.position = XMFLOAT3(origin.x + position[0], origin.y + position[1], origin.z + position[2]);
+				vertex.normal = XMFLOAT3(normal[0], normal[1], normal[2]);
+				vertex.texCoord = XMFLOAT2(u + 0.5f, v + 0.5f);
+				mesh.vertices.push_back(vertex);
+			}
+			uint32_t quad[6] = { 0, 1, 2, 2, 1, 3 };
+			for (uint32_t index : quad) {
+				mesh.indices.push_back(first + index);
+			}
+		}
+		mesh.materialIndex = static_cast<int>(i % materialCount);
+		mesh.materialName = materials[mesh.materialIndex].name;
+		mesh.boundsMin = XMFLOAT3(origin.x - 0.5f, origin.y - 0.5f, origin.z - 0.5f);
+		mesh.boundsMax = XMFLOAT3(origin.x + 0.5f, origin.y + 0.5f, origin.z + 0.5f);
+		mesh.worldUnitsPerUV = 1.0f;
+	}
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "RenderDevice.h"
+#include "DeviceDrawBackend.h"
+#include "DrawRecorder.h"
+#include "FrameTelemetry.h"
+#include "Mesh.h"
+
+class JobSystem;
+
+struct HeadlessFrameLoopDesc
+{
+	uint32_t width = 1280;
+	uint32_t height = 720;
+	uint32_t framesInFlight = 2;
+	// compiled shaders for the opaque and alpha tested pipelines, empty on
+	// NullRenderDevice
+	RenderShader vertexShader;
+	RenderShader pixelShader;
+	RenderShader maskedPixelShader;
+};
+
+// the renderer's frame without a window: constants for an orbiting camera,
+// the scene's draw list recorded in chunks by DrawRecorder and a target
+// cleared, drawn to and transitioned back the way the swap chain buffer is,
+// all on a RenderDevice and with framesInFlight frames queued. materials get
+// a small placeholder texture each, the loop measures the cpu side of a
+// frame, not texture streaming. on NullRenderDevice it runs anywhere and the
+// device checks every frame.
+class HeadlessFrameLoop
+{
+public:
+	HeadlessFrameLoop() = default;
+	HeadlessFrameLoop(const HeadlessFrameLoop&) = delete;
+	HeadlessFrameLoop& operator=(const HeadlessFrameLoop&) = delete;
+	~HeadlessFrameLoop();
+
+	// meshes and materials as MeshCache::Read or OBJLoader return them.
+	// without jobs every draw is recorded on the calling thread
+	bool Initialize(RenderDevice* device, JobSystem* jobs, const HeadlessFrameLoopDesc& desc,
+		const std::vector<Mesh>& meshes, const std::vector<Material>& materials, std::string& error);
+	// waits for the device, then destroys everything it created
+	void Shutdown();
+
+	// records, submits and signals the next frame. FramePhasePresentWait is the
+	// wait for the frame slot's previous frame
+	FrameSample RunFrame();
+	void WaitIdle();
+
+	const DrawRecorderStats& GetRecorderStats() const { return m_recorder.GetStats(); }
+	uint64_t GetFrameCount() const { return m_frame; }
+
+	// count boxes on a grid with a handful of materials, every fourth alpha
+	// tested, for runs without a cooked scene
+	static void BuildSyntheticScene(uint32_t count, std::vector<Mesh>& meshes, std::vector<Material>& materials);
+
+	// keeps the draw list in one chunk when false
+	bool parallelRecording = true;
+
+private:
+	struct SceneDraw
+	{
+		uint32_t pipeline;
+		uint32_t material;
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t baseVertex;
+	};
+
+	bool Upload(const std::vector<Mesh>& meshes, size_t materialCount, std::string& error);
+	void WriteConstants(uint32_t slot);
+
+	RenderDevice* m_device = nullptr;
+	HeadlessFrameLoopDesc m_desc;
+	DeviceDrawBackend m_drawBackend;
+	DeviceDrawState m_drawState; // the constant offsets change with the frame slot
+	DrawRecorder m_recorder;
+
+	RenderHandle m_pipelines[2] = {}; // opaque, masked, what DrawItem::pipeline indexes
+	RenderHandle m_vertexBuffer = InvalidRenderHandle;
+	RenderHandle m_indexBuffer = InvalidRenderHandle;
+	RenderHandle m_constants = InvalidRenderHandle; // upload, ConstantsStride per frame slot
+	std::vector<RenderHandle> m_textures; // one per material, views go with them
+	std::vector<uint64_t> m_tables;
+	RenderHandle m_renderTarget = InvalidRenderHandle;
+	RenderHandle m_renderTargetView = InvalidRenderHandle;
+	RenderHandle m_depth = InvalidRenderHandle;
+	RenderHandle m_depthView = InvalidRenderHandle;
+	RenderHandle m_commandList = InvalidRenderHandle; // barrier and clears before the chunks
+	RenderHandle m_postCommandList = InvalidRenderHandle; // barrier back after them
+
+	std::vector<SceneDraw> m_sceneDraws; // opaque first, like g_meshes
+	std::vector<DrawItem> m_drawItems;
+	std::vector<RenderHandle> m_frameCommandLists;
+	std::vector<uint64_t> m_slotFenceValues;
+	DirectX::XMFLOAT3 m_center = {};
+	float m_radius = 1.0f;
+	uint64_t m_frame = 0;
+};
@@ -0,0 +1,321 @@
+#include "JobSystem.h"
+#include "CpuProfiler.h"
+#include <chrono>
+#include <string>
+
+struct Job
+{
+	JobSystem::Function function;
+	JobCounter* counter;
+};
+
+namespace
+{
+	// idle rounds through every deque before a worker goes to sleep
+	const uint32_t SpinRounds = 64;
+
+	// which system the thread is a worker of, so several can coexist
+	thread_local const JobSystem* t_system = nullptr;
+	thread_local uint32_t t_worker = JobSystem::NotWorker;
+	thread_local uint32_t t_random = 0;
+
+	// xorshift, picks the first victim to steal from
+	uint32_t NextRandom()
+	{
+		uint32_t x = t_random ? t_random : 0x9e3779b9u;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		t_random = x;
+		return x;
+	}
+}
+
+bool JobDeque::Push(Job* job)
+{
+	int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+	int64_t top = m_top.load(std::memory_order_acquire);
+	if (bottom - top >= Capacity) {
+		return false;
+	}
+	m_jobs[bottom & (Capacity - 1)].store(job, std::memory_order_relaxed);
+	// thieves read the slot after seeing the new bottom
+	m_bottom.store(bottom + 1, std::memory_order_release);
+	return true;
+}
+
+Job* JobDeque::Pop()
+{
+	int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	// the bottom store has to be seen by thieves before top is read
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = m_top.load(std::memory_order_relaxed);
+	if (top > bottom) {
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = m_jobs[bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		// the last job, race the thieves for it
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			job = nullptr;
+		}
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* JobDeque::Steal()
+{
+	int64_t top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t bottom = m_bottom.load(std::memory_order_acquire);
+	if (top >= bottom) {
+		return nullptr;
+	}
+	Job* job = m_jobs[top & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		return nullptr;
+	}
+	return job;
+}
+
+bool JobDeque::IsEmpty() const
+{
+	return m_top.load(std::memory_order_acquire) >= m_bottom.load(std::memory_order_acquire);
+}
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+void JobSystem::Initialize(uint32_t workerThreads)
+{
+	Shutdown();
+	m_stop = false;
+	for (uint32_t i = 0; i <= workerThreads; i++) {
+		m_deques.push_back(std::make_unique<JobDeque>());
+	}
+	t_system = this;
+	t_worker = 0;
+	for (uint32_t i = 1; i <= workerThreads; i++) {
+		m_threads.emplace_back(&JobSystem::WorkerThread, this, i);
+	}
+}
+
+void JobSystem::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (std::thread& thread : m_threads) {
+		thread.join();
+	}
+	m_threads.clear();
+
+	// nothing should be left, drop what is without running it
+	for (auto& deque : m_deques) {
+		while (Job* job = deque->Steal()) {
+			delete job;
+		}
+	}
+	m_deques.clear();
+	for (Job* job : m_injected) {
+		delete job;
+	}
+	m_injected.clear();
+	m_queued = 0;
+	if (t_system == this) {
+		t_system = nullptr;
+		t_worker = NotWorker;
+	}
+}
+
+uint32_t JobSystem::GetWorkerIndex() const
+{
+	return t_system == this ? t_worker : NotWorker;
+}
+
+void JobSystem::Run(Function function, JobCounter* counter, JobCounter* dependency)
+{
+	Job* job = new Job{ std::move(function), counter };
+	if (counter) {
+		counter->m_count.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (dependency)
+	{
+		std::lock_guard<std::mutex> lock(dependency->m_mutex);
+		if (dependency->m_count.load(std::memory_order_acquire) > 0) {
+			dependency->m_waiting.push_back(job);
+			return;
+		}
+	}
+	Push(job);
+}
+
+void JobSystem::Push(Job* job)
+{
+	uint32_t worker = GetWorkerIndex();
+	if (worker == NotWorker || m_deques.empty())
+	{
+		if (m_deques.empty()) {
+			// not initialized, everything runs on the caller
+			Execute(job);
+			return;
+		}
+		std::lock_guard<std::mutex> lock(m_injectedMutex);
+		m_injected.push_back(job);
+		m_injectedJobs.fetch_add(1, std::memory_order_relaxed);
+	}
+	else if (!m_deques[worker]->Push(job))
+	{
+		m_inlined.fetch_add(1, std::memory_order_relaxed);
+		Execute(job);
+		return;
+	}
+
+	// paired with the sleeper bumping m_sleeping before it checks m_queued,
+	// one of the two sees the other
+	m_queued.fetch_add(1, std::memory_order_seq_cst);
+	if (m_sleeping.load(std::memory_order_seq_cst) > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_wake.notify_one();
+	}
+}
+
+Job* JobSystem::FindJob(uint32_t worker)
+{
+	Job* job = nullptr;
+	if (worker != NotWorker) {
+		job = m_deques[worker]->Pop();
+	}
+	if (!job && m_queued.load(std::memory_order_relaxed) > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_injectedMutex);
+		if (!m_injected.empty()) {
+			job = m_injected.front();
+			m_injected.pop_front();
+		}
+	}
+	if (!job)
+	{
+		uint32_t count = static_cast<uint32_t>(m_deques.size());
+		uint32_t first = NextRandom() % count;
+		for (uint32_t i = 0; i < count && !job; i++)
+		{
+			uint32_t victim = (first + i) % count;
+			if (victim != worker) {
+				job = m_deques[victim]->Steal();
+			}
+		}
+		if (job) {
+			m_steals.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	if (job) {
+		m_queued.fetch_sub(1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+void JobSystem::Execute(Job* job)
+{
+	job->function();
+	JobCounter* counter = job->counter;
+	delete job;
+	m_jobs.fetch_add(1, std::memory_order_relaxed);
+	if (counter) {
+		Finish(counter);
+	}
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+	// not the last job, nobody can be waiting on this decrement
+	int32_t count = counter->m_count.load(std::memory_order_relaxed);
+	while (count > 1) {
+		if (counter->m_count.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+			return;
+		}
+	}
+
+	// maybe the last one. the decrement to zero happens under the counter's
+	// mutex, Wait takes it before returning so the counter outlives this
+	std::vector<Job*> ready;
+	{
+		std::lock_guard<std::mutex> lock(counter->m_mutex);
+		if (counter->m_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			ready.swap(counter->m_waiting);
+		}
+	}
+	for (Job* job : ready) {
+		Push(job);
+	}
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	uint32_t worker = GetWorkerIndex();
+	while (!counter.IsDone())
+	{
+		if (Job* job = m_deques.empty() ? nullptr : FindJob(worker)) {
+			Execute(job);
+		}
+		else {
+			// the rest is running on other workers
+			std::this_thread::yield();
+		}
+	}
+	std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+void JobSystem::WorkerThread(uint32_t worker)
+{
+	t_system = this;
+	t_worker = worker;
+	t_random = worker * 0x9e3779b9u;
+	std::string name = "job worker " + std::to_string(worker);
+	PROFILE_THREAD(name.c_str());
+
+	uint32_t idleRounds = 0;
+	while (!m_stop.load(std::memory_order_relaxed))
+	{
+		if (Job* job = FindJob(worker)) {
+			Execute(job);
+			idleRounds = 0;
+			continue;
+		}
+		if (++idleRounds < SpinRounds) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+		// the timeout only guards against a missed wake, it isn't needed otherwise
+		m_wake.wait_for(lock, std::chrono::milliseconds(10), [this] {
+			return m_stop.load(std::memory_order_relaxed) || m_queued.load(std::memory_order_seq_cst) > 0;
+		});
+		m_sleeping.fetch_sub(1, std::memory_order_seq_cst);
+		m_sleeps.fetch_add(1, std::memory_order_relaxed);
+		idleRounds = 0;
+	}
+}
+
+JobSystemStats JobSystem::GetStats() const
+{
+	JobSystemStats stats;
+	stats.jobs = m_jobs.load(std::memory_order_relaxed);
+	stats.steals = m_steals.load(std::memory_order_relaxed);
+	stats.injected = m_injectedJobs.load(std::memory_order_relaxed);
+	stats.inlined = m_inlined.load(std::memory_order_relaxed);
+	stats.sleeps = m_sleeps.load(std::memory_order_relaxed);
+	return stats;
+}
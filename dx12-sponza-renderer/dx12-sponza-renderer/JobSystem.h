@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+struct Job;
+
+// counts jobs that haven't finished. JobSystem::Wait runs jobs until it
+// drops to zero, jobs run with it as their dependency start once it does.
+// a counter can be reused once Wait on it returned
+class JobCounter
+{
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool IsDone() const { return m_count.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<int32_t> m_count{ 0 };
+	// the decrement to zero and the jobs waiting for it are guarded by this
+	std::mutex m_mutex;
+	std::vector<Job*> m_waiting;
+};
+
+// fixed size Chase-Lev deque. the owning thread pushes and pops at the
+// bottom, any thread steals from the top
+class JobDeque
+{
+public:
+	static const int64_t Capacity = 4096; // power of two
+
+	// owner only, false when full
+	bool Push(Job* job);
+	// owner only, newest first
+	Job* Pop();
+	// any thread, oldest first. nullptr when empty or another thief won
+	Job* Steal();
+
+	bool IsEmpty() const;
+
+private:
+	std::atomic<int64_t> m_top{ 0 };
+	std::atomic<int64_t> m_bottom{ 0 };
+	std::atomic<Job*> m_jobs[Capacity] = {};
+};
+
+struct JobSystemStats
+{
+	uint64_t jobs = 0;
+	uint64_t steals = 0;
+	uint64_t injected = 0; // run from threads that aren't workers
+	uint64_t inlined = 0; // ran on Run because the caller's deque was full
+	uint64_t sleeps = 0;
+};
+
+// work stealing scheduler. every worker has a deque it runs its own jobs
+// from newest first and idle workers steal the oldest jobs from the others.
+// the thread that calls Initialize is worker 0, it never sleeps in the
+// scheduler and only runs jobs while it waits, so it keeps its frame loop.
+// threads that aren't workers can Run and Wait too, their jobs go through a
+// shared queue.
+class JobSystem
+{
+public:
+	typedef std::function<void()> Function;
+	static const uint32_t NotWorker = UINT32_MAX;
+
+	JobSystem() = default;
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+	~JobSystem();
+
+	// workerThreads on top of the calling thread
+	void Initialize(uint32_t workerThreads);
+	// every job has to be waited for before
+	void Shutdown();
+
+	// counter is incremented now and decremented once the job has run. with
+	// a dependency the job is queued once the dependency's count drops to zero
+	void Run(Function function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+	// runs jobs until counter is done
+	void Wait(JobCounter& counter);
+
+	// body(rangeBegin, rangeEnd) over [begin, end) split into ranges of at
+	// least grain items, the caller runs the first range and waits for the rest
+	template<typename Body>
+	void ParallelFor(size_t begin, size_t end, size_t grain, const Body& body);
+
+	// workers including the initializing thread, 1 before Initialize
+	uint32_t GetWorkerCount() const { return static_cast<uint32_t>(m_deques.size() > 0 ? m_deques.size() : 1); }
+	// the calling thread's worker index, NotWorker for other threads
+	uint32_t GetWorkerIndex() const;
+
+	JobSystemStats GetStats() const;
+
+private:
+	void WorkerThread(uint32_t worker);
+	void Push(Job* job);
+	Job* FindJob(uint32_t worker);
+	void Execute(Job* job);
+	void Finish(JobCounter* counter);
+
+	std::vector<std::unique_ptr<JobDeque>> m_deques; // one per worker, 0 is the initializing thread
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_injectedMutex;
+	std::deque<Job*> m_injected;
+
+	// queued jobs not yet taken, idle workers sleep while it's zero
+	std::atomic<int64_t> m_queued{ 0 };
+	std::atomic<uint32_t> m_sleeping{ 0 };
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+	std::atomic<bool> m_stop{ false };
+
+	std::atomic<uint64_t> m_jobs{ 0 };
+	std::atomic<uint64_t> m_steals{ 0 };
+	std::atomic<uint64_t> m_injectedJobs{ 0 };
+	std::atomic<uint64_t> m_inlined{ 0 };
+	std::atomic<uint64_t> m_sleeps{ 0 };
+};
+
+template<typename Body>
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grain, const Body& body)
+{
+	if (end <= begin) {
+		return;
+	}
+	// a few ranges per worker so stealing can even out uneven ranges
+	size_t count = end - begin;
+	grain = grain > 0 ? grain : 1;
+	size_t ranges = (count + grain - 1) / grain;
+	size_t maxRanges = size_t(GetWorkerCount()) * 4;
+	ranges = ranges < maxRanges ? ranges : maxRanges;
+	if (ranges <= 1) {
+		body(begin, end);
+		return;
+	}
+
+	JobCounter counter;
+	for (size_t i = 1; i < ranges; i++)
+	{
+		size_t rangeBegin = begin + count * i / ranges;
+		size_t rangeEnd = begin + count * (i + 1) / ranges;
+		Run([&body, rangeBegin, rangeEnd]() { body(rangeBegin, rangeEnd); }, &counter);
+	}
+	body(begin, begin + count / ranges);
+	Wait(counter);
+}
@@ -0,0 +1,192 @@
+#include "Lz4.h"
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	const size_t MinMatch = 4;
+	const size_t LastLiterals = 5; // the block always ends with this many literals
+	const size_t MatchFindLimit = 12; // no match may start closer to the end
+	const size_t MaxOffset = 65535;
+	const uint32_t HashLog = 12;
+
+	uint32_t Read32(const uint8_t* p)
+	{
+		uint32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	uint32_t Hash(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - HashLog);
+	}
+
+	// lengths of 15 and up continue in extra bytes of 255 until one is smaller
+	uint8_t* WriteLength(uint8_t* out, size_t length)
+	{
+		for (; length >= 255; length -= 255) {
+			*out++ = 255;
+		}
+		*out++ = static_cast<uint8_t>(length);
+		return out;
+	}
+
+	bool ReadLength(const uint8_t*& in, const uint8_t* end, size_t& length)
+	{
+		uint8_t byte;
+		do
+		{
+			if (in >= end) {
+				return false;
+			}
+			byte = *in++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+}
+
+size_t Lz4::CompressBound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+size_t Lz4::Compress(const uint8_t* source, size_t size, uint8_t* destination, size_t capacity)
+{
+	uint8_t* out = destination;
+	uint8_t* const outEnd = destination + capacity;
+
+	auto emit = [&](size_t anchor, size_t literals, size_t offset, size_t matchLength) {
+		// token, literal length, literals, offset and match length at their largest
+		size_t worstCase = 1 + literals / 255 + 1 + literals + 2 + matchLength / 255 + 1;
+		if (static_cast<size_t>(outEnd - out) < worstCase) {
+			return false;
+		}
+
+		uint8_t* token = out++;
+		*token = static_cast<uint8_t>((literals < 15 ? literals : 15) << 4);
+		if (literals >= 15) {
+			out = WriteLength(out, literals - 15);
+		}
+		if (literals > 0) {
+			std::memcpy(out, source + anchor, literals);
+			out += literals;
+		}
+
+		if (matchLength == 0) {
+			return true; // the last sequence has no match
+		}
+		*out++ = static_cast<uint8_t>(offset);
+		*out++ = static_cast<uint8_t>(offset >> 8);
+		size_t length = matchLength - MinMatch;
+		*token |= static_cast<uint8_t>(length < 15 ? length : 15);
+		if (length >= 15) {
+			out = WriteLength(out, length - 15);
+		}
+		return true;
+	};
+
+	size_t anchor = 0;
+	if (size >= MatchFindLimit)
+	{
+		// positions are stored plus one so zero means empty
+		std::vector<uint32_t> table(size_t(1) << HashLog, 0);
+		const size_t matchLimit = size - LastLiterals;
+		size_t position = 0;
+		uint32_t misses = 0;
+		while (position + MatchFindLimit <= size)
+		{
+			uint32_t sequence = Read32(source + position);
+			uint32_t& slot = table[Hash(sequence)];
+			size_t candidate = slot;
+			slot = static_cast<uint32_t>(position + 1);
+
+			if (candidate == 0 || position - (candidate - 1) > MaxOffset || Read32(source + candidate - 1) != sequence)
+			{
+				// skip faster through data that doesn't compress
+				position += 1 + (misses++ >> 6);
+				continue;
+			}
+			misses = 0;
+
+			size_t match = candidate - 1;
+			size_t length = MinMatch;
+			while (position + length < matchLimit && source[match + length] == source[position + length]) {
+				length++;
+			}
+
+			if (!emit(anchor, position - anchor, position - match, length)) {
+				return 0;
+			}
+			position += length;
+			anchor = position;
+		}
+	}
+
+	if (!emit(anchor, size - anchor, 0, 0)) {
+		return 0;
+	}
+	return static_cast<size_t>(out - destination);
+}
+
+bool Lz4::Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t size)
+{
+	const uint8_t* in = source;
+	const uint8_t* const inEnd = source + sourceSize;
+	uint8_t* out = destination;
+	uint8_t* const outEnd = destination + size;
+
+	while (in < inEnd)
+	{
+		uint8_t token = *in++;
+
+		size_t literals = token >> 4;
+		if (literals == 15 && !ReadLength(in, inEnd, literals)) {
+			return false;
+		}
+		if (literals > static_cast<size_t>(inEnd - in) || literals > static_cast<size_t>(outEnd - out)) {
+			return false;
+		}
+		if (literals > 0) {
+			std::memcpy(out, in, literals);
+			in += literals;
+			out += literals;
+		}
+
+		if (in == inEnd) {
+			break; // last sequence
+		}
+
+		if (inEnd - in < 2) {
+			return false;
+		}
+		size_t offset = in[0] | (size_t(in[1]) << 8);
+		in += 2;
+		if (offset == 0 || offset > static_cast<size_t>(out - destination)) {
+			return false;
+		}
+
+		size_t length = token & 15;
+		if (length == 15 && !ReadLength(in, inEnd, length)) {
+			return false;
+		}
+		length += MinMatch;
+		if (length > static_cast<size_t>(outEnd - out)) {
+			return false;
+		}
+
+		// matches may overlap their own output, which repeats the pattern
+		const uint8_t* match = out - offset;
+		if (offset >= length) {
+			std::memcpy(out, match, length);
+			out += length;
+		}
+		else {
+			for (size_t i = 0; i < length; i++) {
+				*out++ = match[i];
+			}
+		}
+	}
+	return out == outEnd;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// lz4 block format (no frame header), compatible with LZ4_compress_default
+// and LZ4_decompress_safe. the compressor is the single pass hash table one,
+// quick enough to pack assets and the decoder is what runs at load time.
+namespace Lz4
+{
+	// worst case output size for incompressible input
+	size_t CompressBound(size_t size);
+
+	// returns the compressed size, 0 if it doesn't fit in capacity
+	size_t Compress(const uint8_t* source, size_t size, uint8_t* destination, size_t capacity);
+
+	// fails on malformed input or when the output isn't exactly size bytes
+	bool Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t size);
+}
@@ -0,0 +1,93 @@
+#include "MappedFile.h"
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		m_view = other.m_view;
+		m_size = other.m_size;
+		other.m_view = nullptr;
+		other.m_size = 0;
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& filename, std::string& error)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		error = "failed to open " + filename;
+		return false;
+	}
+	LARGE_INTEGER fileSize = {};
+	GetFileSizeEx(file, &fileSize);
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping) {
+		error = "failed to map " + filename;
+		return false;
+	}
+	// the view keeps the mapping alive
+	m_view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	m_size = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+	int file = open(filename.c_str(), O_RDONLY);
+	if (file < 0) {
+		error = "failed to open " + filename;
+		return false;
+	}
+	struct stat fileStat = {};
+	fstat(file, &fileStat);
+	m_size = static_cast<uint64_t>(fileStat.st_size);
+	void* view = m_size > 0 ? mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+	close(file);
+	m_view = view != MAP_FAILED ? view : nullptr;
+#endif
+
+	if (!m_view) {
+		error = "failed to map " + filename;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_view)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(m_view);
+#else
+		munmap(m_view, m_size);
+#endif
+		m_view = nullptr;
+	}
+	m_size = 0;
+}
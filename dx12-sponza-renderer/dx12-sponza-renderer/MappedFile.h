@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// read only view of a whole file. pages are faulted in on first touch, so
+// opening is cheap and only the parts that are read cost io.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	~MappedFile();
+
+	bool Open(const std::string& filename, std::string& error);
+	void Close();
+
+	bool IsOpen() const { return m_view != nullptr; }
+	const uint8_t* GetData() const { return static_cast<const uint8_t*>(m_view); }
+	uint64_t GetSize() const { return m_size; }
+
+private:
+	void* m_view = nullptr;
+	uint64_t m_size = 0;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <DirectXMath.h>
+
+// cpu side geometry and materials as the loaders produce them, kept apart
+// from the loaders so code that only consumes meshes builds anywhere
+
+struct Vertex 
+{
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT3 normal;
+	DirectX::XMFLOAT2 texCoord;
+};
+
+struct Material
+{
+	std::string name;
+	std::string diffuseTexture; // map_Kd
+	std::string alphaTexture; // map_d
+};
+
+struct Mesh 
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::string materialName;
+	int materialIndex = -1;
+
+	// object space bounds and world units covered by one uv unit,
+	// used to estimate on-screen texel density for texture streaming
+	DirectX::XMFLOAT3 boundsMin = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 boundsMax = { 0.0f, 0.0f, 0.0f };
+	float worldUnitsPerUV = 1.0f;
+};
@@ -0,0 +1,214 @@
+#include "MeshCache.h"
+#include "GeometryCodec.h"
+#include "MappedFile.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	struct MeshCacheHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t vertexStride; // a different Vertex layout means a stale cache
+		uint32_t meshCount;
+		uint32_t materialCount;
+		uint32_t reserved;
+	};
+
+	struct MeshCacheRecord
+	{
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		int32_t materialIndex;
+		uint32_t materialNameLength;
+		float boundsMin[3];
+		float boundsMax[3];
+		float worldUnitsPerUV;
+		uint32_t vertexBytes;
+		uint32_t indexBytes;
+		uint32_t reserved;
+	};
+
+	const uint32_t MeshCacheVersion = 1;
+
+	static_assert(sizeof(Vertex) % 4 == 0, "the vertex codec works on 4 byte columns");
+
+	void Append(std::vector<uint8_t>& file, const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		file.insert(file.end(), bytes, bytes + size);
+	}
+
+	void AppendString(std::vector<uint8_t>& file, const std::string& text)
+	{
+		uint32_t length = static_cast<uint32_t>(text.size());
+		Append(file, &length, sizeof(length));
+		Append(file, text.data(), text.size());
+	}
+
+	// bounds checked cursor over the mapped file
+	struct Reader
+	{
+		const uint8_t* data;
+		uint64_t size;
+		uint64_t offset;
+
+		bool Read(void* destination, uint64_t bytes)
+		{
+			if (bytes > size - offset) {
+				return false;
+			}
+			std::memcpy(destination, data + offset, static_cast<size_t>(bytes));
+			offset += bytes;
+			return true;
+		}
+
+		bool ReadString(std::string& text, uint32_t length)
+		{
+			if (length > size - offset) {
+				return false;
+			}
+			text.assign(reinterpret_cast<const char*>(data + offset), length);
+			offset += length;
+			return true;
+		}
+
+		bool ReadString(std::string& text)
+		{
+			uint32_t length = 0;
+			return Read(&length, sizeof(length)) && ReadString(text, length);
+		}
+
+		const uint8_t* Skip(uint64_t bytes)
+		{
+			if (bytes > size - offset) {
+				return nullptr;
+			}
+			offset += bytes;
+			return data + offset - bytes;
+		}
+	};
+}
+
+bool MeshCache::Write(const std::vector<Mesh>& meshes, const std::vector<Material>& materials,
+	const std::string& filename, std::string& error)
+{
+	MeshCacheHeader header = {};
+	std::memcpy(header.magic, "DXMS", 4);
+	header.version = MeshCacheVersion;
+	header.vertexStride = sizeof(Vertex);
+	header.meshCount = static_cast<uint32_t>(meshes.size());
+	header.materialCount = static_cast<uint32_t>(materials.size());
+
+	std::vector<uint8_t> file;
+	Append(file, &header, sizeof(header));
+	for (const Material& material : materials)
+	{
+		AppendString(file, material.diffuseTexture);
+		AppendString(file, material.alphaTexture);
+		AppendString(file, material.name);
+	}
+
+	std::vector<uint8_t> vertices;
+	std::vector<uint8_t> indices;
+	for (const Mesh& mesh : meshes)
+	{
+		vertices.resize(GeometryCodec::VertexBound(mesh.vertices.size(), sizeof(Vertex)));
+		indices.resize(GeometryCodec::IndexBound(mesh.indices.size()));
+		size_t vertexBytes = GeometryCodec::EncodeVertices(vertices.data(), vertices.size(), mesh.vertices.data(),
+			mesh.vertices.size(), sizeof(Vertex));
+		size_t indexBytes = GeometryCodec::EncodeIndices(indices.data(), indices.size(), mesh.indices.data(), mesh.indices.size());
+		if ((vertexBytes == 0 && !mesh.vertices.empty()) || (indexBytes == 0 && !mesh.indices.empty())) {
+			error = "failed to encode geometry for " + filename;
+			return false;
+		}
+
+		MeshCacheRecord record = {};
+		record.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+		record.indexCount = static_cast<uint32_t>(mesh.indices.size());
+		record.materialIndex = mesh.materialIndex;
+		record.materialNameLength = static_cast<uint32_t>(mesh.materialName.size());
+		std::memcpy(record.boundsMin, &mesh.boundsMin, sizeof(record.boundsMin));
+		std::memcpy(record.boundsMax, &mesh.boundsMax, sizeof(record.boundsMax));
+		record.worldUnitsPerUV = mesh.worldUnitsPerUV;
+		record.vertexBytes = static_cast<uint32_t>(vertexBytes);
+		record.indexBytes = static_cast<uint32_t>(indexBytes);
+		Append(file, &record, sizeof(record));
+		Append(file, mesh.materialName.data(), mesh.materialName.size());
+		Append(file, vertices.data(), vertexBytes);
+		Append(file, indices.data(), indexBytes);
+	}
+
+	std::FILE* output = std::fopen(filename.c_str(), "wb");
+	if (!output) {
+		error = "failed to create mesh cache " + filename;
+		return false;
+	}
+	bool ok = std::fwrite(file.data(), 1, file.size(), output) == file.size();
+	std::fclose(output);
+	if (!ok) {
+		error = "failed to write mesh cache " + filename;
+	}
+	return ok;
+}
+
+bool MeshCache::Read(const std::string& filename, std::vector<Mesh>& meshes,
+	std::vector<Material>& materials, std::string& error)
+{
+	MappedFile mappedFile;
+	if (!mappedFile.Open(filename, error)) {
+		error = "mesh cache: " + error;
+		return false;
+	}
+
+	Reader reader = { mappedFile.GetData(), mappedFile.GetSize(), 0 };
+	MeshCacheHeader header = {};
+	bool valid = reader.Read(&header, sizeof(header)) && std::memcmp(header.magic, "DXMS", 4) == 0 &&
+		header.version == MeshCacheVersion && header.vertexStride == sizeof(Vertex);
+
+	std::vector<Material> cachedMaterials(valid ? header.materialCount : 0);
+	for (Material& material : cachedMaterials) {
+		valid = valid && reader.ReadString(material.diffuseTexture) && reader.ReadString(material.alphaTexture) &&
+			reader.ReadString(material.name);
+	}
+
+	std::vector<Mesh> cachedMeshes;
+	for (uint32_t i = 0; valid && i < header.meshCount; i++)
+	{
+		MeshCacheRecord record = {};
+		Mesh mesh;
+		valid = reader.Read(&record, sizeof(record)) && reader.ReadString(mesh.materialName, record.materialNameLength);
+		const uint8_t* vertices = valid ? reader.Skip(record.vertexBytes) : nullptr;
+		const uint8_t* indices = vertices ? reader.Skip(record.indexBytes) : nullptr;
+		// counts are checked against the encoded sizes before anything is allocated
+		valid = indices && record.materialIndex >= -1 && record.materialIndex < static_cast<int32_t>(header.materialCount) &&
+			record.vertexBytes <= GeometryCodec::VertexBound(record.vertexCount, sizeof(Vertex)) &&
+			record.vertexCount <= uint64_t(record.vertexBytes) * 64 && record.indexCount <= uint64_t(record.indexBytes) * 3;
+		if (!valid) {
+			break;
+		}
+
+		mesh.vertices.resize(record.vertexCount);
+		mesh.indices.resize(record.indexCount);
+		valid = GeometryCodec::DecodeVertices(mesh.vertices.data(), mesh.vertices.size(), sizeof(Vertex), vertices, record.vertexBytes) &&
+			GeometryCodec::DecodeIndices(mesh.indices.data(), mesh.indices.size(), indices, record.indexBytes);
+		for (size_t index = 0; valid && index < mesh.indices.size(); index++) {
+			valid = mesh.indices[index] < record.vertexCount;
+		}
+
+		mesh.materialIndex = record.materialIndex;
+		std::memcpy(&mesh.boundsMin, record.boundsMin, sizeof(record.boundsMin));
+		std::memcpy(&mesh.boundsMax, record.boundsMax, sizeof(record.boundsMax));
+		mesh.worldUnitsPerUV = record.worldUnitsPerUV;
+		cachedMeshes.push_back(std::move(mesh));
+	}
+
+	if (!valid || reader.offset != reader.size) {
+		error = "invalid mesh cache " + filename;
+		return false;
+	}
+	meshes = std::move(cachedMeshes);
+	materials = std::move(cachedMaterials);
+	return true;
+}
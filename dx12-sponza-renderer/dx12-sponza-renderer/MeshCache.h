@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "Mesh.h"
+
+// cooked form of a loaded obj, written next to it as .dxmesh so later runs
+// skip parsing. vertices and indices are stored GeometryCodec encoded, a mesh
+// is about a third of its in-memory size on disk.
+//
+// file layout:
+//   MeshCacheHeader
+//   per material: diffuse texture, alpha texture and name, each a uint32_t
+//     length followed by the characters
+//   per mesh: MeshCacheRecord, the material name, encoded vertices, encoded indices
+class MeshCache
+{
+public:
+	static bool Write(const std::vector<Mesh>& meshes, const std::vector<Material>& materials,
+		const std::string& filename, std::string& error);
+
+	// validates everything, indices included, so a bad cache can't index past a mesh
+	static bool Read(const std::string& filename, std::vector<Mesh>& meshes,
+		std::vector<Material>& materials, std::string& error);
+};
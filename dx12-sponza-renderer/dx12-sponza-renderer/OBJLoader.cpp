@@ -1,9 +1,12 @@
 #include "OBJLoader.h"
 #include "tiny_obj_loader.h"
+#include "CpuProfiler.h"
 #include <debugapi.h>
 #include <unordered_map>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 namespace std {
     template<> struct hash<Vertex> {
@@ -41,18 +44,46 @@ bool operator==(const Vertex& a, const Vertex& b) {
         a.texCoord.y == b.texCoord.y;
 }
 
-bool OBJLoader::LoadOBJ(const std::string& filename, std::vector<Mesh>& meshes, std::string& error)
+static void ComputeBoundsAndUVDensity(Mesh& mesh)
 {
-    OutputDebugStringA("************** OBJLoader started **************\n");
+    mesh.boundsMin = mesh.vertices[0].position;
+    mesh.boundsMax = mesh.vertices[0].position;
+    for (const auto& vertex : mesh.vertices)
+    {
+        mesh.boundsMin.x = std::min(mesh.boundsMin.x, vertex.position.x);
+        mesh.boundsMin.y = std::min(mesh.boundsMin.y, vertex.position.y);
+        mesh.boundsMin.z = std::min(mesh.boundsMin.z, vertex.position.z);
+        mesh.boundsMax.x = std::max(mesh.boundsMax.x, vertex.position.x);
+        mesh.boundsMax.y = std::max(mesh.boundsMax.y, vertex.position.y);
+        mesh.boundsMax.z = std::max(mesh.boundsMax.z, vertex.position.z);
+    }
 
-    tinyobj::ObjReaderConfig reader_config;
-    reader_config.mtl_search_path = "C:\\Users\\akyur\\Documents\\graphics-github\\dx12-sponza-renderer\\dx12-sponza-renderer\\models\\"; // path to MTL files
+    // ratio of world space area to uv space area over all triangles
+    double worldArea = 0.0;
+    double uvArea = 0.0;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        const Vertex& a = mesh.vertices[mesh.indices[i + 0]];
+        const Vertex& b = mesh.vertices[mesh.indices[i + 1]];
+        const Vertex& c = mesh.vertices[mesh.indices[i + 2]];
 
-    reader_config.triangulate = true;
+        DirectX::XMVECTOR ab = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&b.position), DirectX::XMLoadFloat3(&a.position));
+        DirectX::XMVECTOR ac = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&c.position), DirectX::XMLoadFloat3(&a.position));
+        worldArea += 0.5 * DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVector3Cross(ab, ac)));
 
-    tinyobj::ObjReader reader;
+        float u1 = b.texCoord.x - a.texCoord.x, v1 = b.texCoord.y - a.texCoord.y;
+        float u2 = c.texCoord.x - a.texCoord.x, v2 = c.texCoord.y - a.texCoord.y;
+        uvArea += 0.5 * std::fabs(u1 * v2 - u2 * v1);
+    }
+
+    if (worldArea > 0.0 && uvArea > 0.0) {
+        mesh.worldUnitsPerUV = static_cast<float>(std::sqrt(worldArea / uvArea));
+    }
+}
 
-    if (!reader.ParseFromFile(filename, reader_config))
+static bool ParseResult(tinyobj::ObjReader& reader, bool parsed, std::string& error)
+{
+    if (!parsed)
     {
         error = reader.Error();
         OutputDebugStringA(("ERROR: " + error + "\n").c_str());
@@ -63,17 +94,66 @@ bool OBJLoader::LoadOBJ(const std::string& filename, std::vector<Mesh>& meshes,
     {
         OutputDebugStringA(("WARNING: " + reader.Warning() + "\n").c_str());
     }
+    return true;
+}
+
+bool OBJLoader::LoadOBJ(const std::string& filename, std::vector<Mesh>& meshes, std::vector<Material>& materials, std::string& error)
+{
+    PROFILE_FUNCTION();
+    OutputDebugStringA("************** OBJLoader started **************\n");
 
+    tinyobj::ObjReaderConfig reader_config;
+    // mtl files are looked up next to the obj
+    size_t separator = filename.find_last_of("\\/");
+    reader_config.mtl_search_path = separator != std::string::npos ? filename.substr(0, separator + 1) : std::string();
+
+    reader_config.triangulate = true;
+
+    tinyobj::ObjReader reader;
+
+    if (!ParseResult(reader, reader.ParseFromFile(filename, reader_config), error)) {
+        return false;
+    }
+    return ConvertReader(reader, meshes, materials);
+}
+
+bool OBJLoader::LoadOBJFromMemory(const std::string& objText, const std::string& mtlText, std::vector<Mesh>& meshes, std::vector<Material>& materials, std::string& error)
+{
+    PROFILE_FUNCTION();
+    OutputDebugStringA("************** OBJLoader started **************\n");
+
+    tinyobj::ObjReaderConfig reader_config;
+    reader_config.triangulate = true;
+
+    tinyobj::ObjReader reader;
+
+    if (!ParseResult(reader, reader.ParseFromString(objText, mtlText, reader_config), error)) {
+        return false;
+    }
+    return ConvertReader(reader, meshes, materials);
+}
+
+bool OBJLoader::ConvertReader(const tinyobj::ObjReader& reader, std::vector<Mesh>& meshes, std::vector<Material>& materials)
+{
     auto& attrib = reader.GetAttrib();
     auto& shapes = reader.GetShapes();
-    auto& materials = reader.GetMaterials();
+    auto& objMaterials = reader.GetMaterials();
 
     std::stringstream debugMsg;
     debugMsg << "loaded: " << shapes.size() << " shapes, "
-        << materials.size() << " materials, "
+        << objMaterials.size() << " materials, "
         << attrib.vertices.size() / 3 << " vertices\n";
     OutputDebugStringA(debugMsg.str().c_str());
 
+    for (const auto& objMaterial : objMaterials)
+    {
+        Material material;
+        material.name = objMaterial.name;
+        material.diffuseTexture = objMaterial.diffuse_texname;
+        material.alphaTexture = objMaterial.alpha_texname;
+        materials.push_back(material);
+    }
+
     for (const auto& shape : shapes)
     {
         Mesh mesh;
@@ -83,8 +163,9 @@ bool OBJLoader::LoadOBJ(const std::string& filename, std::vector<Mesh>& meshes,
         // assign material name if available
         if (!shape.mesh.material_ids.empty() && shape.mesh.material_ids[0] >= 0) {
             int material_id = shape.mesh.material_ids[0];
-            if (material_id < materials.size()) {
-                mesh.materialName = materials[material_id].name;
+            if (material_id < objMaterials.size()) {
+                mesh.materialName = objMaterials[material_id].name;
+                mesh.materialIndex = material_id;
             }
         }
 
@@ -152,6 +233,7 @@ bool OBJLoader::LoadOBJ(const std::string& filename, std::vector<Mesh>& meshes,
 
         // only add the mesh if it has vertices
         if (!mesh.vertices.empty()) {
+            ComputeBoundsAndUVDensity(mesh);
             meshes.push_back(mesh);
         }
     }
@@ -3,22 +3,10 @@
 #include <windows.h>
 #include <vector>
 #include <string>
-#include <DirectxMath.h>
+#include "Mesh.h"
 
+namespace tinyobj { class ObjReader; }
 
-struct Vertex 
-{
-	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT3 normal;
-	DirectX::XMFLOAT2 texCoord;
-};
-
-struct Mesh 
-{
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
-	std::string materialName;
-};
 
 class OBJLoader 
 {
@@ -26,5 +14,21 @@ public:
 	static bool LoadOBJ(
 		const std::string& filename,
 		std::vector<Mesh>& meshes,
+		std::vector<Material>& materials,
+		std::string& error);
+
+	// same as LoadOBJ for an obj and its mtl already in memory, e.g. read
+	// from an asset package
+	static bool LoadOBJFromMemory(
+		const std::string& objText,
+		const std::string& mtlText,
+		std::vector<Mesh>& meshes,
+		std::vector<Material>& materials,
 		std::string& error);
+
+private:
+	static bool ConvertReader(
+		const tinyobj::ObjReader& reader,
+		std::vector<Mesh>& meshes,
+		std::vector<Material>& materials);
 };
\ No newline at end of file
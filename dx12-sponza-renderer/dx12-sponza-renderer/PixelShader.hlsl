@@ -1,9 +1,21 @@
 #include "Constants.hlsl"
 
-static const float3 DEFAULT_COLOR = float3(0.8, 0.8, 0.8);
+// matches TextureStreamer::alphaCutoff, masked mips are built for this value
+static const float ALPHA_CUTOFF = 0.5;
+
 float4 main(PS_INPUT input) : SV_Target
 {
-    float4 textureColor = float4(DEFAULT_COLOR, 1.0);
+    // untextured materials are bound to a light grey default texture.
+    // wrapping happens before the atlas transform, the gradients come from the
+    // unwrapped coordinates so the frac() seam doesn't jump to the smallest mip
+    float2 uv = materialUvOffset + frac(input.texcoord) * materialUvScale;
+    float2 uvDdx = ddx(input.texcoord) * materialUvScale;
+    float2 uvDdy = ddy(input.texcoord) * materialUvScale;
+    float4 textureColor = diffuseTextures.SampleGrad(defaultSampler, float3(uv, materialSlice), uvDdx, uvDdy);
+
+#ifdef ALPHA_TEST
+    clip(textureColor.a - ALPHA_CUTOFF);
+#endif
     
     float3 normal = normalize(input.worldNormal);
     
@@ -0,0 +1,792 @@
+#include "RenderDevice.h"
+#include <algorithm>
+
+namespace
+{
+	const char* GetStateName(RenderResourceState state)
+	{
+		switch (state)
+		{
+		case RenderStateCommon: return "common";
+		case RenderStateCopyDest: return "copy dest";
+		case RenderStateCopySource: return "copy source";
+		case RenderStateGenericRead: return "generic read";
+		case RenderStateVertexAndConstantBuffer: return "vertex and constant buffer";
+		case RenderStateIndexBuffer: return "index buffer";
+		case RenderStateRenderTarget: return "render target";
+		case RenderStateDepthWrite: return "depth write";
+		case RenderStatePixelShaderResource: return "pixel shader resource";
+		default: return "unknown";
+		}
+	}
+
+	void Accumulate(NullRenderDeviceStats& total, const NullRenderDeviceStats& counts)
+	{
+		total.commands += counts.commands;
+		total.draws += counts.draws;
+		total.indices += counts.indices;
+		total.barriers += counts.barriers;
+		total.stateChanges += counts.stateChanges;
+		total.constantBytes += counts.constantBytes;
+		total.copyBytes += counts.copyBytes;
+		total.errors += counts.errors;
+	}
+}
+
+uint32_t GetRenderFormatSize(RenderFormat format)
+{
+	switch (format)
+	{
+	case RenderFormatRGBA8: return 4;
+	case RenderFormatD32: return 4;
+	case RenderFormatR16Uint: return 2;
+	case RenderFormatR32Uint: return 4;
+	default: return 0;
+	}
+}
+
+uint32_t GetTextureRowPitch(uint32_t width, RenderFormat format)
+{
+	return (width * GetRenderFormatSize(format) + 255) & ~255u;
+}
+
+NullRenderDevice::NullRenderDevice()
+	: m_resources(1)
+{
+}
+
+RenderHandle NullRenderDevice::CreateBuffer(const RenderBufferDesc& desc)
+{
+	if (desc.size == 0) {
+		DeviceError("CreateBuffer: empty buffer");
+		return InvalidRenderHandle;
+	}
+	RenderHandle handle = Allocate(KindBuffer, desc.name);
+	Resource& resource = m_resources[GetIndex(handle)];
+	resource.buffer = desc;
+	resource.buffer.name = nullptr; // the caller's string
+	resource.bytes = desc.size;
+	if (desc.memory == RenderMemoryUpload) {
+		resource.memory.assign(static_cast<size_t>(desc.size), 0);
+		resource.state = RenderStateGenericRead;
+	}
+	else {
+		resource.state = RenderStateCopyDest;
+	}
+	m_stats.allocatedBytes += resource.bytes;
+	return handle;
+}
+
+RenderHandle NullRenderDevice::CreateTexture(const RenderTextureDesc& desc)
+{
+	if (desc.width == 0 || desc.height == 0 || desc.mipLevels == 0 || desc.arraySize == 0 ||
+		GetRenderFormatSize(desc.format) == 0) {
+		DeviceError("CreateTexture: bad size or format");
+		return InvalidRenderHandle;
+	}
+	if ((desc.usage & RenderTextureDepthStencil) && desc.format != RenderFormatD32) {
+		DeviceError("CreateTexture: depth stencil textures have to be RenderFormatD32");
+		return InvalidRenderHandle;
+	}
+	RenderHandle handle = Allocate(KindTexture, desc.name);
+	Resource& resource = m_resources[GetIndex(handle)];
+	resource.texture = desc;
+	resource.texture.name = nullptr;
+	resource.state = desc.initialState;
+	for (uint32_t i = 0; i < desc.mipLevels * desc.arraySize; i++) {
+		resource.bytes += GetTextureBytes(desc, i);
+	}
+	m_stats.allocatedBytes += resource.bytes;
+	return handle;
+}
+
+RenderHandle NullRenderDevice::CreatePipeline(const RenderPipelineDesc& desc)
+{
+	// the shaders aren't looked at, headless runs have no compiler for them
+	if (desc.renderTargetFormat != RenderFormatRGBA8 ||
+		(desc.depthFormat != RenderFormatD32 && desc.depthFormat != RenderFormatUnknown)) {
+		DeviceError("CreatePipeline: unsupported target formats");
+		return InvalidRenderHandle;
+	}
+	RenderHandle handle = Allocate(KindPipeline, desc.name);
+	Resource& resource = m_resources[GetIndex(handle)];
+	resource.pipeline = desc;
+	resource.pipeline.name = nullptr;
+	resource.pipeline.vertexShader = RenderShader();
+	resource.pipeline.pixelShader = RenderShader();
+	return handle;
+}
+
+RenderHandle NullRenderDevice::CreateCommandList(uint32_t frameSlots)
+{
+	if (frameSlots == 0) {
+		DeviceError("CreateCommandList: no frame slots");
+		return InvalidRenderHandle;
+	}
+	RenderHandle handle = Allocate(KindCommandList, nullptr);
+	m_resources[GetIndex(handle)].list.slotFenceValues.assign(frameSlots, 0);
+	return handle;
+}
+
+RenderHandle NullRenderDevice::CreateShaderResourceView(RenderHandle texture)
+{
+	Resource* target = Get(texture, KindTexture, "CreateShaderResourceView");
+	if (!target) {
+		return InvalidRenderHandle;
+	}
+	if (!(target->texture.usage & RenderTextureSampled)) {
+		DeviceError("CreateShaderResourceView: " + target->name + " isn't sampled");
+		return InvalidRenderHandle;
+	}
+	RenderHandle handle = Allocate(KindShaderResourceView, nullptr);
+	m_resources[GetIndex(handle)].target = texture;
+	m_resources[GetIndex(texture)].views.push_back(handle);
+	return handle;
+}
+
+RenderHandle NullRenderDevice::CreateRenderTargetView(RenderHandle texture)
+{
+	Resource* target = Get(texture, KindTexture, "CreateRenderTargetView");
+	if (!target) {
+		return InvalidRenderHandle;
+	}
+	if (!(target->texture.usage & RenderTextureRenderTarget)) {
+		DeviceError("CreateRenderTargetView: " + target->name + " isn't a render target");
+		return InvalidRenderHandle;
+	}
+	RenderHandle handle = Allocate(KindRenderTargetView, nullptr);
+	m_resources[GetIndex(handle)].target = texture;
+	m_resources[GetIndex(texture)].views.push_back(handle);
+	return handle;
+}
+
+RenderHandle NullRenderDevice::CreateDepthStencilView(RenderHandle texture)
+{
+	Resource* target = Get(texture, KindTexture, "CreateDepthStencilView");
+	if (!target) {
+		return InvalidRenderHandle;
+	}
+	if (!(target->texture.usage & RenderTextureDepthStencil)) {
+		DeviceError("CreateDepthStencilView: " + target->name + " isn't a depth stencil");
+		return InvalidRenderHandle;
+	}
+	RenderHandle handle = Allocate(KindDepthStencilView, nullptr);
+	m_resources[GetIndex(handle)].target = texture;
+	m_resources[GetIndex(texture)].views.push_back(handle);
+	return handle;
+}
+
+uint64_t NullRenderDevice::GetDescriptorTable(RenderHandle shaderResourceView)
+{
+	if (!Get(shaderResourceView, KindShaderResourceView, "GetDescriptorTable")) {
+		return 0;
+	}
+	return DescriptorTableTag | shaderResourceView;
+}
+
+void NullRenderDevice::Destroy(RenderHandle handle)
+{
+	uint32_t index = GetIndex(handle);
+	if (index == 0 || index >= m_resources.size() || m_resources[index].kind == KindFree ||
+		MakeHandle(index, m_resources[index].generation) != handle) {
+		DeviceError("Destroy: stale or invalid handle");
+		return;
+	}
+	Resource& resource = m_resources[index];
+	if (resource.lastUse > m_completedFenceValue.load(std::memory_order_relaxed)) {
+		DeviceError("Destroy: " + resource.name + " may still be in use by the gpu");
+	}
+	if (resource.kind == KindCommandList && resource.list.open) {
+		DeviceError("Destroy: command list is recording");
+	}
+
+	// views go with their texture
+	std::vector<RenderHandle> views;
+	views.swap(resource.views);
+	for (RenderHandle view : views) {
+		if (Find(view, m_resources[GetIndex(view)].kind)) {
+			Destroy(view);
+		}
+	}
+	if (resource.target != InvalidRenderHandle)
+	{
+		if (Resource* target = Find(resource.target, KindTexture)) {
+			target->views.erase(std::remove(target->views.begin(), target->views.end(), handle), target->views.end());
+		}
+	}
+
+	m_stats.allocatedBytes -= resource.bytes;
+	m_stats.resources--;
+	uint32_t generation = resource.generation + 1;
+	resource = Resource();
+	resource.generation = generation;
+	m_freeIndices.push_back(index);
+}
+
+uint8_t* NullRenderDevice::GetMappedData(RenderHandle buffer)
+{
+	Resource* resource = Get(buffer, KindBuffer, "GetMappedData");
+	if (!resource) {
+		return nullptr;
+	}
+	if (resource->buffer.memory != RenderMemoryUpload) {
+		DeviceError("GetMappedData: " + resource->name + " isn't an upload buffer");
+		return nullptr;
+	}
+	return resource->memory.data();
+}
+
+void NullRenderDevice::Begin(RenderHandle list, uint32_t frameSlot)
+{
+	Resource* resource = Find(list, KindCommandList);
+	if (!resource) {
+		std::lock_guard<std::mutex> lock(m_errorMutex);
+		DeviceError("Begin: invalid command list");
+		return;
+	}
+	CommandList& commandList = resource->list;
+	bool wasOpen = commandList.open;
+	bool slotInRange = frameSlot < commandList.slotFenceValues.size();
+	// the allocator would be reset under the gpu
+	bool slotBusy = slotInRange &&
+		commandList.slotFenceValues[frameSlot] > m_completedFenceValue.load(std::memory_order_acquire);
+
+	// everything since the last Begin goes, submitted or not
+	std::vector<uint64_t> slotFenceValues;
+	slotFenceValues.swap(commandList.slotFenceValues);
+	std::vector<StateEvent> events;
+	events.swap(commandList.events);
+	events.clear();
+	commandList = CommandList();
+	commandList.slotFenceValues.swap(slotFenceValues);
+	commandList.events.swap(events);
+
+	if (wasOpen) {
+		ListError(commandList, "Begin: the list is already recording");
+	}
+	if (!slotInRange) {
+		ListError(commandList, "Begin: frame slot out of range");
+		frameSlot = 0;
+	}
+	else if (slotBusy) {
+		ListError(commandList, "Begin: the frame slot's last submission hasn't completed");
+	}
+	commandList.frameSlot = frameSlot;
+	commandList.open = true;
+}
+
+void NullRenderDevice::Close(RenderHandle list)
+{
+	if (CommandList* commandList = Recording(list, "Close"))
+	{
+		commandList->open = false;
+		commandList->closed = true;
+	}
+}
+
+void NullRenderDevice::Barrier(RenderHandle list, RenderHandle resource, RenderResourceState before, RenderResourceState after)
+{
+	CommandList* commandList = Recording(list, "Barrier");
+	if (!commandList) {
+		return;
+	}
+	commandList->counts.commands++;
+	commandList->counts.barriers++;
+	Resource* target = Find(resource, KindBuffer);
+	if (!target) {
+		target = Get(*commandList, resource, KindTexture, "Barrier");
+	}
+	if (!target) {
+		return;
+	}
+	if (target->kind == KindBuffer && target->buffer.memory == RenderMemoryUpload) {
+		ListError(*commandList, "Barrier: upload buffer " + target->name + " can't transition");
+		return;
+	}
+	if (before == after) {
+		ListError(*commandList, "Barrier: " + target->name + " transitions to the state it's in");
+		return;
+	}
+	commandList->events.push_back({ resource, before, after, true });
+}
+
+void NullRenderDevice::CopyBuffer(RenderHandle list, RenderHandle destination, uint64_t destinationOffset,
+	RenderHandle source, uint64_t sourceOffset, uint64_t size)
+{
+	CommandList* commandList = Recording(list, "CopyBuffer");
+	if (!commandList) {
+		return;
+	}
+	commandList->counts.commands++;
+	Resource* target = Get(*commandList, destination, KindBuffer, "CopyBuffer");
+	Resource* from = Get(*commandList, source, KindBuffer, "CopyBuffer");
+	if (!target || !from) {
+		return;
+	}
+	if (destination == source) {
+		ListError(*commandList, "CopyBuffer: source and destination are the same buffer");
+	}
+	if (target->buffer.memory == RenderMemoryUpload) {
+		ListError(*commandList, "CopyBuffer: the gpu can't write upload buffer " + target->name);
+	}
+	if (destinationOffset + size > target->buffer.size || sourceOffset + size > from->buffer.size) {
+		ListError(*commandList, "CopyBuffer: range past the end of " + target->name + " or " + from->name);
+		return;
+	}
+	commandList->counts.copyBytes += size;
+	Use(*commandList, destination, RenderStateCopyDest);
+	if (from->buffer.memory != RenderMemoryUpload) {
+		Use(*commandList, source, RenderStateCopySource);
+	}
+}
+
+void NullRenderDevice::CopyBufferToTexture(RenderHandle list, RenderHandle destination, uint32_t subresource,
+	RenderHandle source, uint64_t sourceOffset)
+{
+	CommandList* commandList = Recording(list, "CopyBufferToTexture");
+	if (!commandList) {
+		return;
+	}
+	commandList->counts.commands++;
+	Resource* target = Get(*commandList, destination, KindTexture, "CopyBufferToTexture");
+	Resource* from = Get(*commandList, source, KindBuffer, "CopyBufferToTexture");
+	if (!target || !from) {
+		return;
+	}
+	if (subresource >= target->texture.mipLevels * target->texture.arraySize) {
+		ListError(*commandList, "CopyBufferToTexture: subresource out of range of " + target->name);
+		return;
+	}
+	uint64_t size = GetTextureBytes(target->texture, subresource);
+	if (sourceOffset % 512 != 0 || sourceOffset + size > from->buffer.size) {
+		ListError(*commandList, "CopyBufferToTexture: source range of " + from->name + " misaligned or too short");
+		return;
+	}
+	commandList->counts.copyBytes += size;
+	Use(*commandList, destination, RenderStateCopyDest);
+	if (from->buffer.memory != RenderMemoryUpload) {
+		Use(*commandList, source, RenderStateCopySource);
+	}
+}
+
+void NullRenderDevice::SetRenderTarget(RenderHandle list, RenderHandle renderTargetView, RenderHandle depthStencilView)
+{
+	CommandList* commandList = Recording(list, "SetRenderTarget");
+	if (!commandList) {
+		return;
+	}
+	commandList->counts.commands++;
+	commandList->counts.stateChanges++;
+	Resource* view = Get(*commandList, renderTargetView, KindRenderTargetView, "SetRenderTarget");
+	commandList->renderTarget = view ? view->target : InvalidRenderHandle;
+	commandList->depthStencil = InvalidRenderHandle;
+	if (depthStencilView != InvalidRenderHandle)
+	{
+		view = Get(*commandList, depthStencilView, KindDepthStencilView, "SetRenderTarget");
+		commandList->depthStencil = view ? view->target : InvalidRenderHandle;
+	}
+	commandList->unchecked |= BindingRenderTarget | BindingDepthStencil;
+}
+
+void NullRenderDevice::ClearRenderTarget(RenderHandle list, RenderHandle renderTargetView, const float*)
+{
+	CommandList* commandList = Recording(list, "ClearRenderTarget");
+	if (!commandList) {
+		return;
+	}
+	commandList->counts.commands++;
+	if (Resource* view = Get(*commandList, renderTargetView, KindRenderTargetView, "ClearRenderTarget")) {
+		Use(*commandList, view->target, RenderStateRenderTarget);
+	}
+}
+
+void NullRenderDevice::ClearDepth(RenderHandle list, RenderHandle depthStencilView, float depth)
+{
+	CommandList* commandList = Recording(list, "ClearDepth");
+	if (!commandList) {
+		return;
+	}
+	commandList->counts.commands++;
+	if (depth < 0.0f || depth > 1.0f) {
+		ListError(*commandList, "ClearDepth: depth outside [0, 1]");
+	}
+	if (Resource* view = Get(*commandList, depthStencilView, KindDepthStencilView, "ClearDepth")) {
+		Use(*commandList, view->target, RenderStateDepthWrite);
+	}
+}
+
+void NullRenderDevice::SetViewport(RenderHandle list, uint32_t width, uint32_t height)
+{
+	CommandList* commandList = Recording(list, "SetViewport");
+	if (!commandList) {
+		return;
+	}
+	commandList->counts.commands++;
+	commandList->counts.stateChanges++;
+	if (width == 0 || height == 0) {
+		ListError(*commandList, "SetViewport: empty viewport");
+	}
+	commandList->viewport = true;
+}
+
+void NullRenderDevice::SetPipeline(RenderHandle list, RenderHandle pipeline)
+{
+	CommandList* commandList = Recording(list, "SetPipeline");
+	if (!commandList) {
+		return;
+	}
+	commandList->counts.commands++;
+	commandList->counts.stateChanges++;
+	commandList->pipeline = Get(*commandList, pipeline, KindPipeline, "SetPipeline") ? pipeline : InvalidRenderHandle;
+}
+
+void NullRenderDevice::SetConstantBuffer(RenderHandle list, uint32_t slot, RenderHandle buffer, uint64_t offset)
+{
+	CommandList* commandList = Recording(list, "SetConstantBuffer");
+	if (!commandList) {
+		return;
+	}
+	commandList->counts.commands++;
+	commandList->counts.stateChanges++;
+	if (slot > LightConstantsSlot) {
+		ListError(*commandList, "SetConstantBuffer: the root layout has two constant buffers");
+		return;
+	}
+	Resource* resource = Get(*commandList, buffer, KindBuffer, "SetConstantBuffer");
+	commandList->constantBuffers[slot] = InvalidRenderHandle;
+	if (!resource) {
+		return;
+	}
+	if (!(resource->buffer.usage & RenderBufferConstant)) {
+		ListError(*commandList, "SetConstantBuffer: " + resource->name + " isn't a constant buffer");
+	}
+	if (offset % 256 != 0 || offset + 256 > resource->buffer.size) {
+		ListError(*commandList, "SetConstantBuffer: offset into " + resource->name + " misaligned or past the end");
+	}
+	commandList->constantBuffers[slot] = buffer;
+	commandList->unchecked |= BindingConstantBuffers;
+}
+
+void NullRenderDevice::SetDescriptorTable(RenderHandle list, uint64_t descriptorTable)
+{
+	CommandList* commandList = Recording(list, "SetDescriptorTable");
+	if (!commandList) {
+		return;
+	}
+	commandList->counts.commands++;
+	commandList->counts.stateChanges++;
+	commandList->texture = InvalidRenderHandle;
+	if ((descriptorTable & ~0xffffffffull) != DescriptorTableTag) {
+		ListError(*commandList, "SetDescriptorTable: not a table from GetDescriptorTable");
+		return;
+	}
+	RenderHandle view = static_cast<RenderHandle>(descriptorTable);
+	if (Resource* resource = Get(*commandList, view, KindShaderResourceView, "SetDescriptorTable")) {
+		commandList->texture = resource->target;
+	}
+	commandList->unchecked |= BindingTable;
+}
+
+void NullRenderDevice::SetConstants(RenderHandle list, const uint32_t* constants, uint32_t count)
+{
+	CommandList* commandList = Recording(list, "SetConstants");
+	if (!commandList) {
+		return;
+	}
+	commandList->counts.commands++;
+	if (!constants || count == 0 || count > MaxRootConstants) {
+		ListError(*commandList, "SetConstants: no constants or more than the root layout has");
+		return;
+	}
+	commandList->counts.constantBytes += count * sizeof(uint32_t);
+	commandList->constants = count;
+}
+
+void NullRenderDevice::SetVertexBuffer(RenderHandle list, RenderHandle buffer, uint32_t stride)
+{
+	CommandList* commandList = Recording(list, "SetVertexBuffer");
+	if (!commandList) {
+		return;
+	}
+	commandList->counts.commands++;
+	commandList->counts.stateChanges++;
+	commandList->vertexBuffer = InvalidRenderHandle;
+	Resource* resource = Get(*commandList, buffer, KindBuffer, "SetVertexBuffer");
+	if (!resource) {
+		return;
+	}
+	if (!(resource->buffer.usage & RenderBufferVertex) || stride == 0) {
+		ListError(*commandList, "SetVertexBuffer: " + resource->name + " isn't a vertex buffer");
+		return;
+	}
+	commandList->vertexBuffer = buffer;
+	commandList->unchecked |= BindingVertexBuffer;
+}
+
+void NullRenderDevice::SetIndexBuffer(RenderHandle list, RenderHandle buffer, RenderFormat format)
+{
+	CommandList* commandList = Recording(list, "SetIndexBuffer");
+	if (!commandList) {
+		return;
+	}
+	commandList->counts.commands++;
+	commandList->counts.stateChanges++;
+	commandList->indexBuffer = InvalidRenderHandle;
+	Resource* resource = Get(*commandList, buffer, KindBuffer, "SetIndexBuffer");
+	if (!resource) {
+		return;
+	}
+	if (!(resource->buffer.usage & RenderBufferIndex) ||
+		(format != RenderFormatR16Uint && format != RenderFormatR32Uint)) {
+		ListError(*commandList, "SetIndexBuffer: " + resource->name + " isn't an index buffer or the format isn't an index format");
+		return;
+	}
+	commandList->indexBuffer = buffer;
+	commandList->indexSize = GetRenderFormatSize(format);
+	commandList->unchecked |= BindingIndexBuffer;
+}
+
+void NullRenderDevice::DrawIndexed(RenderHandle list, uint32_t indexCount, uint32_t firstIndex, int32_t)
+{
+	CommandList* commandList = Recording(list, "DrawIndexed");
+	if (!commandList) {
+		return;
+	}
+	CommandList& state = *commandList;
+	state.counts.commands++;
+	state.counts.draws++;
+	state.counts.indices += indexCount;
+
+	// every error names the first thing missing, one per draw is enough
+	Resource* pipeline = Find(state.pipeline, KindPipeline);
+	Resource* renderTarget = Find(state.renderTarget, KindTexture);
+	Resource* indexBuffer = Find(state.indexBuffer, KindBuffer);
+	if (!pipeline) {
+		ListError(state, "DrawIndexed: no pipeline");
+		return;
+	}
+	if (!renderTarget || !state.viewport) {
+		ListError(state, "DrawIndexed: no render target or viewport");
+		return;
+	}
+	if (!Find(state.vertexBuffer, KindBuffer) || !indexBuffer) {
+		ListError(state, "DrawIndexed: no vertex or index buffer");
+		return;
+	}
+	if (!Find(state.constantBuffers[0], KindBuffer) || !Find(state.constantBuffers[1], KindBuffer) ||
+		!Find(state.texture, KindTexture) || state.constants == 0) {
+		ListError(state, "DrawIndexed: root layout not fully bound");
+		return;
+	}
+	if (renderTarget->texture.format != pipeline->pipeline.renderTargetFormat) {
+		ListError(state, "DrawIndexed: render target format doesn't match " + pipeline->name);
+	}
+	if ((pipeline->pipeline.depthFormat != RenderFormatUnknown) != (state.depthStencil != InvalidRenderHandle)) {
+		ListError(state, "DrawIndexed: depth stencil doesn't match " + pipeline->name);
+	}
+	if (uint64_t(firstIndex) + indexCount > indexBuffer->buffer.size / state.indexSize) {
+		ListError(state, "DrawIndexed: indices past the end of " + indexBuffer->name);
+	}
+
+	// what was bound since the last draw has to be in the right state now
+	if (state.unchecked & BindingRenderTarget) {
+		Use(state, state.renderTarget, RenderStateRenderTarget);
+	}
+	if ((state.unchecked & BindingDepthStencil) && state.depthStencil != InvalidRenderHandle) {
+		Use(state, state.depthStencil, RenderStateDepthWrite);
+	}
+	if (state.unchecked & BindingVertexBuffer) {
+		Use(state, state.vertexBuffer, RenderStateVertexAndConstantBuffer);
+	}
+	if (state.unchecked & BindingIndexBuffer) {
+		Use(state, state.indexBuffer, RenderStateIndexBuffer);
+	}
+	if (state.unchecked & BindingConstantBuffers) {
+		for (RenderHandle buffer : state.constantBuffers) {
+			Use(state, buffer, RenderStateVertexAndConstantBuffer);
+		}
+	}
+	if (state.unchecked & BindingTable) {
+		Use(state, state.texture, RenderStatePixelShaderResource);
+	}
+	state.unchecked = 0;
+}
+
+void NullRenderDevice::Submit(const RenderHandle* lists, uint32_t count)
+{
+	m_stats.submits++;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Resource* resource = Get(lists[i], KindCommandList, "Submit");
+		if (!resource) {
+			continue;
+		}
+		CommandList& list = resource->list;
+		if (list.open || !list.closed) {
+			DeviceError("Submit: command list isn't closed");
+			continue;
+		}
+		m_stats.commandLists++;
+		Accumulate(m_stats, list.counts);
+		for (const std::string& error : list.errors) {
+			if (m_errors.size() < MaxErrorMessages) {
+				m_errors.push_back(error);
+			}
+		}
+		list.counts = NullRenderDeviceStats();
+		list.errors.clear();
+
+		// the states every list leaves behind are what the next one starts from
+		for (const StateEvent& event : list.events)
+		{
+			Resource* target = Find(event.resource, KindBuffer);
+			if (!target) {
+				target = Find(event.resource, KindTexture);
+			}
+			if (!target) {
+				DeviceError("Submit: a resource the list uses was destroyed");
+				continue;
+			}
+			if (target->kind == KindBuffer && target->buffer.memory == RenderMemoryUpload) {
+				continue;
+			}
+			if (target->state != event.before)
+			{
+				DeviceError(std::string(event.transition ? "Submit: barrier expects " : "Submit: use needs ") +
+					target->name + " in " + GetStateName(event.before) + ", it's in " + GetStateName(target->state));
+			}
+			if (event.transition) {
+				target->state = event.after;
+			}
+			target->lastUse = m_nextFenceValue;
+		}
+		list.slotFenceValues[list.frameSlot] = m_nextFenceValue;
+		resource->lastUse = m_nextFenceValue;
+	}
+}
+
+uint64_t NullRenderDevice::Signal()
+{
+	uint64_t fenceValue = m_nextFenceValue++;
+	m_pending.push_back(fenceValue);
+	return fenceValue;
+}
+
+void NullRenderDevice::WaitForFenceValue(uint64_t fenceValue)
+{
+	if (fenceValue >= m_nextFenceValue) {
+		// a gpu would never get there
+		DeviceError("WaitForFenceValue: the value was never signaled");
+	}
+	while (m_completedFenceValue.load(std::memory_order_relaxed) < fenceValue && !m_pending.empty()) {
+		CompleteSubmissions(1);
+	}
+}
+
+void NullRenderDevice::CompleteSubmissions(uint32_t count)
+{
+	for (uint32_t i = 0; i < count && !m_pending.empty(); i++)
+	{
+		m_completedFenceValue.store(m_pending.front(), std::memory_order_release);
+		m_pending.pop_front();
+	}
+}
+
+NullRenderDeviceStats NullRenderDevice::GetStats() const
+{
+	return m_stats;
+}
+
+RenderHandle NullRenderDevice::Allocate(Kind kind, const char* name)
+{
+	uint32_t index;
+	if (!m_freeIndices.empty()) {
+		index = m_freeIndices.back();
+		m_freeIndices.pop_back();
+	}
+	else {
+		index = static_cast<uint32_t>(m_resources.size());
+		m_resources.emplace_back();
+	}
+	Resource& resource = m_resources[index];
+	resource.kind = kind;
+	m_stats.resources++;
+	RenderHandle handle = MakeHandle(index, resource.generation);
+	resource.name = name ? name : "resource " + std::to_string(handle);
+	return handle;
+}
+
+NullRenderDevice::Resource* NullRenderDevice::Find(RenderHandle handle, Kind kind)
+{
+	uint32_t index = GetIndex(handle);
+	if (index == 0 || index >= m_resources.size()) {
+		return nullptr;
+	}
+	Resource& resource = m_resources[index];
+	if (resource.kind != kind || MakeHandle(index, resource.generation) != handle) {
+		return nullptr;
+	}
+	return &resource;
+}
+
+NullRenderDevice::Resource* NullRenderDevice::Get(RenderHandle handle, Kind kind, const char* call)
+{
+	Resource* resource = Find(handle, kind);
+	if (!resource) {
+		DeviceError(std::string(call) + ": stale handle or the wrong kind of resource");
+	}
+	return resource;
+}
+
+NullRenderDevice::Resource* NullRenderDevice::Get(CommandList& list, RenderHandle handle, Kind kind, const char* call)
+{
+	Resource* resource = Find(handle, kind);
+	if (!resource) {
+		ListError(list, std::string(call) + ": stale handle or the wrong kind of resource");
+	}
+	return resource;
+}
+
+NullRenderDevice::CommandList* NullRenderDevice::Recording(RenderHandle list, const char* call)
+{
+	Resource* resource = Find(list, KindCommandList);
+	if (!resource) {
+		std::lock_guard<std::mutex> lock(m_errorMutex);
+		DeviceError(std::string(call) + ": invalid command list");
+		return nullptr;
+	}
+	if (!resource->list.open) {
+		ListError(resource->list, std::string(call) + ": the list isn't recording");
+		return nullptr;
+	}
+	return &resource->list;
+}
+
+void NullRenderDevice::DeviceError(const std::string& message)
+{
+	m_stats.errors++;
+	if (m_errors.size() < MaxErrorMessages) {
+		m_errors.push_back(message);
+	}
+}
+
+void NullRenderDevice::ListError(CommandList& list, const std::string& message)
+{
+	list.counts.errors++;
+	if (list.errors.size() < MaxErrorMessages) {
+		list.errors.push_back(message);
+	}
+}
+
+void NullRenderDevice::Use(CommandList& list, RenderHandle resource, RenderResourceState state)
+{
+	list.events.push_back({ resource, state, state, false });
+}
+
+uint64_t NullRenderDevice::GetTextureBytes(const RenderTextureDesc& desc, uint32_t subresource)
+{
+	uint32_t mip = subresource % desc.mipLevels;
+	uint32_t width = std::max(1u, desc.width >> mip);
+	uint32_t height = std::max(1u, desc.height >> mip);
+	return uint64_t(GetTextureRowPitch(width, desc.format)) * height;
+}
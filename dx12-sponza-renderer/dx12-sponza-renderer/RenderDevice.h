@@ -0,0 +1,354 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <cstdint>
+
+// the part of a graphics api the renderer uses, behind handles, so frame
+// code runs on D3D12RenderDevice or without a gpu on NullRenderDevice.
+// resources, views and pipelines are created and destroyed on one thread
+// while no list is recording. lists are recorded on any thread, each by one
+// thread at a time, and submitted from the thread that owns the device.
+//
+// every pipeline shares the renderer's root layout (see Constants.hlsl):
+//   constant buffers b0 (matrices) and b1 (light), one srv table at t0 viewed
+//   as a Texture2DArray, up to MaxRootConstants root constants at b3 and a
+//   linear wrap sampler at s0. vertices are the OBJLoader Vertex layout.
+
+typedef uint32_t RenderHandle;
+const RenderHandle InvalidRenderHandle = 0;
+
+enum RenderFormat : uint32_t
+{
+	RenderFormatUnknown,
+	RenderFormatRGBA8,
+	RenderFormatD32,
+	RenderFormatR16Uint,
+	RenderFormatR32Uint,
+};
+
+// where a buffer lives. upload buffers are cpu writable and stay mapped,
+// gpu buffers are filled by copies
+enum RenderMemory : uint32_t
+{
+	RenderMemoryGpu,
+	RenderMemoryUpload,
+};
+
+enum RenderBufferUsage : uint32_t
+{
+	RenderBufferVertex = 1 << 0,
+	RenderBufferIndex = 1 << 1,
+	RenderBufferConstant = 1 << 2,
+	RenderBufferCopySource = 1 << 3,
+};
+
+enum RenderTextureUsage : uint32_t
+{
+	RenderTextureSampled = 1 << 0,
+	RenderTextureRenderTarget = 1 << 1,
+	RenderTextureDepthStencil = 1 << 2,
+};
+
+// resource states as D3D12 has them. upload buffers are always in
+// RenderStateGenericRead and never transition
+enum RenderResourceState : uint32_t
+{
+	RenderStateCommon, // also present
+	RenderStateCopyDest,
+	RenderStateCopySource,
+	RenderStateGenericRead,
+	RenderStateVertexAndConstantBuffer,
+	RenderStateIndexBuffer,
+	RenderStateRenderTarget,
+	RenderStateDepthWrite,
+	RenderStatePixelShaderResource,
+	RenderStateCount
+};
+
+// gpu buffers start in RenderStateCopyDest
+struct RenderBufferDesc
+{
+	uint64_t size = 0;
+	RenderMemory memory = RenderMemoryGpu;
+	uint32_t usage = 0; // RenderBufferUsage
+	const char* name = nullptr;
+};
+
+struct RenderTextureDesc
+{
+	uint32_t width = 1;
+	uint32_t height = 1;
+	uint32_t mipLevels = 1;
+	uint32_t arraySize = 1;
+	RenderFormat format = RenderFormatRGBA8;
+	uint32_t usage = RenderTextureSampled; // RenderTextureUsage
+	RenderResourceState initialState = RenderStateCopyDest;
+	float clearColor[4] = {}; // render targets clear fastest to this
+	float clearDepth = 1.0f;
+	const char* name = nullptr;
+};
+
+// bytes per pixel, 0 for RenderFormatUnknown
+uint32_t GetRenderFormatSize(RenderFormat format);
+// rows of texture data in buffers are this far apart, D3D12 wants them
+// 256 byte aligned
+uint32_t GetTextureRowPitch(uint32_t width, RenderFormat format);
+
+struct RenderShader
+{
+	const void* code = nullptr;
+	size_t size = 0;
+};
+
+struct RenderPipelineDesc
+{
+	RenderShader vertexShader;
+	RenderShader pixelShader;
+	RenderFormat renderTargetFormat = RenderFormatRGBA8;
+	RenderFormat depthFormat = RenderFormatD32;
+	const char* name = nullptr;
+};
+
+class RenderDevice
+{
+public:
+	static const uint32_t MaxRootConstants = 8;
+	// root parameters of the shared layout
+	static const uint32_t MatrixConstantsSlot = 0;
+	static const uint32_t LightConstantsSlot = 1;
+
+	virtual ~RenderDevice() = default;
+
+	// InvalidRenderHandle on failure
+	virtual RenderHandle CreateBuffer(const RenderBufferDesc& desc) = 0;
+	virtual RenderHandle CreateTexture(const RenderTextureDesc& desc) = 0;
+	virtual RenderHandle CreatePipeline(const RenderPipelineDesc& desc) = 0;
+	// frameSlots allocators, Begin picks one. a slot is reused once the frame
+	// that last recorded with it has completed
+	virtual RenderHandle CreateCommandList(uint32_t frameSlots) = 0;
+
+	// views into the device's descriptor heaps, freed with their texture
+	virtual RenderHandle CreateShaderResourceView(RenderHandle texture) = 0;
+	virtual RenderHandle CreateRenderTargetView(RenderHandle texture) = 0;
+	virtual RenderHandle CreateDepthStencilView(RenderHandle texture) = 0;
+	// what SetDescriptorTable and DrawItem::descriptorTable take for a view
+	virtual uint64_t GetDescriptorTable(RenderHandle shaderResourceView) = 0;
+
+	// any handle. the gpu has to be done with it
+	virtual void Destroy(RenderHandle handle) = 0;
+
+	// upload buffers only, valid until the buffer is destroyed
+	virtual uint8_t* GetMappedData(RenderHandle buffer) = 0;
+
+	// recording
+	virtual void Begin(RenderHandle list, uint32_t frameSlot) = 0;
+	virtual void Close(RenderHandle list) = 0;
+	virtual void Barrier(RenderHandle list, RenderHandle resource, RenderResourceState before, RenderResourceState after) = 0;
+	virtual void CopyBuffer(RenderHandle list, RenderHandle destination, uint64_t destinationOffset,
+		RenderHandle source, uint64_t sourceOffset, uint64_t size) = 0;
+	// one subresource, rows GetTextureRowPitch apart from a 512 byte aligned
+	// source offset
+	virtual void CopyBufferToTexture(RenderHandle list, RenderHandle destination, uint32_t subresource,
+		RenderHandle source, uint64_t sourceOffset) = 0;
+	virtual void SetRenderTarget(RenderHandle list, RenderHandle renderTargetView, RenderHandle depthStencilView) = 0;
+	virtual void ClearRenderTarget(RenderHandle list, RenderHandle renderTargetView, const float color[4]) = 0;
+	virtual void ClearDepth(RenderHandle list, RenderHandle depthStencilView, float depth) = 0;
+	// viewport and scissor cover the rectangle
+	virtual void SetViewport(RenderHandle list, uint32_t width, uint32_t height) = 0;
+	virtual void SetPipeline(RenderHandle list, RenderHandle pipeline) = 0;
+	virtual void SetConstantBuffer(RenderHandle list, uint32_t slot, RenderHandle buffer, uint64_t offset) = 0;
+	virtual void SetDescriptorTable(RenderHandle list, uint64_t descriptorTable) = 0;
+	virtual void SetConstants(RenderHandle list, const uint32_t* constants, uint32_t count) = 0;
+	virtual void SetVertexBuffer(RenderHandle list, RenderHandle buffer, uint32_t stride) = 0;
+	virtual void SetIndexBuffer(RenderHandle list, RenderHandle buffer, RenderFormat format) = 0;
+	virtual void DrawIndexed(RenderHandle list, uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex) = 0;
+
+	// queue. lists run in order, Signal returns the value the queue's fence
+	// reaches once everything submitted before it is done
+	virtual void Submit(const RenderHandle* lists, uint32_t count) = 0;
+	virtual uint64_t Signal() = 0;
+	virtual uint64_t GetCompletedFenceValue() = 0;
+	virtual void WaitForFenceValue(uint64_t fenceValue) = 0;
+};
+
+struct NullRenderDeviceStats
+{
+	uint64_t submits = 0;
+	uint64_t commandLists = 0; // submitted
+	uint64_t commands = 0;
+	uint64_t draws = 0;
+	uint64_t indices = 0;
+	uint64_t barriers = 0;
+	uint64_t stateChanges = 0; // pipelines, tables, buffers and targets set
+	uint64_t constantBytes = 0; // root constants
+	uint64_t copyBytes = 0;
+	uint64_t allocatedBytes = 0; // buffers and textures alive
+	uint32_t resources = 0; // alive, views and lists included
+	uint64_t errors = 0;
+};
+
+// records nothing for a gpu. it checks every call the way the D3D12 debug
+// layer would for the rules frame code depends on: handles and their kinds,
+// list and allocator lifetimes, resource states at submission, copy and
+// index ranges and draws with missing state, and counts commands and bytes.
+// upload buffers are real memory, copies into gpu resources only count.
+// submissions complete when a fence value is waited on or with
+// CompleteSubmissions, so any gpu timeline can be replayed.
+class NullRenderDevice : public RenderDevice
+{
+public:
+	static const uint32_t MaxErrorMessages = 64;
+
+	NullRenderDevice();
+
+	RenderHandle CreateBuffer(const RenderBufferDesc& desc) override;
+	RenderHandle CreateTexture(const RenderTextureDesc& desc) override;
+	RenderHandle CreatePipeline(const RenderPipelineDesc& desc) override;
+	RenderHandle CreateCommandList(uint32_t frameSlots) override;
+	RenderHandle CreateShaderResourceView(RenderHandle texture) override;
+	RenderHandle CreateRenderTargetView(RenderHandle texture) override;
+	RenderHandle CreateDepthStencilView(RenderHandle texture) override;
+	uint64_t GetDescriptorTable(RenderHandle shaderResourceView) override;
+	void Destroy(RenderHandle handle) override;
+	uint8_t* GetMappedData(RenderHandle buffer) override;
+
+	void Begin(RenderHandle list, uint32_t frameSlot) override;
+	void Close(RenderHandle list) override;
+	void Barrier(RenderHandle list, RenderHandle resource, RenderResourceState before, RenderResourceState after) override;
+	void CopyBuffer(RenderHandle list, RenderHandle destination, uint64_t destinationOffset,
+		RenderHandle source, uint64_t sourceOffset, uint64_t size) override;
+	void CopyBufferToTexture(RenderHandle list, RenderHandle destination, uint32_t subresource,
+		RenderHandle source, uint64_t sourceOffset) override;
+	void SetRenderTarget(RenderHandle list, RenderHandle renderTargetView, RenderHandle depthStencilView) override;
+	void ClearRenderTarget(RenderHandle list, RenderHandle renderTargetView, const float color[4]) override;
+	void ClearDepth(RenderHandle list, RenderHandle depthStencilView, float depth) override;
+	void SetViewport(RenderHandle list, uint32_t width, uint32_t height) override;
+	void SetPipeline(RenderHandle list, RenderHandle pipeline) override;
+	void SetConstantBuffer(RenderHandle list, uint32_t slot, RenderHandle buffer, uint64_t offset) override;
+	void SetDescriptorTable(RenderHandle list, uint64_t descriptorTable) override;
+	void SetConstants(RenderHandle list, const uint32_t* constants, uint32_t count) override;
+	void SetVertexBuffer(RenderHandle list, RenderHandle buffer, uint32_t stride) override;
+	void SetIndexBuffer(RenderHandle list, RenderHandle buffer, RenderFormat format) override;
+	void DrawIndexed(RenderHandle list, uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex) override;
+
+	void Submit(const RenderHandle* lists, uint32_t count) override;
+	uint64_t Signal() override;
+	uint64_t GetCompletedFenceValue() override { return m_completedFenceValue.load(std::memory_order_acquire); }
+	void WaitForFenceValue(uint64_t fenceValue) override;
+
+	// finishes up to count of the oldest signals
+	void CompleteSubmissions(uint32_t count);
+
+	NullRenderDeviceStats GetStats() const;
+	// the first MaxErrorMessages, stats count all of them
+	const std::vector<std::string>& GetErrors() const { return m_errors; }
+
+private:
+	static const uint64_t DescriptorTableTag = 0x5244ull << 32; // the table of view handle h is tag | h
+
+	enum Binding : uint32_t
+	{
+		BindingRenderTarget = 1 << 0,
+		BindingDepthStencil = 1 << 1,
+		BindingVertexBuffer = 1 << 2,
+		BindingIndexBuffer = 1 << 3,
+		BindingConstantBuffers = 1 << 4,
+		BindingTable = 1 << 5,
+	};
+
+	enum Kind : uint32_t
+	{
+		KindFree,
+		KindBuffer,
+		KindTexture,
+		KindPipeline,
+		KindCommandList,
+		KindShaderResourceView,
+		KindRenderTargetView,
+		KindDepthStencilView,
+	};
+
+	// a state a resource has to be in when the list runs, or a transition
+	struct StateEvent
+	{
+		RenderHandle resource;
+		RenderResourceState before; // required state for a use
+		RenderResourceState after;
+		bool transition;
+	};
+
+	struct CommandList
+	{
+		std::vector<uint64_t> slotFenceValues; // when each allocator was last submitted
+		uint32_t frameSlot = 0;
+		bool open = false;
+		bool closed = false; // closed since the last Begin, ready to submit
+		std::vector<StateEvent> events;
+		std::vector<std::string> errors;
+		NullRenderDeviceStats counts; // since Begin
+
+		// bound state, views resolved to their textures. the states of what's
+		// bound are required at the next draw
+		RenderHandle pipeline = InvalidRenderHandle;
+		RenderHandle renderTarget = InvalidRenderHandle;
+		RenderHandle depthStencil = InvalidRenderHandle;
+		RenderHandle constantBuffers[2] = {};
+		RenderHandle vertexBuffer = InvalidRenderHandle;
+		RenderHandle indexBuffer = InvalidRenderHandle;
+		RenderHandle texture = InvalidRenderHandle; // of the descriptor table
+		uint32_t indexSize = 0;
+		uint32_t constants = 0;
+		bool viewport = false;
+		uint32_t unchecked = 0; // Binding bits bound since the last draw
+	};
+
+	struct Resource
+	{
+		Kind kind = KindFree;
+		uint32_t generation = 0; // bumped on Destroy so stale handles are caught
+		std::string name;
+		RenderBufferDesc buffer;
+		RenderTextureDesc texture;
+		RenderPipelineDesc pipeline;
+		uint64_t bytes = 0;
+		std::vector<uint8_t> memory; // upload buffers
+		RenderResourceState state = RenderStateCommon; // at the end of the last submission
+		RenderHandle target = InvalidRenderHandle; // the texture a view is of
+		std::vector<RenderHandle> views;
+		uint64_t lastUse = 0; // fence value of the last submission using it
+		CommandList list;
+	};
+
+	static RenderHandle MakeHandle(uint32_t index, uint32_t generation) { return (generation << 20) | index; }
+	static uint32_t GetIndex(RenderHandle handle) { return handle & 0xfffff; }
+
+	// named after name, or the handle without one
+	RenderHandle Allocate(Kind kind, const char* name);
+	// nullptr when handle isn't a live resource of kind
+	Resource* Find(RenderHandle handle, Kind kind);
+	// Find, reporting a miss to the device
+	Resource* Get(RenderHandle handle, Kind kind, const char* call);
+	// Find, reporting a miss to the list
+	Resource* Get(CommandList& list, RenderHandle handle, Kind kind, const char* call);
+	// the open list, nullptr and an error otherwise
+	CommandList* Recording(RenderHandle list, const char* call);
+	void DeviceError(const std::string& message);
+	static void ListError(CommandList& list, const std::string& message);
+	static void Use(CommandList& list, RenderHandle resource, RenderResourceState state);
+	// a subresource with its rows GetTextureRowPitch apart
+	static uint64_t GetTextureBytes(const RenderTextureDesc& desc, uint32_t subresource);
+
+	std::vector<Resource> m_resources; // handle index 0 is never used
+	std::vector<uint32_t> m_freeIndices;
+	NullRenderDeviceStats m_stats;
+	std::vector<std::string> m_errors;
+	std::mutex m_errorMutex; // recording threads report bad list handles here
+
+	std::deque<uint64_t> m_pending; // signaled, not completed
+	uint64_t m_nextFenceValue = 1; // what the next Signal returns
+	std::atomic<uint64_t> m_completedFenceValue{ 0 }; // Begin reads it on recording threads
+};
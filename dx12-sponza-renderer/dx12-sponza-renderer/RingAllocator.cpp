@@ -0,0 +1,124 @@
+#include "RingAllocator.h"
+#include <algorithm>
+#include <cassert>
+
+RingAllocator::RingAllocator(uint64_t capacity)
+{
+	Reset(capacity);
+}
+
+void RingAllocator::Reset(uint64_t capacity)
+{
+	m_submissions.clear();
+	m_head = 0;
+	m_tail = 0;
+	m_openBytes = 0;
+	m_lastFenceValue = 0;
+	m_stats = RingAllocatorStats();
+	m_stats.capacity = capacity;
+}
+
+uint64_t RingAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	const uint64_t capacity = m_stats.capacity;
+
+	// an empty ring starts over at 0 to get the largest contiguous range
+	if (m_stats.usedBytes == 0) {
+		m_head = 0;
+		m_tail = 0;
+	}
+
+	uint64_t offset = (m_head + alignment - 1) & ~(alignment - 1);
+	uint64_t newHead = 0;
+
+	if (m_stats.usedBytes > 0 && m_head == m_tail)
+	{
+		// full
+		m_stats.failedAllocations++;
+		return InvalidOffset;
+	}
+	else if (m_head >= m_tail)
+	{
+		// free space is [head, capacity) and [0, tail)
+		if (offset + size <= capacity) {
+			newHead = offset + size;
+		}
+		else if (size <= m_tail) {
+			// skip the end of the ring, 0 is aligned for anything
+			offset = 0;
+			newHead = size;
+		}
+		else {
+			m_stats.failedAllocations++;
+			return InvalidOffset;
+		}
+	}
+	else
+	{
+		// free space is [head, tail)
+		if (offset + size > m_tail) {
+			m_stats.failedAllocations++;
+			return InvalidOffset;
+		}
+		newHead = offset + size;
+	}
+
+	// bytes between the old head and the allocation belong to this submission too
+	uint64_t consumed = offset >= m_head ? newHead - m_head : (capacity - m_head) + newHead;
+	m_head = newHead == capacity ? 0 : newHead;
+	m_openBytes += consumed;
+
+	m_stats.usedBytes += consumed;
+	m_stats.peakUsedBytes = std::max(m_stats.peakUsedBytes, m_stats.usedBytes);
+	m_stats.paddingBytes += consumed - size;
+	m_stats.allocations++;
+	return offset;
+}
+
+void RingAllocator::Submit(uint64_t fenceValue)
+{
+	assert(fenceValue >= m_lastFenceValue);
+	m_lastFenceValue = fenceValue;
+
+	if (m_openBytes == 0) {
+		return;
+	}
+
+	Submission submission;
+	submission.fenceValue = fenceValue;
+	submission.end = m_head;
+	submission.bytes = m_openBytes;
+	m_submissions.push_back(submission);
+	m_openBytes = 0;
+	m_stats.pendingSubmissions = static_cast<uint32_t>(m_submissions.size());
+}
+
+void RingAllocator::Reclaim(uint64_t completedFenceValue)
+{
+	while (!m_submissions.empty() && m_submissions.front().fenceValue <= completedFenceValue)
+	{
+		m_tail = m_submissions.front().end;
+		m_stats.usedBytes -= m_submissions.front().bytes;
+		m_submissions.pop_front();
+	}
+	m_stats.pendingSubmissions = static_cast<uint32_t>(m_submissions.size());
+}
+
+bool RingAllocator::Validate() const
+{
+	uint64_t submitted = 0;
+	for (const Submission& submission : m_submissions) {
+		submitted += submission.bytes;
+	}
+	if (submitted + m_openBytes != m_stats.usedBytes || m_stats.usedBytes > m_stats.capacity) {
+		return false;
+	}
+	if (m_stats.usedBytes == 0 || m_stats.usedBytes == m_stats.capacity) {
+		return true;
+	}
+
+	// the used range runs from tail to head, possibly wrapping
+	uint64_t span = m_head > m_tail ? m_head - m_tail : m_stats.capacity - m_tail + m_head;
+	return span == m_stats.usedBytes;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <deque>
+#include <cstdint>
+
+// sub-allocates a fixed range of bytes as a ring. allocations are retired in
+// groups: Submit tags everything allocated since the previous Submit with the
+// fence value the gpu signals once it's done with them, Reclaim frees every
+// group whose fence has completed. it only does bookkeeping, UploadRingBuffer
+// puts it in front of a mapped upload heap, so the wrap around and reclaim
+// logic can be driven by a simulated fence timeline.
+
+struct RingAllocatorStats
+{
+	uint64_t capacity = 0;
+	uint64_t usedBytes = 0; // allocations, alignment padding and skipped ends
+	uint64_t peakUsedBytes = 0;
+	uint64_t paddingBytes = 0; // total lost to alignment and wrapping
+	uint64_t allocations = 0;
+	uint64_t failedAllocations = 0;
+	uint32_t pendingSubmissions = 0;
+};
+
+class RingAllocator
+{
+public:
+	static const uint64_t InvalidOffset = ~0ull;
+
+	explicit RingAllocator(uint64_t capacity = 0);
+
+	// forgets every allocation, only when nothing is in flight
+	void Reset(uint64_t capacity);
+
+	// alignment has to be a power of two. returns InvalidOffset when there's no
+	// contiguous free range, an allocation never straddles the end of the ring
+	uint64_t Allocate(uint64_t size, uint64_t alignment);
+
+	// the allocations made since the last Submit are free once fenceValue completes.
+	// fence values have to increase from one Submit to the next
+	void Submit(uint64_t fenceValue);
+
+	void Reclaim(uint64_t completedFenceValue);
+
+	uint64_t GetCapacity() const { return m_stats.capacity; }
+	const RingAllocatorStats& GetStats() const { return m_stats; }
+
+	// checks head, tail and the submission list agree, for debugging
+	bool Validate() const;
+
+private:
+	struct Submission
+	{
+		uint64_t fenceValue;
+		uint64_t end; // head when it was submitted, the tail moves here once it retires
+		uint64_t bytes;
+	};
+
+	std::deque<Submission> m_submissions;
+	uint64_t m_head = 0; // next free byte
+	uint64_t m_tail = 0; // first byte still in use
+	uint64_t m_openBytes = 0; // allocated since the last Submit
+	uint64_t m_lastFenceValue = 0;
+	RingAllocatorStats m_stats;
+};
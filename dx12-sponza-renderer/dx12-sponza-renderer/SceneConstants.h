@@ -0,0 +1,35 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// the constant buffers of Constants.hlsl, shared by the renderer and the
+// headless frame loop
+
+struct MatrixBuffer
+{
+	DirectX::XMFLOAT4X4 world;
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 projection;
+
+	float padding[4]; // 4 floats = 16 bytes for alignment
+};
+
+struct LightBuffer
+{
+	DirectX::XMFLOAT3 lightDirection;
+	float padding1;       // 4 bytes padding
+	DirectX::XMFLOAT3 lightColor;
+	float lightIntensity;
+	float ambientIntensity;
+	DirectX::XMFLOAT3 cameraPosition;
+	float specularPower;
+	float specularIntensity;
+	float padding2[2];    // 8 bytes padding
+};
+
+// matches MaterialBuffer in Constants.hlsl, set as root constants per draw
+struct MaterialConstants {
+	DirectX::XMFLOAT2 uvScale;
+	DirectX::XMFLOAT2 uvOffset;
+	float slice;
+};
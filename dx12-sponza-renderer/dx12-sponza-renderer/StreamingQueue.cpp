@@ -0,0 +1,268 @@
+#include "StreamingQueue.h"
+#include "Lz4.h"
+#include <algorithm>
+#include <cassert>
+
+bool StreamingQueue::Initialize(UploadService* uploads, std::string& error, uint32_t queueDepth, uint64_t stagingSize)
+{
+	m_uploads = uploads;
+	m_staging.resize(static_cast<size_t>(stagingSize));
+	m_stagingAllocator.Reset(stagingSize);
+	return m_reader.Initialize(queueDepth, error);
+}
+
+void StreamingQueue::Shutdown()
+{
+	Wait(m_nextFenceValue - 1);
+	m_reader.Shutdown();
+}
+
+StreamFenceValue StreamingQueue::Enqueue(const StreamRequest& request)
+{
+	assert(request.destinationType == StreamDestination::Memory || m_uploads);
+	Request pending = {};
+	pending.request = request;
+	pending.state = State::Queued;
+	pending.stagingOffset = TlsfAllocator::InvalidOffset;
+	m_requests.push_back(pending);
+	m_stats.requests++;
+	m_stats.queued++;
+	return m_nextFenceValue++;
+}
+
+bool StreamingQueue::EnqueueAsset(uint32_t file, const AssetPackage& package, const std::string& name,
+	StreamDestination destinationType, void* destination, uint64_t destinationOffset, StreamFenceValue& fenceValue)
+{
+	std::vector<AssetChunkLocation> chunks;
+	if (!package.GetChunkLocations(name, chunks)) {
+		return false;
+	}
+
+	// an empty asset has nothing to wait for
+	fenceValue = 0;
+	for (const AssetChunkLocation& chunk : chunks)
+	{
+		StreamRequest request;
+		request.file = file;
+		request.offset = chunk.fileOffset;
+		request.size = chunk.size;
+		request.compression = chunk.compression == AssetCompressionLz4 ? StreamCompression::Lz4 : StreamCompression::None;
+		request.uncompressedSize = chunk.uncompressedSize;
+		request.destinationType = destinationType;
+		request.destination = destination;
+		request.destinationOffset = destinationOffset + chunk.assetOffset;
+		fenceValue = Enqueue(request);
+	}
+	return true;
+}
+
+void StreamingQueue::Update()
+{
+	// handoffs free staging, which lets more reads go out
+	IssueReads();
+	CollectReads(false);
+	HandOff();
+	IssueReads();
+	Retire();
+}
+
+void StreamingQueue::IssueReads()
+{
+	while (m_nextToIssue < m_nextFenceValue && m_reader.CanSubmit())
+	{
+		Request& pending = GetRequest(m_nextToIssue);
+		const StreamRequest& request = pending.request;
+
+		// uncompressed memory requests need no staging, the file lands where it belongs
+		uint8_t* target = nullptr;
+		if (request.destinationType == StreamDestination::Memory && request.compression == StreamCompression::None) {
+			target = static_cast<uint8_t*>(request.destination) + request.destinationOffset;
+		}
+		else if (request.size > m_staging.size()) {
+			assert(!"stream request larger than the staging arena");
+			Finish(m_nextToIssue, true);
+			m_stats.queued--;
+			m_nextToIssue++;
+			continue;
+		}
+		else
+		{
+			pending.stagingOffset = m_stagingAllocator.Allocate(std::max(request.size, 1u), 16);
+			if (pending.stagingOffset == TlsfAllocator::InvalidOffset) {
+				// issue in order, a big request mustn't be starved by small ones behind it
+				m_stats.stagingStalls++;
+				break;
+			}
+			target = m_staging.data() + pending.stagingOffset;
+		}
+
+		m_reader.Submit(request.file, request.offset, request.size, target, m_nextToIssue);
+		pending.state = State::Reading;
+		m_stats.queued--;
+		m_stats.reading++;
+		m_nextToIssue++;
+	}
+}
+
+void StreamingQueue::CollectReads(bool wait)
+{
+	m_completions.clear();
+	m_reader.Poll(wait, m_completions);
+	for (const AsyncReadCompletion& completion : m_completions)
+	{
+		Request& pending = GetRequest(completion.userData);
+		m_stats.reading--;
+		if (!completion.success) {
+			Finish(completion.userData, true);
+			continue;
+		}
+		m_stats.bytesRead += pending.request.size;
+		pending.state = State::Read;
+	}
+}
+
+void StreamingQueue::HandOff()
+{
+	// in fence order, so an early request isn't held back by later ones
+	uint64_t budget = maxHandoffBytesPerUpdate;
+	for (StreamFenceValue value = m_firstFenceValue; value < m_nextToIssue; value++)
+	{
+		Request& pending = GetRequest(value);
+		if (pending.state != State::Read) {
+			continue;
+		}
+		// the first one always goes, however large
+		uint64_t bytes = pending.request.compression == StreamCompression::None ? pending.request.size : pending.request.uncompressedSize;
+		if (bytes > budget && budget < maxHandoffBytesPerUpdate) {
+			break;
+		}
+		budget -= std::min(budget, bytes);
+		if (HandOff(value, pending)) {
+			FreeStaging(pending);
+		}
+		else {
+			Finish(value, true);
+		}
+	}
+}
+
+bool StreamingQueue::HandOff(StreamFenceValue value, Request& pending)
+{
+	const StreamRequest& request = pending.request;
+	const uint8_t* staged = pending.stagingOffset != TlsfAllocator::InvalidOffset ? m_staging.data() + pending.stagingOffset : nullptr;
+
+	if (request.destinationType == StreamDestination::Memory)
+	{
+		if (request.compression == StreamCompression::Lz4)
+		{
+			uint8_t* target = static_cast<uint8_t*>(request.destination) + request.destinationOffset;
+			if (!Lz4::Decompress(staged, request.size, target, request.uncompressedSize)) {
+				return false;
+			}
+			m_stats.bytesDecompressed += request.uncompressedSize;
+		}
+		Finish(value, false);
+		return true;
+	}
+
+	// decompression writes straight into the upload's staging memory
+	if (request.compression == StreamCompression::Lz4)
+	{
+		pending.upload = m_uploads->UploadBufferInPlace(request.destination, request.destinationOffset, request.uncompressedSize,
+			[&](uint8_t* target) { return Lz4::Decompress(staged, request.size, target, request.uncompressedSize); });
+		if (pending.upload == 0 && request.uncompressedSize > 0) {
+			return false;
+		}
+		m_stats.bytesDecompressed += request.uncompressedSize;
+		m_stats.bytesUploaded += request.uncompressedSize;
+	}
+	else
+	{
+		pending.upload = m_uploads->UploadBuffer(request.destination, request.destinationOffset, staged, request.size);
+		if (pending.upload == 0 && request.size > 0) {
+			return false;
+		}
+		m_stats.bytesUploaded += request.size;
+	}
+	pending.state = State::Uploading;
+	m_stats.uploading++;
+	return true;
+}
+
+void StreamingQueue::FreeStaging(Request& pending)
+{
+	if (pending.stagingOffset != TlsfAllocator::InvalidOffset)
+	{
+		m_stagingAllocator.Free(pending.stagingOffset);
+		pending.stagingOffset = TlsfAllocator::InvalidOffset;
+	}
+}
+
+void StreamingQueue::Finish(StreamFenceValue value, bool failed)
+{
+	Request& pending = GetRequest(value);
+	FreeStaging(pending);
+	pending.state = State::Done;
+	if (failed)
+	{
+		m_stats.failedRequests++;
+		m_failed.insert(std::upper_bound(m_failed.begin(), m_failed.end(), value), value);
+	}
+}
+
+void StreamingQueue::Retire()
+{
+	for (Request& pending : m_requests)
+	{
+		if (pending.state == State::Uploading && m_uploads->IsComplete(pending.upload))
+		{
+			pending.state = State::Done;
+			m_stats.uploading--;
+		}
+	}
+
+	// handed off and completed only move over an unbroken prefix
+	StreamFenceValue value = m_firstFenceValue;
+	for (const Request& pending : m_requests)
+	{
+		if (pending.state != State::Uploading && pending.state != State::Done) {
+			break;
+		}
+		m_handedOffValue = std::max(m_handedOffValue, value++);
+	}
+	while (!m_requests.empty() && m_requests.front().state == State::Done)
+	{
+		m_completedValue = m_firstFenceValue;
+		m_requests.pop_front();
+		m_firstFenceValue++;
+	}
+}
+
+bool StreamingQueue::HasFailed(StreamFenceValue value) const
+{
+	return std::binary_search(m_failed.begin(), m_failed.end(), value);
+}
+
+void StreamingQueue::Wait(StreamFenceValue value)
+{
+	assert(value < m_nextFenceValue);
+	Update();
+	while (m_completedValue < value)
+	{
+		if (m_reader.GetInFlight() > 0) {
+			CollectReads(true);
+		}
+		else
+		{
+			// everything left has been read, at worst it's waiting on a copy
+			for (const Request& pending : m_requests)
+			{
+				if (pending.state == State::Uploading) {
+					m_uploads->Wait(pending.upload);
+					break;
+				}
+			}
+		}
+		Update();
+	}
+}
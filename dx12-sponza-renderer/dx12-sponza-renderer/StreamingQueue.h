@@ -0,0 +1,153 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <cstdint>
+#include "AsyncFileReader.h"
+#include "TlsfAllocator.h"
+#include "UploadService.h"
+#include "AssetPackage.h"
+
+// request based file to gpu streaming in the spirit of DirectStorage. each
+// request reads a range of a file, optionally lz4 decompresses it and either
+// writes it to cpu memory or hands it to the UploadService for a buffer copy.
+//
+// requests move through three stages:
+//   read     overlapped reads (AsyncFileReader) into a staging arena, or
+//            straight into the destination for uncompressed memory requests
+//   handoff  decompression and the memcpy into mapped upload memory, both on
+//            the thread calling Update and capped per Update so a burst of
+//            finished reads can't blow a frame
+//   upload   the copy queue batch carrying the data, see UploadService
+//
+// every request gets a fence value, requests complete in that order the way
+// an ID3D12Fence would. tests run it on a NullUploadBackend, whose byte
+// arrays stand in for gpu buffers.
+
+enum class StreamCompression : uint32_t
+{
+	None,
+	Lz4
+};
+
+enum class StreamDestination : uint32_t
+{
+	Memory, // destination is cpu memory
+	Buffer // destination is an upload service buffer
+};
+
+struct StreamRequest
+{
+	uint32_t file = AsyncFileReader::InvalidFile;
+	uint64_t offset = 0;
+	uint32_t size = 0; // bytes in the file
+	StreamCompression compression = StreamCompression::None;
+	uint32_t uncompressedSize = 0; // only with compression
+	StreamDestination destinationType = StreamDestination::Memory;
+	void* destination = nullptr;
+	uint64_t destinationOffset = 0;
+};
+
+typedef uint64_t StreamFenceValue; // 0 is always complete
+
+struct StreamingQueueStats
+{
+	uint64_t requests = 0;
+	uint64_t failedRequests = 0;
+	uint64_t bytesRead = 0;
+	uint64_t bytesDecompressed = 0;
+	uint64_t bytesUploaded = 0;
+	uint64_t stagingStalls = 0; // reads held back because the staging arena was full
+	uint32_t queued = 0;
+	uint32_t reading = 0;
+	uint32_t uploading = 0;
+};
+
+class StreamingQueue
+{
+public:
+	// uploads may be null for a queue that only fills cpu memory. staging holds
+	// the file bytes of reads in flight, no request may be larger than it
+	bool Initialize(UploadService* uploads, std::string& error, uint32_t queueDepth = 32,
+		uint64_t stagingSize = 16 * 1024 * 1024);
+	// waits for every request, then closes the files
+	void Shutdown();
+
+	uint32_t OpenFile(const std::string& filename, std::string& error) { return m_reader.OpenFile(filename, error); }
+	void CloseFile(uint32_t file) { m_reader.CloseFile(file); }
+
+	// the destination has to stay valid until the request completes
+	StreamFenceValue Enqueue(const StreamRequest& request);
+	// one request per package chunk, file is the package opened with OpenFile.
+	// returns false if the package doesn't have the asset
+	bool EnqueueAsset(uint32_t file, const AssetPackage& package, const std::string& name,
+		StreamDestination destinationType, void* destination, uint64_t destinationOffset, StreamFenceValue& fenceValue);
+
+	// issues reads, collects finished ones and hands them off. never blocks,
+	// call once per frame before the upload service is flushed
+	void Update();
+
+	// every request up to this value has been handed off: memory destinations
+	// hold their data, buffer copies are in the upload service, so gpu work
+	// waiting on the service's next flush sees them
+	StreamFenceValue GetHandedOffValue() const { return m_handedOffValue; }
+	// every request up to this value is done, buffer copies included
+	StreamFenceValue GetCompletedValue() const { return m_completedValue; }
+	bool IsComplete(StreamFenceValue value) const { return value <= m_completedValue; }
+	// failed requests still complete. their destination is left as it was,
+	// except that a failed raw read into memory, or an upload the staging
+	// couldn't hold, may have written part of it
+	bool HasFailed(StreamFenceValue value) const;
+
+	// cpu wait, keeps updating until the value completes
+	void Wait(StreamFenceValue value);
+
+	const StreamingQueueStats& GetStats() const { return m_stats; }
+	bool IsAsync() const { return m_reader.IsAsync(); }
+
+	uint64_t maxHandoffBytesPerUpdate = 8 * 1024 * 1024;
+
+private:
+	enum class State
+	{
+		Queued,
+		Reading,
+		Read, // waiting for handoff
+		Uploading,
+		Done
+	};
+
+	struct Request
+	{
+		StreamRequest request;
+		State state;
+		uint64_t stagingOffset; // TlsfAllocator::InvalidOffset when reading straight to the destination
+		UploadToken upload;
+	};
+
+	Request& GetRequest(StreamFenceValue value) { return m_requests[value - m_firstFenceValue]; }
+	void IssueReads();
+	void CollectReads(bool wait);
+	void HandOff();
+	bool HandOff(StreamFenceValue value, Request& request);
+	void Retire();
+	void FreeStaging(Request& request);
+	void Finish(StreamFenceValue value, bool failed);
+
+	AsyncFileReader m_reader;
+	UploadService* m_uploads = nullptr;
+	std::vector<uint8_t> m_staging;
+	TlsfAllocator m_stagingAllocator;
+
+	std::deque<Request> m_requests; // by fence value, from m_firstFenceValue
+	StreamFenceValue m_firstFenceValue = 1;
+	StreamFenceValue m_nextFenceValue = 1;
+	StreamFenceValue m_nextToIssue = 1;
+	StreamFenceValue m_handedOffValue = 0;
+	StreamFenceValue m_completedValue = 0;
+	std::vector<StreamFenceValue> m_failed; // sorted, of requests still tracked or retired
+
+	std::vector<AsyncReadCompletion> m_completions;
+	StreamingQueueStats m_stats;
+};
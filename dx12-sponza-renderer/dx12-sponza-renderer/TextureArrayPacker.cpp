@@ -0,0 +1,127 @@
+#include "TextureArrayPacker.h"
+#include <map>
+#include <tuple>
+#include <algorithm>
+
+// imgui_draw.cpp keeps its copy static, so this file gets its own
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "ImGui/imstb_rectpack.h"
+
+void TextureArrayPacker::Pack(const std::vector<TexturePackInput>& textures,
+	std::vector<TextureArrayDesc>& arrays, std::vector<TexturePlacement>& placements)
+{
+	m_stats = TexturePackStats();
+	m_stats.textureCount = static_cast<uint32_t>(textures.size());
+	arrays.clear();
+	placements.assign(textures.size(), TexturePlacement());
+
+	// ordered so the result doesn't depend on hashing
+	std::map<std::tuple<uint32_t, uint32_t, uint32_t>, std::vector<uint32_t>> groups;
+	for (uint32_t i = 0; i < textures.size(); i++) {
+		groups[std::make_tuple(textures[i].format, textures[i].width, textures[i].height)].push_back(i);
+	}
+
+	std::map<uint32_t, std::vector<uint32_t>> atlasCandidates; // by format
+	for (const auto& group : groups)
+	{
+		const TexturePackInput& first = textures[group.second.front()];
+		bool fitsAtlas = std::max(first.width, first.height) + 2 * atlasPadding <= atlasSize;
+		if (group.second.size() < minArraySlices && fitsAtlas)
+		{
+			auto& candidates = atlasCandidates[first.format];
+			candidates.insert(candidates.end(), group.second.begin(), group.second.end());
+			continue;
+		}
+
+		for (size_t start = 0; start < group.second.size(); start += maxArraySlices)
+		{
+			size_t end = std::min(group.second.size(), start + maxArraySlices);
+
+			TextureArrayDesc desc;
+			desc.width = first.width;
+			desc.height = first.height;
+			desc.format = first.format;
+			desc.sliceCount = static_cast<uint32_t>(end - start);
+			desc.atlas = false;
+
+			for (size_t i = start; i < end; i++)
+			{
+				TexturePlacement& placement = placements[group.second[i]];
+				placement.array = static_cast<uint32_t>(arrays.size());
+				placement.slice = static_cast<uint32_t>(i - start);
+				placement.uvScale[0] = placement.uvScale[1] = 1.0f;
+				placement.uvOffset[0] = placement.uvOffset[1] = 0.0f;
+			}
+			arrays.push_back(desc);
+		}
+	}
+
+	for (const auto& candidates : atlasCandidates) {
+		PackAtlas(textures, candidates.second, arrays, placements);
+	}
+
+	m_stats.arrayCount = static_cast<uint32_t>(arrays.size());
+}
+
+void TextureArrayPacker::PackAtlas(const std::vector<TexturePackInput>& textures, const std::vector<uint32_t>& members,
+	std::vector<TextureArrayDesc>& arrays, std::vector<TexturePlacement>& placements)
+{
+	// packing happens in blocks of atlasPadding texels, which keeps every
+	// rect aligned for the mips
+	const int atlasBlocks = static_cast<int>(atlasSize / atlasPadding);
+	std::vector<stbrp_node> nodes(atlasBlocks);
+
+	TextureArrayDesc desc;
+	desc.width = atlasSize;
+	desc.height = atlasSize;
+	desc.format = textures[members.front()].format;
+	desc.sliceCount = 0;
+	desc.atlas = true;
+	const uint32_t arrayIndex = static_cast<uint32_t>(arrays.size());
+
+	std::vector<uint32_t> remaining = members;
+	while (!remaining.empty())
+	{
+		std::vector<stbrp_rect> rects(remaining.size());
+		for (size_t i = 0; i < remaining.size(); i++)
+		{
+			const TexturePackInput& texture = textures[remaining[i]];
+			rects[i].id = static_cast<int>(i);
+			rects[i].w = static_cast<int>((texture.width + 2 * atlasPadding + atlasPadding - 1) / atlasPadding);
+			rects[i].h = static_cast<int>((texture.height + 2 * atlasPadding + atlasPadding - 1) / atlasPadding);
+		}
+
+		stbrp_context context;
+		stbrp_init_target(&context, atlasBlocks, atlasBlocks, nodes.data(), atlasBlocks);
+		stbrp_pack_rects(&context, rects.data(), static_cast<int>(rects.size()));
+
+		std::vector<uint32_t> unpacked;
+		for (const stbrp_rect& rect : rects)
+		{
+			uint32_t texture = remaining[rect.id];
+			if (!rect.was_packed) {
+				unpacked.push_back(texture);
+				continue;
+			}
+
+			TexturePlacement& placement = placements[texture];
+			placement.array = arrayIndex;
+			placement.slice = desc.sliceCount;
+			placement.x = rect.x * atlasPadding + atlasPadding;
+			placement.y = rect.y * atlasPadding + atlasPadding;
+			placement.uvScale[0] = static_cast<float>(textures[texture].width) / atlasSize;
+			placement.uvScale[1] = static_cast<float>(textures[texture].height) / atlasSize;
+			placement.uvOffset[0] = static_cast<float>(placement.x) / atlasSize;
+			placement.uvOffset[1] = static_cast<float>(placement.y) / atlasSize;
+			m_stats.atlasedTextures++;
+		}
+
+		// every candidate fits an empty slice, so each pass places at least one
+		remaining.swap(unpacked);
+		desc.sliceCount++;
+	}
+
+	m_stats.atlasSlices += desc.sliceCount;
+	arrays.push_back(desc);
+}
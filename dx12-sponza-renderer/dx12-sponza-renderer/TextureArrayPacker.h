@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// groups textures into Texture2DArray resources so draws using different
+// textures can share one descriptor table. textures of the same size and
+// format become slices of one array. the leftovers, sizes that only show up
+// once or twice, are packed into atlas slices with stb_rect_pack.
+//
+// atlas rects are placed on a grid of atlasPadding texels and surrounded by
+// atlasPadding texels of wrapped border, so mips down to log2(atlasPadding)
+// never mix neighbours. coarser atlas mips bleed a little, which only shows
+// on far away surfaces.
+
+struct TexturePackInput
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t format; // textures only share an array with the same format
+};
+
+struct TextureArrayDesc
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;
+	uint32_t sliceCount;
+	bool atlas;
+};
+
+// where a texture ended up. uv = uvOffset + frac(uv) * uvScale addresses it
+// inside its slice, x/y is its first texel for copying it into an atlas
+struct TexturePlacement
+{
+	uint32_t array;
+	uint32_t slice;
+	uint32_t x;
+	uint32_t y;
+	float uvScale[2];
+	float uvOffset[2];
+};
+
+struct TexturePackStats
+{
+	uint32_t textureCount = 0;
+	uint32_t arrayCount = 0;
+	uint32_t atlasedTextures = 0;
+	uint32_t atlasSlices = 0;
+};
+
+class TextureArrayPacker
+{
+public:
+	// fills one placement per input, in input order
+	void Pack(const std::vector<TexturePackInput>& textures,
+		std::vector<TextureArrayDesc>& arrays, std::vector<TexturePlacement>& placements);
+
+	const TexturePackStats& GetStats() const { return m_stats; }
+
+	uint32_t atlasSize = 2048;
+	uint32_t atlasPadding = 16;
+	uint32_t minArraySlices = 3; // smaller groups go to the atlas
+	// residency is tracked per array, a huge array would stream all its slices
+	// whenever one of them is close to the camera
+	uint32_t maxArraySlices = 16;
+
+private:
+	void PackAtlas(const std::vector<TexturePackInput>& textures, const std::vector<uint32_t>& members,
+		std::vector<TextureArrayDesc>& arrays, std::vector<TexturePlacement>& placements);
+
+	TexturePackStats m_stats;
+};
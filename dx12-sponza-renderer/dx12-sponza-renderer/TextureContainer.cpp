@@ -0,0 +1,198 @@
+#include "TextureContainer.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+	struct ContainerHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipCount;
+		uint32_t bytesPerTexel;
+		uint64_t payloadOffset;
+		uint64_t payloadSize;
+	};
+
+	const uint32_t ContainerVersion = 1;
+	const uint32_t BytesPerTexel = 4;
+
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	uint64_t PayloadOffset(uint32_t mipCount)
+	{
+		return AlignUp(sizeof(ContainerHeader) + mipCount * sizeof(TextureSubresourceLayout), TextureContainer::PayloadAlignment);
+	}
+}
+
+TextureContainer::TextureContainer(TextureContainer&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+TextureContainer& TextureContainer::operator=(TextureContainer&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		m_layout = std::move(other.m_layout);
+		m_ownedPayload = std::move(other.m_ownedPayload);
+		m_payload = other.m_payload;
+		m_payloadSize = other.m_payloadSize;
+		m_mappedFile = std::move(other.m_mappedFile);
+
+		other.m_payload = nullptr;
+		other.m_payloadSize = 0;
+	}
+	return *this;
+}
+
+TextureContainer::~TextureContainer()
+{
+	Close();
+}
+
+uint64_t TextureContainer::ComputeLayout(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t bytesPerTexel,
+	std::vector<TextureSubresourceLayout>& layout)
+{
+	return ComputeLayout(width, height, mipCount, 1, bytesPerTexel, 1, layout);
+}
+
+uint64_t TextureContainer::ComputeLayout(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t arraySize,
+	uint32_t bytesPerBlock, uint32_t blockDimension, std::vector<TextureSubresourceLayout>& layout)
+{
+	layout.clear();
+
+	uint64_t offset = 0;
+	uint64_t totalBytes = 0;
+	for (uint32_t slice = 0; slice < arraySize; slice++)
+	{
+		for (uint32_t mip = 0; mip < mipCount; mip++)
+		{
+			TextureSubresourceLayout subresource = {};
+			subresource.width = std::max(1u, width >> mip);
+			subresource.height = std::max(1u, height >> mip);
+			subresource.rowSize = (subresource.width + blockDimension - 1) / blockDimension * bytesPerBlock;
+			subresource.rowPitch = static_cast<uint32_t>(AlignUp(subresource.rowSize, RowPitchAlignment));
+			subresource.numRows = (subresource.height + blockDimension - 1) / blockDimension;
+			subresource.offset = AlignUp(offset, PlacementAlignment);
+			layout.push_back(subresource);
+
+			// the last row isn't padded, the next subresource starts at the following placement boundary
+			totalBytes = subresource.offset + uint64_t(subresource.rowPitch) * (subresource.numRows - 1) + subresource.rowSize;
+			offset = totalBytes;
+		}
+	}
+	return totalBytes;
+}
+
+void TextureContainer::CopyMips(const TextureData& texture, const std::vector<TextureSubresourceLayout>& layout, uint8_t* payload)
+{
+	for (size_t mip = 0; mip < layout.size(); mip++)
+	{
+		const TextureSubresourceLayout& subresource = layout[mip];
+		const uint8_t* source = texture.mips[mip].pixels.data();
+		for (uint32_t y = 0; y < subresource.numRows; y++) {
+			std::memcpy(payload + subresource.offset + uint64_t(y) * subresource.rowPitch,
+				source + size_t(y) * subresource.rowSize, subresource.rowSize);
+		}
+	}
+}
+
+bool TextureContainer::Write(const TextureData& texture, const std::string& filename, std::string& error)
+{
+	std::vector<TextureSubresourceLayout> layout;
+	uint64_t payloadSize = ComputeLayout(texture.Width(), texture.Height(), texture.MipCount(), BytesPerTexel, layout);
+
+	ContainerHeader header = {};
+	std::memcpy(header.magic, "TXC1", 4);
+	header.version = ContainerVersion;
+	header.width = texture.Width();
+	header.height = texture.Height();
+	header.mipCount = texture.MipCount();
+	header.bytesPerTexel = BytesPerTexel;
+	header.payloadOffset = PayloadOffset(header.mipCount);
+	header.payloadSize = payloadSize;
+
+	std::vector<uint8_t> file(header.payloadOffset + payloadSize, 0);
+	std::memcpy(file.data(), &header, sizeof(header));
+	std::memcpy(file.data() + sizeof(header), layout.data(), layout.size() * sizeof(TextureSubresourceLayout));
+	CopyMips(texture, layout, file.data() + header.payloadOffset);
+
+	std::FILE* output = std::fopen(filename.c_str(), "wb");
+	if (!output) {
+		error = "failed to create texture container " + filename;
+		return false;
+	}
+	bool ok = std::fwrite(file.data(), 1, file.size(), output) == file.size();
+	std::fclose(output);
+	if (!ok) {
+		error = "failed to write texture container " + filename;
+	}
+	return ok;
+}
+
+bool TextureContainer::Open(const std::string& filename, std::string& error)
+{
+	Close();
+
+	if (!m_mappedFile.Open(filename, error)) {
+		error = "texture container: " + error;
+		return false;
+	}
+
+	ContainerHeader header = {};
+	const uint8_t* bytes = m_mappedFile.GetData();
+	const uint64_t mappedSize = m_mappedFile.GetSize();
+	if (mappedSize >= sizeof(header)) {
+		std::memcpy(&header, bytes, sizeof(header));
+	}
+
+	// a layout that doesn't match ours means the file came from an older cooker
+	std::vector<TextureSubresourceLayout> layout;
+	uint64_t payloadSize = 0;
+	bool valid = std::memcmp(header.magic, "TXC1", 4) == 0 && header.version == ContainerVersion &&
+		header.bytesPerTexel == BytesPerTexel && header.mipCount > 0 && header.mipCount <= 16 &&
+		header.payloadOffset == PayloadOffset(header.mipCount);
+	if (valid)
+	{
+		payloadSize = ComputeLayout(header.width, header.height, header.mipCount, BytesPerTexel, layout);
+		valid = header.payloadSize == payloadSize && header.payloadOffset + payloadSize <= mappedSize &&
+			std::memcmp(bytes + sizeof(header), layout.data(), layout.size() * sizeof(TextureSubresourceLayout)) == 0;
+	}
+	if (!valid) {
+		error = "invalid texture container " + filename;
+		Close();
+		return false;
+	}
+
+	m_layout = std::move(layout);
+	m_payload = bytes + header.payloadOffset;
+	m_payloadSize = payloadSize;
+	return true;
+}
+
+void TextureContainer::Create(const TextureData& texture)
+{
+	Close();
+
+	m_payloadSize = ComputeLayout(texture.Width(), texture.Height(), texture.MipCount(), BytesPerTexel, m_layout);
+	m_ownedPayload.assign(m_payloadSize, 0);
+	CopyMips(texture, m_layout, m_ownedPayload.data());
+	m_payload = m_ownedPayload.data();
+}
+
+void TextureContainer::Close()
+{
+	m_mappedFile.Close();
+	m_ownedPayload.clear();
+	m_layout.clear();
+	m_payload = nullptr;
+	m_payloadSize = 0;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "TextureLoader.h"
+#include "MappedFile.h"
+
+// rgba8 texture stored in exactly the layout GetCopyableFootprints produces:
+// every mip starts on a 512 byte boundary and rows are padded to 256 bytes.
+// the payload starts on a 4 KB boundary in the file, so a memory mapped
+// container can be copied into an upload buffer with a single memcpy and
+// handed to CopyTextureRegion without repitching rows.
+//
+// because every offset is a multiple of 512, the layout of mips [n, count)
+// is the full layout shifted by the offset of mip n, which is what a
+// resource holding only those mips expects.
+
+struct TextureSubresourceLayout
+{
+	uint64_t offset; // from the start of the payload
+	uint32_t rowPitch;
+	uint32_t rowSize;
+	uint32_t numRows;
+	uint32_t width;
+	uint32_t height;
+	uint32_t reserved; // keeps the struct free of implicit padding, it's stored as is
+};
+
+class TextureContainer
+{
+public:
+	static const uint32_t PlacementAlignment = 512; // D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+	static const uint32_t RowPitchAlignment = 256; // D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+	static const uint32_t PayloadAlignment = 4096;
+
+	TextureContainer() = default;
+	TextureContainer(const TextureContainer&) = delete;
+	TextureContainer& operator=(const TextureContainer&) = delete;
+	TextureContainer(TextureContainer&& other) noexcept;
+	TextureContainer& operator=(TextureContainer&& other) noexcept;
+	~TextureContainer();
+
+	// reimplements GetCopyableFootprints for a 2d texture with one array slice
+	static uint64_t ComputeLayout(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t bytesPerTexel,
+		std::vector<TextureSubresourceLayout>& layout);
+	// the same for arraySize slices in subresource order (mip + slice * mipCount)
+	// and formats of blockDimension square blocks, 4 for bc formats. rows
+	// and row sizes count blocks, width and height stay in texels
+	static uint64_t ComputeLayout(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t arraySize,
+		uint32_t bytesPerBlock, uint32_t blockDimension, std::vector<TextureSubresourceLayout>& layout);
+
+	static bool Write(const TextureData& texture, const std::string& filename, std::string& error);
+
+	// memory maps a container written by Write
+	bool Open(const std::string& filename, std::string& error);
+
+	// lays the texture out in memory, for textures that never touch the disk
+	void Create(const TextureData& texture);
+
+	void Close();
+
+	const uint8_t* GetPayload() const { return m_payload; }
+	uint64_t GetPayloadSize() const { return m_payloadSize; }
+	const TextureSubresourceLayout& GetSubresource(uint32_t mip) const { return m_layout[mip]; }
+
+	// bytes needed to upload mips [firstMip, MipCount()) in one copy
+	uint64_t GetUploadSize(uint32_t firstMip) const { return m_payloadSize - m_layout[firstMip].offset; }
+
+	uint32_t Width() const { return m_layout.empty() ? 0 : m_layout[0].width; }
+	uint32_t Height() const { return m_layout.empty() ? 0 : m_layout[0].height; }
+	uint32_t MipCount() const { return static_cast<uint32_t>(m_layout.size()); }
+
+private:
+	static void CopyMips(const TextureData& texture, const std::vector<TextureSubresourceLayout>& layout, uint8_t* payload);
+
+	std::vector<TextureSubresourceLayout> m_layout;
+	const uint8_t* m_payload = nullptr;
+	uint64_t m_payloadSize = 0;
+
+	// either an in-memory payload or a mapped view of the whole file
+	std::vector<uint8_t> m_ownedPayload;
+	MappedFile m_mappedFile;
+};
@@ -0,0 +1,211 @@
+#include "TextureLoader.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include <algorithm>
+
+static bool StoreImage(unsigned char* imageData, int width, int height, TextureData& texture)
+{
+	TextureMip mip;
+	mip.width = static_cast<uint32_t>(width);
+	mip.height = static_cast<uint32_t>(height);
+	mip.pixels.assign(imageData, imageData + size_t(width) * height * 4);
+	stbi_image_free(imageData);
+
+	texture.mips.clear();
+	texture.mips.push_back(std::move(mip));
+	TextureLoader::GenerateMips(texture);
+	return true;
+}
+
+bool TextureLoader::LoadTexture(const std::string& filename, TextureData& texture, std::string& error)
+{
+	int width, height, channels;
+	unsigned char* imageData = stbi_load(filename.c_str(), &width, &height, &channels, 4);
+
+	if (!imageData)
+	{
+		error = "failed to load texture " + filename + ": " + stbi_failure_reason();
+		return false;
+	}
+	return StoreImage(imageData, width, height, texture);
+}
+
+bool TextureLoader::LoadTextureFromMemory(const uint8_t* data, size_t size, const std::string& name, TextureData& texture, std::string& error)
+{
+	int width, height, channels;
+	unsigned char* imageData = stbi_load_from_memory(data, static_cast<int>(size), &width, &height, &channels, 4);
+
+	if (!imageData)
+	{
+		error = "failed to load texture " + name + ": " + stbi_failure_reason();
+		return false;
+	}
+	return StoreImage(imageData, width, height, texture);
+}
+
+void TextureLoader::CreateSolidColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a, TextureData& texture)
+{
+	TextureMip mip;
+	mip.width = 1;
+	mip.height = 1;
+	mip.pixels = { r, g, b, a };
+
+	texture.mips.clear();
+	texture.mips.push_back(std::move(mip));
+}
+
+void TextureLoader::DownsampleMip(const TextureMip& src, TextureMip& dst)
+{
+	dst.width = std::max(1u, src.width / 2);
+	dst.height = std::max(1u, src.height / 2);
+	dst.pixels.resize(size_t(dst.width) * dst.height * 4);
+
+	// 2x2 box filter, clamping at the edge for odd sized sources
+	for (uint32_t y = 0; y < dst.height; y++)
+	{
+		uint32_t y0 = std::min(y * 2, src.height - 1);
+		uint32_t y1 = std::min(y * 2 + 1, src.height - 1);
+		for (uint32_t x = 0; x < dst.width; x++)
+		{
+			uint32_t x0 = std::min(x * 2, src.width - 1);
+			uint32_t x1 = std::min(x * 2 + 1, src.width - 1);
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				uint32_t sum =
+					src.pixels[(size_t(y0) * src.width + x0) * 4 + c] +
+					src.pixels[(size_t(y0) * src.width + x1) * 4 + c] +
+					src.pixels[(size_t(y1) * src.width + x0) * 4 + c] +
+					src.pixels[(size_t(y1) * src.width + x1) * 4 + c];
+				dst.pixels[(size_t(y) * dst.width + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+void TextureLoader::GenerateMips(TextureData& texture)
+{
+	if (texture.mips.empty()) {
+		return;
+	}
+	texture.mips.resize(1);
+
+	while (texture.mips.back().width > 1 || texture.mips.back().height > 1)
+	{
+		TextureMip dst;
+		DownsampleMip(texture.mips.back(), dst);
+		texture.mips.push_back(std::move(dst));
+	}
+}
+
+void TextureLoader::ApplyAlphaMask(TextureData& texture, const TextureData& mask)
+{
+	TextureMip& target = texture.mips[0];
+	const TextureMip& source = mask.mips[0];
+
+	for (uint32_t y = 0; y < target.height; y++)
+	{
+		uint32_t sourceY = static_cast<uint32_t>(uint64_t(y) * source.height / target.height);
+		for (uint32_t x = 0; x < target.width; x++)
+		{
+			uint32_t sourceX = static_cast<uint32_t>(uint64_t(x) * source.width / target.width);
+			target.pixels[(size_t(y) * target.width + x) * 4 + 3] =
+				source.pixels[(size_t(sourceY) * source.width + sourceX) * 4];
+		}
+	}
+}
+
+float TextureLoader::ComputeAlphaCoverage(const TextureMip& mip, float alphaCutoff)
+{
+	size_t texelCount = size_t(mip.width) * mip.height;
+	size_t covered = 0;
+	for (size_t i = 0; i < texelCount; i++)
+	{
+		if (mip.pixels[i * 4 + 3] / 255.0f >= alphaCutoff) {
+			covered++;
+		}
+	}
+	return texelCount > 0 ? static_cast<float>(covered) / texelCount : 0.0f;
+}
+
+void TextureLoader::ScaleAlphaToCoverage(TextureMip& mip, float alphaCutoff, float targetCoverage)
+{
+	size_t texelCount = size_t(mip.width) * mip.height;
+
+	// coverage grows with the scale, so binary search the scale that matches
+	auto coverageAt = [&](float scale) {
+		size_t covered = 0;
+		for (size_t i = 0; i < texelCount; i++)
+		{
+			if (std::min(1.0f, mip.pixels[i * 4 + 3] / 255.0f * scale) >= alphaCutoff) {
+				covered++;
+			}
+		}
+		return static_cast<float>(covered) / texelCount;
+	};
+
+	float low = 0.0f;
+	float high = 4.0f;
+	for (int i = 0; i < 12; i++)
+	{
+		float mid = 0.5f * (low + high);
+		if (coverageAt(mid) < targetCoverage) {
+			low = mid;
+		}
+		else {
+			high = mid;
+		}
+	}
+
+	// texels of the same alpha cross the cutoff at the same scale, so where
+	// thin features averaged to one alpha high can overshoot the target by
+	// a lot. the texels that only pass at high are ties, enough of them
+	// spread over the mip go just below the cutoff to hit the target
+	std::vector<size_t> ties;
+	size_t covered = 0;
+	for (size_t i = 0; i < texelCount; i++)
+	{
+		float alpha = mip.pixels[i * 4 + 3] / 255.0f;
+		mip.pixels[i * 4 + 3] = static_cast<uint8_t>(std::min(1.0f, alpha * high) * 255.0f + 0.5f);
+		if (mip.pixels[i * 4 + 3] / 255.0f >= alphaCutoff)
+		{
+			covered++;
+			if (std::min(1.0f, alpha * low) < alphaCutoff) {
+				ties.push_back(i);
+			}
+		}
+	}
+
+	// the largest alpha that fails the test
+	uint8_t belowCutoff = 0;
+	while (belowCutoff < 255 && (belowCutoff + 1) / 255.0f < alphaCutoff) {
+		belowCutoff++;
+	}
+	size_t targetCovered = static_cast<size_t>(targetCoverage * texelCount + 0.5f);
+	if (covered <= targetCovered || ties.empty() || belowCutoff / 255.0f >= alphaCutoff) {
+		return;
+	}
+	size_t demote = std::min(covered - targetCovered, ties.size());
+	for (size_t i = 0; i < ties.size(); i++)
+	{
+		if ((i + 1) * demote / ties.size() > i * demote / ties.size()) {
+			mip.pixels[ties[i] * 4 + 3] = belowCutoff;
+		}
+	}
+}
+
+void TextureLoader::GenerateMipsPreservingCoverage(TextureData& texture, float alphaCutoff)
+{
+	if (texture.mips.empty()) {
+		return;
+	}
+	texture.mips.resize(1);
+	const float targetCoverage = ComputeAlphaCoverage(texture.mips[0], alphaCutoff);
+
+	while (texture.mips.back().width > 1 || texture.mips.back().height > 1)
+	{
+		TextureMip dst;
+		DownsampleMip(texture.mips.back(), dst);
+		ScaleAlphaToCoverage(dst, alphaCutoff, targetCoverage);
+		texture.mips.push_back(std::move(dst));
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// rgba8 image with a full mip chain, mip 0 is the largest
+struct TextureMip
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+};
+
+struct TextureData
+{
+	std::vector<TextureMip> mips;
+
+	uint32_t Width() const { return mips.empty() ? 0 : mips[0].width; }
+	uint32_t Height() const { return mips.empty() ? 0 : mips[0].height; }
+	uint32_t MipCount() const { return static_cast<uint32_t>(mips.size()); }
+};
+
+class TextureLoader
+{
+public:
+	static bool LoadTexture(
+		const std::string& filename,
+		TextureData& texture,
+		std::string& error);
+
+	// decodes an image file already in memory, name is only used in errors
+	static bool LoadTextureFromMemory(
+		const uint8_t* data,
+		size_t size,
+		const std::string& name,
+		TextureData& texture,
+		std::string& error);
+
+	// single texel texture, used for materials without a diffuse map
+	static void CreateSolidColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a, TextureData& texture);
+
+	// box filters mip 0 down to 1x1, replacing any existing lower mips
+	static void GenerateMips(TextureData& texture);
+
+	// copies the mask's red channel into the alpha of mip 0, resampling
+	// nearest if the sizes differ. mips have to be regenerated afterwards
+	static void ApplyAlphaMask(TextureData& texture, const TextureData& mask);
+
+	// fraction of texels that pass an alpha test against alphaCutoff
+	static float ComputeAlphaCoverage(const TextureMip& mip, float alphaCutoff);
+
+	// like GenerateMips, but scales the alpha of every mip so the same fraction
+	// of texels passes the alpha test as in mip 0. plain box filtering averages
+	// thin masked detail below the cutoff and distant foliage vanishes
+	static void GenerateMipsPreservingCoverage(TextureData& texture, float alphaCutoff);
+
+private:
+	static void DownsampleMip(const TextureMip& src, TextureMip& dst);
+	static void ScaleAlphaToCoverage(TextureMip& mip, float alphaCutoff, float targetCoverage);
+};
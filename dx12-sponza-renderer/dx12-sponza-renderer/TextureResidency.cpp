@@ -0,0 +1,188 @@
+#include "TextureResidency.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+TextureResidencyManager::TextureResidencyManager(uint64_t budgetBytes, uint32_t tailDimension)
+	: m_tailDimension(tailDimension)
+{
+	m_stats.budgetBytes = budgetBytes;
+}
+
+uint32_t TextureResidencyManager::RegisterTexture(uint32_t width, uint32_t height, uint32_t bytesPerTexel)
+{
+	TextureEntry entry;
+
+	uint32_t mipWidth = width;
+	uint32_t mipHeight = height;
+	bool tailFound = false;
+	for (;;)
+	{
+		if (!tailFound && std::max(mipWidth, mipHeight) <= m_tailDimension) {
+			entry.tailMip = static_cast<uint32_t>(entry.mipBytes.size());
+			tailFound = true;
+		}
+		entry.mipBytes.push_back(uint64_t(mipWidth) * mipHeight * bytesPerTexel);
+
+		if (mipWidth == 1 && mipHeight == 1) {
+			break;
+		}
+		mipWidth = std::max(1u, mipWidth / 2);
+		mipHeight = std::max(1u, mipHeight / 2);
+	}
+
+	// the smallest mips are loaded right away, everything above streams in on demand
+	entry.residentMip = entry.tailMip;
+	entry.wantedMip = entry.tailMip;
+	entry.changed = true;
+
+	uint64_t tailBytes = 0;
+	for (size_t mip = entry.tailMip; mip < entry.mipBytes.size(); mip++) {
+		tailBytes += entry.mipBytes[mip];
+	}
+	m_stats.tailBytes += tailBytes;
+	m_stats.residentBytes += tailBytes;
+	m_stats.peakResidentBytes = std::max(m_stats.peakResidentBytes, m_stats.residentBytes);
+
+	m_textures.push_back(entry);
+	return static_cast<uint32_t>(m_textures.size() - 1);
+}
+
+void TextureResidencyManager::BeginFrame(uint64_t frameIndex)
+{
+	m_frameIndex = frameIndex;
+	m_stats.mipLoadsThisFrame = 0;
+	m_stats.mipEvictionsThisFrame = 0;
+
+	for (auto& texture : m_textures)
+	{
+		texture.requested = false;
+		texture.wantedMip = texture.tailMip;
+		texture.priority = 0.0f;
+	}
+}
+
+void TextureResidencyManager::RequestMip(uint32_t texture, float desiredMip, float priority)
+{
+	TextureEntry& entry = m_textures[texture];
+
+	float clamped = std::min(std::max(desiredMip, 0.0f), static_cast<float>(entry.tailMip));
+	uint32_t mip = static_cast<uint32_t>(clamped);
+
+	if (!entry.requested || mip < entry.wantedMip) {
+		entry.wantedMip = mip;
+	}
+	entry.priority = std::max(entry.priority, priority);
+	entry.requested = true;
+	entry.lastRequestFrame = m_frameIndex;
+}
+
+bool TextureResidencyManager::EvictOne(uint32_t protectedTexture, bool onlyUnwanted)
+{
+	// least recently requested first, lowest priority breaks ties
+	TextureEntry* victim = nullptr;
+	for (uint32_t i = 0; i < m_textures.size(); i++)
+	{
+		TextureEntry& entry = m_textures[i];
+		if (i == protectedTexture || entry.residentMip >= entry.tailMip) {
+			continue;
+		}
+		if (onlyUnwanted && entry.residentMip >= entry.wantedMip) {
+			continue;
+		}
+		if (!victim ||
+			entry.lastRequestFrame < victim->lastRequestFrame ||
+			(entry.lastRequestFrame == victim->lastRequestFrame && entry.priority < victim->priority)) {
+			victim = &entry;
+		}
+	}
+
+	if (!victim) {
+		return false;
+	}
+
+	m_stats.residentBytes -= victim->mipBytes[victim->residentMip];
+	victim->residentMip++;
+	victim->changed = true;
+	m_stats.mipEvictionsThisFrame++;
+	m_stats.totalMipEvictions++;
+	return true;
+}
+
+void TextureResidencyManager::Update(uint32_t maxMipLoads, std::vector<TextureResidencyChange>& changes)
+{
+	// the budget may have been lowered since the last frame
+	while (m_stats.residentBytes > m_stats.budgetBytes)
+	{
+		if (!EvictOne(UINT32_MAX, true) && !EvictOne(UINT32_MAX, false)) {
+			break;
+		}
+	}
+
+	std::vector<uint32_t> candidates;
+	for (uint32_t i = 0; i < m_textures.size(); i++)
+	{
+		if (m_textures[i].wantedMip < m_textures[i].residentMip) {
+			candidates.push_back(i);
+		}
+	}
+
+	// most visible and furthest from the wanted mip first
+	auto score = [this](uint32_t i) {
+		const TextureEntry& entry = m_textures[i];
+		return entry.priority * static_cast<float>(entry.residentMip - entry.wantedMip);
+	};
+	std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+		return score(a) > score(b);
+	});
+
+	for (uint32_t i : candidates)
+	{
+		TextureEntry& entry = m_textures[i];
+		while (m_stats.mipLoadsThisFrame < maxMipLoads && entry.residentMip > entry.wantedMip)
+		{
+			uint64_t cost = entry.mipBytes[entry.residentMip - 1];
+
+			// only make room with mips nobody asked for this frame to avoid thrashing
+			while (m_stats.residentBytes + cost > m_stats.budgetBytes && EvictOne(i, true)) {}
+			if (m_stats.residentBytes + cost > m_stats.budgetBytes) {
+				break;
+			}
+
+			entry.residentMip--;
+			entry.changed = true;
+			m_stats.residentBytes += cost;
+			m_stats.mipLoadsThisFrame++;
+			m_stats.totalMipLoads++;
+		}
+	}
+
+	m_stats.peakResidentBytes = std::max(m_stats.peakResidentBytes, m_stats.residentBytes);
+	m_stats.pendingRequests = 0;
+
+	for (uint32_t i = 0; i < m_textures.size(); i++)
+	{
+		TextureEntry& entry = m_textures[i];
+		if (entry.wantedMip < entry.residentMip) {
+			m_stats.pendingRequests++;
+		}
+		if (entry.changed) {
+			changes.push_back({ i, entry.residentMip });
+			entry.changed = false;
+		}
+	}
+
+	// only the always resident tails may push us over the budget
+	assert(m_stats.residentBytes <= std::max(m_stats.budgetBytes, m_stats.tailBytes));
+}
+
+float TextureResidencyManager::ComputeDesiredMip(
+	uint32_t textureWidth, uint32_t textureHeight,
+	float worldUnitsPerUV, float distance,
+	float viewportHeight, float verticalFov)
+{
+	float texelsPerWorldUnit = std::sqrt(float(textureWidth) * float(textureHeight)) / std::max(worldUnitsPerUV, 1e-6f);
+	float pixelsPerWorldUnit = viewportHeight / (2.0f * std::tan(verticalFov * 0.5f) * std::max(distance, 1e-3f));
+
+	return std::max(0.0f, std::log2(texelsPerWorldUnit / pixelsPerWorldUnit));
+}
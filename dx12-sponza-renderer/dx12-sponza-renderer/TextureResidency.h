@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// decides which mip levels of each streamed texture should be resident.
+// it only does bookkeeping, the gpu side (TextureStreamer) applies the changes,
+// so the policy can be driven headless from a simulated camera.
+//
+// every texture keeps its mip tail (mips no larger than tailDimension) resident
+// from registration. higher mips are streamed in one level at a time, highest
+// priority first, and evicted least recently used first whenever a load would
+// exceed the budget.
+
+struct TextureResidencyStats
+{
+	uint64_t budgetBytes = 0;
+	uint64_t residentBytes = 0;
+	uint64_t peakResidentBytes = 0;
+	uint64_t tailBytes = 0; // always resident
+	uint32_t mipLoadsThisFrame = 0;
+	uint32_t mipEvictionsThisFrame = 0;
+	uint32_t pendingRequests = 0; // textures still below their wanted mip
+	uint64_t totalMipLoads = 0;
+	uint64_t totalMipEvictions = 0;
+};
+
+struct TextureResidencyChange
+{
+	uint32_t texture;
+	uint32_t residentMip; // new most detailed resident mip
+};
+
+class TextureResidencyManager
+{
+public:
+	explicit TextureResidencyManager(uint64_t budgetBytes = 256ull * 1024 * 1024, uint32_t tailDimension = 64);
+
+	// returns the texture id, the mip tail is resident immediately
+	uint32_t RegisterTexture(uint32_t width, uint32_t height, uint32_t bytesPerTexel);
+
+	void SetBudget(uint64_t budgetBytes) { m_stats.budgetBytes = budgetBytes; }
+	uint64_t GetBudget() const { return m_stats.budgetBytes; }
+
+	// starts collecting requests for a new frame
+	void BeginFrame(uint64_t frameIndex);
+
+	// desiredMip may be fractional, the most detailed request of the frame wins.
+	// priority is typically the projected screen size of the requesting object
+	void RequestMip(uint32_t texture, float desiredMip, float priority);
+
+	// evicts down to the budget, then loads up to maxMipLoads mip levels.
+	// changes receives one entry per texture whose resident mip moved
+	void Update(uint32_t maxMipLoads, std::vector<TextureResidencyChange>& changes);
+
+	uint32_t GetResidentMip(uint32_t texture) const { return m_textures[texture].residentMip; }
+	uint32_t GetMipCount(uint32_t texture) const { return static_cast<uint32_t>(m_textures[texture].mipBytes.size()); }
+	uint32_t GetTextureCount() const { return static_cast<uint32_t>(m_textures.size()); }
+	const TextureResidencyStats& GetStats() const { return m_stats; }
+
+	// mip level at which one texel covers roughly one pixel for an object at the given distance
+	static float ComputeDesiredMip(
+		uint32_t textureWidth, uint32_t textureHeight,
+		float worldUnitsPerUV, float distance,
+		float viewportHeight, float verticalFov);
+
+private:
+	struct TextureEntry
+	{
+		std::vector<uint64_t> mipBytes;
+		uint32_t tailMip = 0;
+		uint32_t residentMip = 0;
+		uint32_t wantedMip = 0;
+		float priority = 0.0f;
+		uint64_t lastRequestFrame = 0;
+		bool requested = false;
+		bool changed = false;
+	};
+
+	bool EvictOne(uint32_t protectedTexture, bool onlyUnwanted);
+
+	std::vector<TextureEntry> m_textures;
+	TextureResidencyStats m_stats;
+	uint32_t m_tailDimension;
+	uint64_t m_frameIndex = 0;
+};
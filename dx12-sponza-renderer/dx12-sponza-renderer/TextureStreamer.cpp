@@ -0,0 +1,452 @@
+#include "TextureStreamer.h"
+#include "d3dx12.h"
+#include "CpuProfiler.h"
+#include <debugapi.h>
+#include <filesystem>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unordered_set>
+
+using Microsoft::WRL::ComPtr;
+
+bool TextureStreamer::Initialize(ID3D12Device* device, const AssetFileSystem* files, UploadService* uploads, GpuHeapAllocator* heaps,
+	DeferredReleaseQueue* releases, uint32_t maxTextures, uint64_t budgetBytes)
+{
+	m_device = device;
+	m_files = files;
+	m_uploads = uploads;
+	m_heaps = heaps;
+	m_releases = releases;
+	m_maxTextures = maxTextures;
+	m_residency.SetBudget(budgetBytes);
+
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	// the first maxTextures slots start out as the arrays' srvs, the rest hold
+	// replacements while the srvs they replace are still in use
+	heapDesc.NumDescriptors = maxTextures * 2;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	if (FAILED(m_device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&m_srvHeap)))) {
+		return false;
+	}
+	m_freeSrvs.clear();
+	for (uint32_t slot = maxTextures * 2; slot > maxTextures; slot--) {
+		m_freeSrvs.push_back(slot - 1);
+	}
+	m_srvDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	// light grey, matches the untextured look of the scene
+	TextureData defaultTexture;
+	TextureLoader::CreateSolidColor(204, 204, 204, 255, defaultTexture);
+	m_defaultTexture = AddTexture(std::move(defaultTexture));
+	return true;
+}
+
+bool TextureStreamer::LoadSource(const std::string& name, TextureData& texture, std::string& error) const
+{
+	std::vector<uint8_t> file;
+	return m_files->Read(name, file, error) &&
+		TextureLoader::LoadTextureFromMemory(file.data(), file.size(), name, texture, error);
+}
+
+std::string TextureStreamer::GetCookedPath(const std::string& filename, const std::string& alphaMask) const
+{
+	std::string cookedFile = m_files->GetLoosePath(filename);
+	if (!alphaMask.empty()) {
+		cookedFile += "." + std::filesystem::path(alphaMask).stem().string();
+	}
+	return cookedFile + ".dxtex";
+}
+
+bool TextureStreamer::IsCooked(const std::string& cookedFile, const std::string& filename, const std::string& alphaMask) const
+{
+	std::error_code ec;
+	auto cookedTime = std::filesystem::last_write_time(cookedFile, ec);
+	bool cooked = !ec && cookedTime >= m_files->GetWriteTime(filename, ec) && !ec;
+	// a missing mask was replaced by the texture's own alpha
+	if (cooked && !alphaMask.empty() && m_files->Exists(alphaMask)) {
+		cooked = cookedTime >= m_files->GetWriteTime(alphaMask, ec) && !ec;
+	}
+	return cooked;
+}
+
+bool TextureStreamer::ApplyAlphaMask(const std::string& filename, const std::string& alphaMask, TextureData& texture,
+	std::string& error) const
+{
+	// sponza's mtl names masks it doesn't ship, the diffuse maps of those
+	// materials carry the mask in their alpha instead
+	TextureData mask;
+	if (m_files->Exists(alphaMask) || TextureLoader::ComputeAlphaCoverage(texture.mips[0], alphaCutoff) >= 1.0f)
+	{
+		if (!LoadSource(alphaMask, mask, error)) {
+			return false;
+		}
+		TextureLoader::ApplyAlphaMask(texture, mask);
+	}
+	else {
+		OutputDebugStringA(("using the alpha of " + filename + ", " + alphaMask + " is missing\n").c_str());
+	}
+	TextureLoader::GenerateMipsPreservingCoverage(texture, alphaCutoff);
+	return true;
+}
+
+bool TextureStreamer::WriteCooked(const TextureData& texture, const std::string& cookedFile, std::string& error) const
+{
+	std::error_code ec;
+	std::filesystem::create_directories(std::filesystem::path(cookedFile).parent_path(), ec);
+	return TextureContainer::Write(texture, cookedFile, error);
+}
+
+void TextureStreamer::CookTextures(const std::vector<TextureSource>& textures, JobSystem& jobs) const
+{
+	PROFILE_FUNCTION();
+	// a texture used by several materials is cooked once
+	std::vector<const TextureSource*> stale;
+	std::unordered_set<std::string> seen;
+	for (const TextureSource& source : textures)
+	{
+		std::string cookedFile = GetCookedPath(source.filename, source.alphaMask);
+		if (seen.insert(cookedFile).second && !IsCooked(cookedFile, source.filename, source.alphaMask)) {
+			stale.push_back(&source);
+		}
+	}
+
+	// decoding and building mips is most of the loading time, every texture is
+	// independent of the others. failures are left to AddTexture to report
+	jobs.ParallelFor(0, stale.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			PROFILE_ZONE("cook texture");
+			const TextureSource& source = *stale[i];
+			TextureData texture;
+			std::string error;
+			if (LoadSource(source.filename, texture, error) &&
+				(source.alphaMask.empty() || ApplyAlphaMask(source.filename, source.alphaMask, texture, error))) {
+				WriteCooked(texture, GetCookedPath(source.filename, source.alphaMask), error);
+			}
+		}
+	});
+}
+
+uint32_t TextureStreamer::AddTexture(const std::string& filename, const std::string& alphaMask)
+{
+	// the same image with and without a mask are different textures
+	const std::string key = alphaMask.empty() ? filename : filename + "|" + alphaMask;
+	auto it = m_textureByFile.find(key);
+	if (it != m_textureByFile.end()) {
+		return it->second;
+	}
+
+	assert(m_arrays.empty() && "textures have to be added before PackTextures");
+
+	uint32_t index = m_defaultTexture;
+	if (m_textures.size() >= m_maxTextures) {
+		OutputDebugStringA("WARNING: texture streamer is full, using default texture\n");
+		m_textureByFile[key] = index;
+		return index;
+	}
+
+	std::string error;
+	std::string cookedFile = GetCookedPath(filename, alphaMask);
+	StreamedTexture streamed;
+	streamed.alphaMasked = !alphaMask.empty();
+	if (!IsCooked(cookedFile, filename, alphaMask) || !streamed.container.Open(cookedFile, error))
+	{
+		TextureData texture;
+		if (!LoadSource(filename, texture, error)) {
+			OutputDebugStringA(("WARNING: " + error + "\n").c_str());
+			m_textureByFile[key] = index;
+			return index;
+		}
+		if (!alphaMask.empty() && !ApplyAlphaMask(filename, alphaMask, texture, error)) {
+			OutputDebugStringA(("WARNING: " + error + ", drawing it opaque\n").c_str());
+			index = AddTexture(filename);
+			m_textureByFile[key] = index;
+			return index;
+		}
+
+		// keep going from memory if the cache can't be written
+		if (!WriteCooked(texture, cookedFile, error) || !streamed.container.Open(cookedFile, error)) {
+			OutputDebugStringA(("WARNING: " + error + "\n").c_str());
+			streamed.container.Create(texture);
+		}
+	}
+
+	index = static_cast<uint32_t>(m_textures.size());
+	m_textures.push_back(std::move(streamed));
+	m_textureByFile[key] = index;
+	return index;
+}
+
+uint32_t TextureStreamer::AddTexture(TextureData&& texture)
+{
+	assert(m_arrays.empty() && "textures have to be added before PackTextures");
+
+	if (m_textures.size() >= m_maxTextures) {
+		OutputDebugStringA("WARNING: texture streamer is full, using default texture\n");
+		return m_defaultTexture;
+	}
+
+	StreamedTexture streamed;
+	streamed.container.Create(texture);
+
+	uint32_t index = static_cast<uint32_t>(m_textures.size());
+	m_textures.push_back(std::move(streamed));
+	return index;
+}
+
+void TextureStreamer::PackTextures()
+{
+	std::vector<TexturePackInput> inputs;
+	for (const auto& texture : m_textures) {
+		inputs.push_back({ texture.container.Width(), texture.container.Height(), DXGI_FORMAT_R8G8B8A8_UNORM });
+	}
+
+	std::vector<TextureArrayDesc> arrays;
+	m_packer.Pack(inputs, arrays, m_placements);
+
+	m_arrays.resize(arrays.size());
+	for (uint32_t i = 0; i < arrays.size(); i++) {
+		m_arrays[i].desc = arrays[i];
+		m_arrays[i].srv = i;
+		m_arrays[i].sliceTextures.resize(arrays[i].atlas ? 0 : arrays[i].sliceCount);
+	}
+	for (uint32_t texture = 0; texture < m_textures.size(); texture++)
+	{
+		const TexturePlacement& placement = m_placements[texture];
+		if (!m_arrays[placement.array].desc.atlas) {
+			m_arrays[placement.array].sliceTextures[placement.slice] = texture;
+		}
+	}
+
+	// array ids double as residency ids
+	for (uint32_t i = 0; i < m_arrays.size(); i++)
+	{
+		if (m_arrays[i].desc.atlas) {
+			BuildAtlasSlices(i);
+		}
+		const TextureArrayDesc& desc = m_arrays[i].desc;
+		uint32_t id = m_residency.RegisterTexture(desc.width, desc.height, 4 * desc.sliceCount);
+		assert(id == i);
+		(void)id;
+	}
+
+	const TexturePackStats& stats = m_packer.GetStats();
+	char message[256];
+	sprintf_s(message, "packed %u textures into %u arrays (%u textures in %u atlas slices)\n",
+		stats.textureCount, stats.arrayCount, stats.atlasedTextures, stats.atlasSlices);
+	OutputDebugStringA(message);
+}
+
+namespace
+{
+	// copies a mip of the container into the atlas mip with a wrapped border,
+	// so bilinear filtering and box filtered mips see the texture repeat
+	void CopyWrapped(const TextureContainer& source, uint32_t mip, TextureMip& atlas,
+		uint32_t x, uint32_t y, uint32_t border)
+	{
+		const TextureSubresourceLayout& layout = source.GetSubresource(mip);
+		const uint8_t* pixels = source.GetPayload() + layout.offset;
+
+		for (uint32_t row = 0; row < layout.height + 2 * border; row++)
+		{
+			uint32_t sourceRow = (row + layout.height - border % layout.height) % layout.height;
+			uint8_t* dst = atlas.pixels.data() + ((size_t(y) - border + row) * atlas.width + x - border) * 4;
+			const uint8_t* src = pixels + size_t(sourceRow) * layout.rowPitch;
+			for (uint32_t column = 0; column < layout.width + 2 * border; column++)
+			{
+				uint32_t sourceColumn = (column + layout.width - border % layout.width) % layout.width;
+				memcpy(dst + size_t(column) * 4, src + size_t(sourceColumn) * 4, 4);
+			}
+		}
+	}
+}
+
+void TextureStreamer::BuildAtlasSlices(uint32_t array)
+{
+	TextureArray& textureArray = m_arrays[array];
+	const uint32_t padding = m_packer.atlasPadding;
+
+	std::vector<std::vector<uint32_t>> sliceMembers(textureArray.desc.sliceCount);
+	for (uint32_t texture = 0; texture < m_textures.size(); texture++) {
+		if (m_placements[texture].array == array) {
+			sliceMembers[m_placements[texture].slice].push_back(texture);
+		}
+	}
+
+	textureArray.atlasSlices.resize(textureArray.desc.sliceCount);
+	for (uint32_t slice = 0; slice < textureArray.desc.sliceCount; slice++)
+	{
+		TextureData atlas;
+		TextureMip top;
+		top.width = textureArray.desc.width;
+		top.height = textureArray.desc.height;
+		top.pixels.assign(size_t(top.width) * top.height * 4, 0);
+		atlas.mips.push_back(std::move(top));
+
+		for (uint32_t texture : sliceMembers[slice]) {
+			const TexturePlacement& placement = m_placements[texture];
+			CopyWrapped(m_textures[texture].container, 0, atlas.mips[0], placement.x, placement.y, padding);
+		}
+		TextureLoader::GenerateMips(atlas);
+
+		// rects sit on a padding sized grid, so while the border is at least a
+		// texel wide each texture's own mips (coverage preserving for masked
+		// ones) can replace the box filtered ones
+		for (uint32_t mip = 1; mip < atlas.MipCount() && (padding >> mip) > 0; mip++)
+		{
+			for (uint32_t texture : sliceMembers[slice])
+			{
+				// textures smaller than the mip's scale have been filtered away
+				const TextureContainer& source = m_textures[texture].container;
+				if (mip >= source.MipCount() || (source.Width() >> mip) == 0 || (source.Height() >> mip) == 0) {
+					continue;
+				}
+				const TexturePlacement& placement = m_placements[texture];
+				CopyWrapped(source, mip, atlas.mips[mip], placement.x >> mip, placement.y >> mip, padding >> mip);
+			}
+		}
+
+		textureArray.atlasSlices[slice].Create(atlas);
+	}
+}
+
+void TextureStreamer::BeginFrame(uint64_t frameIndex)
+{
+	m_residency.BeginFrame(frameIndex);
+}
+
+void TextureStreamer::RequestMip(uint32_t texture, float desiredMip, float priority)
+{
+	// an array streams at the finest mip any of its textures asks for
+	m_residency.RequestMip(m_placements[texture].array, desiredMip, priority);
+}
+
+float TextureStreamer::ComputeDesiredMip(uint32_t texture, float worldUnitsPerUV, float distance,
+	float viewportHeight, float verticalFov) const
+{
+	const TextureContainer& container = m_textures[texture].container;
+	return TextureResidencyManager::ComputeDesiredMip(container.Width(), container.Height(),
+		worldUnitsPerUV, distance, viewportHeight, verticalFov);
+}
+
+void TextureStreamer::Update()
+{
+	assert(!m_arrays.empty() && "PackTextures has to run before the first Update");
+
+	m_changes.clear();
+	m_residency.Update(maxMipLoadsPerFrame, m_changes);
+
+	for (const auto& change : m_changes) {
+		UploadArray(change.texture, change.residentMip);
+	}
+}
+
+void TextureStreamer::UploadArray(uint32_t array, uint32_t residentMip)
+{
+	TextureArray& textureArray = m_arrays[array];
+	const TextureContainer& firstSlice = textureArray.GetSlice(m_textures, 0);
+	const TextureSubresourceLayout& topMip = firstSlice.GetSubresource(residentMip);
+	const UINT sliceCount = textureArray.desc.sliceCount;
+	UINT mipLevels = firstSlice.MipCount() - residentMip;
+
+	// the resource only holds the resident part of the chain
+	D3D12_RESOURCE_DESC textureDesc = {};
+	textureDesc.MipLevels = static_cast<UINT16>(mipLevels);
+	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	textureDesc.Width = topMip.width;
+	textureDesc.Height = topMip.height;
+	textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+	textureDesc.DepthOrArraySize = static_cast<UINT16>(sliceCount);
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.SampleDesc.Quality = 0;
+	textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+
+	// COMMON so the copy queue can write it, the first pixel shader read on the
+	// direct queue promotes it without a barrier
+	GpuAllocation allocation;
+	if (!m_heaps->CreateTexture(textureDesc, D3D12_RESOURCE_STATE_COMMON, allocation)) {
+		OutputDebugStringA("WARNING: out of texture memory, keeping the current mips\n");
+		return;
+	}
+	ID3D12Resource* resource = allocation.resource.Get();
+
+#ifdef _DEBUG
+	{
+		// a slice's subresources have to match what the device expects row for row
+		std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(mipLevels);
+		std::vector<UINT> numRows(mipLevels);
+		std::vector<UINT64> rowSizes(mipLevels);
+		m_device->GetCopyableFootprints(&textureDesc, 0, mipLevels, 0, footprints.data(), numRows.data(), rowSizes.data(), nullptr);
+		for (UINT i = 0; i < mipLevels; i++) {
+			const TextureSubresourceLayout& layout = firstSlice.GetSubresource(residentMip + i);
+			assert(footprints[i].Offset == layout.offset - topMip.offset);
+			assert(footprints[i].Footprint.RowPitch == layout.rowPitch);
+			assert(numRows[i] == layout.numRows && rowSizes[i] == layout.rowSize);
+		}
+	}
+#endif
+
+	// containers are already in copyable footprint layout, each subresource
+	// is staged with a single memcpy
+	for (UINT slice = 0; slice < sliceCount; slice++)
+	{
+		const TextureContainer& container = textureArray.GetSlice(m_textures, slice);
+		for (UINT i = 0; i < mipLevels; i++)
+		{
+			const TextureSubresourceLayout& layout = container.GetSubresource(residentMip + i);
+
+			UploadTextureFootprint footprint;
+			footprint.format = textureDesc.Format;
+			footprint.width = layout.width;
+			footprint.height = layout.height;
+			footprint.rowPitch = layout.rowPitch;
+			footprint.rowSize = layout.rowSize;
+			footprint.numRows = layout.numRows;
+
+			if (m_uploads->UploadTexture(resource, D3D12CalcSubresource(i, slice, 0, mipLevels, sliceCount),
+				container.GetPayload() + layout.offset, footprint) == 0)
+			{
+				// copies queued before this one may still write the resource
+				OutputDebugStringA("WARNING: texture upload doesn't fit the staging memory, keeping the current mips\n");
+				m_heaps->Release(allocation);
+				return;
+			}
+		}
+	}
+
+	// draws recorded earlier may still reference the old resource
+	m_heaps->Release(textureArray.allocation);
+	textureArray.allocation = std::move(allocation);
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = textureDesc.Format;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MipLevels = mipLevels;
+	srvDesc.Texture2DArray.ArraySize = sliceCount;
+
+	// descriptor tables are read when the gpu executes, so the old srv can't be
+	// overwritten while a frame in flight may use it
+	if (!m_freeSrvs.empty())
+	{
+		uint32_t previous = textureArray.srv;
+		textureArray.srv = m_freeSrvs.back();
+		m_freeSrvs.pop_back();
+		m_releases->Retire([this, previous]() { m_freeSrvs.push_back(previous); });
+	}
+	else {
+		OutputDebugStringA("WARNING: texture streamer is out of srv slots, replacing one in place\n");
+	}
+
+	CD3DX12_CPU_DESCRIPTOR_HANDLE srvCpuHandle(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), textureArray.srv, m_srvDescriptorSize);
+	m_device->CreateShaderResourceView(resource, &srvDesc, srvCpuHandle);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE TextureStreamer::GetSrv(uint32_t texture) const
+{
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(m_srvHeap->GetGPUDescriptorHandleForHeapStart(),
+		m_arrays[m_placements[texture].array].srv, m_srvDescriptorSize);
+}
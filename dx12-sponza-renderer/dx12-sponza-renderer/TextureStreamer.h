@@ -0,0 +1,129 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "TextureLoader.h"
+#include "TextureContainer.h"
+#include "TextureResidency.h"
+#include "TextureArrayPacker.h"
+#include "UploadService.h"
+#include "GpuHeapAllocator.h"
+#include "DeferredReleaseQueue.h"
+#include "AssetPackage.h"
+#include "JobSystem.h"
+
+struct TextureSource
+{
+	std::string filename;
+	std::string alphaMask; // empty without one
+};
+
+// owns the gpu side of streamed textures. decoded mip chains are cooked once
+// into TextureContainer files next to the source image and memory mapped.
+// PackTextures then groups them into texture arrays (see TextureArrayPacker),
+// which are the unit of residency: each array's d3d12 resource is recreated
+// with just its resident mips whenever the TextureResidencyManager moves it
+// up or down the chain.
+class TextureStreamer
+{
+public:
+	// source images are read through files, mip uploads go through uploads,
+	// array resources are placed in heaps and replaced srvs are recycled
+	// through releases, all of them have to outlive the streamer
+	bool Initialize(ID3D12Device* device, const AssetFileSystem* files, UploadService* uploads, GpuHeapAllocator* heaps,
+		DeferredReleaseQueue* releases, uint32_t maxTextures, uint64_t budgetBytes);
+
+	// maps the cooked container of the asset, cooking it first if it's missing or
+	// older than the source. containers are always loose files next to where
+	// the source would be, even when the source comes from a package. files that fail to load map to the default texture.
+	// with an alphaMask the mask goes into alpha and the mips are built to keep
+	// the alpha tested coverage. without the mask file the texture's own alpha
+	// is the mask, a texture with neither is drawn opaque
+	uint32_t AddTexture(const std::string& filename, const std::string& alphaMask = std::string());
+	uint32_t AddTexture(TextureData&& texture);
+	// cooks the stale ones of textures in parallel, so the AddTexture calls
+	// that follow only map containers. safe to call before or between them
+	void CookTextures(const std::vector<TextureSource>& textures, JobSystem& jobs) const;
+	uint32_t GetDefaultTexture() const { return m_defaultTexture; }
+	bool HasAlphaMask(uint32_t texture) const { return m_textures[texture].alphaMasked; }
+
+	// groups every added texture into arrays and registers them for streaming.
+	// call once after the last AddTexture, before the first Update
+	void PackTextures();
+
+	void BeginFrame(uint64_t frameIndex);
+	void RequestMip(uint32_t texture, float desiredMip, float priority);
+	float ComputeDesiredMip(uint32_t texture, float worldUnitsPerUV, float distance,
+		float viewportHeight, float verticalFov) const;
+
+	// applies residency changes and submits the uploads. the new mips can be
+	// sampled once the graphics queue waits on the upload service's tokens
+	void Update();
+
+	ID3D12DescriptorHeap* GetSrvHeap() const { return m_srvHeap.Get(); }
+	// Texture2DArray srv of the array holding the texture. it moves to another
+	// slot whenever the array is recreated, look it up every frame
+	D3D12_GPU_DESCRIPTOR_HANDLE GetSrv(uint32_t texture) const;
+	const TexturePlacement& GetPlacement(uint32_t texture) const { return m_placements[texture]; }
+	const TexturePackStats& GetPackStats() const { return m_packer.GetStats(); }
+	TextureResidencyManager& GetResidency() { return m_residency; }
+
+	uint32_t maxMipLoadsPerFrame = 8;
+
+	// matches ALPHA_CUTOFF in PixelShader.hlsl
+	static constexpr float alphaCutoff = 0.5f;
+
+private:
+	struct StreamedTexture
+	{
+		TextureContainer container;
+		bool alphaMasked = false;
+	};
+
+	struct TextureArray
+	{
+		TextureArrayDesc desc;
+		std::vector<uint32_t> sliceTextures; // plain arrays, one texture per slice
+		std::vector<TextureContainer> atlasSlices; // atlases are composed in memory
+		GpuAllocation allocation;
+		uint32_t srv = 0; // slot in m_srvHeap
+
+		const TextureContainer& GetSlice(const std::vector<StreamedTexture>& textures, uint32_t slice) const {
+			return desc.atlas ? atlasSlices[slice] : textures[sliceTextures[slice]].container;
+		}
+	};
+
+	std::string GetCookedPath(const std::string& filename, const std::string& alphaMask) const;
+	bool IsCooked(const std::string& cookedFile, const std::string& filename, const std::string& alphaMask) const;
+	bool LoadSource(const std::string& name, TextureData& texture, std::string& error) const;
+	bool ApplyAlphaMask(const std::string& filename, const std::string& alphaMask, TextureData& texture, std::string& error) const;
+	bool WriteCooked(const TextureData& texture, const std::string& cookedFile, std::string& error) const;
+	void BuildAtlasSlices(uint32_t array);
+	void UploadArray(uint32_t array, uint32_t residentMip);
+
+	Microsoft::WRL::ComPtr<ID3D12Device> m_device;
+	const AssetFileSystem* m_files = nullptr;
+	UploadService* m_uploads = nullptr;
+	GpuHeapAllocator* m_heaps = nullptr;
+	DeferredReleaseQueue* m_releases = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_srvHeap;
+	UINT m_srvDescriptorSize = 0;
+	// frames in flight may still read a replaced srv, so a recreated array gets
+	// a fresh slot and the old one comes back here once the gpu is done
+	std::vector<uint32_t> m_freeSrvs;
+	uint32_t m_maxTextures = 0;
+
+	TextureResidencyManager m_residency;
+	TextureArrayPacker m_packer;
+	std::vector<StreamedTexture> m_textures;
+	std::vector<TexturePlacement> m_placements;
+	std::vector<TextureArray> m_arrays;
+	std::unordered_map<std::string, uint32_t> m_textureByFile;
+	uint32_t m_defaultTexture = 0;
+
+	std::vector<TextureResidencyChange> m_changes;
+};
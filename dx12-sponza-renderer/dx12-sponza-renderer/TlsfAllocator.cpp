@@ -0,0 +1,364 @@
+#include "TlsfAllocator.h"
+#include <algorithm>
+#include <cassert>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	uint32_t HighestBit(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return index;
+#else
+		return 63 - __builtin_clzll(value);
+#endif
+	}
+
+	uint32_t LowestBit(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return index;
+#else
+		return __builtin_ctzll(value);
+#endif
+	}
+}
+
+TlsfAllocator::TlsfAllocator(uint64_t size)
+{
+	Reset(size);
+}
+
+void TlsfAllocator::Reset(uint64_t size)
+{
+	m_blocks.clear();
+	m_unusedBlocks.clear();
+	m_allocated.clear();
+	m_firstLevelBitmap = 0;
+	std::fill(std::begin(m_secondLevelBitmaps), std::end(m_secondLevelBitmaps), 0u);
+	for (auto& lists : m_freeLists) {
+		std::fill(std::begin(lists), std::end(lists), uint32_t(None));
+	}
+	m_size = size;
+	m_usedBytes = 0;
+
+	if (size > 0)
+	{
+		uint32_t block = NewBlock();
+		m_blocks[block].offset = 0;
+		m_blocks[block].size = size;
+		InsertFree(block);
+	}
+}
+
+void TlsfAllocator::Mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+{
+	// sizes below SecondLevelCount get a list each, above that every power of
+	// two range is split into SecondLevelCount linear classes
+	if (size < SecondLevelCount)
+	{
+		firstLevel = 0;
+		secondLevel = static_cast<uint32_t>(size);
+		return;
+	}
+	uint32_t highest = HighestBit(size);
+	firstLevel = highest - SecondLevelLog2 + 1;
+	secondLevel = static_cast<uint32_t>(size >> (highest - SecondLevelLog2)) - SecondLevelCount;
+}
+
+uint32_t TlsfAllocator::FindFreeBlock(uint64_t size) const
+{
+	// round up to the next class so any block of the class found is big enough
+	if (size >= SecondLevelCount)
+	{
+		uint64_t roundUp = (1ull << (HighestBit(size) - SecondLevelLog2)) - 1;
+		if (size > ~0ull - roundUp) {
+			return None;
+		}
+		size += roundUp;
+	}
+
+	uint32_t firstLevel, secondLevel;
+	Mapping(size, firstLevel, secondLevel);
+
+	uint32_t secondLevelMap = m_secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+	if (secondLevelMap == 0)
+	{
+		uint64_t firstLevelMap = firstLevel + 1 < 64 ? m_firstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+		if (firstLevelMap == 0) {
+			return None;
+		}
+		firstLevel = LowestBit(firstLevelMap);
+		secondLevelMap = m_secondLevelBitmaps[firstLevel];
+	}
+	return m_freeLists[firstLevel][LowestBit(secondLevelMap)];
+}
+
+uint64_t TlsfAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	size = std::max<uint64_t>(size, 1);
+
+	auto fits = [&](uint32_t block) {
+		if (block == None) {
+			return false;
+		}
+		const Block& b = m_blocks[block];
+		uint64_t aligned = (b.offset + alignment - 1) & ~(alignment - 1);
+		return aligned + size <= b.offset + b.size;
+	};
+
+	// blocks are often aligned already, so try without reserving room for the padding first
+	uint32_t block = FindFreeBlock(size);
+	if (!fits(block)) {
+		block = FindFreeBlock(size + alignment - 1);
+	}
+	if (!fits(block))
+	{
+		// the class search skips blocks that only fit depending on where they
+		// start, walk the classes between the two searches as a last resort
+		uint32_t firstLevel, secondLevel, lastFirstLevel, lastSecondLevel;
+		Mapping(size, firstLevel, secondLevel);
+		Mapping(size + alignment - 1, lastFirstLevel, lastSecondLevel);
+		block = None;
+		while (block == None && (firstLevel < lastFirstLevel || (firstLevel == lastFirstLevel && secondLevel <= lastSecondLevel)))
+		{
+			for (block = m_freeLists[firstLevel][secondLevel]; block != None && !fits(block); block = m_blocks[block].nextFree) {
+			}
+			if (++secondLevel == SecondLevelCount) {
+				secondLevel = 0;
+				firstLevel++;
+			}
+		}
+		if (block == None) {
+			return InvalidOffset;
+		}
+	}
+
+	RemoveFree(block);
+
+	uint64_t aligned = (m_blocks[block].offset + alignment - 1) & ~(alignment - 1);
+	uint64_t padding = aligned - m_blocks[block].offset;
+	if (padding > 0)
+	{
+		// the previous block is in use, free blocks never sit next to each other
+		uint32_t back = Split(block, padding);
+		InsertFree(block);
+		block = back;
+	}
+	if (m_blocks[block].size > size)
+	{
+		uint32_t tail = Split(block, size);
+		InsertFree(tail);
+	}
+
+	m_blocks[block].free = false;
+	m_allocated[aligned] = block;
+	m_usedBytes += m_blocks[block].size;
+	return aligned;
+}
+
+void TlsfAllocator::Free(uint64_t offset)
+{
+	auto it = m_allocated.find(offset);
+	assert(it != m_allocated.end() && "freeing an offset that wasn't allocated");
+	if (it == m_allocated.end()) {
+		return;
+	}
+	uint32_t block = it->second;
+	m_allocated.erase(it);
+	m_usedBytes -= m_blocks[block].size;
+
+	uint32_t prev = m_blocks[block].prevPhysical;
+	if (prev != None && m_blocks[prev].free)
+	{
+		RemoveFree(prev);
+		m_blocks[prev].size += m_blocks[block].size;
+		m_blocks[prev].nextPhysical = m_blocks[block].nextPhysical;
+		if (m_blocks[block].nextPhysical != None) {
+			m_blocks[m_blocks[block].nextPhysical].prevPhysical = prev;
+		}
+		ReleaseBlock(block);
+		block = prev;
+	}
+
+	uint32_t next = m_blocks[block].nextPhysical;
+	if (next != None && m_blocks[next].free)
+	{
+		RemoveFree(next);
+		m_blocks[block].size += m_blocks[next].size;
+		m_blocks[block].nextPhysical = m_blocks[next].nextPhysical;
+		if (m_blocks[next].nextPhysical != None) {
+			m_blocks[m_blocks[next].nextPhysical].prevPhysical = block;
+		}
+		ReleaseBlock(next);
+	}
+
+	InsertFree(block);
+}
+
+void TlsfAllocator::InsertFree(uint32_t block)
+{
+	uint32_t firstLevel, secondLevel;
+	Mapping(m_blocks[block].size, firstLevel, secondLevel);
+
+	Block& b = m_blocks[block];
+	b.free = true;
+	b.prevFree = None;
+	b.nextFree = m_freeLists[firstLevel][secondLevel];
+	if (b.nextFree != None) {
+		m_blocks[b.nextFree].prevFree = block;
+	}
+	m_freeLists[firstLevel][secondLevel] = block;
+	m_firstLevelBitmap |= 1ull << firstLevel;
+	m_secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+}
+
+void TlsfAllocator::RemoveFree(uint32_t block)
+{
+	uint32_t firstLevel, secondLevel;
+	Mapping(m_blocks[block].size, firstLevel, secondLevel);
+
+	Block& b = m_blocks[block];
+	if (b.prevFree != None) {
+		m_blocks[b.prevFree].nextFree = b.nextFree;
+	}
+	else {
+		m_freeLists[firstLevel][secondLevel] = b.nextFree;
+	}
+	if (b.nextFree != None) {
+		m_blocks[b.nextFree].prevFree = b.prevFree;
+	}
+	b.prevFree = None;
+	b.nextFree = None;
+	b.free = false;
+
+	if (m_freeLists[firstLevel][secondLevel] == None)
+	{
+		m_secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+		if (m_secondLevelBitmaps[firstLevel] == 0) {
+			m_firstLevelBitmap &= ~(1ull << firstLevel);
+		}
+	}
+}
+
+uint32_t TlsfAllocator::NewBlock()
+{
+	uint32_t block;
+	if (!m_unusedBlocks.empty())
+	{
+		block = m_unusedBlocks.back();
+		m_unusedBlocks.pop_back();
+	}
+	else
+	{
+		block = static_cast<uint32_t>(m_blocks.size());
+		m_blocks.emplace_back();
+	}
+	m_blocks[block] = { 0, 0, None, None, None, None, false };
+	return block;
+}
+
+void TlsfAllocator::ReleaseBlock(uint32_t block)
+{
+	m_blocks[block].size = 0; // marks it unused for GetStats and Validate
+	m_blocks[block].free = false;
+	m_unusedBlocks.push_back(block);
+}
+
+uint32_t TlsfAllocator::Split(uint32_t block, uint64_t frontSize)
+{
+	uint32_t back = NewBlock();
+	Block& front = m_blocks[block];
+	Block& b = m_blocks[back];
+
+	b.offset = front.offset + frontSize;
+	b.size = front.size - frontSize;
+	b.prevPhysical = block;
+	b.nextPhysical = front.nextPhysical;
+	if (front.nextPhysical != None) {
+		m_blocks[front.nextPhysical].prevPhysical = back;
+	}
+	front.nextPhysical = back;
+	front.size = frontSize;
+	return back;
+}
+
+TlsfStats TlsfAllocator::GetStats() const
+{
+	TlsfStats stats;
+	stats.size = m_size;
+	stats.usedBytes = m_usedBytes;
+	stats.allocations = static_cast<uint32_t>(m_allocated.size());
+	for (const Block& block : m_blocks)
+	{
+		if (block.size > 0 && block.free)
+		{
+			stats.freeBytes += block.size;
+			stats.largestFreeBlock = std::max(stats.largestFreeBlock, block.size);
+			stats.freeBlocks++;
+		}
+	}
+	return stats;
+}
+
+bool TlsfAllocator::Validate() const
+{
+	// free lists hold free blocks of their class, bitmaps match the lists
+	for (uint32_t firstLevel = 0; firstLevel < FirstLevelCount; firstLevel++)
+	{
+		for (uint32_t secondLevel = 0; secondLevel < SecondLevelCount; secondLevel++)
+		{
+			uint32_t head = m_freeLists[firstLevel][secondLevel];
+			bool bit = (m_secondLevelBitmaps[firstLevel] >> secondLevel) & 1;
+			if (bit != (head != None)) {
+				return false;
+			}
+			for (uint32_t block = head; block != None; block = m_blocks[block].nextFree)
+			{
+				uint32_t f, s;
+				Mapping(m_blocks[block].size, f, s);
+				if (!m_blocks[block].free || f != firstLevel || s != secondLevel) {
+					return false;
+				}
+			}
+		}
+		bool firstBit = (m_firstLevelBitmap >> firstLevel) & 1;
+		if (firstBit != (m_secondLevelBitmaps[firstLevel] != 0)) {
+			return false;
+		}
+	}
+
+	// the physical chain covers the range without gaps or two free neighbours
+	uint32_t block = None;
+	for (uint32_t i = 0; i < m_blocks.size(); i++) {
+		if (m_blocks[i].size > 0 && m_blocks[i].offset == 0) {
+			block = i;
+		}
+	}
+	uint64_t end = 0;
+	uint64_t used = 0;
+	uint32_t usedBlocks = 0;
+	bool previousFree = false;
+	for (; block != None; block = m_blocks[block].nextPhysical)
+	{
+		const Block& b = m_blocks[block];
+		if (b.offset != end || (previousFree && b.free)) {
+			return false;
+		}
+		if (!b.free) {
+			used += b.size;
+			usedBlocks++;
+		}
+		end += b.size;
+		previousFree = b.free;
+	}
+	return end == m_size && used == m_usedBytes && usedBlocks == m_allocated.size();
+}
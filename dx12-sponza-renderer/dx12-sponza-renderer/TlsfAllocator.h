@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// two level segregated fit allocator over an abstract range of bytes. the
+// block list lives on the cpu side, so it can manage memory the cpu can't
+// touch such as an ID3D12Heap (see GpuHeapAllocator). allocation and free
+// are O(1): free blocks sit in size class lists found through two bitmaps,
+// neighbours are merged as soon as they are freed.
+
+struct TlsfStats
+{
+	uint64_t size = 0;
+	uint64_t usedBytes = 0; // including alignment padding that couldn't be split off
+	uint64_t freeBytes = 0;
+	uint64_t largestFreeBlock = 0;
+	uint32_t allocations = 0;
+	uint32_t freeBlocks = 0;
+
+	// 0 when all free space is one block, close to 1 when it's scattered
+	float Fragmentation() const {
+		return freeBytes > 0 ? 1.0f - static_cast<float>(largestFreeBlock) / freeBytes : 0.0f;
+	}
+};
+
+class TlsfAllocator
+{
+public:
+	static const uint64_t InvalidOffset = ~0ull;
+
+	explicit TlsfAllocator(uint64_t size = 0);
+
+	// forgets every allocation
+	void Reset(uint64_t size);
+
+	// alignment has to be a power of two. returns InvalidOffset when no free
+	// block can hold the aligned size
+	uint64_t Allocate(uint64_t size, uint64_t alignment);
+	void Free(uint64_t offset);
+
+	bool IsEmpty() const { return m_allocated.empty(); }
+	TlsfStats GetStats() const;
+
+	// checks the physical chain, free lists and bitmaps agree, for debugging
+	bool Validate() const;
+
+private:
+	static const uint32_t SecondLevelLog2 = 4;
+	static const uint32_t SecondLevelCount = 1 << SecondLevelLog2;
+	static const uint32_t FirstLevelCount = 64 - SecondLevelLog2 + 1;
+	static const uint32_t None = ~0u;
+
+	struct Block
+	{
+		uint64_t offset;
+		uint64_t size;
+		uint32_t prevPhysical;
+		uint32_t nextPhysical;
+		uint32_t prevFree;
+		uint32_t nextFree;
+		bool free;
+	};
+
+	static void Mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+	uint32_t FindFreeBlock(uint64_t size) const;
+	void InsertFree(uint32_t block);
+	void RemoveFree(uint32_t block);
+	uint32_t NewBlock();
+	void ReleaseBlock(uint32_t block);
+	// splits the front of block off into a new block, returns the back part
+	uint32_t Split(uint32_t block, uint64_t frontSize);
+
+	std::vector<Block> m_blocks;
+	std::vector<uint32_t> m_unusedBlocks;
+	std::unordered_map<uint64_t, uint32_t> m_allocated; // by offset
+
+	uint64_t m_firstLevelBitmap = 0;
+	uint32_t m_secondLevelBitmaps[FirstLevelCount] = {};
+	uint32_t m_freeLists[FirstLevelCount][SecondLevelCount];
+
+	uint64_t m_size = 0;
+	uint64_t m_usedBytes = 0;
+};
@@ -0,0 +1,89 @@
+#include "UploadRingBuffer.h"
+#include "d3dx12.h"
+
+using Microsoft::WRL::ComPtr;
+
+bool UploadRingBuffer::Initialize(ID3D12Device* device, UINT64 capacity)
+{
+	m_device = device;
+
+	auto uploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(capacity);
+	if (FAILED(m_device->CreateCommittedResource(
+		&uploadHeapProps,
+		D3D12_HEAP_FLAG_NONE,
+		&bufferDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&m_buffer)))) {
+		return false;
+	}
+
+	// upload heaps can stay mapped for their whole lifetime
+	CD3DX12_RANGE readRange(0, 0);
+	if (FAILED(m_buffer->Map(0, &readRange, reinterpret_cast<void**>(&m_mappedData)))) {
+		return false;
+	}
+
+	m_ring.Reset(capacity);
+	return true;
+}
+
+UploadAllocation UploadRingBuffer::Allocate(UINT64 size, UINT64 alignment)
+{
+	UploadAllocation allocation = {};
+
+	UINT64 offset = m_ring.Allocate(size, alignment);
+	if (offset != RingAllocator::InvalidOffset)
+	{
+		allocation.resource = m_buffer.Get();
+		allocation.offset = offset;
+		allocation.cpuAddress = m_mappedData + offset;
+		allocation.gpuAddress = m_buffer->GetGPUVirtualAddress() + offset;
+		return allocation;
+	}
+
+	// resources start at 64 KB boundaries, so offset 0 satisfies any copy alignment
+	ComPtr<ID3D12Resource> buffer;
+	auto uploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+	if (FAILED(m_device->CreateCommittedResource(
+		&uploadHeapProps,
+		D3D12_HEAP_FLAG_NONE,
+		&bufferDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&buffer)))) {
+		return {};
+	}
+
+	CD3DX12_RANGE readRange(0, 0);
+	if (FAILED(buffer->Map(0, &readRange, reinterpret_cast<void**>(&allocation.cpuAddress)))) {
+		return {};
+	}
+	allocation.resource = buffer.Get();
+	allocation.offset = 0;
+	allocation.gpuAddress = buffer->GetGPUVirtualAddress();
+
+	m_openDedicated.push_back(buffer);
+	m_dedicatedAllocations++;
+	return allocation;
+}
+
+void UploadRingBuffer::Submit(UINT64 fenceValue)
+{
+	m_ring.Submit(fenceValue);
+
+	m_dedicatedReleases.SetPendingFenceValue(fenceValue);
+	for (auto& buffer : m_openDedicated) {
+		m_dedicatedReleases.RetireObject(buffer);
+	}
+	m_openDedicated.clear();
+}
+
+void UploadRingBuffer::Reclaim(UINT64 completedFenceValue)
+{
+	m_ring.Reclaim(completedFenceValue);
+
+	m_dedicatedReleases.Process(completedFenceValue);
+}
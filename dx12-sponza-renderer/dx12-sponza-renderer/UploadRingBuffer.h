@@ -0,0 +1,49 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <vector>
+#include "RingAllocator.h"
+#include "DeferredReleaseQueue.h"
+
+struct UploadAllocation
+{
+	ID3D12Resource* resource; // the ring buffer, or a dedicated buffer for oversized requests
+	UINT64 offset;
+	UINT8* cpuAddress;
+	D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+};
+
+// staging memory for copies to default heap resources. one persistently mapped
+// upload buffer is handed out as a ring (see RingAllocator) and recycled as
+// the fence values passed to Submit complete, instead of creating and
+// destroying an upload heap per copy.
+class UploadRingBuffer
+{
+public:
+	bool Initialize(ID3D12Device* device, UINT64 capacity);
+
+	// valid until the fence value of the next Submit completes. requests the ring
+	// can't fit right now get a dedicated upload buffer, released the same way.
+	// when that can't be created either the allocation is empty, a null cpuAddress
+	UploadAllocation Allocate(UINT64 size, UINT64 alignment);
+
+	// call after signaling fenceValue on the queue executing the copies
+	void Submit(UINT64 fenceValue);
+	void Reclaim(UINT64 completedFenceValue);
+
+	const RingAllocatorStats& GetStats() const { return m_ring.GetStats(); }
+	UINT64 GetDedicatedAllocations() const { return m_dedicatedAllocations; }
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12Device> m_device;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_buffer;
+	UINT8* m_mappedData = nullptr;
+	RingAllocator m_ring;
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_openDedicated; // since the last Submit
+	// keyed on the fence of the queue running the copies, not the frame fence
+	DeferredReleaseQueue m_dedicatedReleases;
+	UINT64 m_dedicatedAllocations = 0;
+};
@@ -0,0 +1,325 @@
+#include "UploadService.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+void UploadService::Initialize(UploadBackend* backend, uint32_t maxBatchesInFlight)
+{
+	m_backend = backend;
+	m_maxBatchesInFlight = std::max(1u, maxBatchesInFlight);
+}
+
+UploadToken UploadService::UploadBuffer(void* destination, uint64_t destinationOffset, const void* data, uint64_t size)
+{
+	// split so no single copy needs more staging than a batch may hold
+	const uint8_t* source = static_cast<const uint8_t*>(data);
+	for (uint64_t offset = 0; offset < size; offset += maxBatchBytes)
+	{
+		uint64_t chunk = std::min(maxBatchBytes, size - offset);
+		UploadStaging staging;
+		if (!AllocateStaging(chunk, 16, staging)) {
+			return 0;
+		}
+		memcpy(staging.cpuAddress, source + offset, chunk);
+
+		OpenBatch();
+		m_backend->CopyBuffer(destination, destinationOffset + offset, staging, chunk);
+		m_batchBytes += chunk;
+		m_batchCopies++;
+		m_batchHasUploads = true;
+		m_stats.bytes += chunk;
+
+		UploadToken token = m_nextFenceValue;
+		CloseBatchIfFull();
+		if (offset + chunk >= size) {
+			m_stats.uploads++;
+			return token;
+		}
+	}
+
+	// nothing to copy, nothing to wait for
+	return 0;
+}
+
+UploadToken UploadService::UploadBufferInPlace(void* destination, uint64_t destinationOffset, uint64_t size,
+	const std::function<bool(uint8_t*)>& write)
+{
+	assert(size <= maxBatchBytes);
+	if (size == 0) {
+		return 0;
+	}
+
+	// staging of a failed write just goes back with the batch
+	UploadStaging staging;
+	if (!AllocateStaging(size, 16, staging) || !write(staging.cpuAddress)) {
+		return 0;
+	}
+
+	OpenBatch();
+	m_backend->CopyBuffer(destination, destinationOffset, staging, size);
+	m_batchBytes += size;
+	m_batchCopies++;
+	m_batchHasUploads = true;
+	m_stats.bytes += size;
+	m_stats.uploads++;
+
+	UploadToken token = m_nextFenceValue;
+	CloseBatchIfFull();
+	return token;
+}
+
+UploadToken UploadService::UploadTexture(void* destination, uint32_t subresource, const void* data,
+	const UploadTextureFootprint& footprint)
+{
+	// split by row ranges so no single copy needs more staging than a batch may hold
+	const uint8_t* source = static_cast<const uint8_t*>(data);
+	uint64_t rowsPerBatch = maxBatchBytes / std::max(1u, footprint.rowPitch);
+	uint32_t rowsPerCopy = static_cast<uint32_t>(std::max<uint64_t>(1, std::min<uint64_t>(rowsPerBatch, footprint.numRows)));
+	for (uint32_t firstRow = 0; firstRow < footprint.numRows; firstRow += rowsPerCopy)
+	{
+		UploadTextureFootprint rows = footprint;
+		rows.numRows = std::min(rowsPerCopy, footprint.numRows - firstRow);
+
+		// the last row isn't padded to the pitch
+		uint64_t size = uint64_t(rows.rowPitch) * (rows.numRows - 1) + rows.rowSize;
+		UploadStaging staging;
+		if (!AllocateStaging(size, 512, staging)) { // D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+			return 0;
+		}
+		memcpy(staging.cpuAddress, source + uint64_t(firstRow) * footprint.rowPitch, size);
+
+		OpenBatch();
+		m_backend->CopyTexture(destination, subresource, firstRow, staging, rows);
+		m_batchBytes += size;
+		m_batchCopies++;
+		m_batchHasUploads = true;
+		m_stats.bytes += size;
+
+		UploadToken token = m_nextFenceValue;
+		CloseBatchIfFull();
+		if (firstRow + rows.numRows >= footprint.numRows) {
+			m_stats.uploads++;
+			return token;
+		}
+	}
+
+	// nothing to copy, nothing to wait for
+	return 0;
+}
+
+UploadToken UploadService::CopyBuffer(void* destination, uint64_t destinationOffset, void* source, uint64_t sourceOffset, uint64_t size)
+{
+	if (size == 0) {
+		return 0;
+	}
+	if (m_batchHasUploads) {
+		Flush();
+	}
+
+	// no staging, so only the copy count limits the batch
+	OpenBatch();
+	m_backend->CopyBufferRegion(destination, destinationOffset, source, sourceOffset, size);
+	m_batchCopies++;
+	m_stats.copies++;
+
+	UploadToken token = m_nextFenceValue;
+	CloseBatchIfFull();
+	return token;
+}
+
+UploadToken UploadService::Flush()
+{
+	if (m_batchOpen)
+	{
+		uint32_t slot = m_nextSlot;
+		m_backend->ExecuteBatch(slot, m_nextFenceValue);
+		m_inFlight.push_back({ m_nextFenceValue, slot });
+
+		m_stats.batches++;
+		m_stats.largestBatchBytes = std::max(m_stats.largestBatchBytes, m_batchBytes);
+		m_stats.batchesInFlight = static_cast<uint32_t>(m_inFlight.size());
+
+		m_nextFenceValue++;
+		m_nextSlot = (m_nextSlot + 1) % m_maxBatchesInFlight;
+		m_batchOpen = false;
+		m_batchBytes = 0;
+		m_batchCopies = 0;
+		m_batchHasUploads = false;
+	}
+	return m_nextFenceValue - 1;
+}
+
+bool UploadService::IsComplete(UploadToken token)
+{
+	return token <= m_backend->GetCompletedFenceValue();
+}
+
+void UploadService::Wait(UploadToken token)
+{
+	if (IsComplete(token)) {
+		return;
+	}
+	EnsureSubmitted(token);
+	m_backend->WaitForFenceValue(token);
+	RetireCompletedBatches();
+}
+
+void UploadService::EnsureSubmitted(UploadToken token)
+{
+	if (m_batchOpen && token >= m_nextFenceValue) {
+		Flush();
+	}
+}
+
+bool UploadService::AllocateStaging(uint64_t size, uint64_t alignment, UploadStaging& staging)
+{
+	staging = {};
+	while (!m_backend->AllocateStaging(size, alignment, staging))
+	{
+		// the open batch's staging only comes back once it has run, so submit it
+		// and wait for the oldest batch until enough has been freed. with nothing
+		// left in flight the backend can't hold the copy at all
+		Flush();
+		if (m_inFlight.empty()) {
+			m_stats.stagingFailures++;
+			return false;
+		}
+		m_stats.stagingStalls++;
+		WaitForOldestBatch();
+	}
+	return true;
+}
+
+void UploadService::OpenBatch()
+{
+	if (m_batchOpen) {
+		return;
+	}
+
+	// the slot's allocator can only be reset once its last batch has finished
+	RetireCompletedBatches();
+	if (m_inFlight.size() >= m_maxBatchesInFlight) {
+		m_stats.batchSlotStalls++;
+		WaitForOldestBatch();
+	}
+
+	m_backend->BeginBatch(m_nextSlot);
+	m_batchOpen = true;
+}
+
+void UploadService::CloseBatchIfFull()
+{
+	if (m_batchBytes >= maxBatchBytes || m_batchCopies >= maxBatchCopies) {
+		Flush();
+	}
+}
+
+void UploadService::WaitForOldestBatch()
+{
+	m_backend->WaitForFenceValue(m_inFlight.front().fenceValue);
+	RetireCompletedBatches();
+}
+
+void UploadService::RetireCompletedBatches()
+{
+	uint64_t completed = m_backend->GetCompletedFenceValue();
+	while (!m_inFlight.empty() && m_inFlight.front().fenceValue <= completed) {
+		m_inFlight.pop_front();
+	}
+	m_stats.batchesInFlight = static_cast<uint32_t>(m_inFlight.size());
+}
+
+NullUploadBackend::NullUploadBackend(uint64_t stagingSize)
+	: m_staging(stagingSize)
+	, m_ring(stagingSize)
+{
+}
+
+bool NullUploadBackend::AllocateStaging(uint64_t size, uint64_t alignment, UploadStaging& staging)
+{
+	uint64_t offset = m_ring.Allocate(size, alignment);
+	if (offset == RingAllocator::InvalidOffset) {
+		return false;
+	}
+	staging.cpuAddress = m_staging.data() + offset;
+	staging.buffer = m_staging.data();
+	staging.offset = offset;
+	return true;
+}
+
+void NullUploadBackend::BeginBatch(uint32_t)
+{
+	assert(!m_recordingOpen);
+	m_recording.copies.clear();
+	m_recordingOpen = true;
+}
+
+void NullUploadBackend::CopyBuffer(void* destination, uint64_t destinationOffset, const UploadStaging& source, uint64_t size)
+{
+	assert(m_recordingOpen);
+	m_recording.copies.push_back({ destination, destinationOffset, source.offset, size, nullptr, false, {} });
+}
+
+void NullUploadBackend::CopyTexture(void* destination, uint32_t subresource, uint32_t firstRow, const UploadStaging& source,
+	const UploadTextureFootprint& footprint)
+{
+	assert(m_recordingOpen);
+	m_recording.copies.push_back({ destination, subresource, source.offset, firstRow, nullptr, true, footprint });
+}
+
+void NullUploadBackend::CopyBufferRegion(void* destination, uint64_t destinationOffset, void* source, uint64_t sourceOffset, uint64_t size)
+{
+	assert(m_recordingOpen);
+	m_recording.copies.push_back({ destination, destinationOffset, sourceOffset, size, static_cast<const uint8_t*>(source), false, {} });
+}
+
+void NullUploadBackend::ExecuteBatch(uint32_t, uint64_t fenceValue)
+{
+	assert(m_recordingOpen);
+	m_recording.fenceValue = fenceValue;
+	m_executing.push_back(std::move(m_recording));
+	m_recording = Batch();
+	m_recordingOpen = false;
+	m_ring.Submit(fenceValue);
+}
+
+void NullUploadBackend::WaitForFenceValue(uint64_t fenceValue)
+{
+	while (m_completedFenceValue < fenceValue && !m_executing.empty()) {
+		CompleteBatches(1);
+	}
+}
+
+void NullUploadBackend::CompleteBatches(uint32_t count)
+{
+	for (uint32_t i = 0; i < count && !m_executing.empty(); i++)
+	{
+		RunBatch(m_executing.front());
+		m_completedFenceValue = m_executing.front().fenceValue;
+		m_executing.pop_front();
+	}
+	m_ring.Reclaim(m_completedFenceValue);
+}
+
+void NullUploadBackend::RunBatch(const Batch& batch)
+{
+	for (const Copy& copy : batch.copies)
+	{
+		const uint8_t* source = (copy.source ? copy.source : m_staging.data()) + copy.stagingOffset;
+		if (!copy.texture) {
+			memcpy(static_cast<uint8_t*>(copy.destination) + copy.destinationOffset, source, copy.size);
+			continue;
+		}
+
+		// row ranges of a subresource arrive in order, the first one sizes it
+		auto& subresources = *static_cast<std::vector<std::vector<uint8_t>>*>(copy.destination);
+		std::vector<uint8_t>& target = subresources[copy.destinationOffset];
+		size_t firstRow = static_cast<size_t>(copy.size);
+		size_t end = (firstRow + copy.footprint.numRows) * copy.footprint.rowSize;
+		target.resize(firstRow == 0 ? end : std::max(target.size(), end));
+		for (uint32_t row = 0; row < copy.footprint.numRows; row++) {
+			memcpy(target.data() + (firstRow + row) * copy.footprint.rowSize,
+				source + size_t(row) * copy.footprint.rowPitch, copy.footprint.rowSize);
+		}
+	}
+}
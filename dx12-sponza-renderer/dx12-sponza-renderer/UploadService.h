@@ -0,0 +1,198 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <cstdint>
+#include "RingAllocator.h"
+
+// batches buffer and texture uploads for a copy queue. every upload returns a
+// token, the fence value of the batch carrying it, which the graphics queue
+// waits on gpu side (D3D12UploadBackend::QueueWait) before using the data.
+//
+// the service only schedules: it decides when a batch is closed, when the cpu
+// has to wait for a batch slot or staging memory, and hands the copies to an
+// UploadBackend. D3D12UploadBackend runs them on a COPY queue,
+// NullUploadBackend runs them with memcpy so the scheduling works without a
+// device.
+
+typedef uint64_t UploadToken; // 0 is always complete
+
+struct UploadStaging
+{
+	uint8_t* cpuAddress;
+	void* buffer; // backend specific
+	uint64_t offset;
+};
+
+// layout of one subresource in staging, as GetCopyableFootprints reports it
+struct UploadTextureFootprint
+{
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t rowPitch;
+	uint32_t rowSize;
+	uint32_t numRows;
+};
+
+class UploadBackend
+{
+public:
+	virtual ~UploadBackend() = default;
+
+	// staging for the batch that is signaled with the next ExecuteBatch fence.
+	// returns false when it's out of memory until earlier batches complete
+	virtual bool AllocateStaging(uint64_t size, uint64_t alignment, UploadStaging& staging) = 0;
+
+	// slot is in [0, maxBatchesInFlight) and the batch that used it last has completed
+	virtual void BeginBatch(uint32_t slot) = 0;
+	virtual void CopyBuffer(void* destination, uint64_t destinationOffset, const UploadStaging& source, uint64_t size) = 0;
+	// footprint.numRows rows starting at row firstRow of the subresource, width
+	// and height stay the subresource's
+	virtual void CopyTexture(void* destination, uint32_t subresource, uint32_t firstRow, const UploadStaging& source,
+		const UploadTextureFootprint& footprint) = 0;
+	// gpu to gpu, source and destination are different buffers
+	virtual void CopyBufferRegion(void* destination, uint64_t destinationOffset, void* source, uint64_t sourceOffset, uint64_t size) = 0;
+	virtual void ExecuteBatch(uint32_t slot, uint64_t fenceValue) = 0;
+
+	virtual uint64_t GetCompletedFenceValue() = 0;
+	virtual void WaitForFenceValue(uint64_t fenceValue) = 0;
+};
+
+struct UploadServiceStats
+{
+	uint64_t uploads = 0;
+	uint64_t copies = 0; // buffer to buffer
+	uint64_t bytes = 0;
+	uint64_t batches = 0;
+	uint64_t largestBatchBytes = 0;
+	uint64_t batchSlotStalls = 0; // cpu waits because every batch slot was in flight
+	uint64_t stagingStalls = 0; // cpu waits for staging memory
+	uint64_t stagingFailures = 0; // copies larger than the backend's staging, the upload returned 0
+	uint32_t batchesInFlight = 0;
+};
+
+class UploadService
+{
+public:
+	void Initialize(UploadBackend* backend, uint32_t maxBatchesInFlight = 3);
+
+	// uploads return 0 when there is nothing to copy, and also when the backend
+	// can't stage a copy even with nothing in flight. the destination is then
+	// partly written, so 0 for a non-empty upload is a failure
+	UploadToken UploadBuffer(void* destination, uint64_t destinationOffset, const void* data, uint64_t size);
+
+	// lets write fill the staging memory of a buffer upload in place instead
+	// of copying from a source, e.g. to decompress straight into mapped upload
+	// memory. size can't be more than maxBatchBytes. when write returns false
+	// nothing is copied and the returned token is 0
+	UploadToken UploadBufferInPlace(void* destination, uint64_t destinationOffset, uint64_t size,
+		const std::function<bool(uint8_t*)>& write);
+
+	// data points at the subresource in footprint layout, rows rowPitch apart.
+	// subresources larger than maxBatchBytes are copied in row ranges
+	UploadToken UploadTexture(void* destination, uint32_t subresource, const void* data,
+		const UploadTextureFootprint& footprint);
+
+	// copies between two gpu buffers on the upload queue. the copy sees every
+	// upload made before it, an open batch with uploads is submitted first
+	// since copies inside one batch aren't ordered
+	UploadToken CopyBuffer(void* destination, uint64_t destinationOffset, void* source, uint64_t sourceOffset, uint64_t size);
+
+	// submits the open batch, returns the token covering every upload so far
+	UploadToken Flush();
+
+	bool IsComplete(UploadToken token);
+	// cpu wait, submits the batch holding the token first if needed
+	void Wait(UploadToken token);
+	// makes sure the batch holding the token has been handed to the backend,
+	// a gpu queue wait on an unsubmitted fence value would never finish
+	void EnsureSubmitted(UploadToken token);
+
+	const UploadServiceStats& GetStats() const { return m_stats; }
+
+	// an open batch is submitted once it passes either limit
+	uint64_t maxBatchBytes = 32 * 1024 * 1024;
+	uint32_t maxBatchCopies = 512;
+
+private:
+	bool AllocateStaging(uint64_t size, uint64_t alignment, UploadStaging& staging);
+	void OpenBatch();
+	void CloseBatchIfFull();
+	void WaitForOldestBatch();
+	void RetireCompletedBatches();
+
+	struct InFlightBatch
+	{
+		uint64_t fenceValue;
+		uint32_t slot;
+	};
+
+	UploadBackend* m_backend = nullptr;
+	uint32_t m_maxBatchesInFlight = 3;
+	std::deque<InFlightBatch> m_inFlight;
+
+	uint64_t m_nextFenceValue = 1; // fence value of the open batch
+	uint32_t m_nextSlot = 0;
+	bool m_batchOpen = false;
+	uint64_t m_batchBytes = 0;
+	uint32_t m_batchCopies = 0;
+	bool m_batchHasUploads = false;
+
+	UploadServiceStats m_stats;
+};
+
+// runs uploads on the cpu. destinations are byte arrays for buffers and
+// std::vector<std::vector<uint8_t>> (one tightly packed vector per
+// subresource) for textures, buffer to buffer copies read byte arrays too.
+// batches complete when the test calls
+// CompleteBatches or waits on them, so any gpu timeline can be replayed.
+class NullUploadBackend : public UploadBackend
+{
+public:
+	explicit NullUploadBackend(uint64_t stagingSize = 64 * 1024 * 1024);
+
+	bool AllocateStaging(uint64_t size, uint64_t alignment, UploadStaging& staging) override;
+	void BeginBatch(uint32_t slot) override;
+	void CopyBuffer(void* destination, uint64_t destinationOffset, const UploadStaging& source, uint64_t size) override;
+	void CopyTexture(void* destination, uint32_t subresource, uint32_t firstRow, const UploadStaging& source,
+		const UploadTextureFootprint& footprint) override;
+	void CopyBufferRegion(void* destination, uint64_t destinationOffset, void* source, uint64_t sourceOffset, uint64_t size) override;
+	void ExecuteBatch(uint32_t slot, uint64_t fenceValue) override;
+	uint64_t GetCompletedFenceValue() override { return m_completedFenceValue; }
+	void WaitForFenceValue(uint64_t fenceValue) override;
+
+	// finishes up to count of the oldest executed batches
+	void CompleteBatches(uint32_t count);
+
+	uint32_t GetExecutingBatches() const { return static_cast<uint32_t>(m_executing.size()); }
+	const RingAllocatorStats& GetStagingStats() const { return m_ring.GetStats(); }
+
+private:
+	struct Copy
+	{
+		void* destination;
+		uint64_t destinationOffset; // or subresource for textures
+		uint64_t stagingOffset; // or offset into source
+		uint64_t size; // or first row for textures
+		const uint8_t* source; // buffer to buffer copies, staging otherwise
+		bool texture;
+		UploadTextureFootprint footprint;
+	};
+
+	struct Batch
+	{
+		uint64_t fenceValue;
+		std::vector<Copy> copies;
+	};
+
+	void RunBatch(const Batch& batch);
+
+	std::vector<uint8_t> m_staging;
+	RingAllocator m_ring;
+	Batch m_recording;
+	bool m_recordingOpen = false;
+	std::deque<Batch> m_executing;
+	uint64_t m_completedFenceValue = 0;
+};
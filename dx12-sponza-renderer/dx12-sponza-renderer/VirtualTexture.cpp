@@ -0,0 +1,571 @@
+#include "VirtualTexture.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	struct PageFileHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t pageSize;
+		uint32_t pageBorder;
+		uint32_t mipCount;
+	};
+
+	const uint32_t PageFileVersion = 1;
+
+	int SeekFile(std::FILE* file, uint64_t offset)
+	{
+#ifdef _WIN32
+		return _fseeki64(file, static_cast<long long>(offset), SEEK_SET);
+#else
+		return fseeko(file, static_cast<off_t>(offset), SEEK_SET);
+#endif
+	}
+
+	uint32_t MipDimension(uint32_t size, uint32_t mip)
+	{
+		return std::max(1u, size >> mip);
+	}
+}
+
+uint32_t VirtualTextureDesc::PagesX(uint32_t mip) const
+{
+	return (MipDimension(width, mip) + pageSize - 1) / pageSize;
+}
+
+uint32_t VirtualTextureDesc::PagesY(uint32_t mip) const
+{
+	return (MipDimension(height, mip) + pageSize - 1) / pageSize;
+}
+
+//------------------------------------------------------------------------------
+// PageFile
+
+PageFile::~PageFile()
+{
+	Close();
+}
+
+bool PageFile::Build(const TextureData& texture, uint32_t pageSize, uint32_t pageBorder,
+	const std::string& filename, std::string& error)
+{
+	VirtualTextureDesc desc;
+	desc.width = texture.Width();
+	desc.height = texture.Height();
+	desc.pageSize = pageSize;
+	desc.pageBorder = pageBorder;
+
+	// stop at the first mip that fits in a single page
+	desc.mipCount = 1;
+	while (desc.PagesX(desc.mipCount - 1) > 1 || desc.PagesY(desc.mipCount - 1) > 1) {
+		desc.mipCount++;
+	}
+
+	// power of two sizes keep the page table a regular mip chain
+	auto isPowerOfTwo = [](uint32_t value) { return value != 0 && (value & (value - 1)) == 0; };
+	if (!isPowerOfTwo(desc.width) || !isPowerOfTwo(desc.height) || !isPowerOfTwo(pageSize) ||
+		desc.width < pageSize || desc.height < pageSize) {
+		error = "virtual textures need power of two sizes of at least one page: " + filename;
+		return false;
+	}
+	if (desc.mipCount > texture.MipCount() || desc.mipCount > 16 || desc.PagesX(0) > 0x3FFF || desc.PagesY(0) > 0x3FFF) {
+		error = "texture can't be paged: " + filename;
+		return false;
+	}
+
+	std::FILE* file = std::fopen(filename.c_str(), "wb");
+	if (!file) {
+		error = "failed to create page file " + filename;
+		return false;
+	}
+
+	PageFileHeader header = {};
+	std::memcpy(header.magic, "VTPF", 4);
+	header.version = PageFileVersion;
+	header.width = desc.width;
+	header.height = desc.height;
+	header.pageSize = desc.pageSize;
+	header.pageBorder = desc.pageBorder;
+	header.mipCount = desc.mipCount;
+	std::fwrite(&header, sizeof(header), 1, file);
+
+	// pages are written in mip order straight after the offset table
+	uint64_t pageCount = 0;
+	for (uint32_t mip = 0; mip < desc.mipCount; mip++) {
+		pageCount += uint64_t(desc.PagesX(mip)) * desc.PagesY(mip);
+	}
+	uint64_t offset = sizeof(header) + pageCount * sizeof(uint64_t);
+	for (uint32_t mip = 0; mip < desc.mipCount; mip++)
+	{
+		uint32_t mipPages = desc.PagesX(mip) * desc.PagesY(mip);
+		for (uint32_t i = 0; i < mipPages; i++)
+		{
+			std::fwrite(&offset, sizeof(offset), 1, file);
+			offset += desc.PageBytes();
+		}
+	}
+
+	const uint32_t padded = desc.PaddedPageSize();
+	std::vector<uint8_t> page(desc.PageBytes());
+	for (uint32_t mip = 0; mip < desc.mipCount; mip++)
+	{
+		const TextureMip& source = texture.mips[mip];
+		for (uint32_t pageY = 0; pageY < desc.PagesY(mip); pageY++)
+		{
+			for (uint32_t pageX = 0; pageX < desc.PagesX(mip); pageX++)
+			{
+				// borders and partial edge pages wrap, matching the scene's sampler
+				for (uint32_t y = 0; y < padded; y++)
+				{
+					int64_t sourceY = int64_t(pageY) * pageSize + y - pageBorder;
+					sourceY = ((sourceY % source.height) + source.height) % source.height;
+					for (uint32_t x = 0; x < padded; x++)
+					{
+						int64_t sourceX = int64_t(pageX) * pageSize + x - pageBorder;
+						sourceX = ((sourceX % source.width) + source.width) % source.width;
+						std::memcpy(&page[(size_t(y) * padded + x) * 4],
+							&source.pixels[(size_t(sourceY) * source.width + sourceX) * 4], 4);
+					}
+				}
+				std::fwrite(page.data(), 1, page.size(), file);
+			}
+		}
+	}
+
+	bool ok = std::ferror(file) == 0;
+	std::fclose(file);
+	if (!ok) {
+		error = "failed to write page file " + filename;
+	}
+	return ok;
+}
+
+bool PageFile::Open(const std::string& filename, std::string& error)
+{
+	Close();
+
+	m_file = std::fopen(filename.c_str(), "rb");
+	if (!m_file) {
+		error = "failed to open page file " + filename;
+		return false;
+	}
+
+	PageFileHeader header = {};
+	if (std::fread(&header, sizeof(header), 1, m_file) != 1 ||
+		std::memcmp(header.magic, "VTPF", 4) != 0 || header.version != PageFileVersion) {
+		error = "not a page file: " + filename;
+		Close();
+		return false;
+	}
+
+	m_desc.width = header.width;
+	m_desc.height = header.height;
+	m_desc.pageSize = header.pageSize;
+	m_desc.pageBorder = header.pageBorder;
+	m_desc.mipCount = header.mipCount;
+
+	m_pageOffsets.resize(m_desc.mipCount);
+	for (uint32_t mip = 0; mip < m_desc.mipCount; mip++)
+	{
+		m_pageOffsets[mip].resize(size_t(m_desc.PagesX(mip)) * m_desc.PagesY(mip));
+		size_t count = m_pageOffsets[mip].size();
+		if (std::fread(m_pageOffsets[mip].data(), sizeof(uint64_t), count, m_file) != count) {
+			error = "truncated page file: " + filename;
+			Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void PageFile::Close()
+{
+	if (m_file) {
+		std::fclose(m_file);
+		m_file = nullptr;
+	}
+	m_pageOffsets.clear();
+}
+
+bool PageFile::ReadPage(uint32_t pageId, std::vector<uint8_t>& pixels)
+{
+	uint32_t mip = PageId::Mip(pageId);
+	if (mip >= m_desc.mipCount || PageId::X(pageId) >= m_desc.PagesX(mip) || PageId::Y(pageId) >= m_desc.PagesY(mip)) {
+		return false;
+	}
+
+	uint64_t offset = m_pageOffsets[mip][size_t(PageId::Y(pageId)) * m_desc.PagesX(mip) + PageId::X(pageId)];
+	pixels.resize(m_desc.PageBytes());
+
+	std::lock_guard<std::mutex> lock(m_fileMutex);
+	return SeekFile(m_file, offset) == 0 &&
+		std::fread(pixels.data(), 1, pixels.size(), m_file) == pixels.size();
+}
+
+//------------------------------------------------------------------------------
+// PageTable
+
+void PageTable::Initialize(const VirtualTextureDesc& desc)
+{
+	m_desc = desc;
+	m_mips.resize(desc.mipCount);
+	for (uint32_t mip = 0; mip < desc.mipCount; mip++) {
+		m_mips[mip].assign(size_t(desc.PagesX(mip)) * desc.PagesY(mip), Entry());
+	}
+	m_dirty = true;
+}
+
+PageTable::Entry& PageTable::At(uint32_t pageId)
+{
+	uint32_t mip = PageId::Mip(pageId);
+	return m_mips[mip][size_t(PageId::Y(pageId)) * m_desc.PagesX(mip) + PageId::X(pageId)];
+}
+
+const PageTable::Entry& PageTable::At(uint32_t pageId) const
+{
+	uint32_t mip = PageId::Mip(pageId);
+	return m_mips[mip][size_t(PageId::Y(pageId)) * m_desc.PagesX(mip) + PageId::X(pageId)];
+}
+
+void PageTable::SetResident(uint32_t pageId, uint32_t slotX, uint32_t slotY)
+{
+	Entry& entry = At(pageId);
+	entry.slotX = static_cast<uint8_t>(slotX);
+	entry.slotY = static_cast<uint8_t>(slotY);
+	entry.mip = static_cast<uint8_t>(PageId::Mip(pageId));
+	entry.resident = 1;
+	m_dirty = true;
+}
+
+void PageTable::SetNonResident(uint32_t pageId)
+{
+	At(pageId).resident = 0;
+	m_dirty = true;
+}
+
+bool PageTable::IsResident(uint32_t pageId) const
+{
+	return At(pageId).resident != 0;
+}
+
+void PageTable::ResolveFallbacks()
+{
+	for (int mip = int(m_desc.mipCount) - 2; mip >= 0; mip--)
+	{
+		uint32_t pagesX = m_desc.PagesX(mip);
+		uint32_t pagesY = m_desc.PagesY(mip);
+		for (uint32_t y = 0; y < pagesY; y++)
+		{
+			for (uint32_t x = 0; x < pagesX; x++)
+			{
+				Entry& entry = m_mips[mip][size_t(y) * pagesX + x];
+				if (!entry.resident)
+				{
+					entry = At(PageId::Parent(PageId::Pack(mip, x, y)));
+					entry.resident = 0;
+				}
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// FeedbackAnalyzer
+
+void FeedbackAnalyzer::Analyze(const uint32_t* feedback, size_t count, const VirtualTextureDesc& desc,
+	const PageTable& pageTable, std::vector<uint32_t>& touchedPages, std::vector<Request>& requests)
+{
+	m_histogram.clear();
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t pageId = feedback[i];
+		if (pageId == PageId::Invalid) {
+			continue;
+		}
+
+		uint32_t mip = PageId::Mip(pageId);
+		if (mip >= desc.mipCount || PageId::X(pageId) >= desc.PagesX(mip) || PageId::Y(pageId) >= desc.PagesY(mip)) {
+			continue;
+		}
+		m_histogram[pageId]++;
+	}
+
+	std::unordered_map<uint32_t, uint32_t> missing;
+	for (const auto& [pageId, pixels] : m_histogram)
+	{
+		if (pageTable.IsResident(pageId)) {
+			touchedPages.push_back(pageId);
+			continue;
+		}
+
+		// until it arrives the pixels sample the closest resident ancestor,
+		// which therefore counts as used. ancestors on the way are requested too
+		uint32_t page = pageId;
+		for (;;)
+		{
+			uint32_t& requested = missing[page];
+			requested = std::max(requested, pixels);
+
+			if (PageId::Mip(page) + 1 >= desc.mipCount) {
+				break;
+			}
+			page = PageId::Parent(page);
+			if (pageTable.IsResident(page)) {
+				touchedPages.push_back(page);
+				break;
+			}
+		}
+	}
+
+	for (const auto& [pageId, pixels] : missing) {
+		requests.push_back({ pageId, pixels });
+	}
+	std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) {
+		if (PageId::Mip(a.pageId) != PageId::Mip(b.pageId)) {
+			return PageId::Mip(a.pageId) > PageId::Mip(b.pageId);
+		}
+		if (a.pixelCount != b.pixelCount) {
+			return a.pixelCount > b.pixelCount;
+		}
+		return a.pageId < b.pageId;
+	});
+}
+
+//------------------------------------------------------------------------------
+// PhysicalPageCache
+
+void PhysicalPageCache::Initialize(uint32_t slotsX, uint32_t slotsY)
+{
+	m_slotsX = slotsX;
+	m_slots.assign(size_t(slotsX) * slotsY, Slot());
+	m_pageToSlot.clear();
+	m_lru.clear();
+	m_lruPosition.resize(m_slots.size());
+	for (uint32_t i = 0; i < m_slots.size(); i++) {
+		m_lruPosition[i] = m_lru.insert(m_lru.end(), i);
+	}
+}
+
+uint32_t PhysicalPageCache::Find(uint32_t pageId) const
+{
+	auto it = m_pageToSlot.find(pageId);
+	return it != m_pageToSlot.end() ? it->second : UINT32_MAX;
+}
+
+void PhysicalPageCache::Touch(uint32_t slot, uint64_t frameIndex)
+{
+	m_slots[slot].lastUsedFrame = frameIndex;
+	if (!m_slots[slot].pinned) {
+		m_lru.splice(m_lru.end(), m_lru, m_lruPosition[slot]);
+	}
+}
+
+bool PhysicalPageCache::Allocate(uint32_t pageId, uint64_t frameIndex, bool pinned, uint32_t& slot, uint32_t& evictedPageId)
+{
+	if (m_lru.empty()) {
+		return false;
+	}
+
+	// pages seen in this frame's feedback are still needed
+	slot = m_lru.front();
+	Slot& candidate = m_slots[slot];
+	if (candidate.pageId != PageId::Invalid && candidate.lastUsedFrame >= frameIndex) {
+		return false;
+	}
+
+	evictedPageId = candidate.pageId;
+	if (evictedPageId != PageId::Invalid) {
+		m_pageToSlot.erase(evictedPageId);
+	}
+
+	candidate.pageId = pageId;
+	candidate.lastUsedFrame = frameIndex;
+	candidate.pinned = pinned;
+	m_pageToSlot[pageId] = slot;
+
+	if (pinned) {
+		m_lru.erase(m_lruPosition[slot]);
+	}
+	else {
+		m_lru.splice(m_lru.end(), m_lru, m_lruPosition[slot]);
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// VirtualTextureSystem
+
+VirtualTextureSystem::~VirtualTextureSystem()
+{
+	Shutdown();
+}
+
+bool VirtualTextureSystem::Initialize(const std::string& pageFile, uint32_t cacheSlotsX, uint32_t cacheSlotsY, std::string& error)
+{
+	if (!m_pageFile.Open(pageFile, error)) {
+		return false;
+	}
+
+	// page table entries store slot coordinates in 8 bits
+	if (cacheSlotsX == 0 || cacheSlotsY == 0 || cacheSlotsX > 256 || cacheSlotsY > 256) {
+		error = "physical page cache must be between 1x1 and 256x256 pages";
+		return false;
+	}
+
+	const VirtualTextureDesc& desc = m_pageFile.GetDesc();
+	m_pageTable.Initialize(desc);
+	m_cache.Initialize(cacheSlotsX, cacheSlotsY);
+	m_stats.physicalSlots = m_cache.GetSlotCount();
+
+	// the single page of the coarsest mip is every lookup's last fallback,
+	// it's read synchronously and pinned in CollectCompletedPages
+	LoadedPage root;
+	root.pageId = PageId::Pack(desc.mipCount - 1, 0, 0);
+	if (!m_pageFile.ReadPage(root.pageId, root.pixels)) {
+		error = "failed to read root page of " + pageFile;
+		return false;
+	}
+	m_inFlight.insert(root.pageId);
+	m_completedLoads.push_back(std::move(root));
+
+	m_stopLoader = false;
+	m_loaderThread = std::thread(&VirtualTextureSystem::LoaderThread, this);
+	return true;
+}
+
+void VirtualTextureSystem::Shutdown()
+{
+	if (m_loaderThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_queueMutex);
+			m_stopLoader = true;
+		}
+		m_queueCondition.notify_all();
+		m_loaderThread.join();
+	}
+	m_pageFile.Close();
+}
+
+void VirtualTextureSystem::ProcessFeedback(const uint32_t* feedback, size_t count, uint64_t frameIndex)
+{
+	m_frameIndex = frameIndex;
+	m_touchedPages.clear();
+	m_requests.clear();
+	m_analyzer.Analyze(feedback, count, GetDesc(), m_pageTable, m_touchedPages, m_requests);
+
+	for (uint32_t pageId : m_touchedPages)
+	{
+		uint32_t slot = m_cache.Find(pageId);
+		if (slot != UINT32_MAX) {
+			m_cache.Touch(slot, frameIndex);
+		}
+	}
+
+	m_stats.requestedThisFrame = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		for (const auto& request : m_requests)
+		{
+			if (m_stats.requestedThisFrame >= maxRequestsPerFrame) {
+				break;
+			}
+			if (!m_inFlight.insert(request.pageId).second) {
+				continue;
+			}
+			m_pendingLoads.push_back(request.pageId);
+			m_stats.requestedThisFrame++;
+		}
+	}
+	if (m_stats.requestedThisFrame > 0) {
+		m_queueCondition.notify_one();
+	}
+	m_stats.loadsInFlight = static_cast<uint32_t>(m_inFlight.size());
+}
+
+void VirtualTextureSystem::CollectCompletedPages(uint32_t maxUploads, std::vector<PageUpload>& uploads)
+{
+	std::vector<LoadedPage> completed;
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		size_t take = std::min<size_t>(maxUploads, m_completedLoads.size());
+		completed.assign(std::make_move_iterator(m_completedLoads.begin()),
+			std::make_move_iterator(m_completedLoads.begin() + take));
+		m_completedLoads.erase(m_completedLoads.begin(), m_completedLoads.begin() + take);
+	}
+
+	const uint32_t rootPage = PageId::Pack(GetDesc().mipCount - 1, 0, 0);
+	m_stats.uploadedThisFrame = 0;
+	m_stats.evictedThisFrame = 0;
+	m_stats.droppedThisFrame = 0;
+
+	for (auto& page : completed)
+	{
+		m_inFlight.erase(page.pageId);
+		if (page.pixels.empty() || m_cache.Find(page.pageId) != UINT32_MAX) {
+			continue;
+		}
+
+		// when every slot was used this frame the page is dropped,
+		// feedback will ask for it again once there is room
+		uint32_t slot, evictedPageId;
+		if (!m_cache.Allocate(page.pageId, m_frameIndex, page.pageId == rootPage, slot, evictedPageId)) {
+			m_stats.droppedThisFrame++;
+			continue;
+		}
+		if (evictedPageId != PageId::Invalid) {
+			m_pageTable.SetNonResident(evictedPageId);
+			m_stats.evictedThisFrame++;
+		}
+
+		uint32_t slotX = m_cache.SlotX(slot);
+		uint32_t slotY = m_cache.SlotY(slot);
+		m_pageTable.SetResident(page.pageId, slotX, slotY);
+		uploads.push_back({ slotX, slotY, std::move(page.pixels) });
+		m_stats.uploadedThisFrame++;
+		m_stats.totalLoads++;
+	}
+
+	if (m_pageTable.IsDirty()) {
+		m_pageTable.ResolveFallbacks();
+	}
+	m_stats.residentPages = m_cache.GetUsedSlotCount();
+	m_stats.loadsInFlight = static_cast<uint32_t>(m_inFlight.size());
+}
+
+void VirtualTextureSystem::WaitForLoads()
+{
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	m_idleCondition.wait(lock, [this] { return m_pendingLoads.empty() && m_activeLoads == 0; });
+}
+
+void VirtualTextureSystem::LoaderThread()
+{
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	for (;;)
+	{
+		m_queueCondition.wait(lock, [this] { return m_stopLoader || !m_pendingLoads.empty(); });
+		if (m_stopLoader) {
+			break;
+		}
+
+		LoadedPage page;
+		page.pageId = m_pendingLoads.front();
+		m_pendingLoads.pop_front();
+		m_activeLoads++;
+
+		lock.unlock();
+		if (!m_pageFile.ReadPage(page.pageId, page.pixels)) {
+			page.pixels.clear();
+		}
+		lock.lock();
+
+		m_completedLoads.push_back(std::move(page));
+		m_activeLoads--;
+		m_idleCondition.notify_all();
+	}
+}
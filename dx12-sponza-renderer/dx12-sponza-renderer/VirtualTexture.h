@@ -0,0 +1,233 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <list>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include "TextureLoader.h"
+
+// cpu side of sparse virtual texturing. a large texture is split into fixed size
+// pages stored on disk, the gpu only holds a physical page cache plus a page
+// table that maps every virtual page to the closest resident page. none of this
+// touches d3d12 so page management and feedback processing run headless,
+// VirtualTextureStreamer applies the results on the gpu.
+
+// feedback and page table addressing, packed as mip:4 y:14 x:14
+struct PageId
+{
+	static const uint32_t Invalid = 0xFFFFFFFF;
+
+	static uint32_t Pack(uint32_t mip, uint32_t x, uint32_t y) { return (mip << 28) | (y << 14) | x; }
+	static uint32_t Mip(uint32_t id) { return id >> 28; }
+	static uint32_t Y(uint32_t id) { return (id >> 14) & 0x3FFF; }
+	static uint32_t X(uint32_t id) { return id & 0x3FFF; }
+	static uint32_t Parent(uint32_t id) { return Pack(Mip(id) + 1, X(id) / 2, Y(id) / 2); }
+};
+
+struct VirtualTextureDesc
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t pageSize = 128; // texels of content per page side
+	uint32_t pageBorder = 4; // duplicated texels around each page for filtering
+	uint32_t mipCount = 0; // down to the mip that fits in a single page
+
+	uint32_t PaddedPageSize() const { return pageSize + 2 * pageBorder; }
+	uint32_t PageBytes() const { return PaddedPageSize() * PaddedPageSize() * 4; }
+	uint32_t PagesX(uint32_t mip) const;
+	uint32_t PagesY(uint32_t mip) const;
+};
+
+// tiled rgba8 page storage on disk: header, per-mip page offset table, then pages
+class PageFile
+{
+public:
+	~PageFile();
+
+	static bool Build(const TextureData& texture, uint32_t pageSize, uint32_t pageBorder,
+		const std::string& filename, std::string& error);
+
+	bool Open(const std::string& filename, std::string& error);
+	void Close();
+
+	// thread safe, pixels receives PageBytes() bytes
+	bool ReadPage(uint32_t pageId, std::vector<uint8_t>& pixels);
+
+	const VirtualTextureDesc& GetDesc() const { return m_desc; }
+
+private:
+	VirtualTextureDesc m_desc;
+	std::vector<std::vector<uint64_t>> m_pageOffsets; // [mip][y * pagesX + x]
+	std::FILE* m_file = nullptr;
+	std::mutex m_fileMutex;
+};
+
+// for every virtual page of every mip, the physical slot and mip that should be
+// sampled. non resident pages inherit their parent's entry so lookups never miss
+class PageTable
+{
+public:
+	struct Entry
+	{
+		uint8_t slotX = 0;
+		uint8_t slotY = 0;
+		uint8_t mip = 0;
+		uint8_t resident = 0;
+	};
+
+	void Initialize(const VirtualTextureDesc& desc);
+
+	void SetResident(uint32_t pageId, uint32_t slotX, uint32_t slotY);
+	void SetNonResident(uint32_t pageId);
+	bool IsResident(uint32_t pageId) const;
+
+	// refreshes fallback entries, coarsest mip first
+	void ResolveFallbacks();
+	bool IsDirty() const { return m_dirty; }
+	void ClearDirty() { m_dirty = false; }
+
+	const std::vector<Entry>& GetMip(uint32_t mip) const { return m_mips[mip]; }
+
+private:
+	Entry& At(uint32_t pageId);
+	const Entry& At(uint32_t pageId) const;
+
+	VirtualTextureDesc m_desc;
+	std::vector<std::vector<Entry>> m_mips;
+	bool m_dirty = true;
+};
+
+// reduces a feedback buffer to the unique pages it references, coarsest first
+// and then by how many pixels asked for them. missing ancestors are added so a
+// fine page never arrives before the page it falls back to
+class FeedbackAnalyzer
+{
+public:
+	struct Request
+	{
+		uint32_t pageId;
+		uint32_t pixelCount;
+	};
+
+	void Analyze(const uint32_t* feedback, size_t count, const VirtualTextureDesc& desc,
+		const PageTable& pageTable, std::vector<uint32_t>& touchedPages, std::vector<Request>& requests);
+
+private:
+	std::unordered_map<uint32_t, uint32_t> m_histogram;
+};
+
+// fixed size grid of physical page slots with lru replacement
+class PhysicalPageCache
+{
+public:
+	struct Slot
+	{
+		uint32_t pageId = PageId::Invalid;
+		uint64_t lastUsedFrame = 0;
+		bool pinned = false;
+	};
+
+	void Initialize(uint32_t slotsX, uint32_t slotsY);
+
+	// returns the slot index or UINT32_MAX
+	uint32_t Find(uint32_t pageId) const;
+	void Touch(uint32_t slot, uint64_t frameIndex);
+
+	// picks a free slot or the least recently used one not touched this frame.
+	// evictedPageId receives the page that was dropped, if any
+	bool Allocate(uint32_t pageId, uint64_t frameIndex, bool pinned, uint32_t& slot, uint32_t& evictedPageId);
+
+	uint32_t SlotX(uint32_t slot) const { return slot % m_slotsX; }
+	uint32_t SlotY(uint32_t slot) const { return slot / m_slotsX; }
+	uint32_t GetSlotCount() const { return static_cast<uint32_t>(m_slots.size()); }
+	uint32_t GetUsedSlotCount() const { return static_cast<uint32_t>(m_pageToSlot.size()); }
+
+private:
+	std::vector<Slot> m_slots;
+	std::list<uint32_t> m_lru; // front is least recently used
+	std::vector<std::list<uint32_t>::iterator> m_lruPosition;
+	std::unordered_map<uint32_t, uint32_t> m_pageToSlot;
+	uint32_t m_slotsX = 0;
+};
+
+struct VirtualTextureStats
+{
+	uint32_t requestedThisFrame = 0;
+	uint32_t loadsInFlight = 0;
+	uint32_t uploadedThisFrame = 0;
+	uint32_t evictedThisFrame = 0;
+	uint32_t droppedThisFrame = 0; // loads with no free slot, the working set exceeds the cache
+	uint32_t residentPages = 0;
+	uint32_t physicalSlots = 0;
+	uint64_t totalLoads = 0;
+};
+
+// ties the pieces together and reads pages on a background thread
+class VirtualTextureSystem
+{
+public:
+	struct PageUpload
+	{
+		uint32_t slotX;
+		uint32_t slotY;
+		std::vector<uint8_t> pixels; // PageBytes() of padded rgba8
+	};
+
+	~VirtualTextureSystem();
+
+	bool Initialize(const std::string& pageFile, uint32_t cacheSlotsX, uint32_t cacheSlotsY, std::string& error);
+	void Shutdown();
+
+	// feeds one frame of gpu feedback, touches resident pages and queues the missing ones
+	void ProcessFeedback(const uint32_t* feedback, size_t count, uint64_t frameIndex);
+
+	// moves up to maxUploads finished loads into the cache. the page table has to
+	// be re-uploaded afterwards when IsDirty() is set
+	void CollectCompletedPages(uint32_t maxUploads, std::vector<PageUpload>& uploads);
+
+	// blocks until every queued load is finished, for tools and headless runs
+	void WaitForLoads();
+
+	const VirtualTextureDesc& GetDesc() const { return m_pageFile.GetDesc(); }
+	PageTable& GetPageTable() { return m_pageTable; }
+	const PhysicalPageCache& GetCache() const { return m_cache; }
+	const VirtualTextureStats& GetStats() const { return m_stats; }
+
+	uint32_t maxRequestsPerFrame = 32;
+
+private:
+	struct LoadedPage
+	{
+		uint32_t pageId;
+		std::vector<uint8_t> pixels;
+	};
+
+	void LoaderThread();
+
+	PageFile m_pageFile;
+	PageTable m_pageTable;
+	PhysicalPageCache m_cache;
+	FeedbackAnalyzer m_analyzer;
+	VirtualTextureStats m_stats;
+	uint64_t m_frameIndex = 0;
+
+	std::vector<uint32_t> m_touchedPages;
+	std::vector<FeedbackAnalyzer::Request> m_requests;
+	std::unordered_set<uint32_t> m_inFlight;
+
+	std::thread m_loaderThread;
+	std::mutex m_queueMutex;
+	std::condition_variable m_queueCondition;
+	std::condition_variable m_idleCondition;
+	std::deque<uint32_t> m_pendingLoads;
+	std::vector<LoadedPage> m_completedLoads;
+	uint32_t m_activeLoads = 0;
+	bool m_stopLoader = false;
+};
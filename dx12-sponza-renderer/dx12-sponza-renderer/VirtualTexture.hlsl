@@ -0,0 +1,60 @@
+// sparse virtual texture lookup, see VirtualTexture.h for the cpu side
+// the pixel shader using this needs [earlydepthstencil], uav writes
+// otherwise turn off early depth testing
+
+cbuffer VirtualTextureBuffer : register(b2)
+{
+    float2 vtVirtualPages; // pages in mip 0
+    float vtPageSize; // content texels per page side
+    float vtPageBorder;
+    float2 vtPhysicalSize; // physical cache in texels
+    float vtMipCount;
+    float vtFeedbackScale; // render target pixels per feedback texel
+};
+
+Texture2D vtPhysicalCache : register(t1);
+Texture2D<uint4> vtPageTable : register(t2);
+RWTexture2D<uint> vtFeedback : register(u1);
+
+float VTComputeMip(float2 uv)
+{
+    float2 texels = uv * vtVirtualPages * vtPageSize;
+    float2 dx = ddx(texels);
+    float2 dy = ddy(texels);
+    float lengthSq = max(dot(dx, dx), dot(dy, dy));
+    return clamp(0.5 * log2(lengthSq), 0.0, vtMipCount - 1.0);
+}
+
+uint2 VTPageAt(float2 uv, uint mip)
+{
+    float2 pages = max(floor(vtVirtualPages / exp2(mip)), 1.0);
+    return min(uint2(frac(uv) * pages), uint2(pages) - 1);
+}
+
+// one pixel per feedback texel reports the page it wanted, packed like PageId
+void VTWriteFeedback(float2 uv, uint mip, float4 svPosition)
+{
+    uint2 pixel = uint2(svPosition.xy);
+    uint scale = uint(vtFeedbackScale);
+    if (all(pixel % scale == 0))
+    {
+        uint2 page = VTPageAt(uv, mip);
+        vtFeedback[pixel / scale] = (mip << 28) | (page.y << 14) | page.x;
+    }
+}
+
+float4 VTSample(SamplerState linearSampler, float2 uv, float4 svPosition)
+{
+    uint mip = uint(VTComputeMip(uv));
+    VTWriteFeedback(uv, mip, svPosition);
+
+    // the entry points at the requested page or its closest resident ancestor
+    uint4 entry = vtPageTable.Load(int3(VTPageAt(uv, mip), mip));
+
+    float2 pages = max(floor(vtVirtualPages / exp2(entry.z)), 1.0);
+    float2 pageUV = frac(frac(uv) * pages);
+    float paddedSize = vtPageSize + 2.0 * vtPageBorder;
+    float2 texel = float2(entry.xy) * paddedSize + vtPageBorder + pageUV * vtPageSize;
+
+    return vtPhysicalCache.SampleLevel(linearSampler, texel / vtPhysicalSize, 0);
+}
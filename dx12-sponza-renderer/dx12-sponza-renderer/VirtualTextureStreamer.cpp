@@ -0,0 +1,232 @@
+#include "VirtualTextureStreamer.h"
+#include "d3dx12.h"
+#include <cstring>
+
+using Microsoft::WRL::ComPtr;
+
+bool VirtualTextureStreamer::Initialize(ID3D12Device* device, VirtualTextureSystem* system, DeferredReleaseQueue* releases,
+	UINT renderWidth, UINT renderHeight, UINT feedbackScale,
+	D3D12_CPU_DESCRIPTOR_HANDLE descriptorCpu, D3D12_GPU_DESCRIPTOR_HANDLE descriptorGpu)
+{
+	m_device = device;
+	m_system = system;
+	m_releases = releases;
+	m_descriptorGpu = descriptorGpu;
+
+	const VirtualTextureDesc& desc = system->GetDesc();
+	const PhysicalPageCache& cache = system->GetCache();
+	const UINT padded = desc.PaddedPageSize();
+	const UINT descriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	auto defaultHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+
+	UINT slotsX = cache.SlotX(cache.GetSlotCount() - 1) + 1;
+	UINT slotsY = cache.SlotY(cache.GetSlotCount() - 1) + 1;
+
+	m_constants.virtualPagesX = static_cast<float>(desc.PagesX(0));
+	m_constants.virtualPagesY = static_cast<float>(desc.PagesY(0));
+	m_constants.pageSize = static_cast<float>(desc.pageSize);
+	m_constants.pageBorder = static_cast<float>(desc.pageBorder);
+	m_constants.physicalWidth = static_cast<float>(slotsX * padded);
+	m_constants.physicalHeight = static_cast<float>(slotsY * padded);
+	m_constants.mipCount = static_cast<float>(desc.mipCount);
+	m_constants.feedbackScale = static_cast<float>(feedbackScale);
+
+	// physical page cache, a single mip since filtering across pages relies on the borders
+	auto physicalDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, slotsX * padded, slotsY * padded, 1, 1);
+	if (FAILED(device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &physicalDesc,
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, nullptr, IID_PPV_ARGS(&m_physicalCache)))) {
+		return false;
+	}
+
+	// one texel per virtual page, one mip per virtual texture mip
+	auto pageTableDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UINT,
+		desc.PagesX(0), desc.PagesY(0), 1, static_cast<UINT16>(desc.mipCount));
+	if (FAILED(device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &pageTableDesc,
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, nullptr, IID_PPV_ARGS(&m_pageTable)))) {
+		return false;
+	}
+
+	UINT feedbackWidth = (renderWidth + feedbackScale - 1) / feedbackScale;
+	UINT feedbackHeight = (renderHeight + feedbackScale - 1) / feedbackScale;
+	auto feedbackDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_UINT, feedbackWidth, feedbackHeight, 1, 1,
+		1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+	if (FAILED(device->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &feedbackDesc,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr, IID_PPV_ARGS(&m_feedback)))) {
+		return false;
+	}
+
+	UINT64 readbackSize = 0;
+	device->GetCopyableFootprints(&feedbackDesc, 0, 1, 0, &m_feedbackFootprint, nullptr, nullptr, &readbackSize);
+	auto readbackHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+	auto readbackDesc = CD3DX12_RESOURCE_DESC::Buffer(readbackSize);
+	if (FAILED(device->CreateCommittedResource(&readbackHeap, D3D12_HEAP_FLAG_NONE, &readbackDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_feedbackReadback)))) {
+		return false;
+	}
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	srvDesc.Texture2D.MipLevels = 1;
+	CD3DX12_CPU_DESCRIPTOR_HANDLE handle(descriptorCpu);
+	device->CreateShaderResourceView(m_physicalCache.Get(), &srvDesc, handle);
+
+	srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UINT;
+	srvDesc.Texture2D.MipLevels = desc.mipCount;
+	handle.Offset(1, descriptorSize);
+	device->CreateShaderResourceView(m_pageTable.Get(), &srvDesc, handle);
+
+	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+	uavDesc.Format = DXGI_FORMAT_R32_UINT;
+	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
+	handle.Offset(1, descriptorSize);
+	device->CreateUnorderedAccessView(m_feedback.Get(), nullptr, &uavDesc, handle);
+	m_feedbackUavGpu = CD3DX12_GPU_DESCRIPTOR_HANDLE(descriptorGpu, 2, descriptorSize);
+
+	D3D12_DESCRIPTOR_HEAP_DESC clearHeapDesc = {};
+	clearHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	clearHeapDesc.NumDescriptors = 1;
+	clearHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	if (FAILED(device->CreateDescriptorHeap(&clearHeapDesc, IID_PPV_ARGS(&m_clearHeap)))) {
+		return false;
+	}
+	device->CreateUnorderedAccessView(m_feedback.Get(), nullptr, &uavDesc, m_clearHeap->GetCPUDescriptorHandleForHeapStart());
+
+	m_feedbackData.resize(size_t(feedbackWidth) * feedbackHeight);
+	return true;
+}
+
+void VirtualTextureStreamer::BeginFrame(ID3D12GraphicsCommandList* commandList, uint64_t frameIndex)
+{
+	// the frame that wrote the feedback has been waited on before this one started
+	if (m_feedbackPending)
+	{
+		const D3D12_SUBRESOURCE_FOOTPRINT& footprint = m_feedbackFootprint.Footprint;
+		uint8_t* mapped = nullptr;
+		m_feedbackReadback->Map(0, nullptr, reinterpret_cast<void**>(&mapped));
+		for (UINT y = 0; y < footprint.Height; y++) {
+			std::memcpy(&m_feedbackData[size_t(y) * footprint.Width], mapped + size_t(y) * footprint.RowPitch,
+				footprint.Width * sizeof(uint32_t));
+		}
+		D3D12_RANGE writtenRange = { 0, 0 };
+		m_feedbackReadback->Unmap(0, &writtenRange);
+
+		m_system->ProcessFeedback(m_feedbackData.data(), m_feedbackData.size(), frameIndex);
+		m_feedbackPending = false;
+	}
+
+	m_uploads.clear();
+	m_system->CollectCompletedPages(maxUploadsPerFrame, m_uploads);
+	if (!m_uploads.empty()) {
+		UploadPages(commandList);
+	}
+	if (m_system->GetPageTable().IsDirty()) {
+		UploadPageTable(commandList);
+		m_system->GetPageTable().ClearDirty();
+	}
+
+	const UINT clearValue[4] = { PageId::Invalid, PageId::Invalid, PageId::Invalid, PageId::Invalid };
+	commandList->ClearUnorderedAccessViewUint(m_feedbackUavGpu, m_clearHeap->GetCPUDescriptorHandleForHeapStart(),
+		m_feedback.Get(), clearValue, 0, nullptr);
+}
+
+void VirtualTextureStreamer::EndFrame(ID3D12GraphicsCommandList* commandList)
+{
+	auto toCopy = CD3DX12_RESOURCE_BARRIER::Transition(m_feedback.Get(),
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	commandList->ResourceBarrier(1, &toCopy);
+
+	CD3DX12_TEXTURE_COPY_LOCATION dst(m_feedbackReadback.Get(), m_feedbackFootprint);
+	CD3DX12_TEXTURE_COPY_LOCATION src(m_feedback.Get(), 0);
+	commandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+
+	auto toUav = CD3DX12_RESOURCE_BARRIER::Transition(m_feedback.Get(),
+		D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	commandList->ResourceBarrier(1, &toUav);
+	m_feedbackPending = true;
+}
+
+void VirtualTextureStreamer::UploadPages(ID3D12GraphicsCommandList* commandList)
+{
+	const VirtualTextureDesc& desc = m_system->GetDesc();
+	const UINT padded = desc.PaddedPageSize();
+
+	// every page has the same footprint, only the placement offset differs
+	auto pageDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, padded, padded, 1, 1);
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+	UINT64 pageUploadSize = 0;
+	m_device->GetCopyableFootprints(&pageDesc, 0, 1, 0, &footprint, nullptr, nullptr, &pageUploadSize);
+	pageUploadSize = (pageUploadSize + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~UINT64(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+
+	ComPtr<ID3D12Resource> uploadHeap;
+	auto uploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(pageUploadSize * m_uploads.size());
+	m_device->CreateCommittedResource(&uploadHeapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&uploadHeap));
+
+	uint8_t* mapped = nullptr;
+	uploadHeap->Map(0, nullptr, reinterpret_cast<void**>(&mapped));
+
+	auto toCopy = CD3DX12_RESOURCE_BARRIER::Transition(m_physicalCache.Get(),
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
+	commandList->ResourceBarrier(1, &toCopy);
+
+	for (size_t i = 0; i < m_uploads.size(); i++)
+	{
+		const auto& upload = m_uploads[i];
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT placed = footprint;
+		placed.Offset = pageUploadSize * i;
+
+		for (UINT y = 0; y < padded; y++) {
+			std::memcpy(mapped + placed.Offset + size_t(y) * placed.Footprint.RowPitch,
+				&upload.pixels[size_t(y) * padded * 4], padded * 4);
+		}
+
+		CD3DX12_TEXTURE_COPY_LOCATION dst(m_physicalCache.Get(), 0);
+		CD3DX12_TEXTURE_COPY_LOCATION src(uploadHeap.Get(), placed);
+		commandList->CopyTextureRegion(&dst, upload.slotX * padded, upload.slotY * padded, 0, &src, nullptr);
+	}
+	uploadHeap->Unmap(0, nullptr);
+
+	auto toShader = CD3DX12_RESOURCE_BARRIER::Transition(m_physicalCache.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	commandList->ResourceBarrier(1, &toShader);
+
+	m_releases->RetireObject(uploadHeap);
+}
+
+void VirtualTextureStreamer::UploadPageTable(ID3D12GraphicsCommandList* commandList)
+{
+	const VirtualTextureDesc& desc = m_system->GetDesc();
+	const PageTable& pageTable = m_system->GetPageTable();
+
+	ComPtr<ID3D12Resource> uploadHeap;
+	const UINT64 uploadBufferSize = GetRequiredIntermediateSize(m_pageTable.Get(), 0, desc.mipCount);
+	auto uploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
+	m_device->CreateCommittedResource(&uploadHeapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&uploadHeap));
+
+	// entries are laid out as rgba8_uint texels
+	std::vector<D3D12_SUBRESOURCE_DATA> subresources(desc.mipCount);
+	for (uint32_t mip = 0; mip < desc.mipCount; mip++)
+	{
+		subresources[mip].pData = pageTable.GetMip(mip).data();
+		subresources[mip].RowPitch = desc.PagesX(mip) * sizeof(PageTable::Entry);
+		subresources[mip].SlicePitch = subresources[mip].RowPitch * desc.PagesY(mip);
+	}
+
+	auto toCopy = CD3DX12_RESOURCE_BARRIER::Transition(m_pageTable.Get(),
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
+	commandList->ResourceBarrier(1, &toCopy);
+
+	UpdateSubresources(commandList, m_pageTable.Get(), uploadHeap.Get(), 0, 0, desc.mipCount, subresources.data());
+
+	auto toShader = CD3DX12_RESOURCE_BARRIER::Transition(m_pageTable.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	commandList->ResourceBarrier(1, &toShader);
+
+	m_releases->RetireObject(uploadHeap);
+}
+
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <windows.h>
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <vector>
+#include "VirtualTexture.h"
+#include "DeferredReleaseQueue.h"
+
+// matches VirtualTextureBuffer in VirtualTexture.hlsl
+struct VirtualTextureConstants
+{
+	float virtualPagesX;
+	float virtualPagesY;
+	float pageSize;
+	float pageBorder;
+	float physicalWidth;
+	float physicalHeight;
+	float mipCount;
+	float feedbackScale;
+};
+
+// gpu side of a VirtualTextureSystem: the physical page cache texture, the page
+// table texture and the feedback target the pixel shader writes page ids into.
+// feedback is copied to a readback buffer at the end of a frame and analyzed
+// at the start of the next one.
+class VirtualTextureStreamer
+{
+public:
+	// descriptorCpu/Gpu point at three consecutive slots of a shader visible heap:
+	// physical cache srv, page table srv and feedback uav. upload heaps are
+	// retired to releases, which has to outlive the streamer
+	bool Initialize(ID3D12Device* device, VirtualTextureSystem* system, DeferredReleaseQueue* releases,
+		UINT renderWidth, UINT renderHeight, UINT feedbackScale,
+		D3D12_CPU_DESCRIPTOR_HANDLE descriptorCpu, D3D12_GPU_DESCRIPTOR_HANDLE descriptorGpu);
+
+	// processes the feedback of the last finished frame, uploads completed pages
+	// and the page table, then clears the feedback target. the heap holding the
+	// descriptors has to be set on commandList already
+	void BeginFrame(ID3D12GraphicsCommandList* commandList, uint64_t frameIndex);
+
+	// after the draws, copies this frame's feedback for readback
+	void EndFrame(ID3D12GraphicsCommandList* commandList);
+
+	D3D12_GPU_DESCRIPTOR_HANDLE GetDescriptorTable() const { return m_descriptorGpu; }
+	const VirtualTextureConstants& GetConstants() const { return m_constants; }
+
+	uint32_t maxUploadsPerFrame = 16;
+
+private:
+	void UploadPages(ID3D12GraphicsCommandList* commandList);
+	void UploadPageTable(ID3D12GraphicsCommandList* commandList);
+
+	Microsoft::WRL::ComPtr<ID3D12Device> m_device;
+	VirtualTextureSystem* m_system = nullptr;
+	DeferredReleaseQueue* m_releases = nullptr;
+	VirtualTextureConstants m_constants = {};
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_physicalCache;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_pageTable;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_feedback;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_feedbackReadback;
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_feedbackFootprint = {};
+	bool m_feedbackPending = false;
+	std::vector<uint32_t> m_feedbackData;
+
+	// ClearUnorderedAccessViewUint wants the uav in a cpu only heap too
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_clearHeap;
+	D3D12_GPU_DESCRIPTOR_HANDLE m_descriptorGpu = {};
+	D3D12_GPU_DESCRIPTOR_HANDLE m_feedbackUavGpu = {};
+
+	std::vector<VirtualTextureSystem::PageUpload> m_uploads;
+};
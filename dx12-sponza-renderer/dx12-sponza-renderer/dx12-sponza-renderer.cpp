@@ -8,13 +8,37 @@
 #include "ImGui/imgui_impl_win32.h"
 #include "ImGui/imgui_impl_dx12.h"
 #include <sstream>
-#define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 #include <filesystem>
+#include <algorithm>
 
 #include <DirectXMath.h>
 #include "OBJLoader.h"
+#include "MeshCache.h"
+#include "TextureStreamer.h"
+#include "UploadService.h"
+#include "D3D12UploadBackend.h"
+#include "GpuHeapAllocator.h"
+#include "GeometryPool.h"
+#include "DeferredReleaseQueue.h"
+#include "AssetPackage.h"
+#include "AssetPackTool.h"
+#include "StreamingQueue.h"
+#include "FramePacer.h"
+#include "FrameTelemetry.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "D3D12DrawBackend.h"
+#include "BundleCache.h"
+#include "JobSystem.h"
+#include "FramePacket.h"
+#include "SceneConstants.h"
+#include "CameraPath.h"
+#include "FrustumCuller.h"
+#include <thread>
+#include <mutex>
+#include <shellapi.h>
 using namespace DirectX;
 
 #pragma comment(lib, "d3d12.lib")
@@ -31,21 +55,82 @@ HWND hWnd;
 ComPtr<ID3D12Device> g_device; // gpu
 ComPtr<IDXGISwapChain3> g_swapChain; // back buffering
 ComPtr<ID3D12CommandQueue> g_commandQueue; // submit commands for the GPU to execute
-ComPtr<ID3D12CommandAllocator> g_commandAllocator; // memory for a batch of commands
 ComPtr<ID3D12GraphicsCommandList> g_commandList;
+ComPtr<ID3D12GraphicsCommandList> g_postCommandList; // imgui and the present barrier, after the draw chunks
 
 ComPtr<ID3D12DescriptorHeap> g_rtvHeap; // a heap to store descriptors
 UINT g_rtvDescriptorSize = 0; // size of a single descriptor on GPU
-ComPtr<ID3D12Resource> g_renderTargets[2]; // double buffering
+const UINT MaxBackBuffers = 4;
+ComPtr<ID3D12Resource> g_renderTargets[MaxBackBuffers];
 UINT g_currentBackBuffer = 0;
 
+// what the ui can change about rendering. the ui edits g_settings on the
+// main thread, every frame packet carries a copy and the render thread
+// applies what changed to g_renderSettings before it records the frame
+struct RenderSettings
+{
+	int backBufferCount = 3;
+	bool vsync = true;
+	int maxFrameLatency = 2;
+	int framesInFlight = 3;
+	bool useBundles = true;
+	bool parallelDraws = true;
+	int minDrawsPerChunk = 64;
+	int textureBudgetMB = 256;
+};
+RenderSettings g_settings;
+RenderSettings g_renderSettings;
+
+// swap chain setup. the buffer count is applied between frames with
+// ResizeBuffers, vsync off presents uncapped, tearing when the system allows it
+UINT g_swapChainBufferCount = 0; // what the swap chain currently has
+bool g_tearingSupported = false;
+UINT g_swapChainFlags = 0;
+FramePacer g_framePacer;
+
 // synchronization
 ComPtr<ID3D12Fence> g_fence;
-UINT64 g_fenceValue = 0;
+UINT64 g_fenceValue = 0; // the next value to signal
 HANDLE g_fenceEvent; // to tell CPU to wait for GPU
 
+// the cpu records up to framesInFlight frames ahead of the gpu. every frame
+// context has its own command allocator and constants, so only reusing a
+// context waits. more frames absorb cpu and gpu spikes, fewer cut input latency
+const UINT MaxFramesInFlight = 4;
+
+struct FrameContext
+{
+	ComPtr<ID3D12CommandAllocator> commandAllocator; // memory for a batch of commands
+	UINT64 fenceValue = 0; // completes once the gpu is done with the frame
+	UINT8* matrixConstants = nullptr; // cpu pointer to gpu memory
+	UINT8* lightConstants = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS matrixConstantsAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS lightConstantsAddress = 0;
+};
+FrameContext g_frameContexts[MaxFramesInFlight];
+UINT g_frameContext = 0; // the one being recorded
+
+// moving averages of where the cpu spends a frame
+struct FramePacingStats
+{
+	double frameMs = 0.0;
+	double fenceWaitMs = 0.0; // blocked on a frame context the gpu still uses
+	double presentMs = 0.0;
+	UINT64 framesQueued = 0; // submitted frames the gpu hasn't finished
+};
+FramePacingStats g_framePacing;
+
+// per phase cpu timings of every frame, percentiles over the newest
+// g_telemetryWindow frames are shown and all of them can be exported
+FrameTelemetry g_frameTelemetry;
+int g_telemetryWindow = 600;
+
+// gpu time of the passes in PopulateCommandList, read back a few frames late
+GpuProfiler g_gpuProfiler;
+
 ComPtr<ID3D12RootSignature> g_rootSignature; // defines resources shaders need
 ComPtr<ID3D12PipelineState> g_pipelineState;
+ComPtr<ID3D12PipelineState> g_maskedPipelineState; // alpha tested, drawn after the opaque meshes
 
 XMFLOAT4X4 g_worldMatrix;
 XMFLOAT4X4 g_viewMatrix;
@@ -58,11 +143,8 @@ ComPtr<ID3D12Resource> g_indexBuffer;
 D3D12_INDEX_BUFFER_VIEW g_indexBufferView;
 UINT g_indexCount = 0;
 
-ComPtr<ID3D12Resource> g_matrixConstantBuffer;
-ComPtr<ID3D12Resource> g_lightConstantBuffer;
-
-UINT8* g_pMatrixConstantBufferStart = nullptr; // cpu pointer to gpu memory
-UINT8* g_pLightConstantBufferStart = nullptr;
+// every frame context's constants, a 256 byte aligned region each
+ComPtr<ID3D12Resource> g_constantBuffer;
 
 ComPtr<ID3D12Resource> g_depthBuffer;
 ComPtr<ID3D12DescriptorHeap> g_dsvHeap;
@@ -89,47 +171,168 @@ XMFLOAT3 g_cameraUp = { 0.0f, 1.0f, 0.0f };
 float g_cameraMoveSpeed = 5.0f;
 float g_cameraRotationSpeed = 1.0f;
 
+// a path recorded from the camera or loaded for a benchmark, played back
+// looping in place of the input
+static const float CameraPathInterval = 0.25f; // seconds between recorded keys
+CameraPathRecorder g_cameraRecorder;
+CameraPath g_cameraPath;
+bool g_cameraPathPlaying = false;
+float g_cameraPathTime = 0.0f;
+
+// --benchmark plays a path at a fixed timestep for a number of frames, prints
+// the frame telemetry and exits
+struct BenchmarkRun
+{
+	bool enabled = false;
+	int frames = 0;
+	float timestep = 1.0f / 60.0f; // seconds
+	std::string telemetryFile; // optional json
+};
+BenchmarkRun g_benchmark;
+
 struct VertexTest {
 	XMFLOAT3 position;  // 12 bytes
 	XMFLOAT3 normal;    // 12 bytes
 	XMFLOAT2 texCoord;  // 8 bytes
 };
 
-struct MatrixBuffer
-{
-	XMFLOAT4X4 world;
-	XMFLOAT4X4 view;
-	XMFLOAT4X4 projection;
-
-	float padding[4]; // 4 floats = 16 bytes for alignment
-}; MatrixBuffer g_matrixBufferData;
-
-struct LightBuffer
-{
-	XMFLOAT3 lightDirection;
-	float padding1;       // 4 bytes padding
-	XMFLOAT3 lightColor;
-	float lightIntensity;
-	float ambientIntensity;
-	XMFLOAT3 cameraPosition;
-	float specularPower;
-	float specularIntensity;
-	float padding2[2];    // 8 bytes padding
-}; LightBuffer g_lightBufferData;
+MatrixBuffer g_matrixBufferData;
+LightBuffer g_lightBufferData;
 
 ComPtr<ID3D12DescriptorHeap> g_ImguiSrvDescHeap;
 float g_clearColor[4] = { 0.0f, 0.2f, 0.4f, 1.0f };
 
-std::vector<ComPtr<ID3D12Resource>> g_uploadResources;
+// buffer and texture uploads run on a copy queue, the direct queue waits
+// for their tokens on the gpu
+D3D12UploadBackend g_uploadBackend;
+UploadService g_uploadService;
+const UINT g_uploadBatchesInFlight = 3;
+const UINT64 g_uploadStagingSize = 64 * 1024 * 1024;
+
+// gpu objects are retired here and freed once g_fence passes the frame that
+// last used them
+DeferredReleaseQueue g_releaseQueue;
+
+// vertex, index and texture memory is sub-allocated from a few large heaps
+GpuHeapAllocator g_gpuHeaps;
+// every mesh shares one vertex and one index buffer
+GeometryPool g_geometryPool;
+// asynchronous file reads that land in cpu memory or, through the upload
+// service, in gpu buffers without the render thread waiting on disk
+StreamingQueue g_streamingQueue;
 
 struct RenderMesh {
-	ComPtr<ID3D12Resource> vertexBuffer;
-	ComPtr<ID3D12Resource> indexBuffer;
-	D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
-	D3D12_INDEX_BUFFER_VIEW indexBufferView;
-	UINT indexCount;
+	uint32_t geometry; // mesh id in g_geometryPool
+	UINT materialIndex;
+	XMFLOAT3 boundsMin;
+	XMFLOAT3 boundsMax;
+	float worldUnitsPerUV;
 };
 std::vector<RenderMesh> g_meshes;
+size_t g_firstMaskedMesh = 0; // meshes are sorted opaque first
+XMFLOAT3 g_sceneBoundsMin = {}; // of every mesh, camera paths are fitted to it
+XMFLOAT3 g_sceneBoundsMax = {};
+
+// the meshes' bounds in g_meshes order, tested against the camera's frustum
+// on the main thread to pick the frame packet's meshes
+FrustumCuller g_meshCuller;
+bool g_frustumCulling = true;
+uint32_t g_visibleMeshes = 0;
+double g_cullMs = 0.0;
+
+struct RenderMaterial {
+	uint32_t diffuseTexture;
+	bool alphaMasked;
+	MaterialConstants constants;
+};
+std::vector<RenderMaterial> g_materials;
+
+// loading and frame recording run their parallel work as jobs. the main
+// thread is worker 0 and runs jobs while it waits on them, the render thread
+// isn't a worker and hands its jobs over through the shared queue
+JobSystem g_jobSystem;
+
+// the mesh draws are recorded in chunks as jobs, each chunk into
+// its own command list. a frame submits g_commandList, the chunk lists in
+// order and g_postCommandList in one ExecuteCommandLists
+D3D12DrawBackend g_drawBackend;
+DrawRecorder g_drawRecorder;
+std::vector<DrawItem> g_drawItems;
+std::vector<ID3D12CommandList*> g_frameCommandLists;
+
+// the scene is static, so by default the draws are recorded into bundles
+// once and g_commandList only executes them, culling re-records the ones
+// whose draws changed. the chunked recording above is the fallback for
+// scenes that change every frame
+BundleCache g_bundleCache;
+
+// descriptor table switches a frame needs, one srv per texture vs one per texture array
+UINT g_bindGroupsUnpacked = 0;
+UINT g_bindGroupsPacked = 0;
+
+// assets are named relative to the root and come from sponza.pak in the root
+// when it exists, loose files otherwise. build the package with
+// dx12-sponza-renderer.exe --pack <root> <root>\sponza.pak models textures
+const std::string g_assetRoot = "C:\\Users\\akyur\\Documents\\graphics-github\\dx12-sponza-renderer\\dx12-sponza-renderer\\";
+const std::string g_textureDirectory = "textures/sponza/";
+AssetFileSystem g_assetFiles;
+const float g_verticalFov = XM_PIDIV4;
+
+TextureStreamer g_textureStreamer;
+UINT64 g_frameIndex = 0;
+
+// the main thread runs the window, input, camera and ui and hands every
+// frame to the render thread as a packet, the render thread records,
+// submits and presents it. with two packets the next frame is built while
+// the last one renders, at up to a frame more latency
+struct FramePacket
+{
+	uint64_t frame = 0;
+	double inputMs = 0.0; // when the frame's input was last pumped
+	bool paced = false; // the main thread already waited on the swap chain
+	FrameSample sample; // the main thread's phases, the render thread adds its own
+	MatrixBuffer matrices; // transposed for hlsl
+	LightBuffer light;
+	XMFLOAT3 cameraPosition;
+	std::vector<uint32_t> meshes; // into g_meshes, in draw order
+	RenderSettings settings;
+	ImGuiDrawSnapshot ui;
+};
+FramePacketQueue<FramePacket> g_framePackets;
+std::thread g_renderThread;
+// off renders every packet before the next is built, like a single
+// threaded loop, to compare throughput and latency against
+bool g_renderThreadEnabled = true;
+
+// the render thread's state as the ui shows it, copied out after every
+// frame so the ui never reads objects the render thread is using
+struct RenderStats
+{
+	FramePacingStats pacing;
+	FramePacerStats pacer;
+	BundleCacheStats bundles;
+	DrawRecorderStats draws;
+	uint32_t maxDrawChunks = 0;
+	TextureResidencyStats residency;
+	TexturePackStats packs;
+	UploadServiceStats uploads;
+	RingAllocatorStats staging;
+	UINT64 dedicatedStaging = 0;
+	StreamingQueueStats streaming;
+	bool asyncStreaming = false;
+	DeferredReleaseStats releases;
+	GeometryPoolStats geometry;
+	GpuHeapStats heaps;
+	bool gpuProfiler = false;
+	GpuFrameProfile gpuFrame;
+	double gpuFrameMs = 0.0;
+	double gpuQueueLatencyMs = 0.0;
+	// moving averages per mode, serial first, so both can be compared
+	double frameMs[2] = {};
+	double inputToPresentMs[2] = {};
+};
+std::mutex g_renderStatsMutex;
+RenderStats g_renderStats;
 
 ComPtr<ID3D12Resource> g_texture;
 ComPtr<ID3D12Resource> g_textureUploadHeap;
@@ -139,21 +342,68 @@ ComPtr<ID3D12DescriptorHeap> g_textureSrvHeap;
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
 extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 void InitD3D();
-void PopulateCommandList();
-void WaitForPreviousFrame();
+void BuildFramePacket(FramePacket& packet);
+void RenderThread();
+void RenderFrame(FramePacket& packet);
+void ApplyRenderSettings(RenderSettings settings);
+void PublishRenderStats(const FramePacket& packet);
+void PopulateCommandList(FramePacket& packet);
+void BuildDrawList(const FramePacket& packet);
+void WaitForGpu();
+void MoveToNextFrame();
+void CreateBackBuffers();
+bool ResizeBackBuffers(UINT count);
+double GetMilliseconds();
 void LoadTexture();
 void CreateConstantBuffers();
-template<typename T>
-void CreateConstantBuffer(ComPtr<ID3D12Resource>& buffer, UINT8*& mappedData, const T& initialData);
-void CreateBuffer(const void* data, UINT size, ComPtr<ID3D12Resource>& resource,
-	D3D12_RESOURCE_STATES initialState = D3D12_RESOURCE_STATE_COMMON);
-bool LoadOBJModel(const std::string& filename);
-void CleanupUploadResources();
+bool LoadOBJModel(const std::string& name);
 void UpdateCamera(float deltaTime);
+void UpdateCameraPath(float deltaTime);
+void UpdateViewMatrix();
+bool StartBenchmark(const std::vector<std::string>& args);
+int FinishBenchmark();
+std::string GetTimestamp();
+void UpdateTextureStreaming(const XMFLOAT3& cameraPosition);
+void ShowFrameTelemetry();
+void ShowGpuProfiler(const RenderStats& stats);
 
 // main entry point for windows applications
 int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPSTR lpCmdLine, _In_ int nCmdShow)
 {
+	// asset tool commands run instead of the renderer
+	int argc = 0;
+	LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+	std::vector<std::string> args;
+	for (int i = 1; argv && i < argc; i++)
+	{
+		int length = WideCharToMultiByte(CP_UTF8, 0, argv[i], -1, nullptr, 0, nullptr, nullptr);
+		std::string arg(length > 0 ? length - 1 : 0, '\0');
+		WideCharToMultiByte(CP_UTF8, 0, argv[i], -1, &arg[0], length, nullptr, nullptr);
+		args.push_back(arg);
+	}
+	LocalFree(argv);
+	if (!args.empty() && args[0].compare(0, 2, "--") == 0)
+	{
+		// a windows subsystem exe has no console of its own, print to the one it was started from
+		if (AttachConsole(ATTACH_PARENT_PROCESS)) {
+			freopen("CONOUT$", "w", stdout);
+		}
+		if (args[0] == "--benchmark") {
+			if (!StartBenchmark(args)) {
+				return 1;
+			}
+		}
+		else {
+			int result = RunAssetPackTool(args);
+			if (result >= 0) {
+				return result;
+			}
+		}
+	}
+
+	PROFILE_THREAD("main");
+	// a worker per spare core on top of the main thread
+	g_jobSystem.Initialize(std::min(7u, std::max(1u, std::thread::hardware_concurrency()) - 1));
 	SetProcessDPIAware();
 	SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
 
@@ -189,8 +439,14 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
 	UpdateWindow(hWnd);
 	SetFocus(hWnd);
 
-	// main loop
+	// records and presents what the loop below builds
+	g_renderThread = std::thread(RenderThread);
+
+	// main loop, builds a frame packet per frame
 	MSG msg = {};
+	double lastFrameStart = GetMilliseconds();
+	uint64_t frameCount = 0;
+	RenderStats renderStats;
 	while (msg.message != WM_QUIT)
 	{
 		if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
@@ -200,19 +456,73 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
 		}
 		else
 		{
-			LARGE_INTEGER frequency, lastTime, currentTime;
-			QueryPerformanceFrequency(&frequency);
-			QueryPerformanceCounter(&lastTime);
-			float deltaTime = 0.0f;
-
-			QueryPerformanceCounter(&currentTime);
-			deltaTime = static_cast<float>(currentTime.QuadPart - lastTime.QuadPart) / frequency.QuadPart;
-			lastTime = currentTime;
+			PROFILE_ZONE("frame");
+
+			double frameStart = GetMilliseconds();
+			float deltaTime = static_cast<float>(frameStart - lastFrameStart) / 1000.0f;
+			lastFrameStart = frameStart;
+
+			// serial waits until the render thread is done with every packet,
+			// including one from before the switch
+			bool serial = !g_renderThreadEnabled;
+			FramePacket* packet = nullptr;
+			{
+				PROFILE_ZONE("wait for frame packet");
+				if (serial) {
+					g_framePackets.WaitIdle();
+				}
+				packet = g_framePackets.BeginWrite();
+			}
+			FrameSample& frameSample = packet->sample;
+			frameSample = FrameSample();
+			frameSample.frame = frameCount;
+			packet->frame = frameCount++;
+
+			double phaseStart = GetMilliseconds();
+			frameSample.ms[FramePhasePacketWait] = static_cast<float>(phaseStart - frameStart);
+			auto endPhase = [&](FramePhase phase) {
+				double now = GetMilliseconds();
+				frameSample.ms[phase] += static_cast<float>(now - phaseStart);
+				phaseStart = now;
+			};
+
+			// wait until the swap chain can take another frame, then pick up the
+			// input that arrived meanwhile so the frame starts from the latest
+			// state. with the render thread it waits there instead, this thread
+			// is already held back by the packets
+			packet->paced = serial;
+			if (serial)
+			{
+				PROFILE_ZONE("wait for swap chain");
+				g_framePacer.WaitForNextFrame();
+			}
+			endPhase(FramePhasePresentWait);
+			while (msg.message != WM_QUIT && PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+			{
+				TranslateMessage(&msg);
+				DispatchMessage(&msg);
+			}
+			if (msg.message == WM_QUIT) {
+				break;
+			}
+			packet->inputMs = GetMilliseconds();
 
-			// cap delta time to avoid large jumps
+			// cap delta time to avoid large jumps, a benchmark steps the same
+			// amount every frame whatever the frame took
 			if (deltaTime > 0.1f) deltaTime = 0.1f;
-			UpdateCamera(deltaTime);
+			if (g_benchmark.enabled) deltaTime = g_benchmark.timestep;
+			if (g_cameraPathPlaying) {
+				UpdateCameraPath(deltaTime);
+			}
+			else {
+				UpdateCamera(deltaTime);
+			}
+			g_cameraRecorder.Update(deltaTime, g_cameraPosition, g_cameraTarget);
 
+			{
+				std::lock_guard<std::mutex> lock(g_renderStatsMutex);
+				renderStats = g_renderStats;
+			}
 
 			ImGuiIO& io = ImGui::GetIO();
 			io.DisplaySize = ImVec2((float)WindowWidth, (float)WindowHeight);
@@ -239,22 +549,190 @@ int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _
 				g_cameraTarget = { 0.0f, 0.0f, 0.0f };
 				g_cameraInput = {}; // Reset all input flags
 			}
+
+			// keys at fixed steps whatever the frame rate, saved when stopped
+			static std::string pathStatus;
+			if (ImGui::Button(g_cameraRecorder.IsRecording() ? "Stop Recording" : "Record Path"))
+			{
+				if (g_cameraRecorder.IsRecording())
+				{
+					g_cameraPath = g_cameraRecorder.Stop();
+					g_cameraPath.SetBounds(g_sceneBoundsMin, g_sceneBoundsMax);
+					std::string filename = "camera_path_" + GetTimestamp() + ".campath";
+					std::string error;
+					pathStatus = g_cameraPath.Save(filename, error) ? "wrote " + filename : error;
+				}
+				else
+				{
+					g_cameraPathPlaying = false;
+					g_cameraRecorder.Start(CameraPathInterval);
+				}
+			}
+			ImGui::SameLine();
+			if (ImGui::Checkbox("Play Path", &g_cameraPathPlaying)) {
+				g_cameraPathTime = 0.0f;
+			}
+			if (g_cameraPathPlaying && g_cameraPath.IsEmpty()) {
+				g_cameraPathPlaying = false;
+				pathStatus = "no path recorded";
+			}
+			if (g_cameraRecorder.IsRecording()) {
+				ImGui::Text("Recording %.1f s", g_cameraRecorder.GetTime());
+			}
+			else if (g_cameraPathPlaying) {
+				ImGui::Text("Playing %.1f / %.1f s", g_cameraPathTime, g_cameraPath.GetDuration());
+			}
+			else if (!pathStatus.empty()) {
+				ImGui::TextUnformatted(pathStatus.c_str());
+			}
+			ImGui::End();
+
+			const FramePacingStats& pacing = renderStats.pacing;
+			ImGui::Begin("Frame Pacing");
+			// the mode that isn't running keeps its last averages
+			ImGui::Checkbox("Render thread (off is serial)", &g_renderThreadEnabled);
+			ImGui::Text("Frame %.2f ms serial, %.2f ms render thread",
+				renderStats.frameMs[0], renderStats.frameMs[1]);
+			ImGui::Text("Input to present %.2f ms serial, %.2f ms render thread",
+				renderStats.inputToPresentMs[0], renderStats.inputToPresentMs[1]);
+			ImGui::SliderInt("Frames in flight", &g_settings.framesInFlight, 1, MaxFramesInFlight);
+			ImGui::Text("CPU frame %.2f ms, waiting on gpu %.2f ms, in Present %.2f ms",
+				pacing.frameMs, pacing.fenceWaitMs, pacing.presentMs);
+			ImGui::Text("CPU/GPU overlap %.0f%%, %llu frames queued",
+				pacing.frameMs > 0.0 ? 100.0 * (1.0 - pacing.fenceWaitMs / pacing.frameMs) : 0.0,
+				pacing.framesQueued);
+			ImGui::Checkbox(g_tearingSupported ? "VSync (off tears)" : "VSync (off is uncapped, no tearing)", &g_settings.vsync);
+			ImGui::SliderInt("Back buffers", &g_settings.backBufferCount, 2, MaxBackBuffers);
+			ImGui::SliderInt("Max frame latency", &g_settings.maxFrameLatency, 1, 3);
+			const FramePacerStats& pacerStats = renderStats.pacer;
+			ImGui::Text("Swap chain wait %.2f ms, input to present %.2f ms", pacerStats.waitMs, pacerStats.inputToPresentMs);
+			if (pacerStats.displayedFrames > 0) {
+				ImGui::Text("Input to display %.2f ms", pacerStats.inputToDisplayMs);
+			}
+			else {
+				ImGui::Text("Input to display: no frame statistics yet");
+			}
+			ImGui::Checkbox("Record draws into bundles", &g_settings.useBundles);
+			if (g_settings.useBundles)
+			{
+				const BundleCacheStats& bundleStats = renderStats.bundles;
+				ImGui::Text("%u draws in %u bundles, %u recorded this frame (%llu total)", bundleStats.draws,
+					bundleStats.bundles, bundleStats.recorded, bundleStats.totalRecorded);
+				ImGui::Text("Draw recording %.3f ms vs %.3f ms direct, %.3f ms saved", bundleStats.frameMs,
+					bundleStats.directMs, bundleStats.directMs - bundleStats.frameMs);
+			}
+			// a mesh entering or leaving the view shifts the draw list, the bundles
+			// from that draw on are recorded again
+			ImGui::Checkbox("Frustum culling", &g_frustumCulling);
+			ImGui::Text("%u of %zu meshes visible, culled in %.3f ms (%s)", g_visibleMeshes, g_meshes.size(), g_cullMs,
+				FrustumCuller::GetPathName(g_meshCuller.path));
+			ImGui::Checkbox("Parallel draw recording", &g_settings.parallelDraws);
+			ImGui::SliderInt("Min draws per chunk", &g_settings.minDrawsPerChunk, 8, 512);
+			const DrawRecorderStats& drawStats = renderStats.draws;
+			ImGui::Text("%u draws in %u of %u chunks, recorded in %.3f ms", drawStats.draws, drawStats.chunks,
+				renderStats.maxDrawChunks, drawStats.recordMs);
+			JobSystemStats jobStats = g_jobSystem.GetStats();
+			ImGui::Text("Jobs: %u workers, %llu run, %llu stolen", g_jobSystem.GetWorkerCount(), jobStats.jobs, jobStats.steals);
 			ImGui::End();
 
+			const TextureResidencyStats& streamingStats = renderStats.residency;
+			ImGui::Begin("Texture Streaming");
+			ImGui::SliderInt("Budget (MB)", &g_settings.textureBudgetMB, 16, 2048);
+			ImGui::Text("Resident: %.1f MB (peak %.1f MB)",
+				streamingStats.residentBytes / (1024.0 * 1024.0), streamingStats.peakResidentBytes / (1024.0 * 1024.0));
+			ImGui::Text("Mip tails: %.1f MB", streamingStats.tailBytes / (1024.0 * 1024.0));
+			ImGui::Text("Loads/evictions this frame: %u / %u",
+				streamingStats.mipLoadsThisFrame, streamingStats.mipEvictionsThisFrame);
+			ImGui::Text("Pending textures: %u", streamingStats.pendingRequests);
+			const TexturePackStats& packStats = renderStats.packs;
+			ImGui::Text("Texture arrays: %u for %u textures (%u atlased)",
+				packStats.arrayCount, packStats.textureCount, packStats.atlasedTextures);
+			ImGui::Text("Bind groups: %u unpacked, %u packed", g_bindGroupsUnpacked, g_bindGroupsPacked);
+			const UploadServiceStats& uploadStats = renderStats.uploads;
+			const RingAllocatorStats& ringStats = renderStats.staging;
+			ImGui::Text("Upload batches: %llu (%u in flight), stalls %llu slot / %llu staging",
+				uploadStats.batches, uploadStats.batchesInFlight, uploadStats.batchSlotStalls, uploadStats.stagingStalls);
+			ImGui::Text("Upload staging: %.1f / %.1f MB (peak %.1f MB), %llu oversized, %llu failed",
+				ringStats.usedBytes / (1024.0 * 1024.0), ringStats.capacity / (1024.0 * 1024.0),
+				ringStats.peakUsedBytes / (1024.0 * 1024.0), renderStats.dedicatedStaging, uploadStats.stagingFailures);
+			const StreamingQueueStats& streamStats = renderStats.streaming;
+			ImGui::Text("Streaming: %u queued, %u reading, %u uploading, %llu failed (%s)",
+				streamStats.queued, streamStats.reading, streamStats.uploading, streamStats.failedRequests,
+				renderStats.asyncStreaming ? "overlapped" : "blocking reads");
+			ImGui::Text("Streamed: %.1f MB read, %.1f MB decompressed, %llu staging stalls",
+				streamStats.bytesRead / (1024.0 * 1024.0), streamStats.bytesDecompressed / (1024.0 * 1024.0), streamStats.stagingStalls);
+			const DeferredReleaseStats& releaseStats = renderStats.releases;
+			ImGui::Text("Deferred releases: %u pending (peak %u), %llu released",
+				releaseStats.pending, releaseStats.peakPending, releaseStats.released);
+			const GeometryPoolStats& geometryStats = renderStats.geometry;
+			ImGui::Text("Geometry pool: %u meshes, %u / %u vertices, %u / %u indices",
+				geometryStats.meshes, geometryStats.verticesUsed, geometryStats.vertexCapacity,
+				geometryStats.indicesUsed, geometryStats.indexCapacity);
+			ImGui::Text("Geometry grows: %u, compactions: %u, %.0f%% fragmented",
+				geometryStats.grows, geometryStats.compactions, geometryStats.fragmentation * 100.0f);
+			const GpuHeapStats& heapStats = renderStats.heaps;
+			ImGui::Text("GPU heaps: %u, %.1f / %.1f MB used, %.0f%% fragmented",
+				heapStats.heaps, heapStats.usedBytes / (1024.0 * 1024.0), heapStats.heapBytes / (1024.0 * 1024.0),
+				heapStats.fragmentation * 100.0f);
+			ImGui::Text("Placed: %u, shared buffers: %u in %u pages, committed: %u (%.1f MB)",
+				heapStats.placedResources, heapStats.sharedBuffers, heapStats.sharedPages,
+				heapStats.committedResources, heapStats.committedBytes / (1024.0 * 1024.0));
+			ImGui::End();
 
-			PopulateCommandList();
-			ID3D12CommandList* commandLists[] = { g_commandList.Get() };
-			g_commandQueue->ExecuteCommandLists(_countof(commandLists), commandLists);
-			g_swapChain->Present(1, 0);
-			WaitForPreviousFrame();
+			ShowFrameTelemetry();
+			ShowGpuProfiler(renderStats);
+
+			// imgui's texture updates go through its own queue and stay on this
+			// thread, the packet gets a copy of the draw data that only has ids
+			ImGui::Render();
+			ImDrawData* drawData = ImGui::GetDrawData();
+			if (drawData->Textures)
+			{
+				for (ImTextureData* texture : *drawData->Textures) {
+					if (texture->Status != ImTextureStatus_OK) {
+						ImGui_ImplDX12_UpdateTexture(texture);
+					}
+				}
+			}
+			packet->ui.Capture(drawData);
+			BuildFramePacket(*packet);
+			endPhase(FramePhaseUpdate);
+
+			g_framePackets.EndWrite(packet);
+			if (serial)
+			{
+				PROFILE_ZONE("wait for render thread");
+				g_framePackets.WaitIdle();
+			}
+			if (g_benchmark.enabled && frameCount >= static_cast<uint64_t>(g_benchmark.frames)) {
+				PostQuitMessage(0);
+			}
 		}
 	}
 
+	// the render thread finishes the packets already written
+	g_framePackets.Close();
+	g_renderThread.join();
+	int result = g_benchmark.enabled ? FinishBenchmark() : 0;
+
+	// idle both queues before the release queue lets go of everything
+	g_streamingQueue.Shutdown();
+	g_uploadService.Wait(g_uploadService.Flush());
+	WaitForGpu();
+	g_releaseQueue.Flush();
+
+	g_framePacer.Shutdown();
+	g_gpuProfiler.Shutdown();
+	g_drawRecorder.Shutdown();
+	g_drawBackend.Shutdown();
+	g_bundleCache.Shutdown();
+	g_jobSystem.Shutdown();
 	CloseHandle(g_fenceEvent);
+	g_uploadBackend.Shutdown();
 	ImGui_ImplDX12_Shutdown();
 	ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
-	return 0;
+	return result;
 }
 
 // handles messages from the OS
@@ -311,11 +789,13 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 
 void CreatePipelineStateObject()
 {
+	PROFILE_FUNCTION();
 	HRESULT hr;
 
 	// compile shaders
 	ComPtr<ID3DBlob> vertexShader;
 	ComPtr<ID3DBlob> pixelShader;
+	ComPtr<ID3DBlob> maskedPixelShader;
 	ComPtr<ID3DBlob> errorBuffer;
 
 	if (!std::filesystem::exists(L"VertexShader.hlsl")) {
@@ -363,11 +843,31 @@ void CreatePipelineStateObject()
 		exit(1);
 	}
 
+	// same shader with the alpha test compiled in. the opaque pso stays without
+	// clip() so the hardware can keep rejecting hidden pixels before shading
+	D3D_SHADER_MACRO alphaTestDefines[] = { { "ALPHA_TEST", "1" }, { nullptr, nullptr } };
+	hr = D3DCompileFromFile(
+		L"PixelShader.hlsl",
+		alphaTestDefines,
+		D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		"main",
+		"ps_5_0",
+		D3DCOMPILE_ENABLE_STRICTNESS,
+		0,
+		&maskedPixelShader,
+		&errorBuffer
+	);
+	if (FAILED(hr))
+	{
+		MessageBoxA(0, (char*)errorBuffer->GetBufferPointer(), "Pixel Shader Compile Error", MB_OK);
+		exit(1);
+	}
+
 	// create a root signature
 	// updating root parameter for imgui
 	// parameter0 cbv
 
-	D3D12_ROOT_PARAMETER rootParameters[3] = {};
+	D3D12_ROOT_PARAMETER rootParameters[4] = {};
 	rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV; // constant buffer view
 	rootParameters[0].Descriptor.ShaderRegister = 0; // b0
 	rootParameters[0].Descriptor.RegisterSpace = 0;
@@ -387,6 +887,13 @@ void CreatePipelineStateObject()
 	rootParameters[2].DescriptorTable.pDescriptorRanges = &descriptorRange;
 	rootParameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL; // textures are usally used in pixel shaders
 
+	// parameter3 material constants, where the texture sits in its array
+	rootParameters[3].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+	rootParameters[3].Constants.ShaderRegister = 3; // b3
+	rootParameters[3].Constants.RegisterSpace = 0;
+	rootParameters[3].Constants.Num32BitValues = sizeof(MaterialConstants) / 4;
+	rootParameters[3].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
 	D3D12_STATIC_SAMPLER_DESC samplerDesc = {};
 	samplerDesc.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
 	samplerDesc.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
@@ -402,7 +909,7 @@ void CreatePipelineStateObject()
 	samplerDesc.RegisterSpace = 0;
 	samplerDesc.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
 
-	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(3, rootParameters, 1, &samplerDesc, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+	CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc(_countof(rootParameters), rootParameters, 1, &samplerDesc, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 	ComPtr<ID3DBlob> signature;
 	D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, nullptr);
 	g_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&g_rootSignature));
@@ -458,18 +965,26 @@ void CreatePipelineStateObject()
 		MessageBox(nullptr, L"Failed to create Pipeline State Object!", L"Error", MB_OK);
 		exit(1);
 	}
+
+	psoDesc.PS = { maskedPixelShader->GetBufferPointer(), maskedPixelShader->GetBufferSize() };
+	hr = g_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&g_maskedPipelineState));
+	if (FAILED(hr))
+	{
+		MessageBox(nullptr, L"Failed to create masked Pipeline State Object!", L"Error", MB_OK);
+		exit(1);
+	}
 }
 
 void CreateAssets()
 {
-	g_commandList->Reset(g_commandAllocator.Get(), nullptr);
+	g_commandList->Reset(g_frameContexts[g_frameContext].commandAllocator.Get(), nullptr);
 	CreateConstantBuffers();
 	g_commandList->Close();
 
 	ID3D12CommandList* ppCommandLists[] = { g_commandList.Get() };
 	g_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
 
-	WaitForPreviousFrame();
+	WaitForGpu();
 }
 
 void CreateConstantBuffers()
@@ -480,7 +995,6 @@ void CreateConstantBuffers()
 	DirectX::XMStoreFloat4x4(&initMatrix.view, XMMatrixIdentity());
 	DirectX::XMStoreFloat4x4(&initMatrix.projection, XMMatrixIdentity());
 
-	CreateConstantBuffer(g_matrixConstantBuffer, g_pMatrixConstantBufferStart, initMatrix);
 	g_matrixBufferData = initMatrix;
 
 	// initialize light buffer
@@ -493,55 +1007,15 @@ void CreateConstantBuffers()
 	initLight.specularIntensity = 1.0f;
 	initLight.cameraPosition = XMFLOAT3(0.0f, 0.0f, -5.0f);
 
-	CreateConstantBuffer(g_lightConstantBuffer, g_pLightConstantBufferStart, initLight);
 	g_lightBufferData = initLight;
-}
-
-void CreateBuffer(const void* data, UINT size, ComPtr<ID3D12Resource>& resource,
-	D3D12_RESOURCE_STATES initialState) 
-{
-	auto defaultHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-	auto uploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-
-	// create default heap resource
-	auto resDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
-	g_device->CreateCommittedResource(
-		&defaultHeapProps,
-		D3D12_HEAP_FLAG_NONE,
-		&resDesc,
-		initialState,
-		nullptr,
-		IID_PPV_ARGS(&resource)
-	);
-
-	// create upload heap for vertex data
-	ComPtr<ID3D12Resource> uploadResource;
-	g_device->CreateCommittedResource(
-		&uploadHeapProps,
-		D3D12_HEAP_FLAG_NONE,
-		&resDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(&uploadResource)
-	);
-
-	g_uploadResources.push_back(uploadResource);
 
-	// map and copy data
-	void* mappedData;
-	uploadResource->Map(0, nullptr, &mappedData);
-	memcpy(mappedData, data, size);
-	uploadResource->Unmap(0, nullptr);
-
-	// schedule buffer copy
-	g_commandList->CopyResource(resource.Get(), uploadResource.Get());
-}
-
-template<typename T>
-void CreateConstantBuffer(ComPtr<ID3D12Resource>& buffer, UINT8*& mappedData, const T& initialData)
-{
+	// one upload buffer split into a matrix and a light region per frame context
+	const UINT64 matrixSize = (sizeof(MatrixBuffer) + D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1) &
+		~UINT64(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1);
+	const UINT64 lightSize = (sizeof(LightBuffer) + D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1) &
+		~UINT64(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1);
 	auto uploadHeapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-	auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(sizeof(T));
+	auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer((matrixSize + lightSize) * MaxFramesInFlight);
 
 	g_device->CreateCommittedResource(
 		&uploadHeapProps,
@@ -549,61 +1023,208 @@ void CreateConstantBuffer(ComPtr<ID3D12Resource>& buffer, UINT8*& mappedData, co
 		&bufferDesc,
 		D3D12_RESOURCE_STATE_GENERIC_READ,
 		nullptr,
-		IID_PPV_ARGS(&buffer)
+		IID_PPV_ARGS(&g_constantBuffer)
 	);
 
-	buffer->Map(0, nullptr, reinterpret_cast<void**>(&mappedData));
-	memcpy(mappedData, &initialData, sizeof(T));
+	UINT8* mappedData = nullptr;
+	g_constantBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mappedData));
+	D3D12_GPU_VIRTUAL_ADDRESS address = g_constantBuffer->GetGPUVirtualAddress();
+	for (UINT i = 0; i < MaxFramesInFlight; i++)
+	{
+		FrameContext& frame = g_frameContexts[i];
+		UINT64 offset = (matrixSize + lightSize) * i;
+		frame.matrixConstants = mappedData + offset;
+		frame.lightConstants = mappedData + offset + matrixSize;
+		frame.matrixConstantsAddress = address + offset;
+		frame.lightConstantsAddress = address + offset + matrixSize;
+		memcpy(frame.matrixConstants, &initMatrix, sizeof(MatrixBuffer));
+		memcpy(frame.lightConstants, &initLight, sizeof(LightBuffer));
+	}
 }
 
-bool LoadOBJModel(const std::string& filename) 
+bool LoadOBJModel(const std::string& name) 
 {
+	PROFILE_FUNCTION();
 	std::vector<Mesh> loadedMeshes;
+	std::vector<Material> loadedMaterials;
 	std::string error;
 
-	if (!OBJLoader::LoadOBJ(filename, loadedMeshes, error)) {
-		MessageBoxA(nullptr, error.c_str(), "OBJ Load Error", MB_OK);
-		return false;
+	// the mtl is expected next to the obj under the same name
+	std::string mtlName = std::filesystem::path(name).replace_extension(".mtl").generic_string();
+	std::string cacheFile = std::filesystem::path(g_assetFiles.GetLoosePath(name)).replace_extension(".dxmesh").string();
+
+	// the cooked mesh cache is used while it's newer than the obj and mtl it came from
+	std::error_code ec;
+	auto cacheTime = std::filesystem::last_write_time(cacheFile, ec);
+	bool cached = !ec && cacheTime >= g_assetFiles.GetWriteTime(name, ec) && !ec;
+	if (cached) {
+		std::error_code mtlError;
+		auto mtlTime = g_assetFiles.GetWriteTime(mtlName, mtlError);
+		cached = mtlError || cacheTime >= mtlTime;
 	}
+	if (!cached || !MeshCache::Read(cacheFile, loadedMeshes, loadedMaterials, error))
+	{
+		std::vector<uint8_t> objFile;
+		std::vector<uint8_t> mtlFile;
+		bool loaded = g_assetFiles.Read(name, objFile, error);
+		if (loaded && !g_assetFiles.Read(mtlName, mtlFile, error)) {
+			OutputDebugStringA(("WARNING: " + error + ", drawing without materials\n").c_str());
+		}
+		loaded = loaded && OBJLoader::LoadOBJFromMemory(std::string(objFile.begin(), objFile.end()),
+			std::string(mtlFile.begin(), mtlFile.end()), loadedMeshes, loadedMaterials, error);
+		if (!loaded) {
+			MessageBoxA(nullptr, error.c_str(), "OBJ Load Error", MB_OK);
+			return false;
+		}
 
-	g_commandAllocator->Reset();
-	g_commandList->Reset(g_commandAllocator.Get(), nullptr);
+		// the next run loads the cache, it's fine to go on without one
+		if (!MeshCache::Write(loadedMeshes, loadedMaterials, cacheFile, error)) {
+			OutputDebugStringA(("WARNING: " + error + "\n").c_str());
+		}
+	}
 
-	for (const auto& mesh : loadedMeshes) {
-		RenderMesh renderMesh;
+	// mtl paths point at textures/, the files live flat in the sponza texture folder
+	auto textureSource = [](const Material& material) {
+		TextureSource source;
+		source.filename = g_textureDirectory + std::filesystem::path(material.diffuseTexture).filename().string();
+		if (!material.alphaTexture.empty()) {
+			source.alphaMask = g_textureDirectory + std::filesystem::path(material.alphaTexture).filename().string();
+		}
+		return source;
+	};
 
-		// create vertex buffer
-		CreateBuffer(mesh.vertices.data(),
-			mesh.vertices.size() * sizeof(Vertex),
-			renderMesh.vertexBuffer,
-			D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+	// cooking is the slow part of a first load, do it for every texture at
+	// once before the materials register them one by one
+	std::vector<TextureSource> textureSources;
+	for (const auto& material : loadedMaterials) {
+		if (!material.diffuseTexture.empty()) {
+			textureSources.push_back(textureSource(material));
+		}
+	}
+	g_textureStreamer.CookTextures(textureSources, g_jobSystem);
+
+	for (const auto& material : loadedMaterials) {
+		RenderMaterial renderMaterial;
+		renderMaterial.diffuseTexture = g_textureStreamer.GetDefaultTexture();
+		renderMaterial.alphaMasked = false;
+		if (!material.diffuseTexture.empty()) {
+			TextureSource source = textureSource(material);
+			renderMaterial.diffuseTexture = g_textureStreamer.AddTexture(source.filename, source.alphaMask);
+			renderMaterial.alphaMasked = g_textureStreamer.HasAlphaMask(renderMaterial.diffuseTexture);
+		}
+		// neither the mask nor the texture's alpha could be used
+		if (!material.alphaTexture.empty() && !renderMaterial.alphaMasked) {
+			OutputDebugStringA(("WARNING: material " + material.name + " has an alpha mask but is drawn opaque\n").c_str());
+		}
+		g_materials.push_back(renderMaterial);
+	}
 
-		// create index buffer
-		CreateBuffer(mesh.indices.data(),
-			mesh.indices.size() * sizeof(uint32_t),
-			renderMesh.indexBuffer,
-			D3D12_RESOURCE_STATE_INDEX_BUFFER);
+	// fallback for meshes without a material
+	RenderMaterial defaultMaterial;
+	defaultMaterial.diffuseTexture = g_textureStreamer.GetDefaultTexture();
+	defaultMaterial.alphaMasked = false;
+	g_materials.push_back(defaultMaterial);
+
+	g_textureStreamer.PackTextures();
+	for (auto& material : g_materials) {
+		const TexturePlacement& placement = g_textureStreamer.GetPlacement(material.diffuseTexture);
+		material.constants.uvScale = XMFLOAT2(placement.uvScale[0], placement.uvScale[1]);
+		material.constants.uvOffset = XMFLOAT2(placement.uvOffset[0], placement.uvOffset[1]);
+		material.constants.slice = static_cast<float>(placement.slice);
+	}
+
+	// sized for the whole model up front so loading doesn't grow the pool
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+	for (const auto& mesh : loadedMeshes) {
+		vertexCount += mesh.vertices.size();
+		indexCount += mesh.indices.size();
+	}
+	if (!g_geometryPool.Initialize(&g_gpuHeaps, &g_uploadService, sizeof(Vertex),
+		static_cast<uint32_t>(vertexCount), static_cast<uint32_t>(indexCount))) {
+		MessageBox(nullptr, L"Failed to create geometry buffers!", L"Error", MB_OK);
+		return false;
+	}
 
-		// create views
-		renderMesh.vertexBufferView.BufferLocation = renderMesh.vertexBuffer->GetGPUVirtualAddress();
-		renderMesh.vertexBufferView.StrideInBytes = sizeof(Vertex);
-		renderMesh.vertexBufferView.SizeInBytes = mesh.vertices.size() * sizeof(Vertex);
+	for (const auto& mesh : loadedMeshes) {
+		RenderMesh renderMesh;
 
-		renderMesh.indexBufferView.BufferLocation = renderMesh.indexBuffer->GetGPUVirtualAddress();
-		renderMesh.indexBufferView.Format = DXGI_FORMAT_R32_UINT;
-		renderMesh.indexBufferView.SizeInBytes = mesh.indices.size() * sizeof(uint32_t);
+		// the pool copies into its buffers on the upload queue
+		renderMesh.geometry = g_geometryPool.AddMesh(mesh.vertices.data(), static_cast<uint32_t>(mesh.vertices.size()),
+			mesh.indices.data(), static_cast<uint32_t>(mesh.indices.size()));
+		if (renderMesh.geometry == ~0u) {
+			MessageBox(nullptr, L"Failed to allocate mesh geometry!", L"Error", MB_OK);
+			return false;
+		}
 
-		renderMesh.indexCount = static_cast<UINT>(mesh.indices.size());
+		renderMesh.materialIndex = mesh.materialIndex >= 0 ? mesh.materialIndex : static_cast<UINT>(g_materials.size() - 1);
+		renderMesh.boundsMin = mesh.boundsMin;
+		renderMesh.boundsMax = mesh.boundsMax;
+		renderMesh.worldUnitsPerUV = mesh.worldUnitsPerUV;
 
 		g_meshes.push_back(renderMesh);
 	}
 
-	g_commandList->Close();
-	ID3D12CommandList* ppCommandLists[] = { g_commandList.Get() };
-	g_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+	// opaque first so each pso is set once per frame, then by texture array so
+	// draws sharing an array share its descriptor table, then by texture
+	auto arrayOf = [](const RenderMesh& mesh) {
+		return g_textureStreamer.GetPlacement(g_materials[mesh.materialIndex].diffuseTexture).array;
+	};
+	std::stable_sort(g_meshes.begin(), g_meshes.end(), [&](const RenderMesh& a, const RenderMesh& b) {
+		bool aMasked = g_materials[a.materialIndex].alphaMasked;
+		bool bMasked = g_materials[b.materialIndex].alphaMasked;
+		if (aMasked != bMasked) {
+			return !aMasked;
+		}
+		if (arrayOf(a) != arrayOf(b)) {
+			return arrayOf(a) < arrayOf(b);
+		}
+		return g_materials[a.materialIndex].diffuseTexture < g_materials[b.materialIndex].diffuseTexture;
+	});
+	auto firstMasked = std::find_if(g_meshes.begin(), g_meshes.end(),
+		[](const RenderMesh& mesh) { return g_materials[mesh.materialIndex].alphaMasked; });
+	g_firstMaskedMesh = static_cast<size_t>(firstMasked - g_meshes.begin());
+
+	// world space is object space, the world matrix is identity
+	g_meshCuller.Clear();
+	g_meshCuller.Reserve(static_cast<uint32_t>(g_meshes.size()));
+	for (const auto& mesh : g_meshes) {
+		g_meshCuller.Add(mesh.boundsMin, mesh.boundsMax);
+	}
+	for (size_t i = 0; i < g_meshes.size(); i++)
+	{
+		XMVECTOR boundsMin = XMLoadFloat3(&g_meshes[i].boundsMin);
+		XMVECTOR boundsMax = XMLoadFloat3(&g_meshes[i].boundsMax);
+		XMStoreFloat3(&g_sceneBoundsMin, i > 0 ? XMVectorMin(XMLoadFloat3(&g_sceneBoundsMin), boundsMin) : boundsMin);
+		XMStoreFloat3(&g_sceneBoundsMax, i > 0 ? XMVectorMax(XMLoadFloat3(&g_sceneBoundsMax), boundsMax) : boundsMax);
+	}
 
-	WaitForPreviousFrame();
-	CleanupUploadResources();
+	// unpacked, every texture change is a table switch, packed only array changes are
+	uint32_t lastTexture = UINT32_MAX;
+	uint32_t lastArray = UINT32_MAX;
+	for (const auto& mesh : g_meshes)
+	{
+		uint32_t texture = g_materials[mesh.materialIndex].diffuseTexture;
+		if (texture != lastTexture) {
+			g_bindGroupsUnpacked++;
+			lastTexture = texture;
+		}
+		if (arrayOf(mesh) != lastArray) {
+			g_bindGroupsPacked++;
+			lastArray = arrayOf(mesh);
+		}
+	}
+
+	char packMessage[128];
+	sprintf_s(packMessage, "texture bind groups per frame: %u unpacked, %u packed\n", g_bindGroupsUnpacked, g_bindGroupsPacked);
+	OutputDebugStringA(packMessage);
+
+	// uploads the mip tails of every texture
+	g_textureStreamer.Update();
+
+	// the first frame waits for the copies on the gpu, nothing here has to
+	UploadToken uploads = g_uploadService.Flush();
+	g_uploadBackend.QueueWait(g_commandQueue.Get(), uploads);
 
 	return true;
 }
@@ -611,6 +1232,7 @@ bool LoadOBJModel(const std::string& filename)
 // setup directx objects
 void InitD3D()
 {
+	PROFILE_FUNCTION();
 	UINT dxgiFactoryFlags = 0;
 
 #ifdef _DEBUG
@@ -639,15 +1261,33 @@ void InitD3D()
 	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
 	g_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&g_commandQueue));
 
+	// a query range per frame context, the app runs without gpu timings if this fails
+	if (!g_gpuProfiler.Initialize(g_device.Get(), g_commandQueue.Get(), MaxFramesInFlight)) {
+		OutputDebugStringA("gpu profiler unavailable, no timestamp queries\n");
+	}
+
+	// tearing lets an uncapped present show up right away instead of at the next vblank
+	ComPtr<IDXGIFactory5> factory5;
+	BOOL allowTearing = FALSE;
+	if (SUCCEEDED(factory.As(&factory5)) &&
+		SUCCEEDED(factory5->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING, &allowTearing, sizeof(allowTearing)))) {
+		g_tearingSupported = allowTearing == TRUE;
+	}
+	g_swapChainFlags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+	if (g_tearingSupported) {
+		g_swapChainFlags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+	}
+
 	// AFTER the queue create the swap chain
 	DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
-	swapChainDesc.BufferCount = 2;
+	swapChainDesc.BufferCount = g_renderSettings.backBufferCount;
 	swapChainDesc.Width = WindowWidth;
 	swapChainDesc.Height = WindowHeight;
 	swapChainDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 	swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
 	swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
 	swapChainDesc.SampleDesc.Count = 1;
+	swapChainDesc.Flags = g_swapChainFlags;
 
 	ComPtr<IDXGISwapChain1> swapChainLocal;
 	factory->CreateSwapChainForHwnd(
@@ -660,10 +1300,19 @@ void InitD3D()
 	);
 
 	swapChainLocal.As(&g_swapChain);
+	g_swapChainBufferCount = g_renderSettings.backBufferCount;
 
-	// create a descriptor heap for RTVs
+	// alt+enter would switch to exclusive fullscreen, where tearing presents fail
+	factory->MakeWindowAssociation(hWnd, DXGI_MWA_NO_ALT_ENTER);
+
+	if (!g_framePacer.Initialize(g_swapChain.Get(), g_renderSettings.maxFrameLatency)) {
+		MessageBox(nullptr, L"Failed to get the swap chain's waitable object!", L"Error", MB_OK);
+		exit(1);
+	}
+
+	// create a descriptor heap for RTVs, sized for the most back buffers
 	D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
-	rtvHeapDesc.NumDescriptors = 2;
+	rtvHeapDesc.NumDescriptors = MaxBackBuffers;
 	rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
 	rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 	g_device->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&g_rtvHeap));
@@ -735,24 +1384,34 @@ void InitD3D()
 	}
 	g_textureHandle = g_textureSrvHeap->GetGPUDescriptorHandleForHeapStart();
 
-	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(g_rtvHeap->GetCPUDescriptorHandleForHeapStart());
-	for (UINT n = 0; n < 2; n++)
-	{
-		g_swapChain->GetBuffer(n, IID_PPV_ARGS(&g_renderTargets[n]));
-		g_device->CreateRenderTargetView(g_renderTargets[n].Get(), nullptr, rtvHandle);
-		rtvHandle.Offset(1, g_rtvDescriptorSize);
+	CreateBackBuffers();
+
+	// create a command allocator per frame context and one command list
+	for (UINT i = 0; i < MaxFramesInFlight; i++) {
+		g_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&g_frameContexts[i].commandAllocator));
 	}
+	g_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, g_frameContexts[0].commandAllocator.Get(), nullptr, IID_PPV_ARGS(&g_commandList));
 
-	// create command allocator and command list
-	g_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&g_commandAllocator));
-	g_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, g_commandAllocator.Get(), nullptr, IID_PPV_ARGS(&g_commandList));
+	g_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, g_frameContexts[0].commandAllocator.Get(), nullptr, IID_PPV_ARGS(&g_postCommandList));
 
-	// command lists are created in the recording state, close it for now and reset later
+	// command lists are created in the recording state, close them for now and reset later
 	g_commandList->Close();
+	g_postCommandList->Close();
+
+	// a chunk per job worker, the render thread records one in the main thread's place
+	if (!g_drawBackend.Initialize(g_device.Get(), MaxFramesInFlight, g_jobSystem.GetWorkerCount())) {
+		MessageBox(nullptr, L"Failed to create draw command lists!", L"Error", MB_OK);
+		exit(1);
+	}
+	g_drawRecorder.Initialize(&g_drawBackend, &g_jobSystem);
+	g_bundleCache.Initialize(g_device.Get(), &g_releaseQueue);
+	g_drawRecorder.minDrawsPerChunk = static_cast<uint32_t>(g_renderSettings.minDrawsPerChunk);
+	g_drawRecorder.parallel = g_renderSettings.parallelDraws;
 
 	// create synchronization objects
 	g_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&g_fence));
 	g_fenceValue = 1;
+	g_releaseQueue.SetPendingFenceValue(g_fenceValue);
 	g_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr); // create a window event object
 
 	if (g_fenceEvent == nullptr)
@@ -760,14 +1419,39 @@ void InitD3D()
 		// failed to create event
 	}
 
+	if (!g_uploadBackend.Initialize(g_device.Get(), g_uploadBatchesInFlight, g_uploadStagingSize)) {
+		MessageBox(nullptr, L"Failed to create upload copy queue!", L"Error", MB_OK);
+		exit(1);
+	}
+	g_uploadService.Initialize(&g_uploadBackend, g_uploadBatchesInFlight);
+	g_gpuHeaps.Initialize(g_device.Get(), &g_releaseQueue);
+	std::string streamingError;
+	if (!g_streamingQueue.Initialize(&g_uploadService, streamingError)) {
+		MessageBoxA(nullptr, streamingError.c_str(), "Error", MB_OK);
+		exit(1);
+	}
+
 	CreatePipelineStateObject();
 	CreateAssets();
 
-	std::string absolutePath = "C:\\Users\\akyur\\Documents\\graphics-github\\dx12-sponza-renderer\\dx12-sponza-renderer\\models\\sponza.obj";
+	g_assetFiles.SetRoot(g_assetRoot);
+	std::string packageError;
+	if (std::filesystem::exists(g_assetRoot + "sponza.pak") && !g_assetFiles.Mount(g_assetRoot + "sponza.pak", packageError)) {
+		OutputDebugStringA(("WARNING: " + packageError + ", using loose files\n").c_str());
+	}
 
-	if (!LoadOBJModel(absolutePath)) {
+	if (!g_textureStreamer.Initialize(g_device.Get(), &g_assetFiles, &g_uploadService, &g_gpuHeaps, &g_releaseQueue, 256, UINT64(g_renderSettings.textureBudgetMB) * 1024 * 1024)) {
+		MessageBox(nullptr, L"Failed to create texture streamer descriptor heap!", L"Error", MB_OK);
+		exit(1);
+	}
+
+	if (!LoadOBJModel("models/sponza.obj")) {
 		MessageBox(nullptr, L"cannot load obj", L"Info", MB_OK);
 	}
+	// a benchmark path placed against other bounds plays in this scene's units
+	if (!g_meshes.empty()) {
+		g_cameraPath.FitToBounds(g_sceneBoundsMin, g_sceneBoundsMax);
+	}
 
 	XMMATRIX world = XMMatrixIdentity();
 	DirectX::XMStoreFloat4x4(&g_worldMatrix, world);
@@ -784,7 +1468,7 @@ void InitD3D()
 	DirectX::XMStoreFloat4x4(&g_viewMatrix, view);
 
 	XMMATRIX projection = XMMatrixPerspectiveFovLH(
-		XM_PIDIV4,
+		g_verticalFov,
 		static_cast<float>(WindowWidth) / static_cast<float>(WindowHeight),
 		0.1f, // near plane
 		2000.0f // far plane
@@ -808,7 +1492,10 @@ void InitD3D()
 	D3D12_CPU_DESCRIPTOR_HANDLE fontCpuHandle = g_ImguiSrvDescHeap->GetCPUDescriptorHandleForHeapStart();
 	D3D12_GPU_DESCRIPTOR_HANDLE fontGpuHandle = g_ImguiSrvDescHeap->GetGPUDescriptorHandleForHeapStart();
 
-	ImGui_ImplDX12_Init(g_device.Get(), 2,
+	// imgui keeps its own vertex buffers per frame, one for every context.
+	// textures it retires may still be drawn by packets the render thread
+	// hasn't got to, so they're kept that many frames longer
+	ImGui_ImplDX12_Init(g_device.Get(), MaxFramesInFlight + FramePacketQueue<FramePacket>::PacketCount,
 		DXGI_FORMAT_R8G8B8A8_UNORM,
 		g_ImguiSrvDescHeap.Get(),
 		fontCpuHandle,
@@ -818,33 +1505,215 @@ void InitD3D()
 	ImGui_ImplDX12_CreateDeviceObjects();
 }
 
-void PopulateCommandList()
+// everything the render thread needs of the main thread's state for a frame
+void BuildFramePacket(FramePacket& packet)
 {
+	PROFILE_FUNCTION();
 	XMMATRIX world = XMMatrixIdentity();
 	XMMATRIX view = XMLoadFloat4x4(&g_viewMatrix);
 	XMMATRIX projection = XMLoadFloat4x4(&g_projectionMatrix);
 
-	DirectX::XMStoreFloat4x4(&g_matrixBufferData.world, XMMatrixTranspose(world)); // hlsl expects column major
-	DirectX::XMStoreFloat4x4(&g_matrixBufferData.view, XMMatrixTranspose(view));
-	DirectX::XMStoreFloat4x4(&g_matrixBufferData.projection, XMMatrixTranspose(projection));
+	DirectX::XMStoreFloat4x4(&packet.matrices.world, XMMatrixTranspose(world)); // hlsl expects column major
+	DirectX::XMStoreFloat4x4(&packet.matrices.view, XMMatrixTranspose(view));
+	DirectX::XMStoreFloat4x4(&packet.matrices.projection, XMMatrixTranspose(projection));
 
-	memcpy(g_pMatrixConstantBufferStart, &g_matrixBufferData, sizeof(MatrixBuffer));
+	packet.light = g_lightBufferData;
+	packet.light.cameraPosition = g_cameraPosition;
+	XMVECTOR lightDir = XMLoadFloat3(&g_lightBufferData.lightDirection);
+	lightDir = XMVector3Normalize(lightDir);
+	DirectX::XMStoreFloat3(&packet.light.lightDirection, lightDir);
+	packet.cameraPosition = g_cameraPosition;
+
+	// the meshes in the frustum, in g_meshes order so opaque still comes first
+	packet.meshes.resize(g_meshes.size());
+	if (g_frustumCulling)
+	{
+		PROFILE_ZONE("frustum culling");
+		double cullStart = GetMilliseconds();
+		XMFLOAT4X4 viewProjection;
+		DirectX::XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(view, projection));
+		packet.meshes.resize(g_meshCuller.Cull(ExtractFrustumPlanes(viewProjection), packet.meshes.data()));
+		g_cullMs = GetMilliseconds() - cullStart;
+	}
+	else
+	{
+		for (size_t i = 0; i < g_meshes.size(); i++) {
+			packet.meshes[i] = static_cast<uint32_t>(i);
+		}
+		g_cullMs = 0.0;
+	}
+	g_visibleMeshes = static_cast<uint32_t>(packet.meshes.size());
+	packet.settings = g_settings;
+}
 
-	XMMATRIX viewMatrix = XMLoadFloat4x4(&g_viewMatrix);
-	XMMATRIX invViewMatrix = XMMatrixInverse(nullptr, viewMatrix);
-	XMFLOAT4X4 invView;
-	DirectX::XMStoreFloat4x4(&invView, invViewMatrix);
+// renders packets until the queue is closed
+void RenderThread()
+{
+	PROFILE_THREAD("render");
+	while (FramePacket* packet = g_framePackets.BeginRead())
+	{
+		RenderFrame(*packet);
+		g_framePackets.EndRead(packet);
+	}
+}
 
-	g_lightBufferData.cameraPosition = g_cameraPosition;
+// records, submits and presents a packet, then records its telemetry
+void RenderFrame(FramePacket& packet)
+{
+	PROFILE_ZONE("render frame");
+	FrameSample& frameSample = packet.sample;
+	double phaseStart = GetMilliseconds();
+	auto endPhase = [&](FramePhase phase) {
+		double now = GetMilliseconds();
+		frameSample.ms[phase] += static_cast<float>(now - phaseStart);
+		phaseStart = now;
+	};
 
-	XMVECTOR lightDir = XMLoadFloat3(&g_lightBufferData.lightDirection);
-	lightDir = XMVector3Normalize(lightDir);
-	DirectX::XMStoreFloat3(&g_lightBufferData.lightDirection, lightDir);
-	memcpy(g_pLightConstantBufferStart, &g_lightBufferData, sizeof(LightBuffer));
+	// a serial frame waited on the main thread before it sampled input
+	if (!packet.paced)
+	{
+		PROFILE_ZONE("wait for swap chain");
+		g_framePacer.WaitForNextFrame();
+	}
+	g_framePacer.SetInputTime(packet.inputMs);
+	endPhase(FramePhasePresentWait);
+
+	ApplyRenderSettings(packet.settings);
+	PopulateCommandList(packet);
+	endPhase(FramePhaseRecord);
+
+	// streamed buffers go out with this frame's upload batch
+	g_streamingQueue.Update();
+
+	// this frame may sample mips the copy queue is still uploading
+	UploadToken uploads = g_uploadService.Flush();
+	g_uploadBackend.QueueWait(g_commandQueue.Get(), uploads);
+
+	g_commandQueue->ExecuteCommandLists(static_cast<UINT>(g_frameCommandLists.size()), g_frameCommandLists.data());
+	endPhase(FramePhaseSubmit);
+	double presentStart = GetMilliseconds();
+	{
+		PROFILE_ZONE("present");
+		if (g_renderSettings.vsync) {
+			g_swapChain->Present(1, 0);
+		}
+		else {
+			g_swapChain->Present(0, g_tearingSupported ? DXGI_PRESENT_ALLOW_TEARING : 0);
+		}
+	}
+	double presentEnd = GetMilliseconds();
+	g_framePacing.presentMs += (presentEnd - presentStart - g_framePacing.presentMs) * 0.05;
+	frameSample.ms[FramePhaseInputToPresent] = static_cast<float>(presentEnd - packet.inputMs);
+	g_framePacer.OnPresent();
+	MoveToNextFrame();
+	endPhase(FramePhasePresentWait);
+
+	// frees whatever the gpu is done with, never waits for it
+	g_releaseQueue.Process(g_fence->GetCompletedValue());
+
+	// a frame lasts from one rendered frame's end to the next
+	double frameEnd = GetMilliseconds();
+	static double lastFrameEnd = frameEnd;
+	if (packet.frame > 0) {
+		frameSample.ms[FramePhaseFrame] = static_cast<float>(frameEnd - lastFrameEnd);
+		g_frameTelemetry.Record(frameSample);
+	}
+	lastFrameEnd = frameEnd;
+	PublishRenderStats(packet);
+}
+
+// applies what the ui changed since the last packet, between frames. a
+// buffer count the swap chain refused isn't retried until the ui picks another
+void ApplyRenderSettings(RenderSettings settings)
+{
+	static int refusedBackBufferCount = 0;
+	if (settings.backBufferCount != g_renderSettings.backBufferCount && settings.backBufferCount != refusedBackBufferCount)
+	{
+		if (!ResizeBackBuffers(static_cast<UINT>(settings.backBufferCount)))
+		{
+			OutputDebugStringA(("WARNING: can't resize the swap chain to " + std::to_string(settings.backBufferCount) + " buffers\n").c_str());
+			refusedBackBufferCount = settings.backBufferCount;
+		}
+	}
+	if (settings.backBufferCount != refusedBackBufferCount) {
+		refusedBackBufferCount = 0;
+	}
+	// g_renderSettings has to describe the swap chain as it is
+	settings.backBufferCount = static_cast<int>(g_swapChainBufferCount);
+	if (settings.maxFrameLatency != g_renderSettings.maxFrameLatency) {
+		g_framePacer.SetMaximumFrameLatency(settings.maxFrameLatency);
+	}
+	if (settings.useBundles != g_renderSettings.useBundles) {
+		g_bundleCache.Invalidate();
+	}
+	if (settings.textureBudgetMB != g_renderSettings.textureBudgetMB) {
+		g_textureStreamer.GetResidency().SetBudget(UINT64(settings.textureBudgetMB) * 1024 * 1024);
+	}
+	g_drawRecorder.parallel = settings.parallelDraws;
+	g_drawRecorder.minDrawsPerChunk = static_cast<uint32_t>(settings.minDrawsPerChunk);
+	g_renderSettings = settings;
+}
+
+void PublishRenderStats(const FramePacket& packet)
+{
+	const GpuProfileTree& gpuTree = g_gpuProfiler.GetTree();
+	GeometryPoolStats geometryStats = g_geometryPool.GetStats();
+	GpuHeapStats heapStats = g_gpuHeaps.GetStats();
+
+	std::lock_guard<std::mutex> lock(g_renderStatsMutex);
+	RenderStats& stats = g_renderStats;
+	stats.pacing = g_framePacing;
+	stats.pacer = g_framePacer.GetStats();
+	stats.bundles = g_bundleCache.GetStats();
+	stats.draws = g_drawRecorder.GetStats();
+	stats.maxDrawChunks = g_drawRecorder.GetMaxChunks();
+	stats.residency = g_textureStreamer.GetResidency().GetStats();
+	stats.packs = g_textureStreamer.GetPackStats();
+	stats.uploads = g_uploadService.GetStats();
+	stats.staging = g_uploadBackend.GetStagingRing().GetStats();
+	stats.dedicatedStaging = g_uploadBackend.GetStagingRing().GetDedicatedAllocations();
+	stats.streaming = g_streamingQueue.GetStats();
+	stats.asyncStreaming = g_streamingQueue.IsAsync();
+	stats.releases = g_releaseQueue.GetStats();
+	stats.geometry = geometryStats;
+	stats.heaps = heapStats;
+	stats.gpuProfiler = g_gpuProfiler.IsEnabled();
+	stats.gpuFrame = gpuTree.GetLatestFrame();
+	stats.gpuFrameMs = gpuTree.GetAverageFrameMs();
+	stats.gpuQueueLatencyMs = gpuTree.GetAverageQueueLatencyMs();
+
+	const FrameSample& sample = packet.sample;
+	int mode = packet.paced ? 0 : 1;
+	if (packet.frame > 0) {
+		stats.frameMs[mode] += (sample.ms[FramePhaseFrame] - stats.frameMs[mode]) * 0.05;
+	}
+	stats.inputToPresentMs[mode] += (sample.ms[FramePhaseInputToPresent] - stats.inputToPresentMs[mode]) * 0.05;
+}
 
-	// reset command allocator and command list
-	g_commandAllocator->Reset();
-	g_commandList->Reset(g_commandAllocator.Get(), g_pipelineState.Get()); // no pso yet so pass null
+void PopulateCommandList(FramePacket& packet)
+{
+	PROFILE_FUNCTION();
+	FrameContext& frame = g_frameContexts[g_frameContext];
+	memcpy(frame.matrixConstants, &packet.matrices, sizeof(MatrixBuffer));
+	memcpy(frame.lightConstants, &packet.light, sizeof(LightBuffer));
+
+	// reset command allocator and command list, MoveToNextFrame made sure the
+	// gpu is done with this context
+	frame.commandAllocator->Reset();
+	g_commandList->Reset(frame.commandAllocator.Get(), g_pipelineState.Get());
+	g_gpuProfiler.BeginFrame(g_frameContext);
+	g_gpuProfiler.BeginScope(g_commandList.Get(), "frame");
+
+	{
+		GpuProfileScope scope(g_gpuProfiler, g_commandList.Get(), "streaming");
+
+		// record mip uploads before any draw samples the textures
+		UpdateTextureStreaming(packet.cameraPosition);
+
+		// repacks the geometry buffers once removed meshes leave them fragmented,
+		// ranges have to be read after this
+		g_geometryPool.Compact();
+	}
 
 	// tell gpu that we will draw to it now by transitioning the back buffer from
 	// present state to a render target state
@@ -878,30 +1747,57 @@ void PopulateCommandList()
 	g_commandList->RSSetScissorRects(1, &scissorRect);
 
 	// issue commands to clear the render target
+	g_gpuProfiler.BeginScope(g_commandList.Get(), "clear");
 	g_commandList->ClearRenderTargetView(rtvHandle, g_clearColor, 0, nullptr);
-
-	ID3D12DescriptorHeap* mainHeaps[] = { g_textureSrvHeap.Get() };
-	g_commandList->SetDescriptorHeaps(_countof(mainHeaps), mainHeaps);
-
-	g_commandList->SetGraphicsRootSignature(g_rootSignature.Get());
-	g_commandList->SetGraphicsRootConstantBufferView(0, g_matrixConstantBuffer->GetGPUVirtualAddress());
-	g_commandList->SetGraphicsRootConstantBufferView(1, g_lightConstantBuffer->GetGPUVirtualAddress());
-	g_commandList->SetGraphicsRootDescriptorTable(2, g_textureHandle);
-
-	g_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	for (const auto& mesh : g_meshes)
+	g_gpuProfiler.EndScope(g_commandList.Get());
+	g_gpuProfiler.BeginScope(g_commandList.Get(), "meshes");
+
+	// every chunk list sets this state up again, lists don't inherit it
+	ID3D12PipelineState* pipelines[] = { g_pipelineState.Get(), g_maskedPipelineState.Get() };
+	D3D12DrawState drawState;
+	drawState.rootSignature = g_rootSignature.Get();
+	drawState.pipelines = pipelines;
+	drawState.pipelineCount = _countof(pipelines);
+	drawState.srvHeap = g_textureStreamer.GetSrvHeap();
+	drawState.matrixConstants = frame.matrixConstantsAddress;
+	drawState.lightConstants = frame.lightConstantsAddress;
+	drawState.renderTarget = rtvHandle;
+	drawState.depthStencil = g_dsvHandle;
+	drawState.viewport = viewport;
+	drawState.scissorRect = scissorRect;
+	drawState.vertexBuffer = g_geometryPool.GetVertexBufferView();
+	drawState.indexBuffer = g_geometryPool.GetIndexBufferView();
+	g_drawBackend.SetState(drawState);
+
+	BuildDrawList(packet);
+	uint32_t drawChunks = 0;
+	if (g_renderSettings.useBundles)
+	{
+		PROFILE_ZONE("execute bundles");
+		g_bundleCache.Update(g_drawItems, drawState);
+		g_bundleCache.Execute(g_commandList.Get(), drawState);
+		g_commandList->Close();
+	}
+	else
 	{
-		g_commandList->IASetVertexBuffers(0, 1, &mesh.vertexBufferView);
-		g_commandList->IASetIndexBuffer(&mesh.indexBufferView);
-		g_commandList->DrawIndexedInstanced(mesh.indexCount, 1, 0, 0, 0);
+		PROFILE_ZONE("record draws");
+		g_commandList->Close();
+		drawChunks = g_drawRecorder.Record(g_frameContext, g_drawItems);
 	}
 
+	// g_commandList is closed, so the frame's allocator can back this one now
+	g_postCommandList->Reset(frame.commandAllocator.Get(), nullptr);
+	g_gpuProfiler.EndScope(g_postCommandList.Get()); // meshes
+	g_postCommandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &g_dsvHandle);
+
 	// set imgui descriptor heaps before rendering
 	ID3D12DescriptorHeap* imGuiHeaps[] = { g_ImguiSrvDescHeap.Get() };
-	g_commandList->SetDescriptorHeaps(_countof(imGuiHeaps), imGuiHeaps);
+	g_postCommandList->SetDescriptorHeaps(_countof(imGuiHeaps), imGuiHeaps);
 
-	ImGui::Render();
-	ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), g_commandList.Get());
+	{
+		GpuProfileScope scope(g_gpuProfiler, g_postCommandList.Get(), "imgui");
+		ImGui_ImplDX12_RenderDrawData(packet.ui.GetDrawData(), g_postCommandList.Get());
+	}
 
 	// transition the back buffer back to a present state
 	auto barrier3 = CD3DX12_RESOURCE_BARRIER::Transition(
@@ -910,26 +1806,128 @@ void PopulateCommandList()
 		D3D12_RESOURCE_STATE_PRESENT
 	);
 
-	g_commandList->ResourceBarrier(1, &barrier3);
-	g_commandList->Close();
+	g_postCommandList->ResourceBarrier(1, &barrier3);
+	g_gpuProfiler.EndScope(g_postCommandList.Get()); // frame
+	g_gpuProfiler.EndFrame(g_postCommandList.Get());
+	g_postCommandList->Close();
+
+	g_frameCommandLists.clear();
+	g_frameCommandLists.push_back(g_commandList.Get());
+	if (drawChunks > 0) {
+		g_drawBackend.AppendCommandLists(g_frameCommandLists);
+	}
+	g_frameCommandLists.push_back(g_postCommandList.Get());
+}
+
+// the draws of the packet's meshes in order, opaque first. built on the
+// render thread, the texture streamer isn't safe to call from the recording workers
+void BuildDrawList(const FramePacket& packet)
+{
+	static_assert(sizeof(MaterialConstants) <= sizeof(DrawItem::constants), "material constants don't fit a draw item");
+	g_drawItems.clear();
+	for (uint32_t i : packet.meshes)
+	{
+		const RenderMesh& mesh = g_meshes[i];
+		const RenderMaterial& material = g_materials[mesh.materialIndex];
+		const GeometryRange& range = g_geometryPool.GetRange(mesh.geometry);
+
+		// every texture of an array shares the array's srv, so the recorder
+		// only switches tables where the array changes
+		DrawItem item = {};
+		item.pipeline = i < g_firstMaskedMesh ? 0 : 1;
+		item.descriptorTable = g_textureStreamer.GetSrv(material.diffuseTexture).ptr;
+		item.constantCount = sizeof(MaterialConstants) / 4;
+		memcpy(item.constants, &material.constants, sizeof(MaterialConstants));
+		item.indexCount = range.indexCount;
+		item.firstIndex = range.firstIndex;
+		item.baseVertex = static_cast<int32_t>(range.baseVertex);
+		g_drawItems.push_back(item);
+	}
+}
+
+void CreateBackBuffers()
+{
+	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(g_rtvHeap->GetCPUDescriptorHandleForHeapStart());
+	for (UINT n = 0; n < g_swapChainBufferCount; n++)
+	{
+		g_swapChain->GetBuffer(n, IID_PPV_ARGS(&g_renderTargets[n]));
+		g_device->CreateRenderTargetView(g_renderTargets[n].Get(), nullptr, rtvHandle);
+		rtvHandle.Offset(1, g_rtvDescriptorSize);
+	}
+}
+
+// ResizeBuffers needs every back buffer reference gone, the swap chain keeps
+// its buffers when it fails. returns whether the count changed
+bool ResizeBackBuffers(UINT count)
+{
+	WaitForGpu();
+	for (auto& renderTarget : g_renderTargets) {
+		renderTarget.Reset();
+	}
+
+	HRESULT hr = g_swapChain->ResizeBuffers(count, WindowWidth, WindowHeight,
+		DXGI_FORMAT_R8G8B8A8_UNORM, g_swapChainFlags);
+	if (SUCCEEDED(hr)) {
+		g_swapChainBufferCount = count;
+	}
+	CreateBackBuffers();
+	g_currentBackBuffer = g_swapChain->GetCurrentBackBufferIndex();
+	return SUCCEEDED(hr);
 }
 
-void WaitForPreviousFrame()
+// signals everything submitted so far and returns the value
+UINT64 SignalFence()
 {
-	// signal the fence with the current value
 	const UINT64 fence = g_fenceValue;
 	g_commandQueue->Signal(g_fence.Get(), fence);
 	g_fenceValue++;
+	g_releaseQueue.SetPendingFenceValue(g_fenceValue);
+	return fence;
+}
 
-	// wait for the previous frame if gpu is not done
+void WaitForFenceValue(UINT64 fence)
+{
 	if (g_fence->GetCompletedValue() < fence)
 	{
 		g_fence->SetEventOnCompletion(fence, g_fenceEvent);
 		WaitForSingleObject(g_fenceEvent, INFINITE);
 	}
+}
+
+double GetMilliseconds()
+{
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart * 1000.0 / frequency.QuadPart;
+}
+
+// idles the gpu, for setup and shutdown
+void WaitForGpu()
+{
+	WaitForFenceValue(SignalFence());
+	g_currentBackBuffer = g_swapChain->GetCurrentBackBufferIndex();
+}
+
+// ends the frame just submitted and waits until the next frame context is free
+void MoveToNextFrame()
+{
+	PROFILE_FUNCTION();
+	g_frameContexts[g_frameContext].fenceValue = SignalFence();
 
-	// update the index of the current back buffer
+	// a lowered setting just wraps earlier, the wait below keeps it safe
+	g_frameContext = (g_frameContext + 1) % static_cast<UINT>(g_renderSettings.framesInFlight);
 	g_currentBackBuffer = g_swapChain->GetCurrentBackBufferIndex();
+
+	double waitStart = GetMilliseconds();
+	WaitForFenceValue(g_frameContexts[g_frameContext].fenceValue);
+	double now = GetMilliseconds();
+
+	static double lastFrameEnd = now;
+	g_framePacing.frameMs += (now - lastFrameEnd - g_framePacing.frameMs) * 0.05;
+	g_framePacing.fenceWaitMs += (now - waitStart - g_framePacing.fenceWaitMs) * 0.05;
+	g_framePacing.framesQueued = g_fenceValue - 1 - g_fence->GetCompletedValue();
+	lastFrameEnd = now;
 }
 
 void LoadTexture()
@@ -1001,7 +1999,7 @@ void LoadTexture()
 	tempCommandList->Close();
 	ID3D12CommandList* ppCommandLists[] = { tempCommandList.Get() };
 	g_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
-	WaitForPreviousFrame();
+	WaitForGpu();
 
 	// create srv
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
@@ -1018,23 +2016,172 @@ void LoadTexture()
 	stbi_image_free(imageData);
 }
 
-void CleanupUploadResources()
+// draws a scope and its subtree, returns the index after the subtree
+size_t ShowGpuScope(const GpuFrameProfile& profile, size_t index)
+{
+	const GpuScopeNode& node = profile.scopes[index];
+	size_t next = index + 1;
+	bool leaf = next >= profile.scopes.size() || profile.scopes[next].depth <= node.depth;
+
+	ImGui::TableNextRow();
+	ImGui::TableNextColumn();
+	ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_SpanFullWidth | ImGuiTreeNodeFlags_DefaultOpen;
+	if (leaf) {
+		flags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+	}
+	bool open = ImGui::TreeNodeEx(reinterpret_cast<void*>(index), flags, "%s", node.name);
+	double values[] = { node.startMs, node.durationMs, node.selfMs, node.averageMs };
+	for (double value : values) {
+		ImGui::TableNextColumn();
+		if (node.valid) {
+			ImGui::Text("%.3f", value);
+		}
+		else {
+			ImGui::TextUnformatted("-");
+		}
+	}
+
+	if (open && !leaf)
+	{
+		while (next < profile.scopes.size() && profile.scopes[next].depth > node.depth) {
+			next = ShowGpuScope(profile, next);
+		}
+		ImGui::TreePop();
+	}
+	while (next < profile.scopes.size() && profile.scopes[next].depth > node.depth) {
+		next++;
+	}
+	return next;
+}
+
+void ShowGpuProfiler(const RenderStats& stats)
 {
-	// wait for GPU to finish all work
-	WaitForPreviousFrame();
-	WaitForPreviousFrame(); // double wait to be safe
+	ImGui::Begin("GPU Profiler");
+	if (!stats.gpuProfiler) {
+		ImGui::TextUnformatted("timestamp queries unavailable");
+		ImGui::End();
+		return;
+	}
+	const GpuFrameProfile& profile = stats.gpuFrame;
+	ImGui::Text("frame %llu: %.3f ms gpu (avg %.3f)", static_cast<unsigned long long>(profile.frame),
+		profile.durationMs, stats.gpuFrameMs);
+	// gpu clock mapped onto the cpu's through the queue's clock calibration
+	ImGui::Text("recorded to gpu start: %.3f ms (avg %.3f)", profile.queueLatencyMs, stats.gpuQueueLatencyMs);
+	if (ImGui::BeginTable("scopes", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+	{
+		const char* headers[] = { "scope", "start", "ms", "self", "avg" };
+		for (const char* header : headers) {
+			ImGui::TableSetupColumn(header);
+		}
+		ImGui::TableHeadersRow();
+		for (size_t i = 0; i < profile.scopes.size();) {
+			i = ShowGpuScope(profile, i);
+		}
+		ImGui::EndTable();
+	}
+	ImGui::End();
+}
 
-	// now it's safe to clear upload resources
-	g_uploadResources.clear();
+// local time for the names of exported files
+std::string GetTimestamp()
+{
+	SYSTEMTIME time;
+	GetLocalTime(&time);
+	char timestamp[32];
+	sprintf_s(timestamp, "%04u%02u%02u_%02u%02u%02u", time.wYear, time.wMonth, time.wDay,
+		time.wHour, time.wMinute, time.wSecond);
+	return timestamp;
 }
 
-void UpdateCamera(float deltaTime)
+void ShowFrameTelemetry()
 {
-	// if deltaTime is too small, use a fixed value to prevent micro-movement
-	if (deltaTime < 0.0001f) {
-		deltaTime = 0.016f; // ~60 FPS
+	ImGui::Begin("Frame Telemetry");
+	ImGui::SliderInt("Window (frames)", &g_telemetryWindow, 60, FrameTelemetry::Capacity);
+	ImGui::SliderFloat("Stutter factor", &g_frameTelemetry.stutterFactor, 1.25f, 4.0f);
+	FrameTelemetryStats stats = g_frameTelemetry.ComputeStats(static_cast<uint32_t>(g_telemetryWindow));
+	ImGui::Text("%u frames, %u stutters (over %.1fx the median frame)", stats.frames, stats.stutters, g_frameTelemetry.stutterFactor);
+	if (ImGui::BeginTable("phases", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit))
+	{
+		const char* headers[] = { "ms", "avg", "p50", "p95", "p99", "max" };
+		for (const char* header : headers) {
+			ImGui::TableSetupColumn(header);
+		}
+		ImGui::TableHeadersRow();
+		for (uint32_t phase = 0; phase < FramePhaseCount; phase++)
+		{
+			const FramePhaseStats& phaseStats = stats.phases[phase];
+			float values[] = { phaseStats.average, phaseStats.p50, phaseStats.p95, phaseStats.p99, phaseStats.max };
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(FrameTelemetry::GetPhaseName(static_cast<FramePhase>(phase)));
+			for (float value : values) {
+				ImGui::TableNextColumn();
+				ImGui::Text("%.2f", value);
+			}
+		}
+		ImGui::EndTable();
 	}
 
+	// named by time so runs of different builds can sit side by side
+	bool exportCsv = ImGui::Button("Export CSV");
+	ImGui::SameLine();
+	bool exportJson = ImGui::Button("Export JSON");
+	// every zone since startup, for chrome://tracing or ui.perfetto.dev
+	ImGui::SameLine();
+	bool exportTrace = ImGui::Button("Export CPU Trace");
+	static std::string exportStatus;
+	if (exportCsv || exportJson || exportTrace)
+	{
+		std::string timestamp = GetTimestamp();
+		std::string error;
+		std::string filename;
+		bool written = false;
+		if (exportTrace) {
+			filename = "cpu_trace_" + timestamp + ".json";
+			written = CpuProfiler::WriteChromeTrace(filename, error);
+		}
+		else {
+			filename = "frame_telemetry_" + timestamp + (exportCsv ? ".csv" : ".json");
+			written = exportCsv ? g_frameTelemetry.WriteCsv(filename, error) : g_frameTelemetry.WriteJson(filename, error);
+		}
+		exportStatus = written ? "wrote " + filename : error;
+	}
+	if (!exportStatus.empty()) {
+		ImGui::TextUnformatted(exportStatus.c_str());
+	}
+	ImGui::End();
+}
+
+void UpdateTextureStreaming(const XMFLOAT3& cameraPosition)
+{
+	PROFILE_FUNCTION();
+	g_textureStreamer.BeginFrame(++g_frameIndex);
+
+	XMVECTOR cameraPos = XMLoadFloat3(&cameraPosition);
+	for (const auto& mesh : g_meshes)
+	{
+		uint32_t texture = g_materials[mesh.materialIndex].diffuseTexture;
+
+		// distance to the closest point of the bounds, zero when the camera is inside
+		XMVECTOR boundsMin = XMLoadFloat3(&mesh.boundsMin);
+		XMVECTOR boundsMax = XMLoadFloat3(&mesh.boundsMax);
+		XMVECTOR closest = XMVectorClamp(cameraPos, boundsMin, boundsMax);
+		float distance = XMVectorGetX(XMVector3Length(cameraPos - closest));
+		float radius = 0.5f * XMVectorGetX(XMVector3Length(boundsMax - boundsMin));
+
+		float desiredMip = g_textureStreamer.ComputeDesiredMip(texture, mesh.worldUnitsPerUV,
+			distance, static_cast<float>(WindowHeight), g_verticalFov);
+
+		// projected size, nearby and large objects stream first
+		float priority = radius / std::max(distance, 1.0f);
+		g_textureStreamer.RequestMip(texture, desiredMip, priority);
+	}
+
+	g_textureStreamer.Update();
+}
+
+void UpdateCamera(float deltaTime)
+{
 	// camera movement
 	XMVECTOR cameraPos = XMLoadFloat3(&g_cameraPosition);
 	XMVECTOR cameraTarget = XMLoadFloat3(&g_cameraTarget);
@@ -1128,11 +2275,82 @@ void UpdateCamera(float deltaTime)
 		g_cameraTarget = { 0.0f, 0.0f, 0.0f };
 	}
 
-	// update view matrix
+	UpdateViewMatrix();
+}
+
+void UpdateCameraPath(float deltaTime)
+{
+	g_cameraPathTime += deltaTime;
+	float duration = g_cameraPath.GetDuration();
+	if (duration > 0.0f) {
+		g_cameraPathTime = fmod(g_cameraPathTime, duration);
+	}
+	CameraKey key = g_cameraPath.Sample(g_cameraPathTime);
+	g_cameraPosition = key.position;
+	g_cameraTarget = key.target;
+	UpdateViewMatrix();
+}
+
+void UpdateViewMatrix()
+{
 	XMMATRIX view = XMMatrixLookAtLH(
 		XMLoadFloat3(&g_cameraPosition),
 		XMLoadFloat3(&g_cameraTarget),
 		XMLoadFloat3(&g_cameraUp)
 	);
 	DirectX::XMStoreFloat4x4(&g_viewMatrix, view);
+}
+
+bool StartBenchmark(const std::vector<std::string>& args)
+{
+	if (args.size() < 2) {
+		std::printf("usage: --benchmark <atrium | corridor | closeup | path.campath> [frames] [timestep ms] [telemetry.json]\n");
+		return false;
+	}
+	// the standard sponza paths by name, anything else is a path file
+	std::string filename = args[1];
+	if (filename.find('.') == std::string::npos) {
+		filename = g_assetRoot + "benchmarks\\" + filename + ".campath";
+	}
+	std::string error;
+	if (!g_cameraPath.Load(filename, error)) {
+		std::printf("error: %s\n", error.c_str());
+		return false;
+	}
+	if (args.size() > 3) {
+		g_benchmark.timestep = std::max(0.1f, static_cast<float>(std::atof(args[3].c_str()))) / 1000.0f;
+	}
+	// once through the path unless told otherwise, longer runs loop it
+	g_benchmark.frames = args.size() > 2 ? std::max(1, std::atoi(args[2].c_str())) :
+		static_cast<int>(std::ceil(g_cameraPath.GetDuration() / g_benchmark.timestep)) + 1;
+	if (args.size() > 4) {
+		g_benchmark.telemetryFile = args[4];
+	}
+	g_benchmark.enabled = true;
+	g_cameraPathPlaying = true;
+	g_cameraPathTime = 0.0f;
+	// uncapped, the run measures the frame, not the display
+	g_settings.vsync = false;
+	return true;
+}
+
+int FinishBenchmark()
+{
+	// the telemetry ring keeps the last Capacity frames of longer runs
+	FrameTelemetryStats stats = g_frameTelemetry.ComputeStats(FrameTelemetry::Capacity);
+	std::printf("%u frames at %.2f ms steps, %u stutters\n", stats.frames, g_benchmark.timestep * 1000.0f, stats.stutters);
+	for (uint32_t phase = 0; phase < FramePhaseCount; phase++)
+	{
+		const FramePhaseStats& phaseStats = stats.phases[phase];
+		std::printf("%-13s avg %7.3f  p50 %7.3f  p95 %7.3f  p99 %7.3f  max %7.3f ms\n",
+			FrameTelemetry::GetPhaseName(static_cast<FramePhase>(phase)),
+			phaseStats.average, phaseStats.p50, phaseStats.p95, phaseStats.p99, phaseStats.max);
+	}
+	std::string error;
+	if (!g_benchmark.telemetryFile.empty() && !g_frameTelemetry.WriteJson(g_benchmark.telemetryFile, error)) {
+		std::printf("error: %s\n", error.c_str());
+		return 1;
+	}
+	std::fflush(stdout);
+	return 0;
 }
\ No newline at end of file